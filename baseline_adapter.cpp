@@ -6,9 +6,13 @@
 #include <rl_tools/nn/layers/dense/operations_arm/dsp.h>
 #include <rl_tools/nn_models/sequential/operations_generic.h>
 
+#include <cstddef>
+#include <cstring>
+#include <new>
+
 #include "data/actor_baseline.h"
+#include "rl_tools_adapter_spec.h"
 
-#define RL_TOOLS_CONTROL_STATE_ROTATION_MATRIX
 // #define RL_TOOLS_DISABLE_TEST
 
 
@@ -21,29 +25,35 @@ DEVICE device;
 using ACTOR_TYPE = actor::MODEL;
 using TI = typename ACTOR_TYPE::SPEC::TI;
 using T = typename ACTOR_TYPE::SPEC::T;
-constexpr TI CONTROL_FREQUENCY_MULTIPLE = 5;
-static TI controller_tick = 0;
-constexpr TI HISTORY_LENGTH = 2; //rlt::checkpoint::environment::ACTION_HISTORY_LENGTH
-constexpr TI INPUT_DIM_STATE = 13;
-constexpr TI INPUT_DIM_ACTION = 4;
-constexpr TI INPUT_DIM_PER_STEP = INPUT_DIM_STATE + INPUT_DIM_ACTION; //rlt::checkpoint::environment::ACTION_HISTORY_LENGTH
-static_assert(ACTOR_TYPE::SPEC::INPUT_DIM == (INPUT_DIM_PER_STEP * HISTORY_LENGTH));
-static bool initialized = false;
-
-// State
-static ACTOR_TYPE::template Buffer<1, rlt::MatrixStaticTag> buffers;
-static rlt::MatrixStatic<rlt::matrix::Specification<T, TI, 1, ACTOR_TYPE::SPEC::INPUT_DIM>> input_history;
-static rlt::MatrixStatic<rlt::matrix::Specification<T, TI, 1, ACTOR_TYPE::SPEC::INPUT_DIM>> input_buffer;
-static rlt::MatrixStatic<rlt::matrix::Specification<T, TI, 1, INPUT_DIM_PER_STEP>> current_input;
-static rlt::MatrixStatic<rlt::matrix::Specification<T, TI, 1, ACTOR_TYPE::SPEC::OUTPUT_DIM>> output;
-#ifdef RL_TOOLS_ACTION_HISTORY
-static T action_history[ACTION_HISTORY_LENGTH][ACTOR_TYPE::SPEC::OUTPUT_DIM];
-#endif
+// The baseline checkpoint predates the rl_tools::checkpoint export and carries no metadata, so its training setup is
+// spelled out here: two steps of (state, previous action), advanced on every invocation, normalized by
+// observation_mean/observation_std
+using OBSERVATION_SPEC = rl_tools_adapter::ObservationSpec<TI, rl_tools_adapter::Orientation::QUATERNION_XYZW, ACTOR_TYPE::SPEC::OUTPUT_DIM, 2, 1, true, true>;
+static_assert(OBSERVATION_SPEC::INPUT_DIM == ACTOR_TYPE::SPEC::INPUT_DIM, "The baseline observation spec does not match the actor input dimension");
+constexpr TI CONTROL_FREQUENCY_MULTIPLE = OBSERVATION_SPEC::CONTROL_FREQUENCY_MULTIPLE;
+constexpr TI HISTORY_LENGTH = OBSERVATION_SPEC::ACTION_HISTORY_LENGTH;
+constexpr TI INPUT_DIM_STATE = OBSERVATION_SPEC::STATE_DIM;
+constexpr TI INPUT_DIM_ACTION = OBSERVATION_SPEC::ACTION_DIM;
+constexpr TI INPUT_DIM_PER_STEP = INPUT_DIM_STATE + INPUT_DIM_ACTION;
+
+// State (per vehicle, the weights are shared)
+struct rl_tools_context{
+    ACTOR_TYPE::template Buffer<1, rlt::MatrixStaticTag> buffers;
+    rlt::MatrixStatic<rlt::matrix::Specification<T, TI, 1, ACTOR_TYPE::SPEC::INPUT_DIM>> input_history;
+    rlt::MatrixStatic<rlt::matrix::Specification<T, TI, 1, ACTOR_TYPE::SPEC::INPUT_DIM>> input_buffer;
+    rlt::MatrixStatic<rlt::matrix::Specification<T, TI, 1, INPUT_DIM_PER_STEP>> current_input;
+    rlt::MatrixStatic<rlt::matrix::Specification<T, TI, 1, ACTOR_TYPE::SPEC::OUTPUT_DIM>> output;
+    bool initialized;
+    TI controller_tick;
+};
+static_assert(alignof(rl_tools_context) <= alignof(std::max_align_t), "rl_tools_context_init expects malloc-aligned memory");
+static rl_tools_context default_context;
 
 
 // Helper functions (without side-effects)
 template <typename STATE_SPEC, typename OBS_SPEC>
 static inline void observe(const rlt::Matrix<STATE_SPEC>& state, rlt::Matrix<OBS_SPEC>& observation){
+    static_assert(OBSERVATION_SPEC::ORIENTATION == rl_tools_adapter::Orientation::QUATERNION_XYZW);
     static_assert(OBS_SPEC::ROWS == 1);
     static_assert(OBS_SPEC::COLS == INPUT_DIM_STATE);
     float qw = rlt::get(state, 0, 3);
@@ -77,28 +87,118 @@ static inline void observe(const rlt::Matrix<STATE_SPEC>& state, rlt::Matrix<OBS
 
 // Main functions (possibly with side effects)
 void rl_tools_init(){
-    rlt::malloc(device, buffers);
-    rlt::malloc(device, input_history);
-    rlt::malloc(device, input_buffer);
-    rlt::malloc(device, current_input);
-    rlt::malloc(device, output);
-    rlt::set_all(device, output, 0);
-    initialized = false;
-#ifdef RL_TOOLS_ACTION_HISTORY
-    for(TI step_i = 0; step_i < ACTION_HISTORY_LENGTH; step_i++){
-        for(TI action_i = 0; action_i < ACTOR_TYPE::SPEC::OUTPUT_DIM; action_i++){
-            action_history[step_i][action_i] = 0;
-        }
-    }
-#endif
-    controller_tick = 0;
+    rl_tools_context_init(&default_context);
+}
+
+unsigned int rl_tools_context_size(){
+    return sizeof(rl_tools_context);
+}
+
+rl_tools_context_t* rl_tools_context_init(void* memory){
+    rl_tools_context* context = new (memory) rl_tools_context;
+    rlt::malloc(device, context->buffers);
+    rlt::malloc(device, context->input_history);
+    rlt::malloc(device, context->input_buffer);
+    rlt::malloc(device, context->current_input);
+    rlt::malloc(device, context->output);
+    rlt::set_all(device, context->output, 0);
+    context->initialized = false;
+    context->controller_tick = 0;
+    return context;
+}
+
+rl_tools_context_t* rl_tools_context_default(){
+    return &default_context;
 }
 
 char* rl_tools_get_checkpoint_name(){
     return "baseline"; 
 }
 
-float rl_tools_test(float* output_mem){
+// No core-coupled memory placement: weights in flash, state in SRAM
+unsigned int rl_tools_ccm_usage(unsigned int* placement, unsigned int* flash_bytes){
+    if(placement != nullptr){
+        *placement = 0;
+    }
+    if(flash_bytes != nullptr){
+        *flash_bytes = 0; // not tracked
+    }
+    return 0;
+}
+
+// No kernel registry: the baseline always evaluates through rl_tools
+unsigned int rl_tools_kernel_layers(){
+    return 0;
+}
+
+int rl_tools_kernel_available(unsigned char kernel){
+    return kernel == RL_TOOLS_KERNEL_RL_TOOLS;
+}
+
+const char* rl_tools_kernel_name(unsigned char kernel){
+    return kernel == RL_TOOLS_KERNEL_RL_TOOLS ? "rl_tools" : "unknown";
+}
+
+unsigned char rl_tools_kernel_get(const rl_tools_context_t* context, unsigned int layer){
+    return RL_TOOLS_KERNEL_RL_TOOLS;
+}
+
+int rl_tools_kernel_set(rl_tools_context_t* context, unsigned int layer, unsigned char kernel){
+    return kernel == RL_TOOLS_KERNEL_RL_TOOLS;
+}
+
+float rl_tools_kernel_autotune(rl_tools_context_t* context, unsigned int repetitions, unsigned char* selection, float* rl_tools_us){
+    for(unsigned int layer_i = 0; layer_i < rl_tools_kernel_layers(); layer_i++){
+        selection[layer_i] = RL_TOOLS_KERNEL_RL_TOOLS;
+    }
+    if(rl_tools_us != nullptr){
+        *rl_tools_us = 0;
+    }
+    return -1; // nothing to tune
+}
+
+void rl_tools_context_set_layer_callback(rl_tools_context_t* context, void (*callback)(const rl_tools_context_t* context, unsigned int layer)){
+}
+
+void rl_tools_layer_dims(unsigned int layer, unsigned int* input_dim, unsigned int* output_dim){
+    *input_dim = 0;
+    *output_dim = 0;
+}
+
+// No reduced precision: the baseline always evaluates in fp32
+int rl_tools_precision_available(unsigned int layer, unsigned char weights, unsigned char activations){
+    return weights == RL_TOOLS_PRECISION_FP32 && activations == RL_TOOLS_PRECISION_ACTIVATIONS_FP32;
+}
+
+const char* rl_tools_precision_name(unsigned char weights, unsigned char activations){
+    return weights == RL_TOOLS_PRECISION_FP32 && activations == RL_TOOLS_PRECISION_ACTIVATIONS_FP32 ? "fp32" : "unknown";
+}
+
+int rl_tools_precision_set(unsigned int layer, unsigned char weights, unsigned char activations, float range){
+    return rl_tools_precision_available(layer, weights, activations);
+}
+
+unsigned char rl_tools_precision_get(unsigned int layer, unsigned char* activations, float* range){
+    if(activations != nullptr){
+        *activations = RL_TOOLS_PRECISION_ACTIVATIONS_FP32;
+    }
+    if(range != nullptr){
+        *range = 0;
+    }
+    return RL_TOOLS_PRECISION_FP32;
+}
+
+void rl_tools_precision_track_ranges(rl_tools_context_t* context, int enable){
+}
+
+void rl_tools_precision_ranges(const rl_tools_context_t* context, float* ranges){
+}
+
+int rl_tools_precision_write_config(const char* path, const char* comment){
+    return 0;
+}
+
+float rl_tools_context_test(rl_tools_context_t* context, float* output_mem){
 #ifndef RL_TOOLS_DISABLE_TEST
     // rlt::MatrixStatic<rlt::matrix::Specification<T, TI, 1, ACTOR_TYPE::SPEC::INPUT_DIM>> input;
     // rlt::malloc(device, input);
@@ -109,15 +209,15 @@ float rl_tools_test(float* output_mem){
         if(input_i == 2){
             input_value = 1.0;
         }
-        rlt::set(input_buffer, 0, input_i, (input_value - mean) / std);
+        rlt::set(context->input_buffer, 0, input_i, (input_value - mean) / std);
     }
 
-    rlt::evaluate(device, actor::model, input_buffer, output, buffers);
+    rlt::evaluate(device, actor::model, context->input_buffer, context->output, context->buffers);
     // float acc = 0;
     // observation_mean::container._data = observation_mean::memory;
     for(int i = 0; i < ACTOR_TYPE::SPEC::OUTPUT_DIM; i++){
         // acc += std::abs(rlt::get(output, 0, i) - rlt::get(rlt::checkpoint::action::container, 0, i));
-        output_mem[i] = rlt::get(output, 0, i);
+        output_mem[i] = rlt::get(context->output, 0, i);
     }
     return 0; //acc;
 #else
@@ -125,40 +225,89 @@ float rl_tools_test(float* output_mem){
 #endif
 }
 
+float rl_tools_test(float* output_mem){
+    return rl_tools_context_test(&default_context, output_mem);
+}
 
-void rl_tools_control(float* state, float* actions){
-    if(!initialized){
-        rlt::set_all(device, input_history, 0);
-        initialized = true;
+
+void rl_tools_context_control(rl_tools_context_t* context, float* state, float* actions){
+    if(!context->initialized){
+        rlt::set_all(device, context->input_history, 0);
+        context->initialized = true;
     }
-    for(TI step_i = 0; step_i < HISTORY_LENGTH - 1; step_i++){
-        auto current_step_source = rlt::view(device, input_history, rlt::matrix::ViewSpec<1, INPUT_DIM_PER_STEP>{}, 0, (step_i+1)*INPUT_DIM_PER_STEP);
-        auto current_step_target = rlt::view(device, input_history, rlt::matrix::ViewSpec<1, INPUT_DIM_PER_STEP>{}, 0, step_i*INPUT_DIM_PER_STEP);
-        rlt::copy(device, device, current_step_source, current_step_target);
+    if(context->controller_tick % CONTROL_FREQUENCY_MULTIPLE == 0){
+        for(TI step_i = 0; step_i < HISTORY_LENGTH - 1; step_i++){
+            auto current_step_source = rlt::view(device, context->input_history, rlt::matrix::ViewSpec<1, INPUT_DIM_PER_STEP>{}, 0, (step_i+1)*INPUT_DIM_PER_STEP);
+            auto current_step_target = rlt::view(device, context->input_history, rlt::matrix::ViewSpec<1, INPUT_DIM_PER_STEP>{}, 0, step_i*INPUT_DIM_PER_STEP);
+            rlt::copy(device, device, current_step_source, current_step_target);
+        }
+        auto last_action = rlt::view(device, context->input_history, rlt::matrix::ViewSpec<1, INPUT_DIM_ACTION>{}, 0, (HISTORY_LENGTH-1)*INPUT_DIM_PER_STEP + INPUT_DIM_STATE);
+        rlt::copy(device, device, context->output, last_action);
     }
-    auto last_action = rlt::view(device, input_history, rlt::matrix::ViewSpec<1, INPUT_DIM_ACTION>{}, 0, (HISTORY_LENGTH-1)*INPUT_DIM_PER_STEP + INPUT_DIM_STATE);
-    rlt::copy(device, device, output, last_action);
 
     rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, 1, 13, rlt::matrix::layouts::RowMajorAlignment<TI, 1>>> state_matrix = {(T*)state}; 
-    auto last_step_input = rlt::view(device, input_history, rlt::matrix::ViewSpec<1, INPUT_DIM_STATE>{}, 0, (HISTORY_LENGTH-1)*INPUT_DIM_PER_STEP);
+    auto last_step_input = rlt::view(device, context->input_history, rlt::matrix::ViewSpec<1, INPUT_DIM_STATE>{}, 0, (HISTORY_LENGTH-1)*INPUT_DIM_PER_STEP);
     observe(state_matrix, last_step_input);
     for(TI input_i=0; input_i < ACTOR_TYPE::SPEC::INPUT_DIM; input_i++){
-        T value = rlt::get(input_history, 0, input_i);
-        T mean = rlt::get(observation_mean::container, 0, input_i);
-        T std = rlt::get(observation_std::container, 0, input_i);
-        T normalized = (value - mean) / std;
-        rlt::set(input_buffer, 0, input_i, normalized);
+        T value = rlt::get(context->input_history, 0, input_i);
+        if constexpr(OBSERVATION_SPEC::NORMALIZATION){
+            T mean = rlt::get(observation_mean::container, 0, input_i);
+            T std = rlt::get(observation_std::container, 0, input_i);
+            value = (value - mean) / std;
+        }
+        rlt::set(context->input_buffer, 0, input_i, value);
     }
     // rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, 1, ACTOR_TYPE::SPEC::OUTPUT_DIM, rlt::matrix::layouts::RowMajorAlignment<TI, 1>>> output = {(T*)actions};
-    rlt::evaluate(device, actor::model, input_buffer, output, buffers);
+    rlt::evaluate(device, actor::model, context->input_buffer, context->output, context->buffers);
     for(TI action_i = 0; action_i < ACTOR_TYPE::SPEC::OUTPUT_DIM; action_i++){
-        T thrust = rlt::get(output, 0, action_i);
+        T thrust = rlt::get(context->output, 0, action_i);
         T clipped_thrust = thrust < -1.0 ? -1.0 : (thrust > 1.0 ? 1.0 : thrust);
         T normed_thrust = (clipped_thrust + 1)/2;
         T normed_rpm = rlt::math::sqrt(device.math, normed_thrust);
         actions[action_i] = normed_rpm * 2.0 - 1.0;
     }
+    context->controller_tick++;
+}
+
+// Teacher forcing is not supported by the baseline adapter
+int rl_tools_context_observe(rl_tools_context_t* context, float* state, const float* actions, float* observation, int normalized){
+    return 0;
 }
+
+unsigned int rl_tools_observation_layout(unsigned int* state_dim, unsigned int* action_dim){
+    *state_dim = 0;
+    *action_dim = 0;
+    return 0;
+}
+
+void rl_tools_control(float* state, float* actions){
+    rl_tools_context_control(&default_context, state, actions);
+}
+constexpr TI STATE_SIZE = 2 + ACTOR_TYPE::SPEC::INPUT_DIM + ACTOR_TYPE::SPEC::OUTPUT_DIM; // initialized, tick, history, last action
+static_assert(sizeof(T) == sizeof(uint32_t));
+
+unsigned int rl_tools_context_save_state(const rl_tools_context_t* context, uint32_t* state, unsigned int capacity){
+    if(STATE_SIZE > capacity){
+        return 0;
+    }
+    state[0] = context->initialized ? 1 : 0;
+    state[1] = (uint32_t)context->controller_tick;
+    memcpy(state + 2, context->input_history._data, ACTOR_TYPE::SPEC::INPUT_DIM * sizeof(T));
+    memcpy(state + 2 + ACTOR_TYPE::SPEC::INPUT_DIM, context->output._data, ACTOR_TYPE::SPEC::OUTPUT_DIM * sizeof(T));
+    return STATE_SIZE;
+}
+
+bool rl_tools_context_restore_state(rl_tools_context_t* context, const uint32_t* state, unsigned int size){
+    if(size != STATE_SIZE){
+        return false;
+    }
+    context->initialized = state[0] != 0;
+    context->controller_tick = state[1];
+    memcpy(context->input_history._data, state + 2, ACTOR_TYPE::SPEC::INPUT_DIM * sizeof(T));
+    memcpy(context->output._data, state + 2 + ACTOR_TYPE::SPEC::INPUT_DIM, ACTOR_TYPE::SPEC::OUTPUT_DIM * sizeof(T));
+    return true;
+}
+
 // void rl_tools_control_other(float* state, float* actions){
 //     int substep = controller_tick % CONTROL_FREQUENCY_MULTIPLE;
 //     rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, 1, 13, rlt::matrix::layouts::RowMajorAlignment<TI, 1>>> state_matrix = {(T*)state}; 
@@ -0,0 +1,22 @@
+#include "battery_comp.h"
+
+void battery_comp_init(battery_comp_t* comp){
+  comp->voltage = -1;
+  battery_comp_update(comp, BATTERY_COMP_REFERENCE_VOLTAGE, 0);
+}
+
+bool battery_comp_update(battery_comp_t* comp, float supply_voltage, float threshold){
+  float diff = supply_voltage - comp->voltage;
+  if(diff <= threshold && diff >= -threshold && comp->voltage >= 0){
+    return false;
+  }
+  comp->voltage = supply_voltage;
+  float voltage = supply_voltage < BATTERY_COMP_VOLTAGE_MIN ? BATTERY_COMP_VOLTAGE_MIN : supply_voltage;
+  comp->scale = (uint32_t)(BATTERY_COMP_REFERENCE_VOLTAGE / voltage * (1 << BATTERY_COMP_SCALE_SHIFT) + 0.5f);
+  return true;
+}
+
+uint16_t battery_comp_apply(const battery_comp_t* comp, uint16_t cmd){
+  uint32_t pwm = ((uint32_t)cmd * comp->scale) >> BATTERY_COMP_SCALE_SHIFT;
+  return pwm > UINT16_MAX ? UINT16_MAX : (uint16_t)pwm;
+}
@@ -0,0 +1,29 @@
+#ifndef __BATTERY_COMP_H__
+#define __BATTERY_COMP_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Battery compensation of the learned-policy motor path.
+// A brushed motor settles at the RPM of its mean voltage PWM * supply voltage, so the command (linear in RPM,
+// 0..UINT16_MAX, as trained at BATTERY_COMP_REFERENCE_VOLTAGE) is scaled by BATTERY_COMP_REFERENCE_VOLTAGE / supply
+// voltage and capped to the PWM range. The mapping is the identity at the reference voltage, so it does not change the
+// policy's gain. (motorsCompensateBatteryVoltage() of the PID path maps thrust in grams, not a command linear in RPM,
+// and is not used here.)
+#define BATTERY_COMP_REFERENCE_VOLTAGE 4.2f
+#define BATTERY_COMP_VOLTAGE_MIN 3.0f // lower voltages are compensated as this one
+#define BATTERY_COMP_SCALE_SHIFT 15 // fixed-point scale, UINT16_MAX * REFERENCE / MIN << 15 fits in 32 bit
+
+// Scale for the voltage of the last refresh, held per controller context
+typedef struct {
+  uint32_t scale; // BATTERY_COMP_REFERENCE_VOLTAGE / voltage << BATTERY_COMP_SCALE_SHIFT
+  float voltage;
+} battery_comp_t;
+
+void battery_comp_init(battery_comp_t* comp);
+// Recomputes the scale if the voltage moved by more than threshold since the last refresh.
+// Returns true if a refresh happened.
+bool battery_comp_update(battery_comp_t* comp, float supply_voltage, float threshold);
+uint16_t battery_comp_apply(const battery_comp_t* comp, uint16_t cmd);
+
+#endif
@@ -0,0 +1,150 @@
+// Replays a controller trace through controllerOutOfTree and measures SysTick cycles per call and the stack high-water
+// mark of the calls
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "stabilizer_types.h"
+#include "log.h"
+#include "firmware.h"
+#include "controller_trace.h"
+#include "rl_tools_controller.h"
+#include "rl_tools_adapter.h"
+
+void controllerOutOfTreeInit(void);
+bool controllerOutOfTreeTest(void);
+void controllerOutOfTree(control_t *control, setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick);
+
+#define SYST_CSR (*(volatile uint32_t*)0xE000E010)
+#define SYST_RVR (*(volatile uint32_t*)0xE000E014)
+#define SYST_CVR (*(volatile uint32_t*)0xE000E018)
+#define SYST_CSR_ENABLE (1 << 0)
+#define SYST_CSR_CLKSOURCE (1 << 2) // processor clock
+#define SYST_MASK 0x00FFFFFF
+#define CONTROL_INTERVAL_MS 2 // as in rl_tools_controller.c: inference on every second tick
+#ifndef BENCH_ORIG_CONTROLLER
+#define BENCH_ORIG_CONTROLLER 0 // rlt.orig
+#endif
+#ifndef BENCH_FLASH_WAIT_STATES
+#define BENCH_FLASH_WAIT_STATES 5 // 168 MHz at 3.3 V
+#endif
+#define FLASH_LINE_BYTES 16 // ART accelerator: one 128-bit flash line per miss
+#define STACK_PATTERN 0xA5A5A5A5u
+#define STACK_MARGIN 256 // [bytes] below the stack pointer of main that stay unpainted
+
+enum { CATEGORY_IDLE, CATEGORY_ACTIVE, CATEGORY_ACTIVE_INFERENCE, CATEGORY_COUNT };
+static const char* category_names[CATEGORY_COUNT] = {"inactive", "active (no inference)", "active (inference)"};
+
+extern const controller_trace_record_t trace_begin[];
+extern const controller_trace_record_t trace_end[];
+extern uint32_t _ebss, _estack; // free RAM between .bss and the stack (the heap is in CCM, see stm32f405.ld)
+
+static uint32_t cycles[CATEGORY_COUNT][2048];
+static uint32_t counts[CATEGORY_COUNT];
+
+static inline uint32_t systick(void){
+  return SYST_CVR;
+}
+
+// Paints the free RAM below the current stack pointer, returns its lowest word
+static uint32_t* stack_paint(void){
+  uint32_t* sp = (uint32_t*)__builtin_frame_address(0) - STACK_MARGIN / sizeof(uint32_t);
+  for(uint32_t* word = &_ebss; word < sp; word++){
+    *word = STACK_PATTERN;
+  }
+  return &_ebss;
+}
+
+// Bytes from the top of the stack down to the lowest word that is no longer painted
+static uint32_t stack_used(const uint32_t* painted){
+  while(painted < &_estack && *painted == STACK_PATTERN){
+    painted++;
+  }
+  return (uint32_t)((const uint8_t*)&_estack - (const uint8_t*)painted);
+}
+
+static int compare(const void* a, const void* b){
+  uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+int main(void){
+  SYST_RVR = SYST_MASK;
+  SYST_CVR = 0;
+  SYST_CSR = SYST_CSR_CLKSOURCE | SYST_CSR_ENABLE;
+
+  controllerOutOfTreeInit();
+  controllerOutOfTreeTest();
+  const struct log_s* set_motors = sim_log_find("rltrp.sm");
+  if(sim_firmware_classic_stubbed(BENCH_ORIG_CONTROLLER)){
+    printf("rlt.orig=%d: only the zero-output stand-in of sim/firmware.c is linked, build with CLASSIC=1 (or CLASSIC_OBJS)\n", BENCH_ORIG_CONTROLLER);
+    return 1;
+  }
+  if(BENCH_ORIG_CONTROLLER != 0){
+    char orig[32];
+    snprintf(orig, sizeof(orig), "rlt.orig=%d", BENCH_ORIG_CONTROLLER);
+    sim_firmware_set_param_string(orig);
+  }
+  uint32_t* painted = stack_paint();
+
+  uint32_t start = systick();
+  uint32_t overhead = (start - systick()) & SYST_MASK;
+
+  size_t records = trace_end - trace_begin;
+  uint64_t last_packet = 0;
+  for(size_t record_i = 0; record_i < records; record_i++){
+    const controller_trace_record_t* record = &trace_begin[record_i];
+    uint64_t packet = controller_trace_packet_timestamp(record);
+    if(packet != last_packet){
+      sim_firmware_set_time(packet);
+      rl_tools_controller_packet_received();
+      last_packet = packet;
+    }
+    setpoint_t setpoint;
+    sensorData_t sensors;
+    state_t state;
+    control_t control = {0};
+    controller_trace_unpack(record, &setpoint, &sensors, &state);
+    sim_firmware_set_time(controller_trace_timestamp(record));
+    sim_firmware_set_battery_voltage(record->battery_voltage);
+
+    start = systick();
+    controllerOutOfTree(&control, &setpoint, &sensors, &state, record->tick);
+    uint32_t elapsed = ((start - systick()) & SYST_MASK) - overhead;
+
+    int category = CATEGORY_IDLE;
+    if(sim_log_value(set_motors) > 0){
+      category = record->tick % CONTROL_INTERVAL_MS == 0 ? CATEGORY_ACTIVE_INFERENCE : CATEGORY_ACTIVE;
+    }
+    if(counts[category] < sizeof(cycles[category]) / sizeof(cycles[category][0])){
+      cycles[category][counts[category]++] = elapsed;
+    }
+  }
+
+  uint32_t stack = stack_used(painted);
+  printf("%u controllerOutOfTree calls replayed (rlt.orig=%d)\n", (unsigned)records, BENCH_ORIG_CONTROLLER);
+  printf("stack high-water mark: %u bytes\n", (unsigned)stack);
+  // QEMU counts instructions without flash wait states: the model charges them for the weights still read from flash,
+  // one line per miss since the weights stream past the 8-line ART data cache
+  unsigned int ccm_placement = 0, flash_bytes = 0;
+  unsigned int ccm_bytes = rl_tools_ccm_usage(&ccm_placement, &flash_bytes);
+  uint32_t wait_cycles = (flash_bytes + FLASH_LINE_BYTES - 1) / FLASH_LINE_BYTES * BENCH_FLASH_WAIT_STATES;
+  printf("CCM: %u bytes (placement 0x%x), %u weight bytes per inference from flash: +%u cycles at %d wait states (model)\n",
+    ccm_bytes, ccm_placement, flash_bytes, (unsigned)wait_cycles, BENCH_FLASH_WAIT_STATES);
+  printf("%-24s %8s %10s %10s %10s %10s\n", "cycles", "calls", "min", "median", "p99", "max");
+  for(int category = 0; category < CATEGORY_COUNT; category++){
+    uint32_t n = counts[category];
+    if(n == 0){
+      continue;
+    }
+    qsort(cycles[category], n, sizeof(uint32_t), compare);
+    printf("%-24s %8u %10u %10u %10u %10u\n", category_names[category], (unsigned)n, (unsigned)cycles[category][0],
+      (unsigned)cycles[category][n / 2], (unsigned)cycles[category][(n * 99) / 100], (unsigned)cycles[category][n - 1]);
+  }
+  // Single line for per-commit tracking
+  uint32_t n = counts[CATEGORY_ACTIVE_INFERENCE];
+  uint32_t median = n ? cycles[CATEGORY_ACTIVE_INFERENCE][n / 2] : 0;
+  printf("RESULT inference_cycles_median=%u inference_cycles_wait_states=%u stack_bytes=%u ccm_bytes=%u\n", (unsigned)median,
+    (unsigned)(n ? median + wait_cycles : 0), (unsigned)stack, ccm_bytes);
+  return 0;
+}
@@ -0,0 +1,54 @@
+// Minimal Cortex-M4 startup for the benchmark: vector table, .data/.bss/.ccmram init, FPU enable, semihosting, C++ init
+#include <stdint.h>
+#include <stdlib.h>
+
+extern uint32_t _sidata, _sdata, _edata, _sbss, _ebss, _sccmram, _eccmram, _estack;
+extern void __libc_init_array(void);
+extern void initialise_monitor_handles(void);
+int main(void);
+
+#define SCB_CPACR (*(volatile uint32_t*)0xE000ED88)
+
+void Reset_Handler(void){
+  uint32_t* source = &_sidata;
+  for(uint32_t* destination = &_sdata; destination < &_edata; destination++){
+    *destination = *source++;
+  }
+  for(uint32_t* destination = &_sbss; destination < &_ebss; destination++){
+    *destination = 0;
+  }
+  for(uint32_t* destination = &_sccmram; destination < &_eccmram; destination++){
+    *destination = 0;
+  }
+  SCB_CPACR |= (0xFu << 20); // CP10/CP11 full access
+  __asm__ volatile("dsb\n isb");
+  initialise_monitor_handles();
+  __libc_init_array();
+  exit(main());
+}
+
+static void Default_Handler(void){
+  // Faults end the emulation with a non-zero exit code instead of hanging
+  exit(2);
+}
+
+// Linked with -nostartfiles, so crti/crtn are not there to provide these
+void _init(void){}
+void _fini(void){}
+
+__attribute__((section(".isr_vector"), used))
+static void (* const vector_table[16])(void) = {
+  (void (*)(void))&_estack,
+  Reset_Handler,
+  Default_Handler, // NMI
+  Default_Handler, // HardFault
+  Default_Handler, // MemManage
+  Default_Handler, // BusFault
+  Default_Handler, // UsageFault
+  0, 0, 0, 0,
+  Default_Handler, // SVCall
+  Default_Handler, // DebugMonitor
+  0,
+  Default_Handler, // PendSV
+  Default_Handler, // SysTick
+};
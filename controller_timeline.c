@@ -0,0 +1,166 @@
+#include "controller_timeline.h"
+#include <string.h>
+#include "log.h"
+#include "param.h"
+#include "mem.h"
+#include "usec_time.h"
+#ifdef RL_TOOLS_HOST_SIM
+#include <time.h>
+#endif
+
+#ifdef RL_TOOLS_HOST_SIM
+#define TIMELINE_CLOCK_HZ 1000000000 // the virtual usecTimestamp() does not advance within an invocation
+static inline uint64_t timeline_clock(void){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+#else
+#define TIMELINE_CLOCK_HZ 1000000
+static inline uint64_t timeline_clock(void){
+  return usecTimestamp();
+}
+#endif
+
+enum RecorderMode{
+  RECORDER_STOPPED = 0,
+  RECORDER_RING = 1,
+  RECORDER_ONE_SHOT = 2,
+};
+
+static controller_timeline_record_t recorder_buffer[CONTROLLER_TIMELINE_RECORDER_LENGTH];
+static controller_timeline_record_t current;
+static uint64_t current_start;
+static uint8_t recorder_mode = RECORDER_STOPPED;
+static uint8_t recorder_previous_mode = RECORDER_STOPPED;
+static uint32_t recorder_count = 0; // valid records in the buffer
+static uint32_t recorder_next = 0; // slot of the next record
+static uint32_t recorder_dropped = 0;
+static bool recording = false; // current is being filled
+static void (*recorder_sink)(const controller_timeline_record_t* record) = 0;
+
+void controller_timeline_file_header(controller_timeline_header_t* header){
+  memset(header, 0, sizeof(*header));
+  header->magic = CONTROLLER_TIMELINE_MAGIC;
+  header->version = CONTROLLER_TIMELINE_VERSION;
+  header->record_size = sizeof(controller_timeline_record_t);
+  header->clock_hz = TIMELINE_CLOCK_HZ;
+}
+
+static uint32_t recorder_memory_size(void){
+  return sizeof(controller_timeline_header_t) + recorder_count * sizeof(controller_timeline_record_t);
+}
+
+static bool recorder_memory_read(const uint32_t address, const uint8_t length, uint8_t* buffer){
+  if(recorder_mode != RECORDER_STOPPED || address + length > recorder_memory_size()){
+    return false;
+  }
+  controller_timeline_header_t header;
+  controller_timeline_file_header(&header);
+  header.count = recorder_count;
+  header.dropped = recorder_dropped;
+  uint32_t oldest = recorder_count < CONTROLLER_TIMELINE_RECORDER_LENGTH ? 0 : recorder_next;
+  for(uint32_t i = 0; i < length; i++){
+    uint32_t offset = address + i;
+    if(offset < sizeof(header)){
+      buffer[i] = ((const uint8_t*)&header)[offset];
+    }
+    else{
+      offset -= sizeof(header);
+      uint32_t slot = (oldest + offset / sizeof(controller_timeline_record_t)) % CONTROLLER_TIMELINE_RECORDER_LENGTH;
+      buffer[i] = ((const uint8_t*)&recorder_buffer[slot])[offset % sizeof(controller_timeline_record_t)];
+    }
+  }
+  return true;
+}
+
+static const MemoryHandlerDef_t recorder_memory = {
+  .type = MEM_TYPE_APP,
+  .getSize = recorder_memory_size,
+  .read = recorder_memory_read,
+};
+
+void controller_timeline_recorder_init(void){
+  static bool registered = false;
+  recorder_mode = RECORDER_STOPPED;
+  recorder_previous_mode = RECORDER_STOPPED;
+  recorder_count = 0;
+  recorder_next = 0;
+  recorder_dropped = 0;
+  recording = false;
+  if(!registered){
+    memoryRegisterHandler(&recorder_memory);
+    registered = true;
+  }
+}
+
+void controller_timeline_set_sink(void (*sink)(const controller_timeline_record_t* record)){
+  recorder_sink = sink;
+}
+
+void controller_timeline_begin(uint32_t tick, uint64_t timestamp){
+  if(recorder_mode != recorder_previous_mode){
+    if(recorder_mode != RECORDER_STOPPED){
+      // (Re-)arming starts a new recording
+      recorder_count = 0;
+      recorder_next = 0;
+      recorder_dropped = 0;
+    }
+    recorder_previous_mode = recorder_mode;
+  }
+  recording = recorder_sink != 0 || recorder_mode != RECORDER_STOPPED;
+  if(!recording){
+    return;
+  }
+  memset(&current, 0, sizeof(current));
+  current.tick = tick;
+  current.timestamp_low = (uint32_t)timestamp;
+  current.timestamp_high = (uint32_t)(timestamp >> 32);
+  current_start = timeline_clock();
+}
+
+void controller_timeline_mark(enum ControllerTimelineStage stage){
+  if(!recording){
+    return;
+  }
+  current.stage_end[stage] = (uint32_t)(timeline_clock() - current_start);
+  if(stage >= CONTROLLER_TIMELINE_LAYER_0 && stage <= CONTROLLER_TIMELINE_LAYER_2){
+    current.flags |= CONTROLLER_TIMELINE_FLAG_LAYERS;
+  }
+}
+
+void controller_timeline_end(uint32_t flags){
+  if(!recording){
+    return;
+  }
+  controller_timeline_mark(CONTROLLER_TIMELINE_TELEMETRY);
+  recording = false;
+  current.flags |= flags;
+  if(recorder_sink != 0){
+    recorder_sink(&current);
+  }
+  if(recorder_mode == RECORDER_STOPPED){
+    return;
+  }
+  if(recorder_mode == RECORDER_ONE_SHOT && recorder_count == CONTROLLER_TIMELINE_RECORDER_LENGTH){
+    recorder_dropped++;
+    return;
+  }
+  if(recorder_count == CONTROLLER_TIMELINE_RECORDER_LENGTH){
+    recorder_dropped++;
+  }
+  else{
+    recorder_count++;
+  }
+  recorder_buffer[recorder_next] = current;
+  recorder_next = (recorder_next + 1) % CONTROLLER_TIMELINE_RECORDER_LENGTH;
+}
+
+PARAM_GROUP_START(rlttl)
+PARAM_ADD(PARAM_UINT8, mode, &recorder_mode)
+PARAM_GROUP_STOP(rlttl)
+
+LOG_GROUP_START(rlttl)
+LOG_ADD(LOG_UINT32, n, &recorder_count)
+LOG_ADD(LOG_UINT32, dropped, &recorder_dropped)
+LOG_GROUP_STOP(rlttl)
@@ -0,0 +1,70 @@
+#ifndef __CONTROLLER_TIMELINE_H__
+#define __CONTROLLER_TIMELINE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef CONTROLLER_TIMELINE_RECORDER_LENGTH
+#define CONTROLLER_TIMELINE_RECORDER_LENGTH 64 // records kept on board (56 bytes each)
+#endif
+#define CONTROLLER_TIMELINE_MAGIC 0x4c545452 // "RTTL"
+#define CONTROLLER_TIMELINE_VERSION 1
+
+// Stages of one controllerOutOfTree invocation, in execution order. The layer stages are nested in the policy stage
+// and only reached when the adapter evaluates layer by layer (rltk kernel selection other than rl_tools); stages that
+// an invocation does not reach (e.g. the policy on ticks without inference) stay 0.
+enum ControllerTimelineStage{
+  CONTROLLER_TIMELINE_PROLOGUE = 0, // kernel selection, trace recorder, watchdog
+  CONTROLLER_TIMELINE_SETPOINT = 1, // activation, trigger and target computation
+  CONTROLLER_TIMELINE_OBSERVATION = 2, // update_state
+  CONTROLLER_TIMELINE_LAYER_0 = 3,
+  CONTROLLER_TIMELINE_LAYER_1 = 4,
+  CONTROLLER_TIMELINE_LAYER_2 = 5,
+  CONTROLLER_TIMELINE_POLICY = 6, // rl_tools_context_control
+  CONTROLLER_TIMELINE_CONTROL = 7, // motor commands, battery compensation, warmup or classic controller
+  CONTROLLER_TIMELINE_MOTORS = 8, // motorsSetRatio
+  CONTROLLER_TIMELINE_TELEMETRY = 9, // flight metrics, packed log, trace recorder
+  CONTROLLER_TIMELINE_STAGES = 10
+};
+
+#define CONTROLLER_TIMELINE_FLAG_INFERENCE (1 << 0)
+#define CONTROLLER_TIMELINE_FLAG_SET_MOTORS (1 << 1) // learned controller active
+#define CONTROLLER_TIMELINE_FLAG_BEHIND_SCHEDULE (1 << 2) // more than CONTROL_INTERVAL_US since the previous inference
+#define CONTROLLER_TIMELINE_FLAG_LAYERS (1 << 3) // the layer stages are valid
+
+// Stage timestamps of one controllerOutOfTree invocation (global controller instance). The invocation is placed by
+// usecTimestamp() (virtual time in the simulation), the stages by a finer clock relative to the invocation start:
+// usecTimestamp() on board, the host's monotonic clock in the simulation (clock_hz in the header).
+typedef struct {
+  uint32_t tick;
+  uint32_t timestamp_low; // usecTimestamp() at the invocation [us]
+  uint32_t timestamp_high;
+  uint32_t flags;
+  uint32_t stage_end[CONTROLLER_TIMELINE_STAGES]; // since the invocation start [1 / clock_hz]
+} controller_timeline_record_t;
+
+// In front of the records, both in the recorder memory (MEM_TYPE_APP) and in timeline files (sim --timeline)
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;
+  uint32_t clock_hz; // unit of stage_end
+  uint32_t count; // records that follow, oldest first (0 in files: until the end of the file)
+  uint32_t dropped; // records overwritten (ring mode) or not taken (one-shot mode)
+} controller_timeline_header_t;
+
+void controller_timeline_file_header(controller_timeline_header_t* header);
+
+// On-board recorder, controlled by rlttl.mode like rltrec.mode: 0 = stopped (the buffer can be downloaded),
+// 1 = ring buffer of the latest CONTROLLER_TIMELINE_RECORDER_LENGTH invocations, 2 = one-shot.
+void controller_timeline_recorder_init(void);
+// At the very top of controllerOutOfTree
+void controller_timeline_begin(uint32_t tick, uint64_t timestamp);
+// End of a stage (no-op while not recording)
+void controller_timeline_mark(enum ControllerTimelineStage stage);
+// When controllerOutOfTree returns (ends the telemetry stage)
+void controller_timeline_end(uint32_t flags);
+// Every completed record is also handed to the sink, independent of rlttl.mode (host: sim --timeline)
+void controller_timeline_set_sink(void (*sink)(const controller_timeline_record_t* record));
+
+#endif
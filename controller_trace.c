@@ -0,0 +1,317 @@
+#include "controller_trace.h"
+#include <string.h>
+#include "log.h"
+#include "param.h"
+#include "mem.h"
+#include "motors.h"
+#include "pm.h"
+
+static controller_trace_record_t current;
+static bool recording = false; // current is being filled
+static void (*recorder_sink)(const controller_trace_record_t* record) = 0;
+
+#if CONTROLLER_TRACE_RECORDER_LENGTH > 0
+enum RecorderMode{
+  RECORDER_STOPPED = 0,
+  RECORDER_RING = 1,
+  RECORDER_ONE_SHOT = 2,
+};
+
+#define RECORDER_SNAPSHOT_SLOT(i) ((i) * (CONTROLLER_TRACE_RECORDER_LENGTH / 2)) // buffer slot of snapshot i
+
+static controller_trace_record_t recorder_buffer[CONTROLLER_TRACE_RECORDER_LENGTH];
+// State before the records in the slots RECORDER_SNAPSHOT_SLOT(0) and RECORDER_SNAPSHOT_SLOT(1)
+static controller_trace_snapshot_t recorder_snapshots[2];
+static bool recorder_snapshot_valid[2];
+static uint8_t recorder_mode = RECORDER_STOPPED;
+static uint8_t recorder_previous_mode = RECORDER_STOPPED;
+static uint32_t recorder_count = 0; // valid records in the buffer
+static uint32_t recorder_next = 0; // slot of the next record
+static uint32_t recorder_dropped = 0;
+#endif
+
+static inline void pack_attitude(float* out, const attitude_t* attitude){
+  out[0] = attitude->roll;
+  out[1] = attitude->pitch;
+  out[2] = attitude->yaw;
+}
+static inline void unpack_attitude(const float* in, attitude_t* attitude){
+  attitude->roll = in[0];
+  attitude->pitch = in[1];
+  attitude->yaw = in[2];
+}
+static inline void pack_quaternion(float* out, const quaternion_t* q){
+  out[0] = q->x;
+  out[1] = q->y;
+  out[2] = q->z;
+  out[3] = q->w;
+}
+static inline void unpack_quaternion(const float* in, quaternion_t* q){
+  q->x = in[0];
+  q->y = in[1];
+  q->z = in[2];
+  q->w = in[3];
+}
+static inline void pack_vector(float* out, const vector_t* v){
+  out[0] = v->x;
+  out[1] = v->y;
+  out[2] = v->z;
+}
+static inline void unpack_vector(const float* in, vector_t* v){
+  v->x = in[0];
+  v->y = in[1];
+  v->z = in[2];
+}
+static inline void pack_axis(float* out, const Axis3f* v){
+  out[0] = v->x;
+  out[1] = v->y;
+  out[2] = v->z;
+}
+static inline void unpack_axis(const float* in, Axis3f* v){
+  v->x = in[0];
+  v->y = in[1];
+  v->z = in[2];
+}
+
+void controller_trace_pack(controller_trace_record_t* record, const setpoint_t* setpoint, const sensorData_t* sensors, const state_t* state, uint32_t tick, uint64_t timestamp, float battery_voltage){
+  record->tick = tick;
+  record->timestamp_low = (uint32_t)timestamp;
+  record->timestamp_high = (uint32_t)(timestamp >> 32);
+  record->battery_voltage = battery_voltage;
+
+  record->setpoint_timestamp = setpoint->timestamp;
+  pack_attitude(record->setpoint_attitude, &setpoint->attitude);
+  pack_attitude(record->setpoint_attitude_rate, &setpoint->attitudeRate);
+  pack_quaternion(record->setpoint_quaternion, &setpoint->attitudeQuaternion);
+  record->setpoint_thrust = setpoint->thrust;
+  pack_vector(record->setpoint_position, &setpoint->position);
+  pack_vector(record->setpoint_velocity, &setpoint->velocity);
+  pack_vector(record->setpoint_acceleration, &setpoint->acceleration);
+  record->setpoint_mode[0] = setpoint->mode.x;
+  record->setpoint_mode[1] = setpoint->mode.y;
+  record->setpoint_mode[2] = setpoint->mode.z;
+  record->setpoint_mode[3] = setpoint->mode.roll;
+  record->setpoint_mode[4] = setpoint->mode.pitch;
+  record->setpoint_mode[5] = setpoint->mode.yaw;
+  record->setpoint_mode[6] = setpoint->mode.quat;
+  record->setpoint_velocity_body = setpoint->velocity_body;
+
+  pack_attitude(record->state_attitude, &state->attitude);
+  pack_quaternion(record->state_quaternion, &state->attitudeQuaternion);
+  pack_vector(record->state_position, &state->position);
+  pack_vector(record->state_velocity, &state->velocity);
+  pack_vector(record->state_acc, &state->acc);
+
+  pack_axis(record->sensors_acc, &sensors->acc);
+  pack_axis(record->sensors_gyro, &sensors->gyro);
+  pack_axis(record->sensors_mag, &sensors->mag);
+  record->sensors_timestamp_low = (uint32_t)sensors->interruptTimestamp;
+  record->sensors_timestamp_high = (uint32_t)(sensors->interruptTimestamp >> 32);
+}
+
+void controller_trace_unpack(const controller_trace_record_t* record, setpoint_t* setpoint, sensorData_t* sensors, state_t* state){
+  memset(setpoint, 0, sizeof(*setpoint));
+  memset(sensors, 0, sizeof(*sensors));
+  memset(state, 0, sizeof(*state));
+
+  setpoint->timestamp = record->setpoint_timestamp;
+  unpack_attitude(record->setpoint_attitude, &setpoint->attitude);
+  unpack_attitude(record->setpoint_attitude_rate, &setpoint->attitudeRate);
+  unpack_quaternion(record->setpoint_quaternion, &setpoint->attitudeQuaternion);
+  setpoint->thrust = record->setpoint_thrust;
+  unpack_vector(record->setpoint_position, &setpoint->position);
+  unpack_vector(record->setpoint_velocity, &setpoint->velocity);
+  unpack_vector(record->setpoint_acceleration, &setpoint->acceleration);
+  setpoint->mode.x = (stab_mode_t)record->setpoint_mode[0];
+  setpoint->mode.y = (stab_mode_t)record->setpoint_mode[1];
+  setpoint->mode.z = (stab_mode_t)record->setpoint_mode[2];
+  setpoint->mode.roll = (stab_mode_t)record->setpoint_mode[3];
+  setpoint->mode.pitch = (stab_mode_t)record->setpoint_mode[4];
+  setpoint->mode.yaw = (stab_mode_t)record->setpoint_mode[5];
+  setpoint->mode.quat = (stab_mode_t)record->setpoint_mode[6];
+  setpoint->velocity_body = record->setpoint_velocity_body;
+
+  unpack_attitude(record->state_attitude, &state->attitude);
+  unpack_quaternion(record->state_quaternion, &state->attitudeQuaternion);
+  unpack_vector(record->state_position, &state->position);
+  unpack_vector(record->state_velocity, &state->velocity);
+  unpack_vector(record->state_acc, &state->acc);
+
+  unpack_axis(record->sensors_acc, &sensors->acc);
+  unpack_axis(record->sensors_gyro, &sensors->gyro);
+  unpack_axis(record->sensors_mag, &sensors->mag);
+  sensors->interruptTimestamp = (uint64_t)record->sensors_timestamp_high << 32 | record->sensors_timestamp_low;
+}
+
+uint64_t controller_trace_timestamp(const controller_trace_record_t* record){
+  return (uint64_t)record->timestamp_high << 32 | record->timestamp_low;
+}
+
+uint64_t controller_trace_packet_timestamp(const controller_trace_record_t* record){
+  return (uint64_t)record->packet_timestamp_high << 32 | record->packet_timestamp_low;
+}
+
+#if CONTROLLER_TRACE_RECORDER_LENGTH > 0
+// Position (oldest record first) of the oldest record with a snapshot in front of it; the download starts there
+static uint32_t recorder_replay_start(uint32_t* snapshot_i){
+  uint32_t oldest = recorder_count < CONTROLLER_TRACE_RECORDER_LENGTH ? 0 : recorder_next;
+  uint32_t start = recorder_count;
+  for(uint32_t i = 0; i < 2; i++){
+    uint32_t position = (RECORDER_SNAPSHOT_SLOT(i) + CONTROLLER_TRACE_RECORDER_LENGTH - oldest) % CONTROLLER_TRACE_RECORDER_LENGTH;
+    if(recorder_snapshot_valid[i] && position < start){
+      start = position;
+      *snapshot_i = i;
+    }
+  }
+  return start;
+}
+
+static uint32_t recorder_memory_size(void){
+  uint32_t snapshot_i;
+  uint32_t start = recorder_replay_start(&snapshot_i);
+  if(start == recorder_count){
+    return sizeof(controller_trace_header_t);
+  }
+  return sizeof(controller_trace_header_t) + sizeof(controller_trace_snapshot_t) + (recorder_count - start) * sizeof(controller_trace_record_t);
+}
+
+static bool recorder_memory_read(const uint32_t address, const uint8_t length, uint8_t* buffer){
+  if(recorder_mode != RECORDER_STOPPED || address + length > recorder_memory_size()){
+    return false;
+  }
+  uint32_t snapshot_i = 0;
+  uint32_t start = recorder_replay_start(&snapshot_i);
+  bool snapshot = start < recorder_count;
+  controller_trace_header_t header = {
+    .magic = CONTROLLER_TRACE_MAGIC,
+    .version = CONTROLLER_TRACE_VERSION,
+    .record_size = sizeof(controller_trace_record_t),
+    .count = recorder_count - start,
+    .dropped = recorder_dropped + start,
+    .snapshot_size = snapshot ? sizeof(controller_trace_snapshot_t) : 0,
+  };
+  uint32_t oldest = recorder_count < CONTROLLER_TRACE_RECORDER_LENGTH ? 0 : recorder_next;
+  for(uint32_t i = 0; i < length; i++){
+    uint32_t offset = address + i;
+    if(offset < sizeof(header)){
+      buffer[i] = ((const uint8_t*)&header)[offset];
+      continue;
+    }
+    offset -= sizeof(header);
+    if(offset < header.snapshot_size){
+      buffer[i] = ((const uint8_t*)&recorder_snapshots[snapshot_i])[offset];
+      continue;
+    }
+    offset -= header.snapshot_size;
+    uint32_t slot = (oldest + start + offset / sizeof(controller_trace_record_t)) % CONTROLLER_TRACE_RECORDER_LENGTH;
+    buffer[i] = ((const uint8_t*)&recorder_buffer[slot])[offset % sizeof(controller_trace_record_t)];
+  }
+  return true;
+}
+
+static const MemoryHandlerDef_t recorder_memory = {
+  .type = MEM_TYPE_APP,
+  .getSize = recorder_memory_size,
+  .read = recorder_memory_read,
+};
+#endif
+
+void controller_trace_recorder_init(void){
+  recording = false;
+#if CONTROLLER_TRACE_RECORDER_LENGTH > 0
+  static bool registered = false;
+  recorder_mode = RECORDER_STOPPED;
+  recorder_previous_mode = RECORDER_STOPPED;
+  recorder_count = 0;
+  recorder_next = 0;
+  recorder_dropped = 0;
+  recorder_snapshot_valid[0] = false;
+  recorder_snapshot_valid[1] = false;
+  if(!registered){
+    memoryRegisterHandler(&recorder_memory);
+    registered = true;
+  }
+#endif
+}
+
+void controller_trace_set_sink(void (*sink)(const controller_trace_record_t* record)){
+  recorder_sink = sink;
+}
+
+controller_trace_snapshot_t* controller_trace_recorder_begin(const setpoint_t* setpoint, const sensorData_t* sensors, const state_t* state, uint32_t tick, uint64_t timestamp, uint64_t packet_timestamp){
+  controller_trace_snapshot_t* snapshot = 0;
+#if CONTROLLER_TRACE_RECORDER_LENGTH > 0
+  if(recorder_mode != recorder_previous_mode){
+    if(recorder_mode != RECORDER_STOPPED){
+      // (Re-)arming starts a new recording
+      recorder_count = 0;
+      recorder_next = 0;
+      recorder_dropped = 0;
+      recorder_snapshot_valid[0] = false;
+      recorder_snapshot_valid[1] = false;
+    }
+    recorder_previous_mode = recorder_mode;
+  }
+  bool stored = recorder_mode == RECORDER_RING || (recorder_mode == RECORDER_ONE_SHOT && recorder_count < CONTROLLER_TRACE_RECORDER_LENGTH);
+  for(uint32_t i = 0; i < 2 && stored && snapshot == 0; i++){
+    if(recorder_next == RECORDER_SNAPSHOT_SLOT(i)){
+      snapshot = &recorder_snapshots[i];
+      snapshot->tick = tick;
+      recorder_snapshot_valid[i] = true;
+    }
+  }
+  recording = recorder_sink != 0 || recorder_mode != RECORDER_STOPPED;
+#else
+  recording = recorder_sink != 0;
+#endif
+  if(!recording){
+    return snapshot;
+  }
+  controller_trace_pack(&current, setpoint, sensors, state, tick, timestamp, pmGetBatteryVoltage());
+  current.packet_timestamp_low = (uint32_t)packet_timestamp;
+  current.packet_timestamp_high = (uint32_t)(packet_timestamp >> 32);
+  return snapshot;
+}
+
+void controller_trace_recorder_end(const float* action, const uint16_t* motor_cmd){
+  if(!recording){
+    return;
+  }
+  recording = false;
+  for(int i = 0; i < 4; i++){
+    current.action[i] = action[i];
+    current.motor_cmd[i] = motor_cmd[i];
+    current.motor_ratio[i] = motorsGetRatio(i);
+  }
+  if(recorder_sink != 0){
+    recorder_sink(&current);
+  }
+#if CONTROLLER_TRACE_RECORDER_LENGTH > 0
+  if(recorder_mode == RECORDER_STOPPED){
+    return;
+  }
+  if(recorder_mode == RECORDER_ONE_SHOT && recorder_count == CONTROLLER_TRACE_RECORDER_LENGTH){
+    recorder_dropped++;
+    return;
+  }
+  if(recorder_count == CONTROLLER_TRACE_RECORDER_LENGTH){
+    recorder_dropped++;
+  }
+  else{
+    recorder_count++;
+  }
+  recorder_buffer[recorder_next] = current;
+  recorder_next = (recorder_next + 1) % CONTROLLER_TRACE_RECORDER_LENGTH;
+#endif
+}
+
+#if CONTROLLER_TRACE_RECORDER_LENGTH > 0
+PARAM_GROUP_START(rltrec)
+PARAM_ADD(PARAM_UINT8, mode, &recorder_mode)
+PARAM_GROUP_STOP(rltrec)
+
+LOG_GROUP_START(rltrec)
+LOG_ADD(LOG_UINT32, n, &recorder_count)
+LOG_ADD(LOG_UINT32, dropped, &recorder_dropped)
+LOG_GROUP_STOP(rltrec)
+#endif
@@ -0,0 +1,123 @@
+#ifndef __CONTROLLER_TRACE_H__
+#define __CONTROLLER_TRACE_H__
+
+#include <stdint.h>
+#include "stabilizer_types.h"
+
+// Records kept by the on-board recorder. It costs CONTROLLER_TRACE_RECORDER_LENGTH * 256 bytes plus two state snapshots
+// of 812 bytes of static RAM, so it is compiled out by default (0); e.g. 32 (about 9.6 KB) with
+// EXTRA_CFLAGS=-DCONTROLLER_TRACE_RECORDER_LENGTH=32. The sink (controller_trace_set_sink) works either way.
+#ifndef CONTROLLER_TRACE_RECORDER_LENGTH
+#define CONTROLLER_TRACE_RECORDER_LENGTH 0
+#endif
+#define CONTROLLER_TRACE_ADAPTER_STATE_SIZE 160 // words of adapter state a snapshot can hold
+#define CONTROLLER_TRACE_MAGIC 0x43525452 // "RTRC"
+#define CONTROLLER_TRACE_VERSION 2
+
+// Portable record of one controllerOutOfTree invocation: everything the controller (and the classic controllers it
+// falls back to) reads, plus the clock, battery voltage and trigger packet time it samples, followed by what it
+// produced. Naturally aligned fixed-size fields, so the layout is the same on the Cortex-M4 and on the host and
+// records can be moved between flight, simulation and benchmark builds.
+typedef struct {
+  uint32_t tick;
+  uint32_t timestamp_low; // usecTimestamp() at the invocation
+  uint32_t timestamp_high;
+  float battery_voltage;
+  // setpoint_t
+  uint32_t setpoint_timestamp;
+  float setpoint_attitude[3]; // roll, pitch, yaw
+  float setpoint_attitude_rate[3];
+  float setpoint_quaternion[4]; // x, y, z, w
+  float setpoint_thrust;
+  float setpoint_position[3];
+  float setpoint_velocity[3];
+  float setpoint_acceleration[3];
+  uint8_t setpoint_mode[7]; // x, y, z, roll, pitch, yaw, quat
+  uint8_t setpoint_velocity_body;
+  // state_t
+  float state_attitude[3];
+  float state_quaternion[4];
+  float state_position[3];
+  float state_velocity[3];
+  float state_acc[3];
+  // sensorData_t
+  float sensors_acc[3];
+  float sensors_gyro[3];
+  float sensors_mag[3];
+  uint32_t sensors_timestamp_low;
+  uint32_t sensors_timestamp_high;
+  // Last rl_tools_controller_packet_received() (trigger packet)
+  uint32_t packet_timestamp_low;
+  uint32_t packet_timestamp_high;
+  // Outputs, filled in when the invocation returns
+  float action[4];
+  uint16_t motor_cmd[4];
+  uint16_t motor_ratio[4]; // motorsGetRatio(), whichever controller set the motors
+} controller_trace_record_t;
+
+// State the controller and the adapter carry from one invocation to the next, taken before the invocation with the
+// given tick. Restoring it (and the parameters) before replaying the records from that tick on reproduces a window
+// recorded mid-flight. Same portable layout rules as the record.
+typedef struct {
+  uint32_t tick;
+  // rl_tools_controller.c
+  uint32_t controller_tick[2]; // low, high (as all 64-bit values)
+  uint32_t timestamp_last_reset[2];
+  uint32_t timestamp_last_behind_schedule_message[2];
+  uint32_t timestamp_last_control_invocation[2];
+  uint32_t timestamp_last_control_packet_received[2];
+  uint32_t timestamp_last_control_packet_received_hover[2];
+  uint32_t timestamp_controller_activation[2];
+  uint32_t timestamp_pre_set_motors[2];
+  uint32_t waypoint_navigation_timestamp_start[2];
+  uint32_t figure_eight_last_invocation[2];
+  float control_invocation_interval;
+  float target_pos[3];
+  float target_vel[3];
+  float origin[3];
+  float figure_eight_progress;
+  float action_output[4];
+  float battery_compensation_voltage;
+  uint16_t motor_cmd[4];
+  uint16_t motor_ratio[4]; // held by the motor driver on ticks without a control step
+  uint8_t waypoint_navigation_dynamic_current_waypoint;
+  uint8_t prev_set_motors;
+  uint8_t prev_pre_set_motors;
+  uint8_t reserved;
+  // Adapter (rl_tools_save_state)
+  uint32_t adapter_state_size;
+  uint32_t adapter_state[CONTROLLER_TRACE_ADAPTER_STATE_SIZE];
+} controller_trace_snapshot_t;
+
+// Header in front of the snapshot and the records when the recorder buffer is read through the memory subsystem
+// (MEM_TYPE_APP)
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;
+  uint32_t count; // records that follow the snapshot, oldest first
+  uint32_t dropped; // records overwritten (ring mode) or not taken (one-shot mode)
+  uint16_t snapshot_size; // bytes of the controller_trace_snapshot_t after the header, 0 if there is none
+  uint16_t reserved;
+} controller_trace_header_t;
+
+void controller_trace_pack(controller_trace_record_t* record, const setpoint_t* setpoint, const sensorData_t* sensors, const state_t* state, uint32_t tick, uint64_t timestamp, float battery_voltage);
+void controller_trace_unpack(const controller_trace_record_t* record, setpoint_t* setpoint, sensorData_t* sensors, state_t* state);
+uint64_t controller_trace_timestamp(const controller_trace_record_t* record);
+uint64_t controller_trace_packet_timestamp(const controller_trace_record_t* record);
+
+// On-board recorder, controlled by rltrec.mode: 0 = stopped (the buffer can be downloaded), 1 = ring buffer of the
+// latest CONTROLLER_TRACE_RECORDER_LENGTH invocations, 2 = one-shot, the first invocations after arming.
+// A snapshot of the controller state is taken when arming and, in ring mode, whenever the recording passes the start or
+// the middle of the buffer; the download starts at the oldest snapshot still covered, so at least half the buffer
+// replays exactly.
+void controller_trace_recorder_init(void);
+// Called at the top of controllerOutOfTree, before anything modifies the setpoint. Returns the snapshot the controller
+// has to fill with its current state if this invocation starts a snapshot, NULL otherwise.
+controller_trace_snapshot_t* controller_trace_recorder_begin(const setpoint_t* setpoint, const sensorData_t* sensors, const state_t* state, uint32_t tick, uint64_t timestamp, uint64_t packet_timestamp);
+// Called when controllerOutOfTree returns
+void controller_trace_recorder_end(const float* action, const uint16_t* motor_cmd);
+// Every completed record is also handed to the sink, independent of rltrec.mode (host: sim --trace)
+void controller_trace_set_sink(void (*sink)(const controller_trace_record_t* record));
+
+#endif
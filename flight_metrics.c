@@ -0,0 +1,198 @@
+#include "flight_metrics.h"
+#include <math.h>
+#include "log.h"
+#include "param.h"
+
+#define FLIGHT_METRICS_NUM_MOTORS 4
+#define FLIGHT_METRICS_ACTION_DIM 4
+#define P2_MARKERS 5
+
+// P^2 quantile estimator (Jain & Chlamtac, 1985): five markers whose heights track the min, p/2, p, (1+p)/2 and max
+// quantiles, adjusted with piecewise-parabolic interpolation as samples arrive.
+typedef struct {
+  float p;
+  uint32_t count;
+  float height[P2_MARKERS];
+  float position[P2_MARKERS];
+  float desired[P2_MARKERS];
+  float increment[P2_MARKERS];
+} p2_quantile_t;
+
+static void p2_init(p2_quantile_t* e, float p){
+  e->p = p;
+  e->count = 0;
+  e->increment[0] = 0;
+  e->increment[1] = p / 2;
+  e->increment[2] = p;
+  e->increment[3] = (1 + p) / 2;
+  e->increment[4] = 1;
+}
+
+static float p2_parabolic(const p2_quantile_t* e, int i, float d){
+  const float* q = e->height;
+  const float* n = e->position;
+  return q[i] + d / (n[i + 1] - n[i - 1]) * ((n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) + (n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+}
+
+static void p2_add(p2_quantile_t* e, float x){
+  if(e->count < P2_MARKERS){
+    // Insertion sort of the first samples, they initialize the markers
+    int i = e->count++;
+    while(i > 0 && e->height[i - 1] > x){
+      e->height[i] = e->height[i - 1];
+      i--;
+    }
+    e->height[i] = x;
+    if(e->count == P2_MARKERS){
+      for(int j = 0; j < P2_MARKERS; j++){
+        e->position[j] = j;
+        e->desired[j] = 4 * e->increment[j];
+      }
+    }
+    return;
+  }
+  int k;
+  if(x < e->height[0]){
+    e->height[0] = x;
+    k = 0;
+  }
+  else if(x >= e->height[P2_MARKERS - 1]){
+    e->height[P2_MARKERS - 1] = x;
+    k = P2_MARKERS - 2;
+  }
+  else{
+    k = 0;
+    while(x >= e->height[k + 1]){
+      k++;
+    }
+  }
+  for(int i = k + 1; i < P2_MARKERS; i++){
+    e->position[i] += 1;
+  }
+  for(int i = 0; i < P2_MARKERS; i++){
+    e->desired[i] += e->increment[i];
+  }
+  for(int i = 1; i < P2_MARKERS - 1; i++){
+    float d = e->desired[i] - e->position[i];
+    if((d >= 1 && e->position[i + 1] - e->position[i] > 1) || (d <= -1 && e->position[i - 1] - e->position[i] < -1)){
+      float s = d >= 0 ? 1 : -1;
+      float q = p2_parabolic(e, i, s);
+      if(e->height[i - 1] < q && q < e->height[i + 1]){
+        e->height[i] = q;
+      }
+      else{
+        int j = i + (int)s;
+        e->height[i] += s * (e->height[j] - e->height[i]) / (e->position[j] - e->position[i]);
+      }
+      e->position[i] += s;
+    }
+  }
+  e->count++;
+}
+
+static float p2_get(const p2_quantile_t* e){
+  if(e->count == 0){
+    return 0;
+  }
+  if(e->count < P2_MARKERS){
+    return e->height[(int)(e->p * (e->count - 1) + 0.5f)];
+  }
+  return e->height[2];
+}
+
+static uint32_t steps;
+static float error_mean, error_m2;
+static float previous_action[FLIGHT_METRICS_ACTION_DIM];
+static float action_rate_sum;
+static p2_quantile_t inference_time_quantiles[3];
+
+static float log_rmse;
+static float log_error_max;
+static float log_saturation_time[FLIGHT_METRICS_NUM_MOTORS];
+static float log_action_rate;
+static float log_inference_time[3];
+static float log_active_time;
+
+static float quantiles[3];
+
+void flight_metrics_init(void){
+  quantiles[0] = 0.5f;
+  quantiles[1] = 0.9f;
+  quantiles[2] = 0.99f;
+  flight_metrics_reset();
+}
+
+void flight_metrics_reset(void){
+  steps = 0;
+  error_mean = 0;
+  error_m2 = 0;
+  action_rate_sum = 0;
+  log_rmse = 0;
+  log_error_max = 0;
+  log_action_rate = 0;
+  log_active_time = 0;
+  for(uint8_t i = 0; i < FLIGHT_METRICS_NUM_MOTORS; i++){
+    log_saturation_time[i] = 0;
+  }
+  for(uint8_t i = 0; i < 3; i++){
+    p2_init(&inference_time_quantiles[i], quantiles[i]);
+    log_inference_time[i] = 0;
+  }
+}
+
+void flight_metrics_update(const float* pos_error, const float* action, const uint16_t* motor_ratio, float dt, float inference_time){
+  steps++;
+  float error = sqrtf(pos_error[0] * pos_error[0] + pos_error[1] * pos_error[1] + pos_error[2] * pos_error[2]);
+  float delta = error - error_mean;
+  error_mean += delta / steps;
+  error_m2 += delta * (error - error_mean);
+  // mean(e^2) = mean(e)^2 + var(e)
+  log_rmse = sqrtf(error_mean * error_mean + error_m2 / steps);
+  if(error > log_error_max){
+    log_error_max = error;
+  }
+
+  for(uint8_t i = 0; i < FLIGHT_METRICS_NUM_MOTORS; i++){
+    if(motor_ratio[i] == 0 || motor_ratio[i] == UINT16_MAX){
+      log_saturation_time[i] += dt;
+    }
+  }
+
+  if(steps > 1){
+    for(uint8_t i = 0; i < FLIGHT_METRICS_ACTION_DIM; i++){
+      float d = action[i] - previous_action[i];
+      action_rate_sum += d * d;
+    }
+    log_action_rate = action_rate_sum / (steps - 1);
+  }
+  for(uint8_t i = 0; i < FLIGHT_METRICS_ACTION_DIM; i++){
+    previous_action[i] = action[i];
+  }
+
+  for(uint8_t i = 0; i < 3; i++){
+    p2_add(&inference_time_quantiles[i], inference_time);
+    log_inference_time[i] = p2_get(&inference_time_quantiles[i]);
+  }
+  log_active_time += dt;
+}
+
+// Inference time quantiles reported as it1..it3, changes take effect on the next activation
+PARAM_GROUP_START(rltfq)
+PARAM_ADD(PARAM_FLOAT, q1, &quantiles[0])
+PARAM_ADD(PARAM_FLOAT, q2, &quantiles[1])
+PARAM_ADD(PARAM_FLOAT, q3, &quantiles[2])
+PARAM_GROUP_STOP(rltfq)
+
+LOG_GROUP_START(rltfq)
+LOG_ADD(LOG_FLOAT, rmse, &log_rmse)
+LOG_ADD(LOG_FLOAT, emax, &log_error_max)
+LOG_ADD(LOG_FLOAT, s1, &log_saturation_time[0])
+LOG_ADD(LOG_FLOAT, s2, &log_saturation_time[1])
+LOG_ADD(LOG_FLOAT, s3, &log_saturation_time[2])
+LOG_ADD(LOG_FLOAT, s4, &log_saturation_time[3])
+LOG_ADD(LOG_FLOAT, ar, &log_action_rate)
+LOG_ADD(LOG_FLOAT, it1, &log_inference_time[0])
+LOG_ADD(LOG_FLOAT, it2, &log_inference_time[1])
+LOG_ADD(LOG_FLOAT, it3, &log_inference_time[2])
+LOG_ADD(LOG_FLOAT, t, &log_active_time)
+LOG_GROUP_STOP(rltfq)
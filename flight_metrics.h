@@ -0,0 +1,19 @@
+#ifndef __FLIGHT_METRICS_H__
+#define __FLIGHT_METRICS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Streaming flight-quality statistics over the current activation of the learned controller, updated once per
+// inference step in O(1) time and memory and exposed as the rltfq LOG group:
+//   rmse, emax  position error (Welford running mean/variance of the error norm)
+//   s1..s4      time each motor spent saturated (ratio at 0 or UINT16_MAX) [s]
+//   ar          action-rate energy, mean of |a_t - a_{t-1}|^2 per step
+//   it1..it3    inference time at the rltfq.q1..q3 quantiles (default 0.5, 0.9, 0.99; P^2 estimators) [us]
+//   t           active time [s]
+void flight_metrics_init(void);
+// Called on the activation edge, all statistics restart from zero.
+void flight_metrics_reset(void);
+void flight_metrics_update(const float* pos_error, const float* action, const uint16_t* motor_ratio, float dt, float inference_time);
+
+#endif
@@ -0,0 +1,90 @@
+#include "jitter_buffer.h"
+#include <string.h>
+
+#define DEPTH_MEAN_ALPHA 0.99f
+
+static inline const jitter_buffer_entry_t* entry(const jitter_buffer_t* buffer, uint8_t i){
+  return &buffer->entries[(buffer->head + i) % JITTER_BUFFER_LENGTH];
+}
+
+void jitter_buffer_reset(jitter_buffer_t* buffer){
+  memset(buffer, 0, sizeof(*buffer));
+}
+
+void jitter_buffer_push(jitter_buffer_t* buffer, uint64_t timestamp, const float* position, uint64_t max_gap){
+  if(buffer->count > 0){
+    uint64_t newest = entry(buffer, buffer->count - 1)->timestamp;
+    if(timestamp <= newest){
+      return;
+    }
+    if(timestamp - newest > max_gap){
+      buffer->head = 0;
+      buffer->count = 0;
+    }
+  }
+  if(buffer->count == JITTER_BUFFER_LENGTH){
+    buffer->head = (buffer->head + 1) % JITTER_BUFFER_LENGTH;
+    buffer->count--;
+    buffer->overflows++;
+  }
+  jitter_buffer_entry_t* e = &buffer->entries[(buffer->head + buffer->count) % JITTER_BUFFER_LENGTH];
+  e->timestamp = timestamp;
+  e->position[0] = position[0];
+  e->position[1] = position[1];
+  e->position[2] = position[2];
+  buffer->count++;
+}
+
+// Slope between the setpoints a and b [m/s]
+static inline float slope(const jitter_buffer_entry_t* a, const jitter_buffer_entry_t* b, uint8_t axis){
+  return (b->position[axis] - a->position[axis]) / ((b->timestamp - a->timestamp) / 1000000.0f);
+}
+
+bool jitter_buffer_sample(jitter_buffer_t* buffer, uint64_t now, uint32_t latency, uint8_t interpolation, uint64_t max_age, float* position, float* velocity){
+  if(buffer->count == 0 || now - entry(buffer, buffer->count - 1)->timestamp > max_age){
+    return false;
+  }
+  uint64_t t = now > latency ? now - latency : 0;
+  // Only the setpoint before the segment around t is still needed (tangent of the cubic interpolation)
+  while(buffer->count > 2 && entry(buffer, 2)->timestamp <= t){
+    buffer->head = (buffer->head + 1) % JITTER_BUFFER_LENGTH;
+    buffer->count--;
+  }
+  // Start of the segment: the last setpoint at or before t (index 0 or 1 after the pruning above)
+  uint8_t i = buffer->count > 1 && entry(buffer, 1)->timestamp <= t ? 1 : 0;
+  const jitter_buffer_entry_t* a = entry(buffer, i);
+  if(t < a->timestamp || i == buffer->count - 1){
+    // Before the first setpoint (filling up) or past the newest one (underrun): hold
+    bool underrun = t >= a->timestamp;
+    const jitter_buffer_entry_t* hold = underrun ? entry(buffer, buffer->count - 1) : a;
+    buffer->underruns += underrun;
+    buffer->depth = underrun ? 0 : buffer->count;
+    for(uint8_t axis = 0; axis < 3; axis++){
+      position[axis] = hold->position[axis];
+      velocity[axis] = 0;
+    }
+  }
+  else{
+    const jitter_buffer_entry_t* b = entry(buffer, i + 1);
+    float h = (b->timestamp - a->timestamp) / 1000000.0f;
+    float u = (t - a->timestamp) / 1000000.0f / h;
+    buffer->depth = buffer->count - 1 - i;
+    for(uint8_t axis = 0; axis < 3; axis++){
+      float m = slope(a, b, axis);
+      if(interpolation == JITTER_BUFFER_CUBIC){
+        // Tangents over the neighbouring setpoints, the segment's slope at the ends of the buffer
+        float ma = i > 0 ? slope(entry(buffer, i - 1), b, axis) : m;
+        float mb = i + 2 < buffer->count ? slope(a, entry(buffer, i + 2), axis) : m;
+        float u2 = u * u, u3 = u2 * u;
+        position[axis] = (2*u3 - 3*u2 + 1) * a->position[axis] + (u3 - 2*u2 + u) * h * ma + (-2*u3 + 3*u2) * b->position[axis] + (u3 - u2) * h * mb;
+        velocity[axis] = ((6*u2 - 6*u) * a->position[axis] + (-6*u2 + 6*u) * b->position[axis]) / h + (3*u2 - 4*u + 1) * ma + (3*u2 - 2*u) * mb;
+      }
+      else{
+        position[axis] = a->position[axis] + u * (b->position[axis] - a->position[axis]);
+        velocity[axis] = m;
+      }
+    }
+  }
+  buffer->depth_mean = DEPTH_MEAN_ALPHA * buffer->depth_mean + (1 - DEPTH_MEAN_ALPHA) * buffer->depth;
+  return true;
+}
@@ -0,0 +1,45 @@
+#ifndef __JITTER_BUFFER_H__
+#define __JITTER_BUFFER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Jitter buffer for streamed position setpoints: setpoints are stored with their arrival time and played back a fixed
+// latency later, interpolated between the two setpoints around the playback time. The latency has to cover the
+// setpoint interval plus the arrival jitter; if the playback time passes the newest setpoint (underrun) it is held.
+// Linear interpolation gives a continuous target and a piecewise constant velocity; cubic (Hermite with finite
+// difference tangents over the neighbouring setpoints) also a continuous velocity. Sampling is O(1).
+#define JITTER_BUFFER_LENGTH 8
+
+enum JitterBufferInterpolation{
+  JITTER_BUFFER_OFF = 0,
+  JITTER_BUFFER_LINEAR = 1,
+  JITTER_BUFFER_CUBIC = 2
+};
+
+typedef struct {
+  uint64_t timestamp; // arrival [us]
+  float position[3];
+} jitter_buffer_entry_t;
+
+typedef struct {
+  jitter_buffer_entry_t entries[JITTER_BUFFER_LENGTH]; // ring, oldest at head
+  uint8_t head;
+  uint8_t count;
+
+  // Statistics
+  uint8_t depth; // setpoints ahead of the playback time at the last sample
+  float depth_mean; // exponential moving average of depth
+  uint32_t underruns; // samples with the playback time past the newest setpoint
+  uint32_t overflows; // setpoints dropped because the buffer was full
+} jitter_buffer_t;
+
+void jitter_buffer_reset(jitter_buffer_t* buffer);
+// Appends a setpoint. Setpoints not newer than the newest one are ignored; after a gap longer than max_gap [us] the
+// buffer restarts with this setpoint.
+void jitter_buffer_push(jitter_buffer_t* buffer, uint64_t timestamp, const float* position, uint64_t max_gap);
+// Target position and velocity at now - latency [us] with the given interpolation. Returns false (and leaves the
+// outputs untouched) if the buffer is empty or its newest setpoint is older than max_age [us].
+bool jitter_buffer_sample(jitter_buffer_t* buffer, uint64_t now, uint32_t latency, uint8_t interpolation, uint64_t max_age, float* position, float* velocity);
+
+#endif
@@ -0,0 +1,51 @@
+#include "motor_curve.h"
+#ifdef SYSID_CONFIG
+#include SYSID_CONFIG
+#include <math.h>
+
+// Inverse of the identified RPM-vs-command curve at the command bins
+static uint16_t table[MOTOR_CURVE_CMD_BINS];
+
+static inline uint16_t cap(float v){
+  if(v < 0){
+    return 0;
+  }
+  if(v > UINT16_MAX){
+    return UINT16_MAX;
+  }
+  return (uint16_t)v;
+}
+
+static inline uint32_t cmd_bin(uint32_t bin_i){
+  uint32_t cmd = bin_i << MOTOR_CURVE_CMD_SHIFT;
+  return cmd > UINT16_MAX ? UINT16_MAX : cmd;
+}
+#endif
+
+void motor_curve_init(void){
+#ifdef SYSID_CONFIG
+  // r = c + b (c^2 - c) solved for c (b = 0: the curve is the identity)
+  const float b = SYSID_RPM_CURVATURE;
+  for(uint8_t cmd_i = 0; cmd_i < MOTOR_CURVE_CMD_BINS; cmd_i++){
+    float r = (float)cmd_bin(cmd_i) / UINT16_MAX;
+    float c = b != 0 ? (-(1 - b) + sqrtf((1 - b) * (1 - b) + 4 * b * r)) / (2 * b) : r;
+    table[cmd_i] = cap(c * UINT16_MAX);
+  }
+#endif
+}
+
+uint16_t motor_curve_linearize(uint16_t cmd){
+#ifdef SYSID_CONFIG
+  uint32_t bin = cmd >> MOTOR_CURVE_CMD_SHIFT;
+  if(bin >= MOTOR_CURVE_CMD_BINS - 1){
+    return table[MOTOR_CURVE_CMD_BINS - 1];
+  }
+  int32_t a = table[bin];
+  int32_t b = table[bin + 1];
+  int32_t frac = cmd - (bin << MOTOR_CURVE_CMD_SHIFT);
+  // The last bin is UINT16_MAX instead of 1 << 16, the error of treating it as a full step is below one LSB
+  return (uint16_t)(a + (((b - a) * frac) >> MOTOR_CURVE_CMD_SHIFT));
+#else
+  return cmd;
+#endif
+}
@@ -0,0 +1,17 @@
+#ifndef __MOTOR_CURVE_H__
+#define __MOTOR_CURVE_H__
+
+#include <stdint.h>
+
+// Linearization of the motor's RPM-vs-command curve for the learned-policy motor path.
+// Maps a command linear in RPM (0..UINT16_MAX) to the command c that realizes that RPM on a motor with the curve
+// rpm / max_rpm = c + SYSID_RPM_CURVATURE * (c^2 - c) identified by sim/build/sysid (SYSID_CONFIG, see sim/sysid.cpp),
+// interpolating the inverse tabulated at MOTOR_CURVE_CMD_BINS commands. The identity without a SYSID_CONFIG (no table).
+#define MOTOR_CURVE_CMD_BINS 17
+#define MOTOR_CURVE_CMD_SHIFT 12 // (UINT16_MAX + 1) / (MOTOR_CURVE_CMD_BINS - 1) = 1 << 12
+
+// Computes the shared table, once before the first motor_curve_linearize()
+void motor_curve_init(void);
+uint16_t motor_curve_linearize(uint16_t cmd);
+
+#endif
@@ -0,0 +1,100 @@
+#include "packed_log.h"
+#include "log.h"
+#include "param.h"
+
+static uint8_t seq;
+static int16_t state_packed[PACKED_LOG_STATE_DIM];
+static int16_t action_packed[PACKED_LOG_ACTION_DIM];
+static uint16_t motor_cmd_packed[PACKED_LOG_ACTION_DIM];
+static uint8_t flags_packed;
+
+// Full-scale values (value that maps to PACKED_LOG_FULL_SCALE)
+static float scale_position;
+static float scale_orientation;
+static float scale_linear_velocity;
+static float scale_angular_velocity;
+static float scale_action;
+
+static inline int16_t quantize(float value, float scale){
+  // A scale set to 0 or below (or NaN) through rltp.* logs 0 instead of converting NaN
+  if(!(scale > 0)){
+    return 0;
+  }
+  float v = value / scale * PACKED_LOG_FULL_SCALE;
+  if(v != v){
+    return 0;
+  }
+  if(v >= PACKED_LOG_FULL_SCALE){
+    return PACKED_LOG_FULL_SCALE;
+  }
+  if(v <= -PACKED_LOG_FULL_SCALE){
+    return -PACKED_LOG_FULL_SCALE;
+  }
+  return (int16_t)(v < 0 ? v - 0.5f : v + 0.5f);
+}
+
+void packed_log_init(void){
+  seq = 0;
+  flags_packed = 0;
+  // The relative position/velocity inputs are clipped to the distance limits (<= 0.6m, 2m/s), the gyro range is 2000deg/s
+  scale_position = 1.0f;
+  scale_orientation = 1.0f;
+  scale_linear_velocity = 4.0f;
+  scale_angular_velocity = 35.0f;
+  scale_action = 1.0f;
+}
+
+void packed_log_update(const float* state, const float* action, const uint16_t* motor_cmd, uint8_t flags){
+  for(uint8_t i = 0; i < 3; i++){
+    state_packed[ 0 + i] = quantize(state[ 0 + i], scale_position);
+    state_packed[ 7 + i] = quantize(state[ 7 + i], scale_linear_velocity);
+    state_packed[10 + i] = quantize(state[10 + i], scale_angular_velocity);
+  }
+  for(uint8_t i = 0; i < 4; i++){
+    state_packed[3 + i] = quantize(state[3 + i], scale_orientation);
+  }
+  for(uint8_t i = 0; i < PACKED_LOG_ACTION_DIM; i++){
+    action_packed[i] = quantize(action[i], scale_action);
+    motor_cmd_packed[i] = motor_cmd[i];
+  }
+  flags_packed = flags;
+  seq++;
+}
+
+PARAM_GROUP_START(rltp)
+PARAM_ADD(PARAM_FLOAT, sp, &scale_position)
+PARAM_ADD(PARAM_FLOAT, sq, &scale_orientation)
+PARAM_ADD(PARAM_FLOAT, sv, &scale_linear_velocity)
+PARAM_ADD(PARAM_FLOAT, sw, &scale_angular_velocity)
+PARAM_ADD(PARAM_FLOAT, sa, &scale_action)
+PARAM_GROUP_STOP(rltp)
+
+LOG_GROUP_START(rltpa)
+LOG_ADD(LOG_UINT8, seq, &seq)
+LOG_ADD(LOG_INT16, s0, &state_packed[0])
+LOG_ADD(LOG_INT16, s1, &state_packed[1])
+LOG_ADD(LOG_INT16, s2, &state_packed[2])
+LOG_ADD(LOG_INT16, s3, &state_packed[3])
+LOG_ADD(LOG_INT16, s4, &state_packed[4])
+LOG_ADD(LOG_INT16, s5, &state_packed[5])
+LOG_ADD(LOG_INT16, s6, &state_packed[6])
+LOG_ADD(LOG_INT16, s7, &state_packed[7])
+LOG_ADD(LOG_INT16, s8, &state_packed[8])
+LOG_ADD(LOG_INT16, s9, &state_packed[9])
+LOG_ADD(LOG_INT16, s10, &state_packed[10])
+LOG_ADD(LOG_INT16, s11, &state_packed[11])
+LOG_GROUP_STOP(rltpa)
+
+LOG_GROUP_START(rltpb)
+LOG_ADD(LOG_UINT8, seq, &seq)
+LOG_ADD(LOG_INT16, s12, &state_packed[12])
+LOG_ADD(LOG_INT16, a1, &action_packed[0])
+LOG_ADD(LOG_INT16, a2, &action_packed[1])
+LOG_ADD(LOG_INT16, a3, &action_packed[2])
+LOG_ADD(LOG_INT16, a4, &action_packed[3])
+LOG_ADD(LOG_UINT16, m1, &motor_cmd_packed[0])
+LOG_ADD(LOG_UINT16, m2, &motor_cmd_packed[1])
+LOG_ADD(LOG_UINT16, m3, &motor_cmd_packed[2])
+LOG_ADD(LOG_UINT16, m4, &motor_cmd_packed[3])
+LOG_ADD(LOG_UINT8, flags, &flags_packed)
+LOG_GROUP_STOP(rltpb)
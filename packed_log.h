@@ -0,0 +1,21 @@
+#ifndef __PACKED_LOG_H__
+#define __PACKED_LOG_H__
+
+#include <stdint.h>
+
+// Packed telemetry of the learned-policy internals (state_input, action_output, motor_cmd) for high-rate logging.
+// Values are quantized to int16 as round(value / scale * PACKED_LOG_FULL_SCALE), saturating, with the scales exposed
+// as parameters (rltp.*); non-positive scales and NaN values log 0. The snapshot is split into two LOG groups that both start with the same sequence counter:
+//   rltpa: seq, s0..s11                      (25 bytes)
+//   rltpb: seq, s12, a1..a4, m1..m4, flags   (20 bytes)
+// so each group fits in one log packet and the host (scripts/packedlog.py) can pair the halves of a snapshot.
+#define PACKED_LOG_FULL_SCALE 32767
+#define PACKED_LOG_STATE_DIM 13
+#define PACKED_LOG_ACTION_DIM 4
+#define PACKED_LOG_FLAG_SET_MOTORS (1 << 0)
+
+void packed_log_init(void);
+// Quantizes one snapshot and advances the sequence counter. Called once per inference tick.
+void packed_log_update(const float* state, const float* action, const uint16_t* motor_cmd, uint8_t flags);
+
+#endif
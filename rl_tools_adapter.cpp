@@ -3,14 +3,38 @@
 
 #include <rl_tools/operations/arm.h>
 #include <rl_tools/nn/layers/dense/operations_arm/opt.h>
+#ifndef RL_TOOLS_HOST_SIM
 #include <rl_tools/nn/layers/dense/operations_arm/dsp.h>
+#endif
 #include <rl_tools/nn_models/sequential/operations_generic.h>
 
-#include "policies/l2f_action_history_delay_3M.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#ifdef RL_TOOLS_HOST_SIM
+#include <chrono>
+#else
+#define RL_TOOLS_KERNEL_DSP_AVAILABLE
+extern "C" uint64_t usecTimestamp(void);
+#endif
 
-#define RL_TOOLS_CONTROL_STATE_ROTATION_MATRIX
-#define RL_TOOLS_DISABLE_TEST
-#define RL_TOOLS_ACTION_HISTORY
+// Any checkpoint can be selected, e.g. -DRL_TOOLS_CHECKPOINT='"data/decimation_2.h"' -DRL_TOOLS_CONTROL_FREQUENCY_MULTIPLE=2,
+// its observation layout comes from rl_tools_adapter_spec.h
+#ifndef RL_TOOLS_CHECKPOINT
+#define RL_TOOLS_CHECKPOINT "policies/l2f_action_history_delay_3M.h"
+#ifndef RL_TOOLS_CONTROL_FREQUENCY_MULTIPLE
+#define RL_TOOLS_CONTROL_FREQUENCY_MULTIPLE 5 // the default checkpoint was trained with the L2F decimation
+#endif
+#endif
+#include RL_TOOLS_CHECKPOINT
+#include "rl_tools_adapter_spec.h"
+#include "rl_tools_adapter_kernels.h"
+#include "rl_tools_adapter_precision.h"
+#ifdef RL_TOOLS_HOST_SIM
+#include <cstdio>
+#endif
 
 
 // Definitions
@@ -22,21 +46,102 @@ DEVICE device;
 using ACTOR_TYPE = rlt::checkpoint::actor::MODEL;
 using TI = typename ACTOR_TYPE::SPEC::TI;
 using T = typename ACTOR_TYPE::SPEC::T;
-constexpr TI CONTROL_FREQUENCY_MULTIPLE = 5;
-static TI controller_tick = 0;
-constexpr TI ACTION_HISTORY_LENGTH = 32; //rlt::checkpoint::environment::ACTION_HISTORY_LENGTH
-#ifdef RL_TOOLS_ACTION_HISTORY
-static_assert(ACTOR_TYPE::SPEC::INPUT_DIM == (18 + ACTION_HISTORY_LENGTH * ACTOR_TYPE::SPEC::OUTPUT_DIM));
+using OBSERVATION_SPEC = typename rl_tools_adapter::CheckpointObservationSpec<typename ACTOR_TYPE::SPEC>::SPEC;
+constexpr TI CONTROL_FREQUENCY_MULTIPLE = OBSERVATION_SPEC::CONTROL_FREQUENCY_MULTIPLE;
+constexpr TI ACTION_HISTORY_LENGTH = OBSERVATION_SPEC::ACTION_HISTORY_LENGTH;
+constexpr TI ACTION_DIM = OBSERVATION_SPEC::ACTION_DIM;
+using LAYER_0 = decltype(ACTOR_TYPE::content);
+using LAYER_1 = decltype(decltype(ACTOR_TYPE::next_module)::content);
+using LAYER_2 = decltype(decltype(decltype(ACTOR_TYPE::next_module)::next_module)::content);
+constexpr TI KERNEL_LAYERS = 3;
+static_assert(KERNEL_LAYERS <= RL_TOOLS_KERNEL_MAX_LAYERS);
+constexpr TI HIDDEN_DIM = LAYER_0::SPEC::OUTPUT_DIM > LAYER_1::SPEC::OUTPUT_DIM ? LAYER_0::SPEC::OUTPUT_DIM : LAYER_1::SPEC::OUTPUT_DIM;
+
+// State (per vehicle, the weights are shared)
+struct rl_tools_context{
+    ACTOR_TYPE::template Buffer<1, rlt::MatrixStaticTag> buffers;
+    rlt::MatrixStatic<rlt::matrix::Specification<T, TI, 1, ACTOR_TYPE::SPEC::INPUT_DIM>> input;
+    rlt::MatrixStatic<rlt::matrix::Specification<T, TI, 1, ACTOR_TYPE::SPEC::OUTPUT_DIM>> output;
+    T action_history[ACTION_HISTORY_LENGTH > 0 ? ACTION_HISTORY_LENGTH : 1][ACTION_DIM];
+    T hidden[2][HIDDEN_DIM]; // layer outputs of the layer-wise kernels
+    TI controller_tick;
+    unsigned char kernel_selection[KERNEL_LAYERS];
+    bool kernel_layerwise; // as soon as one layer selects a registry kernel
+    void (*layer_callback)(const rl_tools_context_t* context, unsigned int layer);
+    bool precision_tracking;
+    float precision_ranges[KERNEL_LAYERS]; // max |input| per layer while tracking
+};
+static_assert(alignof(rl_tools_context) <= alignof(std::max_align_t), "rl_tools_context_init expects malloc-aligned memory");
+
+// Core-coupled memory (64 KB, zero wait states, no DMA) is shared with the firmware, so only RL_TOOLS_CCM_BUDGET bytes
+// are claimed (0: weights read from flash, state in SRAM). Within the budget, in this order and as long as they fit:
+// the default context (buffers, input, output, action history), the output layer, layer_1 and the non-history columns
+// of layer_0 (the action-history columns make up most of it and stay in flash). The weights are copied in by
+// rl_tools_init(); placed layers 1 and 2 are evaluated through placed_model, the split layer_0 by the layer-wise path.
+#ifndef RL_TOOLS_CCM_BUDGET
+#define RL_TOOLS_CCM_BUDGET 0
+#endif
+#ifdef RL_TOOLS_HOST_SIM
+#define RL_TOOLS_CCM // same placement in ordinary memory
 #else
-static_assert(ACTOR_TYPE::SPEC::INPUT_DIM == 18);
+#define RL_TOOLS_CCM __attribute__((section(".ccmbss"))) // NO_DMA_CCM_SAFE_ZERO_INIT in the firmware
+#endif
+static_assert(RL_TOOLS_CCM_BUDGET <= 64 * 1024, "RL_TOOLS_CCM_BUDGET exceeds the core-coupled memory");
+constexpr TI STATE_DIM = OBSERVATION_SPEC::STATE_DIM;
+template <typename LAYER>
+static constexpr TI ccm_layer_size(TI columns){
+    return (LAYER::SPEC::OUTPUT_DIM * columns + LAYER::SPEC::OUTPUT_DIM) * sizeof(T); // weights and biases
+}
+constexpr bool CCM_CONTEXT = sizeof(rl_tools_context) <= RL_TOOLS_CCM_BUDGET;
+constexpr TI CCM_USED_CONTEXT = CCM_CONTEXT ? sizeof(rl_tools_context) : 0;
+constexpr bool CCM_LAYER_2 = CCM_USED_CONTEXT + ccm_layer_size<LAYER_2>(LAYER_2::SPEC::INPUT_DIM) <= RL_TOOLS_CCM_BUDGET;
+constexpr TI CCM_USED_2 = CCM_USED_CONTEXT + (CCM_LAYER_2 ? ccm_layer_size<LAYER_2>(LAYER_2::SPEC::INPUT_DIM) : 0);
+constexpr bool CCM_LAYER_1 = CCM_USED_2 + ccm_layer_size<LAYER_1>(LAYER_1::SPEC::INPUT_DIM) <= RL_TOOLS_CCM_BUDGET;
+constexpr TI CCM_USED_1 = CCM_USED_2 + (CCM_LAYER_1 ? ccm_layer_size<LAYER_1>(LAYER_1::SPEC::INPUT_DIM) : 0);
+constexpr bool CCM_LAYER_0 = CCM_USED_1 + ccm_layer_size<LAYER_0>(STATE_DIM) <= RL_TOOLS_CCM_BUDGET;
+constexpr TI CCM_USED = CCM_USED_1 + (CCM_LAYER_0 ? ccm_layer_size<LAYER_0>(STATE_DIM) : 0);
+alignas(rl_tools_context) static unsigned char default_context_memory[CCM_CONTEXT ? 1 : sizeof(rl_tools_context)];
+alignas(rl_tools_context) static unsigned char default_context_memory_ccm[CCM_CONTEXT ? sizeof(rl_tools_context) : 1] RL_TOOLS_CCM;
+static rl_tools_context* const default_context = (rl_tools_context*)(CCM_CONTEXT ? default_context_memory_ccm : default_context_memory);
+alignas(8) static T ccm_layer_2[CCM_LAYER_2 ? ccm_layer_size<LAYER_2>(LAYER_2::SPEC::INPUT_DIM) / sizeof(T) : 1] RL_TOOLS_CCM;
+alignas(8) static T ccm_layer_1[CCM_LAYER_1 ? ccm_layer_size<LAYER_1>(LAYER_1::SPEC::INPUT_DIM) / sizeof(T) : 1] RL_TOOLS_CCM;
+alignas(8) static T ccm_layer_0[CCM_LAYER_0 ? ccm_layer_size<LAYER_0>(STATE_DIM) / sizeof(T) : 1] RL_TOOLS_CCM; // OUTPUT_DIM x STATE_DIM, biases
+// The checkpoint model with the parameters of the placed layers pointing to their copies
+static ACTOR_TYPE placed_model = rlt::checkpoint::actor::model;
+
+#ifndef RL_TOOLS_KERNEL_TOLERANCE
+#define RL_TOOLS_KERNEL_TOLERANCE 1e-4f // accepted deviation of the layer-wise actions from rl_tools
 #endif
 
-// State
-static ACTOR_TYPE::template Buffer<1, rlt::MatrixStaticTag> buffers;
-static rlt::MatrixStatic<rlt::matrix::Specification<T, TI, 1, ACTOR_TYPE::SPEC::INPUT_DIM>> input;
-static rlt::MatrixStatic<rlt::matrix::Specification<T, TI, 1, ACTOR_TYPE::SPEC::OUTPUT_DIM>> output;
-#ifdef RL_TOOLS_ACTION_HISTORY
-static T action_history[ACTION_HISTORY_LENGTH][ACTOR_TYPE::SPEC::OUTPUT_DIM];
+// Precision selection (rl_tools_adapter.h); a compiled configuration (RL_TOOLS_PRECISION_CONFIG, written by
+// sim/build/precision) provides the quantized weights of its layers as flash constants
+struct LayerPrecision{
+    unsigned char weights;
+    unsigned char activations;
+    float range; // fixed-point activations: |input| <= range
+    const void* data; // quantized weights (nullptr for fp32)
+    const float* scales; // per output row (integer formats)
+    unsigned int size; // bytes of data
+};
+#ifdef RL_TOOLS_PRECISION_CONFIG
+#include RL_TOOLS_PRECISION_CONFIG
+#else
+#define RL_TOOLS_PRECISION_LAYERS {}
+#endif
+static constexpr LayerPrecision COMPILED_PRECISION[KERNEL_LAYERS] = RL_TOOLS_PRECISION_LAYERS;
+// Shared by all contexts like the weights it points to (set it before contexts evaluate concurrently)
+static LayerPrecision layer_precision[KERNEL_LAYERS];
+static bool precision_layerwise = false; // as soon as one layer is not fp32
+static constexpr LayerPrecision FP32_PRECISION = {};
+#ifdef RL_TOOLS_HOST_SIM
+template <typename LAYER>
+struct QuantizedLayer{
+    uint16_t weights[LAYER::SPEC::INPUT_DIM * LAYER::SPEC::OUTPUT_DIM]; // 2 bytes per weight cover every reduced format
+    float scales[LAYER::SPEC::OUTPUT_DIM];
+};
+static QuantizedLayer<LAYER_0> quantized_0;
+static QuantizedLayer<LAYER_1> quantized_1;
+static QuantizedLayer<LAYER_2> quantized_2;
 #endif
 
 
@@ -68,32 +173,463 @@ static inline void observe_rotation_matrix(const rlt::Matrix<STATE_SPEC>& state,
     rlt::set(observation, 0, 15 + 1, rlt::get(state, 0, 3 + 4 + 3 + 1));
     rlt::set(observation, 0, 15 + 2, rlt::get(state, 0, 3 + 4 + 3 + 2));
 }
+template <typename STATE_SPEC, typename OBS_SPEC>
+static inline void observe_quaternion(const rlt::Matrix<STATE_SPEC>& state, rlt::Matrix<OBS_SPEC>& observation){
+    static_assert(OBS_SPEC::ROWS == 1);
+    static_assert(OBS_SPEC::COLS == 13);
+    for(TI state_i = 0; state_i < 13; state_i++){
+        rlt::set(observation, 0, state_i, rlt::get(state, 0, state_i));
+    }
+}
+
+static constexpr unsigned int precision_weight_size(unsigned char weights){
+    return weights == RL_TOOLS_PRECISION_INT8 ? 1 : (weights == RL_TOOLS_PRECISION_FP32 ? sizeof(T) : 2);
+}
+
+template <typename LAYER>
+static constexpr bool compiled_precision_matches(const LayerPrecision& precision){
+    return precision.weights == RL_TOOLS_PRECISION_FP32 || precision.size == LAYER::SPEC::INPUT_DIM * LAYER::SPEC::OUTPUT_DIM * precision_weight_size(precision.weights);
+}
+static_assert(compiled_precision_matches<LAYER_0>(COMPILED_PRECISION[0]) && compiled_precision_matches<LAYER_1>(COMPILED_PRECISION[1]) && compiled_precision_matches<LAYER_2>(COMPILED_PRECISION[2]),
+    "RL_TOOLS_PRECISION_CONFIG was written for a checkpoint with different layer sizes");
+
+// Firmware builds only contain the kernels of the compiled configuration, the host simulation all of them
+static constexpr bool precision_available(TI layer_i, unsigned char weights, unsigned char activations){
+    if(weights == RL_TOOLS_PRECISION_FP32){
+        return activations == RL_TOOLS_PRECISION_ACTIVATIONS_FP32;
+    }
+    if(weights >= RL_TOOLS_PRECISION_WEIGHT_FORMATS || activations > RL_TOOLS_PRECISION_ACTIVATIONS_FIXED || (weights == RL_TOOLS_PRECISION_FP16 && activations == RL_TOOLS_PRECISION_ACTIVATIONS_FIXED)){
+        return false;
+    }
+#ifdef RL_TOOLS_HOST_SIM
+    return true;
+#else
+    return COMPILED_PRECISION[layer_i].weights == weights && COMPILED_PRECISION[layer_i].activations == activations;
+#endif
+}
+
+template <TI LAYER_I, unsigned char WEIGHTS, unsigned char ACTIVATIONS, typename LAYER>
+static bool evaluate_reduced(const LAYER& layer, const LayerPrecision& precision, const T* input, T* output){
+    if constexpr(precision_available(LAYER_I, WEIGHTS, ACTIVATIONS)){
+        if(precision.weights == WEIGHTS && precision.activations == ACTIVATIONS){
+            using STORAGE = typename rl_tools_adapter::precision::Storage<WEIGHTS>::TYPE;
+            rl_tools_adapter::precision::dense<WEIGHTS, ACTIVATIONS, T, TI, LAYER::SPEC::OUTPUT_DIM, LAYER::SPEC::INPUT_DIM>((const STORAGE*)precision.data, precision.scales, layer.biases.parameters._data, precision.range, input, output);
+            return true;
+        }
+    }
+    return false;
+}
+
+template <TI LAYER_I, typename LAYER>
+static void evaluate_layer(const LAYER& layer, unsigned char kernel, const LayerPrecision& precision, const T* input, T* output, float* ranges = nullptr){
+    using SPEC = typename LAYER::SPEC;
+    constexpr TI INPUT_DIM = SPEC::INPUT_DIM;
+    constexpr TI OUTPUT_DIM = SPEC::OUTPUT_DIM;
+    if(ranges != nullptr){
+        for(TI input_i = 0; input_i < INPUT_DIM; input_i++){
+            ranges[LAYER_I] = std::fmax(ranges[LAYER_I], std::abs(input[input_i]));
+        }
+    }
+    bool reduced = evaluate_reduced<LAYER_I, RL_TOOLS_PRECISION_FP16, RL_TOOLS_PRECISION_ACTIVATIONS_FP32>(layer, precision, input, output) ||
+                   evaluate_reduced<LAYER_I, RL_TOOLS_PRECISION_INT16, RL_TOOLS_PRECISION_ACTIVATIONS_FP32>(layer, precision, input, output) ||
+                   evaluate_reduced<LAYER_I, RL_TOOLS_PRECISION_INT16, RL_TOOLS_PRECISION_ACTIVATIONS_FIXED>(layer, precision, input, output) ||
+                   evaluate_reduced<LAYER_I, RL_TOOLS_PRECISION_INT8, RL_TOOLS_PRECISION_ACTIVATIONS_FP32>(layer, precision, input, output) ||
+                   evaluate_reduced<LAYER_I, RL_TOOLS_PRECISION_INT8, RL_TOOLS_PRECISION_ACTIVATIONS_FIXED>(layer, precision, input, output);
+    if(!reduced){
+        const T* weights = layer.weights.parameters._data;
+        const T* biases = layer.biases.parameters._data;
+        namespace kernels = rl_tools_adapter::kernels;
+        if constexpr(LAYER_I == 0 && CCM_LAYER_0){
+            // Non-history columns from their copy, the history columns from flash (the kernel selection does not apply)
+            kernels::unrolled<T, TI, OUTPUT_DIM, STATE_DIM>(ccm_layer_0, ccm_layer_0 + OUTPUT_DIM * STATE_DIM, input, output);
+            kernels::accumulate<T, TI, OUTPUT_DIM, INPUT_DIM - STATE_DIM, INPUT_DIM>(weights + STATE_DIM, input + STATE_DIM, output);
+        }
+        else switch(kernel){
+            case RL_TOOLS_KERNEL_NAIVE: kernels::naive<T, TI, OUTPUT_DIM, INPUT_DIM>(weights, biases, input, output); break;
+            case RL_TOOLS_KERNEL_PANEL: kernels::panel<T, TI, OUTPUT_DIM, INPUT_DIM>(weights, biases, input, output); break;
+#ifdef RL_TOOLS_KERNEL_DSP_AVAILABLE
+            case RL_TOOLS_KERNEL_DSP: kernels::dsp<T, TI, OUTPUT_DIM, INPUT_DIM>(weights, biases, input, output); break;
+#endif
+            default: kernels::unrolled<T, TI, OUTPUT_DIM, INPUT_DIM>(weights, biases, input, output); break;
+        }
+    }
+    for(TI output_i = 0; output_i < OUTPUT_DIM; output_i++){
+        output[output_i] = rlt::activation<typename DEVICE::SPEC::MATH, T, SPEC::ACTIVATION_FUNCTION>(output[output_i]);
+    }
+}
+
+// In fp32 whatever the precision selection (kernel autotuning)
+static void evaluate_layer_index(TI layer_i, unsigned char kernel, const T* input, T* output){
+    switch(layer_i){
+        case 0: evaluate_layer<0>(placed_model.content, kernel, FP32_PRECISION, input, output); break;
+        case 1: evaluate_layer<1>(placed_model.next_module.content, kernel, FP32_PRECISION, input, output); break;
+        case 2: evaluate_layer<2>(placed_model.next_module.next_module.content, kernel, FP32_PRECISION, input, output); break;
+    }
+}
+
+template <typename LAYER>
+static void place_layer(const LAYER& source, LAYER& destination, T* memory){
+    constexpr TI WEIGHTS = LAYER::SPEC::OUTPUT_DIM * LAYER::SPEC::INPUT_DIM;
+    std::memcpy(memory, source.weights.parameters._data, WEIGHTS * sizeof(T));
+    std::memcpy(memory + WEIGHTS, source.biases.parameters._data, LAYER::SPEC::OUTPUT_DIM * sizeof(T));
+    destination.weights.parameters._data = memory;
+    destination.biases.parameters._data = memory + WEIGHTS;
+}
+
+static void place_weights(){
+    const ACTOR_TYPE& model = rlt::checkpoint::actor::model;
+    if constexpr(CCM_LAYER_2){
+        place_layer(model.next_module.next_module.content, placed_model.next_module.next_module.content, ccm_layer_2);
+    }
+    if constexpr(CCM_LAYER_1){
+        place_layer(model.next_module.content, placed_model.next_module.content, ccm_layer_1);
+    }
+    if constexpr(CCM_LAYER_0){
+        constexpr TI OUTPUT_DIM = LAYER_0::SPEC::OUTPUT_DIM;
+        for(TI output_i = 0; output_i < OUTPUT_DIM; output_i++){
+            std::memcpy(ccm_layer_0 + output_i * STATE_DIM, model.content.weights.parameters._data + output_i * LAYER_0::SPEC::INPUT_DIM, STATE_DIM * sizeof(T));
+        }
+        std::memcpy(ccm_layer_0 + OUTPUT_DIM * STATE_DIM, model.content.biases.parameters._data, OUTPUT_DIM * sizeof(T));
+    }
+}
+
+static void update_precision_layerwise(){
+    precision_layerwise = false;
+    for(TI layer_i = 0; layer_i < KERNEL_LAYERS; layer_i++){
+        precision_layerwise = precision_layerwise || layer_precision[layer_i].weights != RL_TOOLS_PRECISION_FP32;
+    }
+}
+
+#ifdef RL_TOOLS_HOST_SIM
+template <typename LAYER>
+static void quantize_layer(const LAYER& layer, QuantizedLayer<LAYER>& buffer, unsigned char weights, LayerPrecision& precision){
+    constexpr TI INPUT_DIM = LAYER::SPEC::INPUT_DIM;
+    constexpr TI OUTPUT_DIM = LAYER::SPEC::OUTPUT_DIM;
+    namespace quantization = rl_tools_adapter::precision;
+    const T* data = layer.weights.parameters._data;
+    switch(weights){
+        case RL_TOOLS_PRECISION_FP16: quantization::quantize<RL_TOOLS_PRECISION_FP16, T, TI, OUTPUT_DIM, INPUT_DIM>(data, buffer.weights, buffer.scales); break;
+        case RL_TOOLS_PRECISION_INT16: quantization::quantize<RL_TOOLS_PRECISION_INT16, T, TI, OUTPUT_DIM, INPUT_DIM>(data, (int16_t*)buffer.weights, buffer.scales); break;
+        case RL_TOOLS_PRECISION_INT8: quantization::quantize<RL_TOOLS_PRECISION_INT8, T, TI, OUTPUT_DIM, INPUT_DIM>(data, (int8_t*)buffer.weights, buffer.scales); break;
+    }
+    precision.data = buffer.weights;
+    precision.scales = buffer.scales;
+    precision.size = INPUT_DIM * OUTPUT_DIM * precision_weight_size(weights);
+}
+
+template <typename LAYER>
+static void write_layer_config(FILE* file, const LAYER& layer, TI layer_i, const LayerPrecision& precision){
+    constexpr TI INPUT_DIM = LAYER::SPEC::INPUT_DIM;
+    constexpr TI OUTPUT_DIM = LAYER::SPEC::OUTPUT_DIM;
+    if(precision.weights == RL_TOOLS_PRECISION_FP32){
+        return;
+    }
+    const char* type = precision.weights == RL_TOOLS_PRECISION_INT8 ? "int8_t" : (precision.weights == RL_TOOLS_PRECISION_INT16 ? "int16_t" : "uint16_t");
+    fprintf(file, "static const %s rl_tools_precision_l%u_weights[%u] = { // %s, %u x %u\n", type, (unsigned)layer_i, (unsigned)(INPUT_DIM * OUTPUT_DIM), rl_tools_precision_name(precision.weights, RL_TOOLS_PRECISION_ACTIVATIONS_FP32), (unsigned)OUTPUT_DIM, (unsigned)INPUT_DIM);
+    for(TI weight_i = 0; weight_i < INPUT_DIM * OUTPUT_DIM; weight_i++){
+        switch(precision.weights){
+            case RL_TOOLS_PRECISION_INT8: fprintf(file, "%d,", ((const int8_t*)precision.data)[weight_i]); break;
+            case RL_TOOLS_PRECISION_INT16: fprintf(file, "%d,", ((const int16_t*)precision.data)[weight_i]); break;
+            default: fprintf(file, "0x%04x,", ((const uint16_t*)precision.data)[weight_i]); break;
+        }
+        fprintf(file, (weight_i + 1) % 16 == 0 || weight_i + 1 == INPUT_DIM * OUTPUT_DIM ? "\n" : " ");
+    }
+    fprintf(file, "};\n");
+    if(precision.weights != RL_TOOLS_PRECISION_FP16){
+        fprintf(file, "static const float rl_tools_precision_l%u_scales[%u] = {\n", (unsigned)layer_i, (unsigned)OUTPUT_DIM);
+        for(TI output_i = 0; output_i < OUTPUT_DIM; output_i++){
+            fprintf(file, "%.9ef,%s", precision.scales[output_i], (output_i + 1) % 8 == 0 || output_i + 1 == OUTPUT_DIM ? "\n" : " ");
+        }
+        fprintf(file, "};\n");
+    }
+}
+#endif
+
+static uint64_t kernel_clock_ns(){
+#ifdef RL_TOOLS_HOST_SIM
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+    return usecTimestamp() * 1000;
+#endif
+}
 
 // Main functions (possibly with side effects)
 void rl_tools_init(){
-    rlt::malloc(device, buffers);
-    rlt::malloc(device, input);
-    rlt::malloc(device, output);
-#ifdef RL_TOOLS_ACTION_HISTORY
+    // A compiled configuration only applies to the checkpoint it was quantized from
+#ifdef RL_TOOLS_PRECISION_CHECKPOINT
+    bool compiled = std::strcmp(RL_TOOLS_PRECISION_CHECKPOINT, rlt::checkpoint::meta::name) == 0;
+#else
+    bool compiled = false;
+#endif
+    for(TI layer_i = 0; layer_i < KERNEL_LAYERS; layer_i++){
+        layer_precision[layer_i] = compiled ? COMPILED_PRECISION[layer_i] : LayerPrecision{};
+    }
+    update_precision_layerwise();
+    place_weights();
+    rl_tools_context_init(default_context);
+}
+
+unsigned int rl_tools_ccm_usage(unsigned int* placement, unsigned int* flash_bytes){
+    if(placement != nullptr){
+        *placement = (CCM_CONTEXT ? RL_TOOLS_CCM_CONTEXT : 0) | (CCM_LAYER_0 ? RL_TOOLS_CCM_LAYER_0_STATE : 0) | (CCM_LAYER_1 ? RL_TOOLS_CCM_LAYER_1 : 0) | (CCM_LAYER_2 ? RL_TOOLS_CCM_LAYER_2 : 0);
+    }
+    if(flash_bytes != nullptr){
+        // Reduced-precision layers read their quantized weights from flash whatever the placement
+        const TI fp32_flash[KERNEL_LAYERS] = {
+            CCM_LAYER_0 ? LAYER_0::SPEC::OUTPUT_DIM * (LAYER_0::SPEC::INPUT_DIM - STATE_DIM) * sizeof(T) : ccm_layer_size<LAYER_0>(LAYER_0::SPEC::INPUT_DIM),
+            CCM_LAYER_1 ? 0 : ccm_layer_size<LAYER_1>(LAYER_1::SPEC::INPUT_DIM),
+            CCM_LAYER_2 ? 0 : ccm_layer_size<LAYER_2>(LAYER_2::SPEC::INPUT_DIM),
+        };
+        *flash_bytes = 0;
+        for(TI layer_i = 0; layer_i < KERNEL_LAYERS; layer_i++){
+            *flash_bytes += layer_precision[layer_i].weights == RL_TOOLS_PRECISION_FP32 ? fp32_flash[layer_i] : layer_precision[layer_i].size;
+        }
+    }
+    return CCM_USED;
+}
+
+unsigned int rl_tools_context_size(){
+    return sizeof(rl_tools_context);
+}
+
+rl_tools_context_t* rl_tools_context_init(void* memory){
+    rl_tools_context* context = new (memory) rl_tools_context;
+    rlt::malloc(device, context->buffers);
+    rlt::malloc(device, context->input);
+    rlt::malloc(device, context->output);
     for(TI step_i = 0; step_i < ACTION_HISTORY_LENGTH; step_i++){
-        for(TI action_i = 0; action_i < ACTOR_TYPE::SPEC::OUTPUT_DIM; action_i++){
-            action_history[step_i][action_i] = 0;
+        for(TI action_i = 0; action_i < ACTION_DIM; action_i++){
+            context->action_history[step_i][action_i] = 0;
+        }
+    }
+    context->controller_tick = 0;
+    for(TI layer_i = 0; layer_i < KERNEL_LAYERS; layer_i++){
+        context->kernel_selection[layer_i] = RL_TOOLS_KERNEL_RL_TOOLS;
+    }
+    context->kernel_layerwise = false;
+    context->layer_callback = nullptr;
+    context->precision_tracking = false;
+    for(TI layer_i = 0; layer_i < KERNEL_LAYERS; layer_i++){
+        context->precision_ranges[layer_i] = 0;
+    }
+    return context;
+}
+
+rl_tools_context_t* rl_tools_context_default(){
+    return default_context;
+}
+
+unsigned int rl_tools_kernel_layers(){
+    return KERNEL_LAYERS;
+}
+
+int rl_tools_kernel_available(unsigned char kernel){
+#ifndef RL_TOOLS_KERNEL_DSP_AVAILABLE
+    if(kernel == RL_TOOLS_KERNEL_DSP){
+        return 0;
+    }
+#endif
+    return kernel >= RL_TOOLS_KERNEL_RL_TOOLS && kernel < RL_TOOLS_KERNEL_COUNT;
+}
+
+const char* rl_tools_kernel_name(unsigned char kernel){
+    static const char* names[RL_TOOLS_KERNEL_COUNT] = {"auto", "rl_tools", "naive", "unrolled", "panel", "dsp"};
+    return kernel < RL_TOOLS_KERNEL_COUNT ? names[kernel] : "unknown";
+}
+
+unsigned char rl_tools_kernel_get(const rl_tools_context_t* context, unsigned int layer){
+    return layer < KERNEL_LAYERS ? context->kernel_selection[layer] : RL_TOOLS_KERNEL_AUTO;
+}
+
+int rl_tools_kernel_set(rl_tools_context_t* context, unsigned int layer, unsigned char kernel){
+    if(layer >= KERNEL_LAYERS || !rl_tools_kernel_available(kernel)){
+        return 0;
+    }
+    context->kernel_selection[layer] = kernel;
+    context->kernel_layerwise = false;
+    for(TI layer_i = 0; layer_i < KERNEL_LAYERS; layer_i++){
+        context->kernel_layerwise = context->kernel_layerwise || context->kernel_selection[layer_i] != RL_TOOLS_KERNEL_RL_TOOLS;
+    }
+    return 1;
+}
+
+float rl_tools_kernel_autotune(rl_tools_context_t* context, unsigned int repetitions, unsigned char* selection, float* rl_tools_us){
+    repetitions = repetitions > 0 ? repetitions : 1;
+    // The kernels only apply to fp32 layers, they are compared against rl_tools in full precision (the shared precision
+    // selection is left alone, evaluate_layer_index() ignores it)
+    uint32_t seed = 1;
+    for(TI input_i = 0; input_i < ACTOR_TYPE::SPEC::INPUT_DIM; input_i++){
+        seed = seed * 1664525 + 1013904223;
+        rlt::set(context->input, 0, input_i, (T)(seed >> 8) / (T)(1 << 23) - 1);
+    }
+    T reference[ACTION_DIM];
+    T actions[ACTION_DIM];
+    rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, 1, ACTION_DIM, rlt::matrix::layouts::RowMajorAlignment<TI, 1>>> reference_matrix = {reference};
+    uint64_t start = kernel_clock_ns();
+    for(unsigned int repetition_i = 0; repetition_i < repetitions; repetition_i++){
+        rlt::evaluate(device, placed_model, context->input, reference_matrix, context->buffers);
+    }
+    float rl_tools_time = (kernel_clock_ns() - start) / 1000.0f / repetitions;
+
+    unsigned char best[KERNEL_LAYERS];
+    float layerwise_time = 0;
+    const T* layer_input = context->input._data;
+    for(TI layer_i = 0; layer_i < KERNEL_LAYERS; layer_i++){
+        T* layer_output = layer_i + 1 < KERNEL_LAYERS ? context->hidden[layer_i % 2] : actions;
+        float best_time = INFINITY;
+        best[layer_i] = RL_TOOLS_KERNEL_UNROLLED;
+        for(unsigned char kernel = RL_TOOLS_KERNEL_NAIVE; kernel < RL_TOOLS_KERNEL_COUNT; kernel++){
+            if(!rl_tools_kernel_available(kernel)){
+                continue;
+            }
+            start = kernel_clock_ns();
+            for(unsigned int repetition_i = 0; repetition_i < repetitions; repetition_i++){
+                evaluate_layer_index(layer_i, kernel, layer_input, layer_output);
+            }
+            float time = (kernel_clock_ns() - start) / 1000.0f / repetitions;
+            if(time < best_time){
+                best_time = time;
+                best[layer_i] = kernel;
+            }
         }
+        evaluate_layer_index(layer_i, best[layer_i], layer_input, layer_output);
+        layerwise_time += best_time;
+        layer_input = layer_output;
+    }
+    bool consistent = true;
+    for(TI action_i = 0; action_i < ACTION_DIM; action_i++){
+        consistent = consistent && std::abs(actions[action_i] - reference[action_i]) <= RL_TOOLS_KERNEL_TOLERANCE * (1 + std::abs(reference[action_i]));
     }
+    bool layerwise = consistent && layerwise_time < rl_tools_time;
+    for(TI layer_i = 0; layer_i < KERNEL_LAYERS; layer_i++){
+        selection[layer_i] = layerwise ? best[layer_i] : RL_TOOLS_KERNEL_RL_TOOLS;
+    }
+    if(rl_tools_us != nullptr){
+        *rl_tools_us = rl_tools_time;
+    }
+    return layerwise ? layerwise_time : rl_tools_time;
+}
+
+void rl_tools_context_set_layer_callback(rl_tools_context_t* context, void (*callback)(const rl_tools_context_t* context, unsigned int layer)){
+    context->layer_callback = callback;
+}
+
+void rl_tools_layer_dims(unsigned int layer, unsigned int* input_dim, unsigned int* output_dim){
+    unsigned int dims[KERNEL_LAYERS][2] = {{LAYER_0::SPEC::INPUT_DIM, LAYER_0::SPEC::OUTPUT_DIM}, {LAYER_1::SPEC::INPUT_DIM, LAYER_1::SPEC::OUTPUT_DIM}, {LAYER_2::SPEC::INPUT_DIM, LAYER_2::SPEC::OUTPUT_DIM}};
+    *input_dim = layer < KERNEL_LAYERS ? dims[layer][0] : 0;
+    *output_dim = layer < KERNEL_LAYERS ? dims[layer][1] : 0;
+}
+
+int rl_tools_precision_available(unsigned int layer, unsigned char weights, unsigned char activations){
+    return layer < KERNEL_LAYERS && precision_available(layer, weights, activations);
+}
+
+const char* rl_tools_precision_name(unsigned char weights, unsigned char activations){
+    static const char* names[RL_TOOLS_PRECISION_WEIGHT_FORMATS][2] = {{"fp32", "fp32/fixed"}, {"fp16", "fp16/fixed"}, {"int16", "int16/fixed"}, {"int8", "int8/fixed"}};
+    return weights < RL_TOOLS_PRECISION_WEIGHT_FORMATS && activations <= RL_TOOLS_PRECISION_ACTIVATIONS_FIXED ? names[weights][activations] : "unknown";
+}
+
+int rl_tools_precision_set(unsigned int layer, unsigned char weights, unsigned char activations, float range){
+    if(!rl_tools_precision_available(layer, weights, activations) || (activations == RL_TOOLS_PRECISION_ACTIVATIONS_FIXED && !(range > 0))){
+        return 0;
+    }
+#ifdef RL_TOOLS_HOST_SIM
+    const ACTOR_TYPE& model = rlt::checkpoint::actor::model;
+#endif
+    LayerPrecision& precision = layer_precision[layer];
+    if(weights == RL_TOOLS_PRECISION_FP32){
+        precision = LayerPrecision{};
+    }
+    else if(COMPILED_PRECISION[layer].weights == weights){
+        precision = COMPILED_PRECISION[layer];
+    }
+    else{
+#ifdef RL_TOOLS_HOST_SIM
+        switch(layer){
+            case 0: quantize_layer(model.content, quantized_0, weights, precision); break;
+            case 1: quantize_layer(model.next_module.content, quantized_1, weights, precision); break;
+            case 2: quantize_layer(model.next_module.next_module.content, quantized_2, weights, precision); break;
+        }
+#endif
+    }
+    precision.weights = weights;
+    precision.activations = activations;
+    precision.range = activations == RL_TOOLS_PRECISION_ACTIVATIONS_FIXED ? range : 0;
+    update_precision_layerwise();
+    return 1;
+}
+
+unsigned char rl_tools_precision_get(unsigned int layer, unsigned char* activations, float* range){
+    const LayerPrecision precision = layer < KERNEL_LAYERS ? layer_precision[layer] : LayerPrecision{};
+    if(activations != nullptr){
+        *activations = precision.activations;
+    }
+    if(range != nullptr){
+        *range = precision.range;
+    }
+    return precision.weights;
+}
+
+void rl_tools_precision_track_ranges(rl_tools_context_t* context, int enable){
+    context->precision_tracking = enable != 0;
+    if(context->precision_tracking){
+        for(TI layer_i = 0; layer_i < KERNEL_LAYERS; layer_i++){
+            context->precision_ranges[layer_i] = 0;
+        }
+    }
+}
+
+void rl_tools_precision_ranges(const rl_tools_context_t* context, float* ranges){
+    std::memcpy(ranges, context->precision_ranges, sizeof(context->precision_ranges));
+}
+
+int rl_tools_precision_write_config(const char* path, const char* comment){
+#ifdef RL_TOOLS_HOST_SIM
+    FILE* file = fopen(path, "w");
+    if(file == nullptr){
+        return 0;
+    }
+    fprintf(file, "// Per-layer precision of %s for rl_tools_adapter.cpp (-DRL_TOOLS_PRECISION_CONFIG), written by sim/build/precision\n", rlt::checkpoint::meta::name);
+    if(comment != nullptr){
+        fprintf(file, "// %s\n", comment);
+    }
+    fprintf(file, "#define RL_TOOLS_PRECISION_CHECKPOINT \"%s\"\n", rlt::checkpoint::meta::name);
+    const ACTOR_TYPE& model = rlt::checkpoint::actor::model;
+    write_layer_config(file, model.content, 0, layer_precision[0]);
+    write_layer_config(file, model.next_module.content, 1, layer_precision[1]);
+    write_layer_config(file, model.next_module.next_module.content, 2, layer_precision[2]);
+    const char* weights_macros[RL_TOOLS_PRECISION_WEIGHT_FORMATS] = {"RL_TOOLS_PRECISION_FP32", "RL_TOOLS_PRECISION_FP16", "RL_TOOLS_PRECISION_INT16", "RL_TOOLS_PRECISION_INT8"};
+    fprintf(file, "#define RL_TOOLS_PRECISION_LAYERS { \\\n");
+    for(TI layer_i = 0; layer_i < KERNEL_LAYERS; layer_i++){
+        const LayerPrecision& precision = layer_precision[layer_i];
+        const char* activations = precision.activations == RL_TOOLS_PRECISION_ACTIVATIONS_FIXED ? "RL_TOOLS_PRECISION_ACTIVATIONS_FIXED" : "RL_TOOLS_PRECISION_ACTIVATIONS_FP32";
+        if(precision.weights == RL_TOOLS_PRECISION_FP32){
+            fprintf(file, "    {%s, %s, 0, nullptr, nullptr, 0}, \\\n", weights_macros[precision.weights], activations);
+        }
+        else{
+            fprintf(file, "    {%s, %s, %.9ef, rl_tools_precision_l%u_weights, %s, sizeof(rl_tools_precision_l%u_weights)}, \\\n",
+                weights_macros[precision.weights], activations, precision.range, (unsigned)layer_i,
+                precision.weights == RL_TOOLS_PRECISION_FP16 ? "nullptr" : (layer_i == 0 ? "rl_tools_precision_l0_scales" : (layer_i == 1 ? "rl_tools_precision_l1_scales" : "rl_tools_precision_l2_scales")),
+                (unsigned)layer_i);
+        }
+    }
+    fprintf(file, "}\n");
+    return fclose(file) == 0;
+#else
+    return 0;
 #endif
-    controller_tick = 0;
 }
 
 char* rl_tools_get_checkpoint_name(){
     return (char*)rlt::checkpoint::meta::name;
 }
 
-float rl_tools_test(float* output_mem){
+float rl_tools_context_test(rl_tools_context_t* context, float* output_mem){
 #ifndef RL_TOOLS_DISABLE_TEST
-    rlt::evaluate(device, rlt::checkpoint::actor::model, rlt::checkpoint::observation::container, output, buffers);
+    rlt::evaluate(device, placed_model, rlt::checkpoint::observation::container, context->output, context->buffers);
     float acc = 0;
-    for(int i = 0; i < ACTOR_TYPE::SPEC::OUTPUT_DIM; i++){
-        acc += std::abs(rlt::get(output, 0, i) - rlt::get(rlt::checkpoint::action::container, 0, i));
+    for(TI i = 0; i < ACTOR_TYPE::SPEC::OUTPUT_DIM; i++){
+        acc += std::abs(rlt::get(context->output, 0, i) - rlt::get(rlt::checkpoint::action::container, 0, i));
         output_mem[i] = rlt::get(rlt::checkpoint::action::container, 0, i);
     }
     return acc;
@@ -102,36 +638,118 @@ float rl_tools_test(float* output_mem){
 #endif
 }
 
-void rl_tools_control(float* state, float* actions){
+float rl_tools_test(float* output_mem){
+    return rl_tools_context_test(default_context, output_mem);
+}
+
+// Policy input for state with the context's action history (before normalization if normalize is false)
+static void observe(rl_tools_context_t* context, float* state, bool normalize){
     rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, 1, 13, rlt::matrix::layouts::RowMajorAlignment<TI, 1>>> state_matrix = {(T*)state}; 
-    auto state_rotation_matrix_input = rlt::view(device, input, rlt::matrix::ViewSpec<1, 18>{}, 0, 0);
-    observe_rotation_matrix(state_matrix, state_rotation_matrix_input);
-#ifdef RL_TOOLS_ACTION_HISTORY
-    auto action_history_observation = rlt::view(device, input, rlt::matrix::ViewSpec<1, ACTION_HISTORY_LENGTH * ACTOR_TYPE::SPEC::OUTPUT_DIM>{}, 0, 18);
-    for(TI step_i = 0; step_i < ACTION_HISTORY_LENGTH; step_i++){
-        for(TI action_i = 0; action_i < ACTOR_TYPE::SPEC::OUTPUT_DIM; action_i++){
-            rlt::set(action_history_observation, 0, step_i * ACTOR_TYPE::SPEC::OUTPUT_DIM + action_i, action_history[step_i][action_i]);
+    auto state_input = rlt::view(device, context->input, rlt::matrix::ViewSpec<1, OBSERVATION_SPEC::STATE_DIM>{}, 0, 0);
+    if constexpr(OBSERVATION_SPEC::ORIENTATION == rl_tools_adapter::Orientation::ROTATION_MATRIX){
+        observe_rotation_matrix(state_matrix, state_input);
+    }
+    else{
+        observe_quaternion(state_matrix, state_input);
+    }
+    if constexpr(ACTION_HISTORY_LENGTH > 0){
+        auto action_history_observation = rlt::view(device, context->input, rlt::matrix::ViewSpec<1, ACTION_HISTORY_LENGTH * ACTION_DIM>{}, 0, OBSERVATION_SPEC::STATE_DIM);
+        for(TI step_i = 0; step_i < ACTION_HISTORY_LENGTH; step_i++){
+            for(TI action_i = 0; action_i < ACTION_DIM; action_i++){
+                rlt::set(action_history_observation, 0, step_i * ACTION_DIM + action_i, context->action_history[step_i][action_i]);
+            }
         }
     }
-#endif
-    rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, 1, ACTOR_TYPE::SPEC::OUTPUT_DIM, rlt::matrix::layouts::RowMajorAlignment<TI, 1>>> output = {(T*)actions};
-    rlt::evaluate(device, rlt::checkpoint::actor::model, input, output, buffers);
-#ifdef RL_TOOLS_ACTION_HISTORY
-    int substep = controller_tick % CONTROL_FREQUENCY_MULTIPLE;
-    if(substep == 0){
-        for(TI step_i = 0; step_i < ACTION_HISTORY_LENGTH - 1; step_i++){
-            for(TI action_i = 0; action_i < ACTOR_TYPE::SPEC::OUTPUT_DIM; action_i++){
-                action_history[step_i][action_i] = action_history[step_i + 1][action_i];
+    if constexpr(OBSERVATION_SPEC::NORMALIZATION){
+        if(normalize){
+            for(TI input_i = 0; input_i < OBSERVATION_SPEC::INPUT_DIM; input_i++){
+                T value = rlt::get(context->input, 0, input_i);
+                rlt::set(context->input, 0, input_i, (value - rlt::checkpoint::observation_normalization::mean[input_i]) / rlt::checkpoint::observation_normalization::std[input_i]);
+            }
+        }
+    }
+}
+
+static void update_action_history(rl_tools_context_t* context, const float* actions){
+    if constexpr(ACTION_HISTORY_LENGTH > 0){
+        TI substep = context->controller_tick % CONTROL_FREQUENCY_MULTIPLE;
+        if(substep == 0){
+            for(TI step_i = 0; step_i < ACTION_HISTORY_LENGTH - 1; step_i++){
+                for(TI action_i = 0; action_i < ACTION_DIM; action_i++){
+                    context->action_history[step_i][action_i] = context->action_history[step_i + 1][action_i];
+                }
             }
         }
+        for(TI action_i = 0; action_i < ACTION_DIM; action_i++){
+            T value = context->action_history[ACTION_HISTORY_LENGTH - 1][action_i];
+            value *= substep;
+            value += actions[action_i];
+            value /= substep + 1;
+            context->action_history[ACTION_HISTORY_LENGTH - 1][action_i] = value;
+        }
     }
-    for(TI action_i = 0; action_i < ACTOR_TYPE::SPEC::OUTPUT_DIM; action_i++){
-        T value = action_history[ACTION_HISTORY_LENGTH - 1][action_i];
-        value *= substep;
-        value += rlt::get(output, 0, action_i);
-        value /= substep + 1;
-        action_history[ACTION_HISTORY_LENGTH - 1][action_i] = value;
+    context->controller_tick++;
+}
+
+unsigned int rl_tools_observation_layout(unsigned int* state_dim, unsigned int* action_dim){
+    *state_dim = OBSERVATION_SPEC::STATE_DIM;
+    *action_dim = ACTION_DIM;
+    return ACTION_HISTORY_LENGTH * CONTROL_FREQUENCY_MULTIPLE;
+}
+
+int rl_tools_context_observe(rl_tools_context_t* context, float* state, const float* actions, float* observation, int normalized){
+    observe(context, state, normalized != 0);
+    std::memcpy(observation, context->input._data, OBSERVATION_SPEC::INPUT_DIM * sizeof(T));
+    update_action_history(context, actions);
+    return 1;
+}
+
+void rl_tools_context_control(rl_tools_context_t* context, float* state, float* actions){
+    observe(context, state, true);
+    rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, 1, ACTION_DIM, rlt::matrix::layouts::RowMajorAlignment<TI, 1>>> output = {(T*)actions};
+    if(context->kernel_layerwise || precision_layerwise || context->precision_tracking || CCM_LAYER_0){
+        const ACTOR_TYPE& model = placed_model;
+        float* ranges = context->precision_tracking ? context->precision_ranges : nullptr;
+        evaluate_layer<0>(model.content, context->kernel_selection[0], layer_precision[0], context->input._data, context->hidden[0], ranges);
+        if(context->layer_callback != nullptr){
+            context->layer_callback(context, 0);
+        }
+        evaluate_layer<1>(model.next_module.content, context->kernel_selection[1], layer_precision[1], context->hidden[0], context->hidden[1], ranges);
+        if(context->layer_callback != nullptr){
+            context->layer_callback(context, 1);
+        }
+        evaluate_layer<2>(model.next_module.next_module.content, context->kernel_selection[2], layer_precision[2], context->hidden[1], (T*)actions, ranges);
+        if(context->layer_callback != nullptr){
+            context->layer_callback(context, 2);
+        }
     }
-#endif
-    controller_tick++;
+    else{
+        rlt::evaluate(device, placed_model, context->input, output, context->buffers);
+    }
+    update_action_history(context, actions);
+}
+
+void rl_tools_control(float* state, float* actions){
+    rl_tools_context_control(default_context, state, actions);
+}
+
+constexpr TI STATE_HISTORY_SIZE = ACTION_HISTORY_LENGTH * ACTION_DIM;
+static_assert(sizeof(T) == sizeof(uint32_t));
+
+unsigned int rl_tools_context_save_state(const rl_tools_context_t* context, uint32_t* state, unsigned int capacity){
+    if(1 + STATE_HISTORY_SIZE > capacity){
+        return 0;
+    }
+    state[0] = (uint32_t)context->controller_tick;
+    memcpy(state + 1, context->action_history, STATE_HISTORY_SIZE * sizeof(T));
+    return 1 + STATE_HISTORY_SIZE;
+}
+
+bool rl_tools_context_restore_state(rl_tools_context_t* context, const uint32_t* state, unsigned int size){
+    if(size != 1 + STATE_HISTORY_SIZE){
+        return false;
+    }
+    context->controller_tick = state[0];
+    memcpy(context->action_history, state + 1, STATE_HISTORY_SIZE * sizeof(T));
+    return true;
 }
@@ -1,3 +1,9 @@
+#ifndef __RL_TOOLS_ADAPTER_H__
+#define __RL_TOOLS_ADAPTER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
 #ifdef __cplusplus
 extern "C"
 #endif
@@ -15,4 +21,153 @@ extern "C"
 #endif
 char* rl_tools_get_checkpoint_name();
 
+// Re-entrant inference: the per-vehicle state (observation, action history, buffers) lives in an opaque context, the
+// weights are shared read-only. rl_tools_init() resets the default context, which is the one rl_tools_control() runs
+// on. Each context must only be used by one thread at a time.
+typedef struct rl_tools_context rl_tools_context_t;
+#ifdef __cplusplus
+extern "C"
+#endif
+unsigned int rl_tools_context_size();
+#ifdef __cplusplus
+extern "C"
+#endif
+rl_tools_context_t* rl_tools_context_init(void* memory); // rl_tools_context_size() bytes, malloc-aligned
+#ifdef __cplusplus
+extern "C"
+#endif
+float rl_tools_context_test(rl_tools_context_t* context, float* output); // rl_tools_test on the context's buffers (e.g. from a background task)
+#ifdef __cplusplus
+extern "C"
+#endif
+rl_tools_context_t* rl_tools_context_default();
+#ifdef __cplusplus
+extern "C"
+#endif
+void rl_tools_context_control(rl_tools_context_t* context, float* state, float* actions);
+// State carried from one rl_tools_context_control call to the next (decimation phase, action history), as 32-bit
+// words. Returns the number of words written, 0 if they do not fit capacity.
+#ifdef __cplusplus
+extern "C"
+#endif
+unsigned int rl_tools_context_save_state(const rl_tools_context_t* context, uint32_t* state, unsigned int capacity);
+// Returns false if size does not match this checkpoint's state
+#ifdef __cplusplus
+extern "C"
+#endif
+bool rl_tools_context_restore_state(rl_tools_context_t* context, const uint32_t* state, unsigned int size);
+// Teacher forcing (e.g. datasets built from flight logs): writes the policy input for state into observation (layer 0
+// input dim floats, as rl_tools_context_control builds it; normalized = 0 skips the checkpoint's observation
+// normalization), then advances the context's action history with actions instead of evaluating the policy. Returns 0
+// (observation untouched) if the adapter does not support teacher forcing.
+#ifdef __cplusplus
+extern "C"
+#endif
+int rl_tools_context_observe(rl_tools_context_t* context, float* state, const float* actions, float* observation, int normalized);
+#ifdef __cplusplus
+extern "C"
+#endif
+unsigned int rl_tools_observation_layout(unsigned int* state_dim, unsigned int* action_dim); // returns the inference steps the action history spans
+
+// Core-coupled memory placement (RL_TOOLS_CCM_BUDGET bytes at compile time, 0 by default, see rl_tools_adapter.cpp).
+// Returns the bytes placed; placement: RL_TOOLS_CCM_* mask, flash_bytes: weight and bias bytes the current precision
+// selection still reads from flash per inference (either may be NULL).
+#define RL_TOOLS_CCM_CONTEXT (1 << 0) // default context: buffers, input, output, action history
+#define RL_TOOLS_CCM_LAYER_0_STATE (1 << 1) // non-history columns of the input layer (evaluated layer-wise)
+#define RL_TOOLS_CCM_LAYER_1 (1 << 2)
+#define RL_TOOLS_CCM_LAYER_2 (1 << 3) // output layer
+#ifdef __cplusplus
+extern "C"
+#endif
+unsigned int rl_tools_ccm_usage(unsigned int* placement, unsigned int* flash_bytes);
 
+// Dense-layer kernel registry (rl_tools_adapter_kernels.h), one selection per layer and context (rl_tools by default).
+// RL_TOOLS_KERNEL_RL_TOOLS evaluates the whole model through rl_tools (operations_arm/opt.h) and applies only if every
+// layer selects it (in a mixed selection such layers use the unrolled kernel). rl_tools_kernel_autotune() times each
+// available kernel per layer on this device (repetitions evaluations each, on the given context's scratch buffers),
+// writes the fastest per layer to selection (rl_tools_kernel_layers() entries) if the result matches rl_tools and beats
+// it (otherwise RL_TOOLS_KERNEL_RL_TOOLS), and returns the time per inference in us (negative if the adapter has no
+// kernel registry). It does not apply the selection, so it can run in a background task on a context of its own.
+#define RL_TOOLS_KERNEL_AUTO 0 // no selection yet (controller: autotune)
+#define RL_TOOLS_KERNEL_RL_TOOLS 1
+#define RL_TOOLS_KERNEL_NAIVE 2
+#define RL_TOOLS_KERNEL_UNROLLED 3
+#define RL_TOOLS_KERNEL_PANEL 4
+#define RL_TOOLS_KERNEL_DSP 5 // CMSIS-DSP, firmware builds only
+#define RL_TOOLS_KERNEL_COUNT 6
+#define RL_TOOLS_KERNEL_MAX_LAYERS 3
+#ifdef __cplusplus
+extern "C"
+#endif
+unsigned int rl_tools_kernel_layers();
+#ifdef __cplusplus
+extern "C"
+#endif
+int rl_tools_kernel_available(unsigned char kernel);
+#ifdef __cplusplus
+extern "C"
+#endif
+const char* rl_tools_kernel_name(unsigned char kernel);
+#ifdef __cplusplus
+extern "C"
+#endif
+unsigned char rl_tools_kernel_get(const rl_tools_context_t* context, unsigned int layer);
+#ifdef __cplusplus
+extern "C"
+#endif
+int rl_tools_kernel_set(rl_tools_context_t* context, unsigned int layer, unsigned char kernel); // 0 if the kernel is not available
+#ifdef __cplusplus
+extern "C"
+#endif
+float rl_tools_kernel_autotune(rl_tools_context_t* context, unsigned int repetitions, unsigned char* selection, float* rl_tools_us);
+#ifdef __cplusplus
+extern "C"
+#endif
+void rl_tools_context_set_layer_callback(rl_tools_context_t* context, void (*callback)(const rl_tools_context_t* context, unsigned int layer)); // after each layer of the context's layer-wise evaluations (e.g. stage timing), NULL to remove
+#ifdef __cplusplus
+extern "C"
+#endif
+void rl_tools_layer_dims(unsigned int layer, unsigned int* input_dim, unsigned int* output_dim);
+
+// Per-layer precision (rl_tools_adapter_precision.h), shared by all contexts like the weights (set it before contexts
+// run concurrently); the range tracking belongs to a context. Layers that are not fp32 are evaluated layer-wise by the
+// reduced-precision kernel of their format (their kernel selection does not apply). The host simulation quantizes the checkpoint weights for any format on rl_tools_precision_set(); firmware
+// builds only contain the formats of a compiled configuration (RL_TOOLS_PRECISION_CONFIG, written by
+// sim/build/precision), which rl_tools_init() selects if it was quantized from the same checkpoint.
+#define RL_TOOLS_PRECISION_FP32 0
+#define RL_TOOLS_PRECISION_FP16 1
+#define RL_TOOLS_PRECISION_INT16 2 // per output row scale
+#define RL_TOOLS_PRECISION_INT8 3 // per output row scale
+#define RL_TOOLS_PRECISION_WEIGHT_FORMATS 4
+#define RL_TOOLS_PRECISION_ACTIVATIONS_FP32 0
+#define RL_TOOLS_PRECISION_ACTIVATIONS_FIXED 1 // layer input as int16 over [-range, range], integer weights only
+#ifdef __cplusplus
+extern "C"
+#endif
+int rl_tools_precision_available(unsigned int layer, unsigned char weights, unsigned char activations);
+#ifdef __cplusplus
+extern "C"
+#endif
+const char* rl_tools_precision_name(unsigned char weights, unsigned char activations);
+#ifdef __cplusplus
+extern "C"
+#endif
+int rl_tools_precision_set(unsigned int layer, unsigned char weights, unsigned char activations, float range); // 0 if not available
+#ifdef __cplusplus
+extern "C"
+#endif
+unsigned char rl_tools_precision_get(unsigned int layer, unsigned char* activations, float* range); // returns the weight format
+#ifdef __cplusplus
+extern "C"
+#endif
+void rl_tools_precision_track_ranges(rl_tools_context_t* context, int enable); // resets and records max |input| per layer of the context's evaluations (forces layer-wise evaluation)
+#ifdef __cplusplus
+extern "C"
+#endif
+void rl_tools_precision_ranges(const rl_tools_context_t* context, float* ranges); // rl_tools_kernel_layers() entries
+#ifdef __cplusplus
+extern "C"
+#endif
+int rl_tools_precision_write_config(const char* path, const char* comment); // host only: current selection as compiled configuration
+
+#endif
@@ -0,0 +1,106 @@
+// Dense-layer kernel variants for the adapter's kernel registry (included by rl_tools_adapter.cpp)
+// Each computes the pre-activation y = W x + b of one layer for a single input row on plain pointers: W is row-major
+// OUTPUT_DIM x INPUT_DIM (the checkpoint layout), b has OUTPUT_DIM entries. They differ only in loop structure and
+// therefore in summation order, i.e. results agree up to float rounding.
+#ifndef __RL_TOOLS_ADAPTER_KERNELS_H__
+#define __RL_TOOLS_ADAPTER_KERNELS_H__
+
+#if defined(RL_TOOLS_KERNEL_DSP_AVAILABLE)
+#include "arm_math.h"
+#endif
+
+namespace rl_tools_adapter::kernels{
+    // Reference: one dot product per output
+    template <typename T, typename TI, TI OUTPUT_DIM, TI INPUT_DIM>
+    void naive(const T* weights, const T* biases, const T* input, T* output){
+        for(TI output_i = 0; output_i < OUTPUT_DIM; output_i++){
+            const T* row = weights + output_i * INPUT_DIM;
+            T acc = biases[output_i];
+            for(TI input_i = 0; input_i < INPUT_DIM; input_i++){
+                acc += row[input_i] * input[input_i];
+            }
+            output[output_i] = acc;
+        }
+    }
+
+    // Inner loop unrolled by four with independent accumulators (hides the FPU's multiply-accumulate latency)
+    template <typename T, typename TI, TI OUTPUT_DIM, TI INPUT_DIM>
+    void unrolled(const T* weights, const T* biases, const T* input, T* output){
+        constexpr TI UNROLLED_DIM = INPUT_DIM / 4 * 4;
+        for(TI output_i = 0; output_i < OUTPUT_DIM; output_i++){
+            const T* row = weights + output_i * INPUT_DIM;
+            T acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+            for(TI input_i = 0; input_i < UNROLLED_DIM; input_i += 4){
+                acc0 += row[input_i + 0] * input[input_i + 0];
+                acc1 += row[input_i + 1] * input[input_i + 1];
+                acc2 += row[input_i + 2] * input[input_i + 2];
+                acc3 += row[input_i + 3] * input[input_i + 3];
+            }
+            for(TI input_i = UNROLLED_DIM; input_i < INPUT_DIM; input_i++){
+                acc0 += row[input_i] * input[input_i];
+            }
+            output[output_i] = biases[output_i] + ((acc0 + acc1) + (acc2 + acc3));
+        }
+    }
+
+    // Panels of four outputs: every input element is loaded once per panel and reused for four rows
+    template <typename T, typename TI, TI OUTPUT_DIM, TI INPUT_DIM>
+    void panel(const T* weights, const T* biases, const T* input, T* output){
+        constexpr TI PANEL_DIM = OUTPUT_DIM / 4 * 4;
+        for(TI output_i = 0; output_i < PANEL_DIM; output_i += 4){
+            const T* row0 = weights + (output_i + 0) * INPUT_DIM;
+            const T* row1 = weights + (output_i + 1) * INPUT_DIM;
+            const T* row2 = weights + (output_i + 2) * INPUT_DIM;
+            const T* row3 = weights + (output_i + 3) * INPUT_DIM;
+            T acc0 = biases[output_i + 0], acc1 = biases[output_i + 1], acc2 = biases[output_i + 2], acc3 = biases[output_i + 3];
+            for(TI input_i = 0; input_i < INPUT_DIM; input_i++){
+                T value = input[input_i];
+                acc0 += row0[input_i] * value;
+                acc1 += row1[input_i] * value;
+                acc2 += row2[input_i] * value;
+                acc3 += row3[input_i] * value;
+            }
+            output[output_i + 0] = acc0;
+            output[output_i + 1] = acc1;
+            output[output_i + 2] = acc2;
+            output[output_i + 3] = acc3;
+        }
+        naive<T, TI, OUTPUT_DIM - PANEL_DIM, INPUT_DIM>(weights + PANEL_DIM * INPUT_DIM, biases + PANEL_DIM, input, output + PANEL_DIM);
+    }
+
+    // Adds W x for a block of INPUT_DIM columns of a wider row-major matrix (ROW_STRIDE entries per row) to output, e.g.
+    // the columns of a layer that stay in flash while the others are evaluated from a copy in core-coupled memory
+    template <typename T, typename TI, TI OUTPUT_DIM, TI INPUT_DIM, TI ROW_STRIDE>
+    void accumulate(const T* weights, const T* input, T* output){
+        constexpr TI UNROLLED_DIM = INPUT_DIM / 4 * 4;
+        for(TI output_i = 0; output_i < OUTPUT_DIM; output_i++){
+            const T* row = weights + output_i * ROW_STRIDE;
+            T acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+            for(TI input_i = 0; input_i < UNROLLED_DIM; input_i += 4){
+                acc0 += row[input_i + 0] * input[input_i + 0];
+                acc1 += row[input_i + 1] * input[input_i + 1];
+                acc2 += row[input_i + 2] * input[input_i + 2];
+                acc3 += row[input_i + 3] * input[input_i + 3];
+            }
+            for(TI input_i = UNROLLED_DIM; input_i < INPUT_DIM; input_i++){
+                acc0 += row[input_i] * input[input_i];
+            }
+            output[output_i] += (acc0 + acc1) + (acc2 + acc3);
+        }
+    }
+
+#if defined(RL_TOOLS_KERNEL_DSP_AVAILABLE)
+    // CMSIS-DSP dot products (the library's unrolling for the Cortex-M4F)
+    template <typename T, typename TI, TI OUTPUT_DIM, TI INPUT_DIM>
+    void dsp(const T* weights, const T* biases, const T* input, T* output){
+        static_assert(sizeof(T) == sizeof(float32_t), "The CMSIS-DSP kernel is float only");
+        for(TI output_i = 0; output_i < OUTPUT_DIM; output_i++){
+            float32_t acc;
+            arm_dot_prod_f32((float32_t*)(weights + output_i * INPUT_DIM), (float32_t*)input, INPUT_DIM, &acc); // non-const in older CMSIS-DSP
+            output[output_i] = biases[output_i] + acc;
+        }
+    }
+#endif
+}
+
+#endif
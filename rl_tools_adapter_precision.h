@@ -0,0 +1,167 @@
+// Reduced-precision dense layers for the adapter's per-layer precision selection (included by rl_tools_adapter.cpp)
+// Weights are stored as fp16 or as symmetric int16/int8 with one scale per output row (w = q * scale), biases stay
+// fp32. With fixed-point activations (integer weights only) the layer input is quantized to int16 over a calibrated
+// range (x = q * range / 32767, saturating) and the products are accumulated in integers (the Cortex-M4 SIMD
+// multiply-accumulate path); otherwise the weights are converted to float and accumulated in float.
+#ifndef __RL_TOOLS_ADAPTER_PRECISION_H__
+#define __RL_TOOLS_ADAPTER_PRECISION_H__
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace rl_tools_adapter::precision{
+    constexpr int32_t FIXED_ONE = 32767;
+
+    template <unsigned char WEIGHTS>
+    struct Storage;
+    template <>
+    struct Storage<RL_TOOLS_PRECISION_FP16>{ using TYPE = uint16_t; };
+    template <>
+    struct Storage<RL_TOOLS_PRECISION_INT16>{ using TYPE = int16_t; static constexpr int32_t MAX = 32767; };
+    template <>
+    struct Storage<RL_TOOLS_PRECISION_INT8>{ using TYPE = int8_t; static constexpr int32_t MAX = 127; };
+
+    inline float half_to_float(uint16_t value){
+#if defined(__ARM_FP16_FORMAT_IEEE)
+        __fp16 half; // VCVTB.F32.F16 on the FPv4
+        std::memcpy(&half, &value, sizeof(half));
+        return half;
+#else
+        uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+        int32_t exponent = (value >> 10) & 0x1f;
+        uint32_t mantissa = value & 0x3ff;
+        uint32_t bits;
+        if(exponent == 0x1f){
+            bits = sign | 0x7f800000 | (mantissa << 13);
+        }
+        else if(exponent == 0){
+            if(mantissa == 0){
+                bits = sign;
+            }
+            else{
+                exponent = 1;
+                while((mantissa & 0x400) == 0){
+                    mantissa <<= 1;
+                    exponent--;
+                }
+                bits = sign | (uint32_t)(exponent + 127 - 15) << 23 | (mantissa & 0x3ff) << 13;
+            }
+        }
+        else{
+            bits = sign | (uint32_t)(exponent + 127 - 15) << 23 | mantissa << 13;
+        }
+        float result;
+        std::memcpy(&result, &bits, sizeof(result));
+        return result;
+#endif
+    }
+
+    // Round to nearest even, saturating to the largest finite half
+    inline uint16_t float_to_half(float value){
+#if defined(__ARM_FP16_FORMAT_IEEE)
+        __fp16 half = value;
+        uint16_t result;
+        std::memcpy(&result, &half, sizeof(result));
+        return result;
+#else
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        uint16_t sign = (bits >> 16) & 0x8000;
+        int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+        uint32_t mantissa = bits & 0x7fffff;
+        if(exponent >= 0x1f){
+            return sign | 0x7bff;
+        }
+        if(exponent <= 0){
+            if(exponent < -10){
+                return sign;
+            }
+            mantissa |= 0x800000;
+            uint32_t shift = 14 - exponent;
+            uint32_t half = mantissa >> shift;
+            uint32_t rest = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+            half += rest > halfway || (rest == halfway && (half & 1));
+            return sign | half;
+        }
+        uint32_t half = (uint32_t)exponent << 10 | mantissa >> 13;
+        uint32_t rest = mantissa & 0x1fff;
+        half += rest > 0x1000 || (rest == 0x1000 && (half & 1)); // a carry into the exponent is the correct rounding
+        return half >= 0x7c00 ? (sign | 0x7bff) : (sign | half);
+#endif
+    }
+
+    // Row-major OUTPUT_DIM x INPUT_DIM float weights into the storage format (scales: one per row for the integer formats)
+    template <unsigned char WEIGHTS, typename T, typename TI, TI OUTPUT_DIM, TI INPUT_DIM>
+    void quantize(const T* weights, typename Storage<WEIGHTS>::TYPE* quantized, float* scales){
+        for(TI output_i = 0; output_i < OUTPUT_DIM; output_i++){
+            const T* row = weights + output_i * INPUT_DIM;
+            if constexpr(WEIGHTS == RL_TOOLS_PRECISION_FP16){
+                for(TI input_i = 0; input_i < INPUT_DIM; input_i++){
+                    quantized[output_i * INPUT_DIM + input_i] = float_to_half(row[input_i]);
+                }
+            }
+            else{
+                constexpr int32_t MAX = Storage<WEIGHTS>::MAX;
+                float max_abs = 0;
+                for(TI input_i = 0; input_i < INPUT_DIM; input_i++){
+                    max_abs = std::fmax(max_abs, std::fabs((float)row[input_i]));
+                }
+                scales[output_i] = max_abs > 0 ? max_abs / MAX : 1;
+                for(TI input_i = 0; input_i < INPUT_DIM; input_i++){
+                    long value = std::lround(row[input_i] / scales[output_i]);
+                    quantized[output_i * INPUT_DIM + input_i] = (typename Storage<WEIGHTS>::TYPE)(value > MAX ? MAX : (value < -MAX ? -MAX : value));
+                }
+            }
+        }
+    }
+
+    template <typename T, typename TI, TI INPUT_DIM>
+    void quantize_input(const T* input, float range, int16_t* quantized){
+        float scale = FIXED_ONE / range;
+        for(TI input_i = 0; input_i < INPUT_DIM; input_i++){
+            long value = std::lround(input[input_i] * scale);
+            quantized[input_i] = (int16_t)(value > FIXED_ONE ? FIXED_ONE : (value < -FIXED_ONE ? -FIXED_ONE : value));
+        }
+    }
+
+    // Pre-activation y = W x + b (as the kernels in rl_tools_adapter_kernels.h)
+    template <unsigned char WEIGHTS, unsigned char ACTIVATIONS, typename T, typename TI, TI OUTPUT_DIM, TI INPUT_DIM>
+    void dense(const typename Storage<WEIGHTS>::TYPE* weights, const float* scales, const T* biases, float range, const T* input, T* output){
+        if constexpr(ACTIVATIONS == RL_TOOLS_PRECISION_ACTIVATIONS_FIXED){
+            static_assert(WEIGHTS != RL_TOOLS_PRECISION_FP16, "Fixed-point activations need integer weights");
+            int16_t quantized_input[INPUT_DIM];
+            quantize_input<T, TI, INPUT_DIM>(input, range, quantized_input);
+            const float input_scale = range / FIXED_ONE;
+            for(TI output_i = 0; output_i < OUTPUT_DIM; output_i++){
+                const typename Storage<WEIGHTS>::TYPE* row = weights + output_i * INPUT_DIM;
+                // int8: |acc| <= 127 * 32767 * INPUT_DIM fits 32 bits for INPUT_DIM < 516; int16 needs 64 bits
+                using ACC = typename std::conditional<WEIGHTS == RL_TOOLS_PRECISION_INT8 && INPUT_DIM < 516, int32_t, int64_t>::type;
+                ACC acc = 0;
+                for(TI input_i = 0; input_i < INPUT_DIM; input_i++){
+                    acc += (int32_t)row[input_i] * (int32_t)quantized_input[input_i];
+                }
+                output[output_i] = biases[output_i] + (T)acc * (scales[output_i] * input_scale);
+            }
+        }
+        else{
+            for(TI output_i = 0; output_i < OUTPUT_DIM; output_i++){
+                const typename Storage<WEIGHTS>::TYPE* row = weights + output_i * INPUT_DIM;
+                T acc = 0;
+                for(TI input_i = 0; input_i < INPUT_DIM; input_i++){
+                    if constexpr(WEIGHTS == RL_TOOLS_PRECISION_FP16){
+                        acc += half_to_float(row[input_i]) * input[input_i];
+                    }
+                    else{
+                        acc += (T)row[input_i] * input[input_i];
+                    }
+                }
+                output[output_i] = biases[output_i] + (WEIGHTS == RL_TOOLS_PRECISION_FP16 ? acc : acc * scales[output_i]);
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,82 @@
+// Compile-time description of the policy input of a checkpoint (included by the adapters after the checkpoint)
+#ifndef __RL_TOOLS_ADAPTER_SPEC_H__
+#define __RL_TOOLS_ADAPTER_SPEC_H__
+
+// Overrides for checkpoints that do not export the metadata (-1 = deduce from the actor's input dimension)
+#ifndef RL_TOOLS_OBSERVATION_ROTATION_MATRIX
+#define RL_TOOLS_OBSERVATION_ROTATION_MATRIX -1
+#endif
+#ifndef RL_TOOLS_ACTION_HISTORY_LENGTH
+#define RL_TOOLS_ACTION_HISTORY_LENGTH -1
+#endif
+#ifndef RL_TOOLS_CONTROL_FREQUENCY_MULTIPLE
+#define RL_TOOLS_CONTROL_FREQUENCY_MULTIPLE -1 // required if the checkpoint has an action history and does not export it
+#endif
+
+// Checkpoints may export their training setup in rl_tools::checkpoint::environment (and the observation normalization
+// in rl_tools::checkpoint::observation_normalization). Qualified lookup only follows the using-directives below if the
+// checkpoint does not declare a name itself, so exported values take precedence over these fallbacks.
+namespace rl_tools::checkpoint::environment{
+    namespace adapter_fallback{
+        constexpr int OBSERVATION_ROTATION_MATRIX = RL_TOOLS_OBSERVATION_ROTATION_MATRIX;
+        constexpr int ACTION_HISTORY_LENGTH = RL_TOOLS_ACTION_HISTORY_LENGTH;
+        constexpr int CONTROL_FREQUENCY_MULTIPLE = RL_TOOLS_CONTROL_FREQUENCY_MULTIPLE;
+    }
+    using namespace adapter_fallback;
+}
+namespace rl_tools::checkpoint::observation_normalization{
+    namespace adapter_fallback{
+        constexpr bool ENABLED = false;
+        constexpr const float* mean = nullptr; // INPUT_DIM values each, applied as (x - mean) / std
+        constexpr const float* std = nullptr;
+    }
+    using namespace adapter_fallback;
+}
+
+namespace rl_tools_adapter{
+    enum class Orientation{
+        ROTATION_MATRIX, // 3 position, 9 rotation matrix (row-major), 3 linear velocity, 3 angular velocity
+        QUATERNION,      // 3 position, 4 quaternion (w, x, y, z), 3 linear velocity, 3 angular velocity
+        QUATERNION_XYZW, // 3 position, 4 quaternion (x, y, z, w) with w >= 0, 3 linear velocity, 3 angular velocity
+    };
+    template <typename T_TI, Orientation T_ORIENTATION, T_TI T_ACTION_DIM, T_TI T_ACTION_HISTORY_LENGTH, T_TI T_CONTROL_FREQUENCY_MULTIPLE, bool T_NORMALIZATION, bool T_STATE_HISTORY = false>
+    struct ObservationSpec{
+        using TI = T_TI;
+        static constexpr Orientation ORIENTATION = T_ORIENTATION;
+        static constexpr TI STATE_DIM = ORIENTATION == Orientation::ROTATION_MATRIX ? 18 : 13;
+        static constexpr TI ACTION_DIM = T_ACTION_DIM;
+        // Actions of the last ACTION_HISTORY_LENGTH policy steps, each averaged over CONTROL_FREQUENCY_MULTIPLE
+        // controller invocations (the policy was trained at 1/CONTROL_FREQUENCY_MULTIPLE of the inference rate)
+        static constexpr TI ACTION_HISTORY_LENGTH = T_ACTION_HISTORY_LENGTH;
+        static constexpr TI CONTROL_FREQUENCY_MULTIPLE = T_CONTROL_FREQUENCY_MULTIPLE;
+        static constexpr bool NORMALIZATION = T_NORMALIZATION;
+        // The state is part of the history as well: ACTION_HISTORY_LENGTH steps of state followed by action
+        static constexpr bool STATE_HISTORY = T_STATE_HISTORY;
+        static constexpr TI INPUT_DIM = STATE_HISTORY ? ACTION_HISTORY_LENGTH * (STATE_DIM + ACTION_DIM) : STATE_DIM + ACTION_HISTORY_LENGTH * ACTION_DIM;
+        static_assert(CONTROL_FREQUENCY_MULTIPLE >= 1);
+    };
+
+    // Observation spec of the checkpoint: exported metadata or overrides, otherwise deduced from the input dimension
+    // (18 + H * ACTION_DIM for the rotation matrix, 13 + H * ACTION_DIM for the quaternion observation)
+    template <typename ACTOR_SPEC>
+    struct CheckpointObservationSpec{
+        using TI = typename ACTOR_SPEC::TI;
+        static constexpr TI INPUT_DIM = ACTOR_SPEC::INPUT_DIM;
+        static constexpr TI ACTION_DIM = ACTOR_SPEC::OUTPUT_DIM;
+        static constexpr int EXPORTED_ROTATION_MATRIX = ::rl_tools::checkpoint::environment::OBSERVATION_ROTATION_MATRIX;
+        static constexpr int EXPORTED_ACTION_HISTORY_LENGTH = ::rl_tools::checkpoint::environment::ACTION_HISTORY_LENGTH;
+        static constexpr bool DEDUCED_ROTATION_MATRIX = INPUT_DIM >= 18 && (INPUT_DIM - 18) % ACTION_DIM == 0;
+        static constexpr bool ROTATION_MATRIX = EXPORTED_ROTATION_MATRIX >= 0 ? EXPORTED_ROTATION_MATRIX != 0 : DEDUCED_ROTATION_MATRIX;
+        static constexpr TI STATE_DIM = ROTATION_MATRIX ? 18 : 13;
+        static_assert(INPUT_DIM >= STATE_DIM && (INPUT_DIM - STATE_DIM) % ACTION_DIM == 0, "The actor input is neither a rotation matrix nor a quaternion observation followed by an action history");
+        static constexpr TI ACTION_HISTORY_LENGTH = EXPORTED_ACTION_HISTORY_LENGTH >= 0 ? (TI)EXPORTED_ACTION_HISTORY_LENGTH : (INPUT_DIM - STATE_DIM) / ACTION_DIM;
+        // The decimation cannot be deduced from the dimensions, a wrong value silently skews the action history
+        static constexpr int EXPORTED_CONTROL_FREQUENCY_MULTIPLE = ::rl_tools::checkpoint::environment::CONTROL_FREQUENCY_MULTIPLE;
+        static_assert(ACTION_HISTORY_LENGTH == 0 || EXPORTED_CONTROL_FREQUENCY_MULTIPLE >= 1, "The checkpoint does not export environment::CONTROL_FREQUENCY_MULTIPLE, set its action-history decimation with -DRL_TOOLS_CONTROL_FREQUENCY_MULTIPLE=<n>");
+        static constexpr TI CONTROL_FREQUENCY_MULTIPLE = EXPORTED_CONTROL_FREQUENCY_MULTIPLE >= 1 ? (TI)EXPORTED_CONTROL_FREQUENCY_MULTIPLE : 1;
+        using SPEC = ObservationSpec<TI, ROTATION_MATRIX ? Orientation::ROTATION_MATRIX : Orientation::QUATERNION, ACTION_DIM, ACTION_HISTORY_LENGTH, CONTROL_FREQUENCY_MULTIPLE, ::rl_tools::checkpoint::observation_normalization::ENABLED>;
+        static_assert(SPEC::INPUT_DIM == INPUT_DIM, "The checkpoint metadata does not match the actor input dimension");
+    };
+}
+
+#endif
@@ -1,22 +1,35 @@
 #include "debug.h"
 #include "usec_time.h"
 #include <math.h>
+#include <string.h>
 #include "math3d.h"
 #include "log.h"
 #include "param.h"
+#include "param_logic.h"
 #include "motors.h"
 #include "watchdog.h"
+#include "cfassert.h"
 #include "controller_pid.h"
 #include "controller_mellinger.h"
 #include "controller_indi.h"
 #include "controller_brescianini.h"
 #include "power_distribution.h"
 #include "rl_tools_adapter.h"
+#include "rl_tools_controller.h"
+#include "battery_comp.h"
+#include "motor_curve.h"
+#include "packed_log.h"
+#include "flight_metrics.h"
+#include "controller_trace.h"
+#include "controller_timeline.h"
+#include "jitter_buffer.h"
 #include "stabilizer_types.h"
 #include "pm.h"
+#include "FreeRTOS.h"
 #include "task.h"
+#include "semphr.h"
 
-#define CONTROL_INTERVAL_MS 2
+#define CONTROL_INTERVAL_MS RL_TOOLS_CONTROLLER_INTERVAL_MS
 #define CONTROL_INTERVAL_US (CONTROL_INTERVAL_MS * 1000)
 #define CONTROL_PACKET_TIMEOUT_USEC (1000*200)
 #define BEHIND_SCHEDULE_MESSAGE_MIN_INTERVAL (1000000)
@@ -26,49 +39,26 @@
 #define MAX_RPM 21702.1
 #define WAYPOINT_NAVIGATION_NUMBER_OF_POINTS (5)
 #define WARMUP_TIME (1000 * 500)
-typedef enum ControllerState{
-  STATE_RESET,
-  STATE_FORWARD,
-  STATE_FINISHED 
-} ControllerState;
-
-// State
-static ControllerState controller_state;
-
-// Counters
-static uint64_t controller_tick = 0; // Number of control function invocations
-static uint64_t forward_tick = 0; // Number of forward passes
-
-// Timestamps
-static uint64_t timestamp_last_reset;
-static uint64_t timestamp_last_behind_schedule_message = 0;
-static uint64_t timestamp_last_control_invocation = 0;
-static uint64_t timestamp_last_control_packet_received = 0;
-static uint64_t timestamp_last_control_packet_received_hover = 0;
-static uint64_t timestamp_controller_activation;
-static uint64_t timestamp_pre_set_motors;
-
-// Logging variables
-static float control_invocation_interval = 0;
-
-// Control variables: input
-static float target_pos[3] = {0, 0, 0};
-static float target_vel[3] = {0, 0, 0};
-static float pos_error[3] = {0, 0, 0};
-static float relative_pos[3] = {0, 0, 0};
-static float origin[3] = {0, 0, 0};
-
-static float pos_distance_limit_position;
-static float vel_distance_limit_position;
-static float pos_distance_limit_figure_eight;
-static float vel_distance_limit_figure_eight;
-static float pos_distance_limit_mellinger;
-static float vel_distance_limit_mellinger;
-static float pos_distance_limit_bresciani;
-static float vel_distance_limit_bresciani;
-static uint8_t log_set_motors = 0;
-static float velocity_cmd_multiplier, velocity_cmd_p_term;
-
+#define SWARM_PACKET_QUEUE_LENGTH 4 // power of two, a frame's packet for this vehicle per invocation at most
+#define SWARM_PACKET_MAX_SIZE (SWARM_SETPOINT_HEADER_SIZE + SWARM_SETPOINT_SLOTS * SWARM_SETPOINT_SLOT_SIZE)
+// Dense kernel per layer at boot (rl_tools_adapter.h) unless a tuned selection was stored: rl_tools, so that recorded
+// traces replay bit for bit
+#ifndef RL_TOOLS_KERNEL_DEFAULT
+#define RL_TOOLS_KERNEL_DEFAULT RL_TOOLS_KERNEL_RL_TOOLS
+#endif
+#define RL_TOOLS_KERNEL_AUTOTUNE_REPETITIONS 16
+#define KERNEL_TUNE_TASK_PRIORITY (tskIDLE_PRIORITY + 1)
+#ifndef KERNEL_TUNE_TASK_STACK_SIZE
+#define KERNEL_TUNE_TASK_STACK_SIZE 800 // [words] as the self-test task (host high-water mark 2928 bytes, rltk.stack)
+#endif
+#define SELF_TEST_TOLERANCE 0.2f // summed absolute deviation from the checkpoint's reference actions
+#define SELF_TEST_TASK_PRIORITY (tskIDLE_PRIORITY + 1)
+// [words] The host simulation measures a high-water mark of 3008 bytes with DEBUG_PRINT formatting the %f through
+// glibc's printf, 312 bytes for the inference alone (x86-64 frames, LD_BIND_NOW). The firmware's console formatter
+// needs less than glibc, so this is an upper bound with some margin; rltboot.stack logs the mark on the device.
+#ifndef SELF_TEST_TASK_STACK_SIZE
+#define SELF_TEST_TASK_STACK_SIZE 800
+#endif
 enum Mode{
   NORMAL = 0,
   POSITION = 1,
@@ -80,8 +70,18 @@ enum TriggerMode{
   RL_TOOLS_PACKET = 0,
   HOVER_PACKET = 1,
 };
-static uint8_t mode;
-static uint8_t trigger_mode;
+enum SelfTestState{
+  SELF_TEST_PENDING = 0,
+  SELF_TEST_PASSED = 1,
+  SELF_TEST_FAILED = 2
+};
+enum ClassicController{
+  CLASSIC_PID = 0,
+  CLASSIC_MELLINGER = 1,
+  CLASSIC_INDI = 2,
+  CLASSIC_BRESCIANINI = 3,
+  CLASSIC_COUNT = 4
+};
 static float trajectory[WAYPOINT_NAVIGATION_NUMBER_OF_POINTS][3] = {
   {0.0, 0.0, 0.0},
   {1.0, 0.0, 0.0},
@@ -89,39 +89,51 @@ static float trajectory[WAYPOINT_NAVIGATION_NUMBER_OF_POINTS][3] = {
   {0.0, 1.0, 0.0},
   {0.0, 0.0, 0.0},
 };
-static float target_height;
-
-static uint64_t waypoint_navigation_timestamp_start;
-static uint8_t  waypoint_navigation_dynamic_current_waypoint = 0;
-static float    waypoint_navigation_dynamic_threshold = 0.1;
-static float    waypoint_navigation_point_duration = 4;
-static float    waypoint_navigation_trajectory_scale = 0.5;
-
-static float    figure_eight_interval = 5.5;
-static float    figure_eight_warmup_time; 
-static float    figure_eight_scale = 1.0;
-static float    figure_eight_progress = 0;
-static uint64_t figure_eight_last_invocation;
-static float    target_height_figure_eight;
-
-static float state_input[13];
-static float action_output[4];
 
 const uint8_t motors[4] = {MOTOR_M1, MOTOR_M2, MOTOR_M3, MOTOR_M4};
-static uint8_t set_motors_overwrite = 0;
-static uint16_t motor_cmd[4];
-static float motor_cmd_divider, motor_cmd_divider_warmup;
-static bool prev_set_motors, prev_pre_set_motors;
-static uint8_t use_pre_set_warmup;
 
-static motors_thrust_uncapped_t motorThrustUncapped;
-static motors_thrust_uncapped_t motorThrustBatCompUncapped;
-static motors_thrust_pwm_t motorPwm;
+// The instance behind the firmware entry points, PARAM and LOG variables
+static rl_tools_controller_context_t controller;
+
+// Kernel selection of the global instance's inference context (rltk parameters), applied between controller
+// invocations. A tuning result is written to the parameters and to the persistent parameter store
+static uint8_t kernel_selection[RL_TOOLS_KERNEL_MAX_LAYERS] = {RL_TOOLS_KERNEL_DEFAULT, RL_TOOLS_KERNEL_DEFAULT, RL_TOOLS_KERNEL_DEFAULT};
+static const char* kernel_selection_names[RL_TOOLS_KERNEL_MAX_LAYERS] = {"l0", "l1", "l2"};
+static uint8_t kernel_tune = 0;
+static volatile uint8_t kernel_tuning = 0; // the tuning task is running
+static float kernel_time = 0;
+static float kernel_time_rl_tools = 0;
+static uint32_t kernel_tune_stack = 0; // stack high-water mark of the tuning task [bytes]
 
-static setpoint_t last_setpoint;
+// Swarm setpoint packets from the receiving task, handed to the context between controller invocations (single
+// producer, single consumer: each side only writes its own index)
+static struct {
+  uint64_t timestamp;
+  uint8_t size;
+  uint8_t data[SWARM_PACKET_MAX_SIZE];
+} swarm_packets[SWARM_PACKET_QUEUE_LENGTH];
+static volatile uint8_t swarm_packets_written = 0;
+static volatile uint8_t swarm_packets_read = 0;
 
-static uint8_t hand_test = 0; // 0 = off; 1 = setpoint; 2 = angular velocity rejection; 3 = angular velocity rejection + orientation rejection;
-static uint8_t use_orig_controller = 0;
+// Boot: the policy's golden-output check runs in a low-priority task after init and gates the learned controller
+// (including the motor warmup). Global on purpose: it checks the weights all contexts share. Only the self-test task
+// writes it (one byte, after init reset it), the contexts only read it.
+static volatile uint8_t self_test_state = SELF_TEST_PENDING;
+// The classic controllers are initialized on first use. They are firmware singletons with internal state (integrators,
+// filters) shared by all contexts that fall back to them; classic_mutex serializes them and this flag between contexts
+// stepped from different threads. Everything else a step touches belongs to its context.
+static bool classic_initialized[CLASSIC_COUNT];
+static StaticSemaphore_t classic_mutex_buffer;
+static SemaphoreHandle_t classic_mutex = NULL;
+static uint64_t timestamp_boot;
+static struct {
+  uint32_t init; // controllerOutOfTreeInit [us]
+  uint32_t rl_tools; // rl_tools_init [us]
+  uint32_t self_test; // background self-test [us]
+  uint32_t ready; // from the start of controllerOutOfTreeInit until the self-test passed [us]
+  uint32_t classic[CLASSIC_COUNT]; // first initialization (init + test) of PID, Mellinger, INDI, Brescianini [us]
+  uint32_t self_test_stack; // stack high-water mark of the self-test task [bytes]
+} boot_profile;
 
 
 static inline float clip(float v, float low, float high){
@@ -138,194 +150,493 @@ static inline float clip(float v, float low, float high){
   }
 }
 
-static inline void update_state(const sensorData_t* sensors, const state_t* state){
-  if(hand_test == 0){
-    float POS_DISTANCE_LIMIT = mode == FIGURE_EIGHT ? pos_distance_limit_figure_eight : pos_distance_limit_position;
-    state_input[ 0] = clip(state->position.x - target_pos[0], -POS_DISTANCE_LIMIT, POS_DISTANCE_LIMIT);
-    state_input[ 1] = clip(state->position.y - target_pos[1], -POS_DISTANCE_LIMIT, POS_DISTANCE_LIMIT);
-    state_input[ 2] = clip(state->position.z - target_pos[2], -POS_DISTANCE_LIMIT, POS_DISTANCE_LIMIT);
+void rl_tools_controller_context_update_state(rl_tools_controller_context_t* ctx, const sensorData_t* sensors, const state_t* state){
+  if(ctx->hand_test == 0){
+    float POS_DISTANCE_LIMIT = ctx->mode == FIGURE_EIGHT ? ctx->pos_distance_limit_figure_eight : ctx->pos_distance_limit_position;
+    ctx->state_input[ 0] = clip(state->position.x - ctx->target_pos[0], -POS_DISTANCE_LIMIT, POS_DISTANCE_LIMIT);
+    ctx->state_input[ 1] = clip(state->position.y - ctx->target_pos[1], -POS_DISTANCE_LIMIT, POS_DISTANCE_LIMIT);
+    ctx->state_input[ 2] = clip(state->position.z - ctx->target_pos[2], -POS_DISTANCE_LIMIT, POS_DISTANCE_LIMIT);
   }
   else{
-    state_input[ 0] = 0;
-    state_input[ 1] = 0;
-    state_input[ 2] = 0;
+    ctx->state_input[ 0] = 0;
+    ctx->state_input[ 1] = 0;
+    ctx->state_input[ 2] = 0;
   }
-  if(hand_test == 0 || hand_test == 3){
-    state_input[ 3] = state->attitudeQuaternion.w;
-    state_input[ 4] = state->attitudeQuaternion.x;
-    state_input[ 5] = state->attitudeQuaternion.y;
-    state_input[ 6] = state->attitudeQuaternion.z;
+  if(ctx->hand_test == 0 || ctx->hand_test == 3){
+    ctx->state_input[ 3] = state->attitudeQuaternion.w;
+    ctx->state_input[ 4] = state->attitudeQuaternion.x;
+    ctx->state_input[ 5] = state->attitudeQuaternion.y;
+    ctx->state_input[ 6] = state->attitudeQuaternion.z;
   }
   else{
-    state_input[ 3] = 1;
-    state_input[ 4] = 0;
-    state_input[ 5] = 0;
-    state_input[ 6] = 0;
+    ctx->state_input[ 3] = 1;
+    ctx->state_input[ 4] = 0;
+    ctx->state_input[ 5] = 0;
+    ctx->state_input[ 6] = 0;
   }
-  if(hand_test == 0){
-    float VEL_DISTANCE_LIMIT = mode == FIGURE_EIGHT ? vel_distance_limit_figure_eight : vel_distance_limit_position;
-    state_input[ 7] = clip(state->velocity.x - target_vel[0], -VEL_DISTANCE_LIMIT, VEL_DISTANCE_LIMIT);
-    state_input[ 8] = clip(state->velocity.y - target_vel[1], -VEL_DISTANCE_LIMIT, VEL_DISTANCE_LIMIT);
-    state_input[ 9] = clip(state->velocity.z - target_vel[2], -VEL_DISTANCE_LIMIT, VEL_DISTANCE_LIMIT);
+  if(ctx->hand_test == 0){
+    float VEL_DISTANCE_LIMIT = ctx->mode == FIGURE_EIGHT ? ctx->vel_distance_limit_figure_eight : ctx->vel_distance_limit_position;
+    ctx->state_input[ 7] = clip(state->velocity.x - ctx->target_vel[0], -VEL_DISTANCE_LIMIT, VEL_DISTANCE_LIMIT);
+    ctx->state_input[ 8] = clip(state->velocity.y - ctx->target_vel[1], -VEL_DISTANCE_LIMIT, VEL_DISTANCE_LIMIT);
+    ctx->state_input[ 9] = clip(state->velocity.z - ctx->target_vel[2], -VEL_DISTANCE_LIMIT, VEL_DISTANCE_LIMIT);
   }
   else{
-    state_input[ 7] = 0;
-    state_input[ 8] = 0;
-    state_input[ 9] = 0;
+    ctx->state_input[ 7] = 0;
+    ctx->state_input[ 8] = 0;
+    ctx->state_input[ 9] = 0;
   }
-  if(hand_test != 1){
-    state_input[10] = radians(sensors->gyro.x);
-    state_input[11] = radians(sensors->gyro.y);
-    state_input[12] = radians(sensors->gyro.z);
+  if(ctx->hand_test != 1){
+    ctx->state_input[10] = radians(sensors->gyro.x);
+    ctx->state_input[11] = radians(sensors->gyro.y);
+    ctx->state_input[12] = radians(sensors->gyro.z);
   }
   else{
-    state_input[10] = 0;
-    state_input[11] = 0;
-    state_input[12] = 0;
+    ctx->state_input[10] = 0;
+    ctx->state_input[11] = 0;
+    ctx->state_input[12] = 0;
+  }
+}
+
+void rl_tools_controller_context_packet_received(rl_tools_controller_context_t* ctx, uint64_t now){
+  ctx->timestamp_last_control_packet_received = now;
+}
+
+static inline bool swarm_target_fresh(const rl_tools_controller_context_t* ctx, uint64_t now){
+  return ctx->timestamp_swarm_target != 0 && now - ctx->timestamp_swarm_target < CONTROL_PACKET_TIMEOUT_USEC;
+}
+
+bool rl_tools_controller_context_swarm_packet_received(rl_tools_controller_context_t* ctx, const uint8_t* data, uint8_t size, uint64_t now){
+  uint8_t frame;
+  swarm_setpoint_target_t target;
+  if(!swarm_setpoint_unpack(data, size, ctx->swarm_id, &frame, &target)){
+    return false;
+  }
+  if(swarm_target_fresh(ctx, now)){
+    // Frame ids wrap, only the difference to the current target is meaningful (and only while it is fresh)
+    int8_t frames = (int8_t)(frame - ctx->swarm_frame);
+    if(frames <= 0){
+      return false;
+    }
+    ctx->swarm_frames_lost += frames - 1;
+  }
+  ctx->swarm_frame = frame;
+  ctx->swarm_target = target;
+  ctx->timestamp_swarm_target = now;
+  if(ctx->jitter_buffer_mode != JITTER_BUFFER_OFF){
+    jitter_buffer_push(&ctx->jitter_buffer, now, target.position, CONTROL_PACKET_TIMEOUT_USEC);
   }
+  rl_tools_controller_context_packet_received(ctx, now);
+  return true;
+}
+const rl_tools_controller_context_t* rl_tools_controller_context_global(void){
+  return &controller;
+}
+
+float rl_tools_controller_action_from_motor_cmd(uint16_t motor_cmd){
+  float des_rpm = (float)motor_cmd / UINT16_MAX * MAX_RPM;
+  return (des_rpm - MIN_RPM) / (MAX_RPM - MIN_RPM) * 2 - 1;
 }
 
 void rl_tools_controller_packet_received(){
   uint64_t now = usecTimestamp();
-  timestamp_last_control_packet_received = now;
+  rl_tools_controller_context_packet_received(&controller, now);
+}
+void rl_tools_controller_swarm_packet_received(const uint8_t* data, uint8_t size){
+  uint8_t written = swarm_packets_written;
+  if(size > SWARM_PACKET_MAX_SIZE || (uint8_t)(written - swarm_packets_read) >= SWARM_PACKET_QUEUE_LENGTH){
+    return; // the controller is not keeping up: dropped, counted as lost frames once a newer one arrives
+  }
+  uint8_t slot = written % SWARM_PACKET_QUEUE_LENGTH;
+  swarm_packets[slot].timestamp = usecTimestamp();
+  swarm_packets[slot].size = size;
+  memcpy(swarm_packets[slot].data, data, size);
+  __sync_synchronize();
+  swarm_packets_written = written + 1;
+}
+
+static void swarmPacketsUpdate(void){
+  uint8_t read = swarm_packets_read;
+  while(read != swarm_packets_written){
+    __sync_synchronize();
+    uint8_t slot = read % SWARM_PACKET_QUEUE_LENGTH;
+    rl_tools_controller_context_swarm_packet_received(&controller, swarm_packets[slot].data, swarm_packets[slot].size, swarm_packets[slot].timestamp);
+    read++;
+    swarm_packets_read = read;
+  }
 }
 // void rl_tools_controller_hover_packet_received(){
 //   uint64_t now = usecTimestamp();
-//   timestamp_last_control_packet_received_hover = now;
+//   controller.timestamp_last_control_packet_received_hover = now;
 //   DEBUG_PRINT("Hover packet received\n");
 // }
 
 
+void rl_tools_controller_context_init(rl_tools_controller_context_t* ctx, rl_tools_context_t* policy, uint64_t now){
+  memset(ctx, 0, sizeof(*ctx));
+  ctx->policy = policy;
+  ctx->controller_state = STATE_RESET;
+  ctx->controller_tick = 0;
+  ctx->motor_cmd_divider = 1.0;
+  ctx->motor_cmd_divider_warmup = 7.0;
+
+  ctx->motor_cmd[0] = 0;
+  ctx->motor_cmd[1] = 0;
+  ctx->motor_cmd[2] = 0;
+  ctx->motor_cmd[3] = 0;
+  ctx->timestamp_last_reset = now;
+  ctx->prev_set_motors = false;
+  ctx->prev_pre_set_motors = false;
+  ctx->use_pre_set_warmup = 1;
+  ctx->timestamp_last_control_packet_received = 0;
+  ctx->timestamp_last_control_packet_received_hover = 0;
+  ctx->timestamp_last_behind_schedule_message = 0;
+  ctx->control_invocation_interval = 0;
+  ctx->forward_tick = 0;
+  ctx->hand_test = 0;
+  ctx->waypoint_navigation_timestamp_start = 0;
+  ctx->waypoint_navigation_point_duration = 4;
+  ctx->waypoint_navigation_trajectory_scale = 0.5;
+  ctx->relative_pos[0] = 0;
+  ctx->relative_pos[1] = 0;
+  ctx->relative_pos[2] = 0;
+  ctx->log_set_motors = 0;
+
+  ctx->pos_distance_limit_position = 0.5f;
+  ctx->vel_distance_limit_position = 2.0f;
+  ctx->pos_distance_limit_figure_eight = 0.6f;
+  ctx->vel_distance_limit_figure_eight = 2.0f;
+  ctx->pos_distance_limit_mellinger = 0.2f;
+  ctx->vel_distance_limit_mellinger = 1.0f;
+  ctx->pos_distance_limit_bresciani = 0.2f;
+  ctx->vel_distance_limit_bresciani = 1.0f;
+  ctx->velocity_cmd_multiplier = 1;
+  ctx->velocity_cmd_p_term = 0.0;
+  ctx->use_battery_compensation = 0;
+  ctx->battery_compensation_threshold = 0.05f;
+
+  ctx->target_height = 0.5;
+  ctx->target_height_figure_eight = 0.0;
+
+  // ctx->mode = NORMAL;
+  ctx->mode = POSITION;
+  // ctx->mode = FIGURE_EIGHT;
+  ctx->trigger_mode = RL_TOOLS_PACKET;
+  // ctx->trigger_mode = HOVER_PACKET;
+  ctx->use_orig_controller = 0;
+  ctx->waypoint_navigation_dynamic_current_waypoint = 0;
+  ctx->waypoint_navigation_dynamic_threshold = 0;
+
+  ctx->figure_eight_interval = 5.5;
+  ctx->figure_eight_scale = 1;
+  ctx->figure_eight_progress = 0;
+  ctx->figure_eight_warmup_time = 2;
+
+  jitter_buffer_reset(&ctx->jitter_buffer);
+  ctx->jitter_buffer_mode = JITTER_BUFFER_OFF;
+  ctx->jitter_buffer_latency = 25;
+
+  battery_comp_init(&ctx->battery_comp);
+}
+
+// Stage timing follows the global instance only
+static inline void timelineMark(const rl_tools_controller_context_t* ctx, enum ControllerTimelineStage stage){
+  if(ctx == &controller){
+    controller_timeline_mark(stage);
+  }
+}
+
+static void timelineLayer(const rl_tools_context_t* policy, unsigned int layer){
+  (void)policy; // only registered on the global instance's context
+  controller_timeline_mark(CONTROLLER_TIMELINE_LAYER_0 + layer);
+}
+
+// With classic_mutex held
+static void classicControllerInit(enum ClassicController classic_controller){
+  if(classic_initialized[classic_controller]){
+    return;
+  }
+  uint64_t before = usecTimestamp();
+  bool passed = false;
+  switch(classic_controller){
+    case CLASSIC_PID:
+      controllerPidInit();
+      passed = controllerPidTest();
+      break;
+    case CLASSIC_MELLINGER:
+      controllerMellingerFirmwareInit();
+      passed = controllerMellingerFirmwareTest();
+      break;
+    case CLASSIC_INDI:
+      controllerINDIInit();
+      passed = controllerINDITest();
+      break;
+    default:
+      controllerBrescianiniInit();
+      passed = controllerBrescianiniTest();
+      break;
+  }
+  classic_initialized[classic_controller] = true;
+  boot_profile.classic[classic_controller] = usecTimestamp() - before;
+  if(!passed){
+    DEBUG_PRINT("BackpropTools controller: classic controller %d failed its test\n", classic_controller);
+  }
+}
+
+static void classicControl(enum ClassicController classic_controller, control_t *control, const setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick){
+  xSemaphoreTake(classic_mutex, portMAX_DELAY);
+  classicControllerInit(classic_controller);
+  switch(classic_controller){
+    case CLASSIC_PID:
+      controllerPid(control, setpoint, sensors, state, tick);
+      break;
+    case CLASSIC_MELLINGER:
+      controllerMellingerFirmware(control, setpoint, sensors, state, tick);
+      break;
+    case CLASSIC_INDI:
+      controllerINDI(control, setpoint, sensors, state, tick);
+      break;
+    default:
+      controllerBrescianini(control, setpoint, sensors, state, tick);
+      break;
+  }
+  xSemaphoreGive(classic_mutex);
+}
+
+// Mellinger and INDI start from a reset state (integrators, filters) as with the stock activation; their test and boot
+// timing ran with the first, lazy initialization and are not repeated
+static void classicControllersReset(void){
+  xSemaphoreTake(classic_mutex, portMAX_DELAY);
+  if(classic_initialized[CLASSIC_MELLINGER]){
+    controllerMellingerFirmwareInit();
+  }
+  if(classic_initialized[CLASSIC_INDI]){
+    controllerINDIInit();
+  }
+  xSemaphoreGive(classic_mutex);
+}
+
+static void selfTest(void){
+  uint64_t before = usecTimestamp();
+  // Own buffers: the control loop keeps using the default context meanwhile
+  void* memory = pvPortMalloc(rl_tools_context_size());
+  bool passed = false;
+  if(memory != NULL){
+    float output[4] = {0, 0, 0, 0}; // not written if the adapter is built with RL_TOOLS_DISABLE_TEST
+    float absdiff = rl_tools_context_test(rl_tools_context_init(memory), output);
+    vPortFree(memory);
+    if(absdiff < 0){
+      absdiff = -absdiff;
+    }
+    DEBUG_PRINT("BackpropTools controller test, abs diff: %f\n", (double)absdiff);
+    for(int i = 0; i < 4; i++){
+      DEBUG_PRINT("BackpropTools controller: Test action %d: %f\n", i, (double)output[i]);
+    }
+    passed = absdiff <= SELF_TEST_TOLERANCE;
+  }
+  uint64_t after = usecTimestamp();
+  boot_profile.self_test = after - before;
+  boot_profile.ready = passed ? after - timestamp_boot : 0;
+  self_test_state = passed ? SELF_TEST_PASSED : SELF_TEST_FAILED;
+  DEBUG_PRINT("BackpropTools controller: self-test %s after %uus, ready %uus after init\n", passed ? "passed" : "FAILED", (unsigned int)boot_profile.self_test, (unsigned int)boot_profile.ready);
+}
+
+static void selfTestTask(void* parameters){
+  (void)parameters;
+  selfTest();
+  boot_profile.self_test_stack = (SELF_TEST_TASK_STACK_SIZE - uxTaskGetStackHighWaterMark(NULL)) * sizeof(StackType_t);
+  DEBUG_PRINT("BackpropTools controller: self-test stack %u of %u bytes\n", (unsigned int)boot_profile.self_test_stack, (unsigned int)(SELF_TEST_TASK_STACK_SIZE * sizeof(StackType_t)));
+  vTaskDelete(NULL);
+}
+
 void controllerOutOfTreeInit(void){
-  controller_state = STATE_RESET;
-  controller_tick = 0;
-  motor_cmd_divider = 1.0;
-  motor_cmd_divider_warmup = 7.0;
-
-  motor_cmd[0] = 0;
-  motor_cmd[1] = 0;
-  motor_cmd[2] = 0;
-  motor_cmd[3] = 0;
-  timestamp_last_reset = usecTimestamp();
-  prev_set_motors = false;
-  prev_pre_set_motors = false;
-  use_pre_set_warmup = 1;
-  timestamp_last_control_packet_received = 0;
-  timestamp_last_control_packet_received_hover = 0;
-  timestamp_last_behind_schedule_message = 0;
-  control_invocation_interval = 0;
-  forward_tick = 0;
-  hand_test = 0;
-  waypoint_navigation_timestamp_start = 0;
-  waypoint_navigation_trajectory_scale = 0.5;
-  relative_pos[0] = 0;
-  relative_pos[1] = 0;
-  relative_pos[2] = 0;
-  log_set_motors = 0;
-
-  pos_distance_limit_position = 0.5f;
-  vel_distance_limit_position = 2.0f;
-  pos_distance_limit_figure_eight = 0.6f;
-  vel_distance_limit_figure_eight = 2.0f;
-  pos_distance_limit_mellinger = 0.2f;
-  vel_distance_limit_mellinger = 1.0f;
-  pos_distance_limit_bresciani = 0.2f;
-  vel_distance_limit_bresciani = 1.0f;
-  velocity_cmd_multiplier = 1;
-  velocity_cmd_p_term = 0.0;
-
-  target_height = 0.5;
-  target_height_figure_eight = 0.0;
-
-  // mode = NORMAL;
-  mode = POSITION;
-  // mode = FIGURE_EIGHT;
-  trigger_mode = RL_TOOLS_PACKET;
-  // trigger_mode = HOVER_PACKET;
-  use_orig_controller = 0;
-  waypoint_navigation_dynamic_current_waypoint = 0;
-  waypoint_navigation_dynamic_threshold = 0;
-
-  figure_eight_interval = 5.5;
-  figure_eight_scale = 1;
-  figure_eight_progress = 0;
-  figure_eight_warmup_time = 2;
-
-  controllerPidInit();
-  controllerMellingerFirmwareInit();
-  controllerINDIInit();
-  controllerBrescianiniInit();
+  timestamp_boot = usecTimestamp();
+  self_test_state = SELF_TEST_PENDING;
+  if(classic_mutex == NULL){
+    classic_mutex = xSemaphoreCreateMutexStatic(&classic_mutex_buffer);
+    ASSERT(classic_mutex != NULL);
+  }
+  for(int i = 0; i < CLASSIC_COUNT; i++){
+    classic_initialized[i] = false;
+  }
+  packed_log_init();
+  flight_metrics_init();
+  controller_trace_recorder_init();
+  controller_timeline_recorder_init();
+  motor_curve_init();
+  uint64_t before = usecTimestamp();
   rl_tools_init();
+  boot_profile.rl_tools = usecTimestamp() - before;
+  rl_tools_controller_context_init(&controller, rl_tools_context_default(), usecTimestamp());
+  rl_tools_context_set_layer_callback(controller.policy, timelineLayer); // the timeline follows the global instance
 
   DEBUG_PRINT("BackpropTools controller init! Checkpoint: %s\n", rl_tools_get_checkpoint_name());
+  unsigned int ccm_placement = 0;
+  unsigned int ccm_bytes = rl_tools_ccm_usage(&ccm_placement, NULL);
+  if(ccm_bytes > 0){
+    DEBUG_PRINT("BackpropTools controller: %u bytes in CCM (placement 0x%x)\n", ccm_bytes, ccm_placement);
+  }
+  boot_profile.init = usecTimestamp() - timestamp_boot;
+  if(xTaskCreate(selfTestTask, "RLTTEST", SELF_TEST_TASK_STACK_SIZE, NULL, SELF_TEST_TASK_PRIORITY, NULL) != pdPASS){
+    selfTest();
+  }
 }
 
-bool controllerOutOfTreeTest(void)
-{
-  float output[4];
-  float absdiff = rl_tools_test(output);
-  if(absdiff < 0){
-    absdiff = -absdiff;
+static void kernelStore(unsigned int layers){
+  for(unsigned int layer_i = 0; layer_i < layers; layer_i++){
+    paramVarId_t id = paramGetVarId("rltk", kernel_selection_names[layer_i]);
+    if(!PARAM_VARID_IS_VALID(id) || !paramPersistentStore(id)){
+      DEBUG_PRINT("BackpropTools kernels: rltk.%s not stored\n", kernel_selection_names[layer_i]);
+    }
   }
-  DEBUG_PRINT("BackpropTools controller test, abs diff: %f\n", absdiff);
-  for(int i = 0; i < 4; i++){
-    DEBUG_PRINT("BackpropTools controller: Test action %d: %f\n", i, output[i]);
+}
+
+static void kernelTune(void){
+  // Own buffers: the control loop keeps using the default context meanwhile. Layers without a selection fall back to
+  // rl_tools if the context cannot be allocated
+  unsigned int layers = rl_tools_kernel_layers();
+  uint8_t selection[RL_TOOLS_KERNEL_MAX_LAYERS];
+  for(unsigned int layer_i = 0; layer_i < layers; layer_i++){
+    selection[layer_i] = kernel_selection[layer_i] == RL_TOOLS_KERNEL_AUTO ? RL_TOOLS_KERNEL_RL_TOOLS : kernel_selection[layer_i];
   }
-  if(absdiff > 0.2){
-    return false;
+  bool tuned = false;
+  void* memory = pvPortMalloc(rl_tools_context_size());
+  if(memory != NULL){
+    float time_rl_tools = 0;
+    float time = rl_tools_kernel_autotune(rl_tools_context_init(memory), RL_TOOLS_KERNEL_AUTOTUNE_REPETITIONS, selection, &time_rl_tools);
+    vPortFree(memory);
+    tuned = time >= 0;
+    if(tuned){
+      kernel_time = time;
+      kernel_time_rl_tools = time_rl_tools;
+      DEBUG_PRINT("BackpropTools kernels: %.1fus (rl_tools %.1fus)", (double)kernel_time, (double)kernel_time_rl_tools);
+      for(unsigned int layer_i = 0; layer_i < layers; layer_i++){
+        DEBUG_PRINT(" %s", rl_tools_kernel_name(selection[layer_i]));
+      }
+      DEBUG_PRINT("\n");
+    }
+    else{
+      DEBUG_PRINT("BackpropTools kernels: no kernel registry to tune\n");
+    }
   }
-  return controllerPidTest() && controllerMellingerFirmwareTest() && controllerINDITest() && controllerBrescianiniTest();
+  else{
+    DEBUG_PRINT("BackpropTools kernels: no memory to tune\n");
+  }
+  // Picked up by kernelsUpdate at the next controller invocation
+  for(unsigned int layer_i = 0; layer_i < layers; layer_i++){
+    kernel_selection[layer_i] = selection[layer_i];
+  }
+  if(tuned){
+    kernelStore(layers);
+  }
+  kernel_tune = 0;
+  kernel_tuning = 0;
 }
 
-static void batteryCompensation(const motors_thrust_uncapped_t* motorThrustUncapped, motors_thrust_uncapped_t* motorThrustBatCompUncapped)
+static void kernelTuneTask(void* parameters){
+  (void)parameters;
+  kernelTune();
+  kernel_tune_stack = (KERNEL_TUNE_TASK_STACK_SIZE - uxTaskGetStackHighWaterMark(NULL)) * sizeof(StackType_t);
+  vTaskDelete(NULL);
+}
+
+static void kernelsUpdate(void){
+  unsigned int layers = rl_tools_kernel_layers();
+  bool tune = kernel_tune != 0;
+  for(unsigned int layer_i = 0; layer_i < layers; layer_i++){
+    tune = tune || kernel_selection[layer_i] == RL_TOOLS_KERNEL_AUTO;
+  }
+  if(tune || kernel_tuning){
+    // Timing takes a few inferences worth of time: in a low-priority task, started only while the motors are off and
+    // after the self-test (which runs inferences of its own)
+    if(kernel_tuning || self_test_state == SELF_TEST_PENDING){
+      return;
+    }
+    for(uint8_t i=0; i<4; i++){
+      if(motorsGetRatio(motors[i]) != 0){
+        return;
+      }
+    }
+    kernel_tuning = 1;
+    if(xTaskCreate(kernelTuneTask, "RLTKERN", KERNEL_TUNE_TASK_STACK_SIZE, NULL, KERNEL_TUNE_TASK_PRIORITY, NULL) != pdPASS){
+      DEBUG_PRINT("BackpropTools kernels: tuning task not started\n");
+      for(unsigned int layer_i = 0; layer_i < layers; layer_i++){
+        if(kernel_selection[layer_i] == RL_TOOLS_KERNEL_AUTO){
+          kernel_selection[layer_i] = RL_TOOLS_KERNEL_RL_TOOLS;
+        }
+      }
+      kernel_tune = 0;
+      kernel_tuning = 0;
+    }
+    return;
+  }
+  rl_tools_context_t* context = controller.policy;
+  for(unsigned int layer_i = 0; layer_i < layers; layer_i++){
+    if(kernel_selection[layer_i] != rl_tools_kernel_get(context, layer_i) && !rl_tools_kernel_set(context, layer_i, kernel_selection[layer_i])){
+      DEBUG_PRINT("BackpropTools kernels: %d not available\n", kernel_selection[layer_i]);
+      kernel_selection[layer_i] = rl_tools_kernel_get(context, layer_i);
+    }
+  }
+}
+
+bool controllerOutOfTreeTest(void)
 {
-  float supplyVoltage = pmGetBatteryVoltage();
+  // The policy check runs in the background (selfTest) and the classic controllers are tested on first use
+  return self_test_state != SELF_TEST_FAILED;
+}
 
+static void batteryCompensation(const motors_thrust_uncapped_t* motorThrustUncapped, motors_thrust_uncapped_t* motorThrustBatCompUncapped, float supplyVoltage)
+{
   for (int motor = 0; motor < STABILIZER_NR_OF_MOTORS; motor++)
   {
     motorThrustBatCompUncapped->list[motor] = motorsCompensateBatteryVoltage(motor, motorThrustUncapped->list[motor], supplyVoltage);
   }
 }
-static void setMotorRatios(const motors_thrust_pwm_t* motorPwm)
+static inline void setMotorRatio(rl_tools_controller_context_t* ctx, uint8_t motor_i, uint16_t ratio)
 {
-  motorsSetRatio(MOTOR_M1, motorPwm->motors.m1);
-  motorsSetRatio(MOTOR_M2, motorPwm->motors.m2);
-  motorsSetRatio(MOTOR_M3, motorPwm->motors.m3);
-  motorsSetRatio(MOTOR_M4, motorPwm->motors.m4);
+  ctx->motor_output[motor_i] = ratio;
+  ctx->motor_output_set = true;
+}
+static void setMotorRatios(rl_tools_controller_context_t* ctx, const motors_thrust_pwm_t* motorPwm)
+{
+  setMotorRatio(ctx, 0, motorPwm->motors.m1);
+  setMotorRatio(ctx, 1, motorPwm->motors.m2);
+  setMotorRatio(ctx, 2, motorPwm->motors.m3);
+  setMotorRatio(ctx, 3, motorPwm->motors.m4);
 }
 
 
-static inline void every_500ms(){
+static inline void every_500ms(rl_tools_controller_context_t* ctx){
+  (void)ctx; // PRINT_TWIST only
 #ifdef PRINT_TWIST
-  DEBUG_PRINT("tw.l: %5.2f, %5.2f, %5.2f tw.a: %5.2f, %5.2f, %5.2f\n", state_input[7], state_input[8], state_input[9], state_input[10], state_input[11], state_input[12]);
-  DEBUG_PRINT("q: %5.2f, %5.2f, %5.2f, %5.2f\n", state_input[3], state_input[4], state_input[5], state_input[6]);
+  DEBUG_PRINT("tw.l: %5.2f, %5.2f, %5.2f tw.a: %5.2f, %5.2f, %5.2f\n", ctx->state_input[7], ctx->state_input[8], ctx->state_input[9], ctx->state_input[10], ctx->state_input[11], ctx->state_input[12]);
+  DEBUG_PRINT("q: %5.2f, %5.2f, %5.2f, %5.2f\n", ctx->state_input[3], ctx->state_input[4], ctx->state_input[5], ctx->state_input[6]);
 #endif
 }
 
-static inline void every_1000ms(){
+static inline void every_1000ms(rl_tools_controller_context_t* ctx){
 #ifdef PRINT_RPY
   DEBUG_PRINT("rpy: %5.2f, %5.2f, %5.2f\n", attitude_rpy[0], attitude_rpy[1], attitude_rpy[2]);
 #endif
 
-  DEBUG_PRINT("Last setpoint: x disposition/mode %f/%f/%d\n", last_setpoint.position.x, last_setpoint.velocity.x, last_setpoint.mode.x);
-  DEBUG_PRINT("Last setpoint: y disposition/mode %f/%f/%d\n", last_setpoint.position.y, last_setpoint.velocity.y, last_setpoint.mode.y);
-  DEBUG_PRINT("Last setpoint: z disposition/mode %f/%f/%d\n", last_setpoint.position.z, last_setpoint.velocity.z, last_setpoint.mode.z);
+  DEBUG_PRINT("Last setpoint: x disposition/mode %f/%f/%d\n", ctx->last_setpoint.position.x, ctx->last_setpoint.velocity.x, ctx->last_setpoint.mode.x);
+  DEBUG_PRINT("Last setpoint: y disposition/mode %f/%f/%d\n", ctx->last_setpoint.position.y, ctx->last_setpoint.velocity.y, ctx->last_setpoint.mode.y);
+  DEBUG_PRINT("Last setpoint: z disposition/mode %f/%f/%d\n", ctx->last_setpoint.position.z, ctx->last_setpoint.velocity.z, ctx->last_setpoint.mode.z);
 }
 
-static inline void every_10000ms(){
-  DEBUG_PRINT("control invocation interval %f\n", (double)control_invocation_interval);
+static inline void every_10000ms(rl_tools_controller_context_t* ctx){
+  DEBUG_PRINT("control invocation interval %f\n", (double)ctx->control_invocation_interval);
 }
 
-static inline void trigger_every(uint64_t controller_tick){
+static inline void trigger_every(rl_tools_controller_context_t* ctx, uint64_t controller_tick){
   if(controller_tick > 3000){
     if(controller_tick % 500 == 0){
-      every_500ms();
+      every_500ms(ctx);
     }
     if(controller_tick  % 1000 == 150){
-      every_1000ms();
+      every_1000ms(ctx);
     }
     if(controller_tick % 10000 == 9300){
-      every_10000ms();
+      every_10000ms(ctx);
     }
   }
 }
@@ -344,229 +655,296 @@ static void print_mode(stab_mode_t mode){
   }
 }
 
-void controllerOutOfTree(control_t *control, setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick) {
-  uint64_t now = usecTimestamp();
-  if(setpoint->mode.x == modeVelocity && setpoint->mode.y == modeVelocity){
-    timestamp_last_control_packet_received_hover = now;
-  }
-
-  last_setpoint = *setpoint;
-  watchdogReset();
-  control_invocation_interval *= CONTROL_INVOCATION_INTERVAL_ALPHA;
-  control_invocation_interval += (1-CONTROL_INVOCATION_INTERVAL_ALPHA) * (now - timestamp_last_control_invocation);
-  timestamp_last_control_invocation = now;
-  uint64_t relevant_timestamp_last_control_packet_received = trigger_mode == RL_TOOLS_PACKET ? timestamp_last_control_packet_received : timestamp_last_control_packet_received_hover;
-  bool pre_set_motors = (now - relevant_timestamp_last_control_packet_received < CONTROL_PACKET_TIMEOUT_USEC)  || (set_motors_overwrite == 1 && motor_cmd_divider >= 3);
-  bool set_motors = false;
-
-  if(!prev_pre_set_motors && pre_set_motors){
-    timestamp_pre_set_motors = now;
-  }
-  set_motors = pre_set_motors && (((now - timestamp_pre_set_motors) > WARMUP_TIME) || use_pre_set_warmup == 0);
-
-  log_set_motors = set_motors ? 1 : 0;
-  // set_rl_tools_overwrite_stabilizer(set_motors);
-  if(!prev_set_motors && set_motors){
-    waypoint_navigation_timestamp_start = now;
-    timestamp_controller_activation = now;
-    waypoint_navigation_dynamic_current_waypoint = 0;
-    origin[0] = state->position.x;
-    origin[1] = state->position.y;
-    origin[2] = state->position.z + (mode == FIGURE_EIGHT ? target_height_figure_eight : target_height);
-    figure_eight_last_invocation = now;
-    figure_eight_progress = 0;
-    controllerMellingerFirmwareInit();
-    controllerINDIInit();
-    DEBUG_PRINT("Controller activated\n");
-    switch(mode){
-      case NORMAL:
-        DEBUG_PRINT("NORMAL mode \n");
-        DEBUG_PRINT("\t x mode: "); print_mode(setpoint->mode.x);
-        DEBUG_PRINT("\t y mode: "); print_mode(setpoint->mode.y);
-        DEBUG_PRINT("\t z mode: "); print_mode(setpoint->mode.z);
-        break;
-      case POSITION:
-        DEBUG_PRINT("POSITION mode\n");
-        break;
-      case WAYPOINT_NAVIGATION:
-        DEBUG_PRINT("WAYPOINT_NAVIGATION mode\n");
-        break;
-      case WAYPOINT_NAVIGATION_DYNAMIC:
-        DEBUG_PRINT("WAYPOINT_NAVIGATION_DYNAMIC mode\n");
+// Reference generation: target position and velocity of the mode (setpoint decoding, waypoints, figure eight)
+static void update_reference(rl_tools_controller_context_t* ctx, const setpoint_t *setpoint, const state_t *state, uint64_t now){
+  ctx->target_vel[0] = 0;
+  ctx->target_vel[1] = 0;
+  ctx->target_vel[2] = 0;
+  switch(ctx->mode){
+    case NORMAL:
+      if(ctx->jitter_buffer_mode != JITTER_BUFFER_OFF && jitter_buffer_sample(&ctx->jitter_buffer, now, (uint32_t)(ctx->jitter_buffer_latency * 1000), ctx->jitter_buffer_mode, CONTROL_PACKET_TIMEOUT_USEC, ctx->target_pos, ctx->target_vel)){
         break;
-      case FIGURE_EIGHT:
-        DEBUG_PRINT("FIGURE_EIGHT mode\n");
+      }
+      if(swarm_target_fresh(ctx, now)){
+        // Held between frames along the target velocity
+        float age = (now - ctx->timestamp_swarm_target) / 1000000.0f;
+        for(uint8_t i=0; i<3; i++){
+          ctx->target_pos[i] = ctx->swarm_target.position[i] + ctx->swarm_target.velocity[i] * age;
+          ctx->target_vel[i] = ctx->swarm_target.velocity[i];
+        }
         break;
-    }
-  }
-  if(prev_set_motors && !set_motors){
-    DEBUG_PRINT("Controller deactivated\n");
-    for(uint8_t i=0; i<4; i++){
-      motorsSetRatio(motors[i], 0);
-    }
-  }
-  relative_pos[0] = state->position.x - origin[0];
-  relative_pos[1] = state->position.y - origin[1];
-  relative_pos[2] = state->position.z - origin[2];
-  target_vel[0] = 0;
-  target_vel[1] = 0;
-  target_vel[2] = 0;
-  switch(mode){
-    case NORMAL:
+      }
       switch(setpoint->mode.x){
         case modeAbs:
-        target_pos[0] = setpoint->position.x;
-        target_vel[0] = 0;
+        ctx->target_pos[0] = setpoint->position.x;
+        ctx->target_vel[0] = 0;
         break;
         case modeVelocity:
-        target_pos[0] = state->position.x - setpoint->velocity.x * velocity_cmd_p_term;
-        target_vel[0] = setpoint->velocity.x * velocity_cmd_multiplier;
+        ctx->target_pos[0] = state->position.x - setpoint->velocity.x * ctx->velocity_cmd_p_term;
+        ctx->target_vel[0] = setpoint->velocity.x * ctx->velocity_cmd_multiplier;
         break;
         case modeDisable:
-        target_pos[0] = origin[0];
-        target_vel[0] = 0;
+        ctx->target_pos[0] = ctx->origin[0];
+        ctx->target_vel[0] = 0;
         break;
       }
       switch(setpoint->mode.y){
         case modeAbs:
-        target_pos[1] = setpoint->position.y;
-        target_vel[1] = 0;
+        ctx->target_pos[1] = setpoint->position.y;
+        ctx->target_vel[1] = 0;
         break;
         case modeVelocity:
-        target_pos[1] = state->position.y - setpoint->velocity.y * velocity_cmd_p_term;
-        target_vel[1] = setpoint->velocity.y * velocity_cmd_multiplier;
+        ctx->target_pos[1] = state->position.y - setpoint->velocity.y * ctx->velocity_cmd_p_term;
+        ctx->target_vel[1] = setpoint->velocity.y * ctx->velocity_cmd_multiplier;
         break;
         case modeDisable:
-        target_pos[1] = origin[1];
-        target_vel[1] = 0;
+        ctx->target_pos[1] = ctx->origin[1];
+        ctx->target_vel[1] = 0;
         break;
       }
       switch(setpoint->mode.z){
         case modeAbs:
-        target_pos[2] = setpoint->position.z;
-        target_vel[2] = 0;
+        ctx->target_pos[2] = setpoint->position.z;
+        ctx->target_vel[2] = 0;
         break;
         case modeVelocity:
-        target_pos[2] = state->position.z - setpoint->velocity.z * velocity_cmd_p_term;
-        target_vel[2] = setpoint->velocity.z * velocity_cmd_multiplier;
+        ctx->target_pos[2] = state->position.z - setpoint->velocity.z * ctx->velocity_cmd_p_term;
+        ctx->target_vel[2] = setpoint->velocity.z * ctx->velocity_cmd_multiplier;
         break;
         case modeDisable:
-        target_pos[2] = origin[2];
-        target_vel[2] = 0;
+        ctx->target_pos[2] = ctx->origin[2];
+        ctx->target_vel[2] = 0;
         break;
       }
     break;
     case POSITION:
-      target_pos[0] = origin[0];
-      target_pos[1] = origin[1];
-      target_pos[2] = origin[2];
+      ctx->target_pos[0] = ctx->origin[0];
+      ctx->target_pos[1] = ctx->origin[1];
+      ctx->target_pos[2] = ctx->origin[2];
       break;
     case WAYPOINT_NAVIGATION:
     {
-      uint64_t elapsed_since_start = (now-waypoint_navigation_timestamp_start);
-      int current_point = (elapsed_since_start / ((int)(waypoint_navigation_point_duration * 1000 * 1000))) % WAYPOINT_NAVIGATION_NUMBER_OF_POINTS;
-      target_pos[0] = trajectory[current_point][0] * waypoint_navigation_trajectory_scale + origin[0];
-      target_pos[1] = trajectory[current_point][1] * waypoint_navigation_trajectory_scale + origin[1];
-      target_pos[2] = trajectory[current_point][2] * waypoint_navigation_trajectory_scale + origin[2];
+      uint64_t elapsed_since_start = (now-ctx->waypoint_navigation_timestamp_start);
+      int current_point = (elapsed_since_start / ((int)(ctx->waypoint_navigation_point_duration * 1000 * 1000))) % WAYPOINT_NAVIGATION_NUMBER_OF_POINTS;
+      ctx->target_pos[0] = trajectory[current_point][0] * ctx->waypoint_navigation_trajectory_scale + ctx->origin[0];
+      ctx->target_pos[1] = trajectory[current_point][1] * ctx->waypoint_navigation_trajectory_scale + ctx->origin[1];
+      ctx->target_pos[2] = trajectory[current_point][2] * ctx->waypoint_navigation_trajectory_scale + ctx->origin[2];
     }
       break;
     case WAYPOINT_NAVIGATION_DYNAMIC:
       {
-        float x = relative_pos[0] - trajectory[waypoint_navigation_dynamic_current_waypoint][0];
-        float y = relative_pos[1] - trajectory[waypoint_navigation_dynamic_current_waypoint][1];
-        float z = relative_pos[2] - trajectory[waypoint_navigation_dynamic_current_waypoint][2];
+        float x = ctx->relative_pos[0] - trajectory[ctx->waypoint_navigation_dynamic_current_waypoint][0];
+        float y = ctx->relative_pos[1] - trajectory[ctx->waypoint_navigation_dynamic_current_waypoint][1];
+        float z = ctx->relative_pos[2] - trajectory[ctx->waypoint_navigation_dynamic_current_waypoint][2];
 
         float current_dist = sqrtf(x*x + y*y + z*z);
-        if(current_dist < waypoint_navigation_dynamic_threshold){
-          waypoint_navigation_dynamic_current_waypoint = (waypoint_navigation_dynamic_current_waypoint + 1) % WAYPOINT_NAVIGATION_NUMBER_OF_POINTS;
-          DEBUG_PRINT("Next waypoint %d, [%f, %f, %f]\n", waypoint_navigation_dynamic_current_waypoint, trajectory[waypoint_navigation_dynamic_current_waypoint][0], trajectory[waypoint_navigation_dynamic_current_waypoint][1], trajectory[waypoint_navigation_dynamic_current_waypoint][2]);
+        if(current_dist < ctx->waypoint_navigation_dynamic_threshold){
+          ctx->waypoint_navigation_dynamic_current_waypoint = (ctx->waypoint_navigation_dynamic_current_waypoint + 1) % WAYPOINT_NAVIGATION_NUMBER_OF_POINTS;
+          DEBUG_PRINT("Next waypoint %d, [%f, %f, %f]\n", ctx->waypoint_navigation_dynamic_current_waypoint, trajectory[ctx->waypoint_navigation_dynamic_current_waypoint][0], trajectory[ctx->waypoint_navigation_dynamic_current_waypoint][1], trajectory[ctx->waypoint_navigation_dynamic_current_waypoint][2]);
         }
-        target_pos[0] = origin[0] + trajectory[waypoint_navigation_dynamic_current_waypoint][0];
-        target_pos[1] = origin[1] + trajectory[waypoint_navigation_dynamic_current_waypoint][1];
-        target_pos[2] = origin[2] + trajectory[waypoint_navigation_dynamic_current_waypoint][2];
+        ctx->target_pos[0] = ctx->origin[0] + trajectory[ctx->waypoint_navigation_dynamic_current_waypoint][0];
+        ctx->target_pos[1] = ctx->origin[1] + trajectory[ctx->waypoint_navigation_dynamic_current_waypoint][1];
+        ctx->target_pos[2] = ctx->origin[2] + trajectory[ctx->waypoint_navigation_dynamic_current_waypoint][2];
       }
       break;
     case FIGURE_EIGHT:
       {
-        float t = (now - timestamp_controller_activation) / 1000000.0f;
-        float dt = (now - figure_eight_last_invocation) / 1000000.0f;
-        float target_speed = 1/figure_eight_interval;
+        float t = (now - ctx->timestamp_controller_activation) / 1000000.0f;
+        float dt = (now - ctx->figure_eight_last_invocation) / 1000000.0f;
+        float target_speed = 1/ctx->figure_eight_interval;
         float speed = target_speed;
-        if(t < figure_eight_warmup_time){
-          speed = target_speed * t/figure_eight_warmup_time;
+        if(t < ctx->figure_eight_warmup_time){
+          speed = target_speed * t/ctx->figure_eight_warmup_time;
         }
-        figure_eight_progress += dt * speed;
-        float progress = figure_eight_progress;
-        target_pos[0] = origin[0] + cosf(progress*2*M_PI + M_PI / 2) * figure_eight_scale;
-        target_vel[0] = -sinf(progress*2*M_PI + M_PI / 2) * figure_eight_scale * 2 * M_PI * speed;
-        target_pos[1] = origin[1] + sinf(2*(progress*2*M_PI + M_PI / 2)) / 2.0f * figure_eight_scale;
-        target_vel[1] = cosf(2*(progress*2*M_PI + M_PI / 2)) / 2.0f * figure_eight_scale * 4 * M_PI * speed;
-        target_pos[2] = origin[2];
-        figure_eight_last_invocation = now;
+        ctx->figure_eight_progress += dt * speed;
+        float progress = ctx->figure_eight_progress;
+        ctx->target_pos[0] = ctx->origin[0] + cosf(progress*2*M_PI + M_PI / 2) * ctx->figure_eight_scale;
+        ctx->target_vel[0] = -sinf(progress*2*M_PI + M_PI / 2) * ctx->figure_eight_scale * 2 * M_PI * speed;
+        ctx->target_pos[1] = ctx->origin[1] + sinf(2*(progress*2*M_PI + M_PI / 2)) / 2.0f * ctx->figure_eight_scale;
+        ctx->target_vel[1] = cosf(2*(progress*2*M_PI + M_PI / 2)) / 2.0f * ctx->figure_eight_scale * 4 * M_PI * speed;
+        ctx->target_pos[2] = ctx->origin[2];
+        ctx->figure_eight_last_invocation = now;
       }
       break;
   }
-  pos_error[0] = target_pos[0] - state->position.x;
-  pos_error[1] = target_pos[1] - state->position.y;
-  pos_error[2] = target_pos[2] - state->position.z;
+  ctx->timestamp_reference = now;
+}
 
-  trigger_every(controller_tick);
-  prev_set_motors = set_motors;
-  prev_pre_set_motors = pre_set_motors;
+// Between two reference updates the classic controllers (rlt.orig), which run every tick, follow the reference along
+// target_vel; the next update replaces it
+static void extrapolate_reference(rl_tools_controller_context_t* ctx, uint64_t now){
+  float dt = (now - ctx->timestamp_reference) / 1000000.0f;
+  ctx->target_pos[0] += ctx->target_vel[0] * dt;
+  ctx->target_pos[1] += ctx->target_vel[1] * dt;
+  ctx->target_pos[2] += ctx->target_vel[2] * dt;
+  ctx->timestamp_reference = now;
+}
+
+void rl_tools_controller_context_step(rl_tools_controller_context_t* ctx, control_t *control, setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick, uint64_t now, float battery_voltage) {
+  ctx->activated = false;
+  ctx->inference = false;
+  ctx->behind_schedule = false;
+  ctx->motor_output_set = false;
+  if(setpoint->mode.x == modeVelocity && setpoint->mode.y == modeVelocity){
+    ctx->timestamp_last_control_packet_received_hover = now;
+  }
+
+  ctx->last_setpoint = *setpoint;
+  ctx->control_invocation_interval *= CONTROL_INVOCATION_INTERVAL_ALPHA;
+  ctx->control_invocation_interval += (1-CONTROL_INVOCATION_INTERVAL_ALPHA) * (now - ctx->timestamp_last_control_invocation);
+  ctx->timestamp_last_control_invocation = now;
+  uint64_t relevant_timestamp_last_control_packet_received = ctx->trigger_mode == RL_TOOLS_PACKET ? ctx->timestamp_last_control_packet_received : ctx->timestamp_last_control_packet_received_hover;
+  bool triggered = (now - relevant_timestamp_last_control_packet_received < CONTROL_PACKET_TIMEOUT_USEC)  || (ctx->set_motors_overwrite == 1 && ctx->motor_cmd_divider >= 3);
+  // The policy self-test only gates the learned controller, rlt.orig >= 1 flies the classic controllers regardless
+  bool self_test_blocked = triggered && ctx->use_orig_controller == 0 && self_test_state != SELF_TEST_PASSED;
+  if(self_test_blocked && !ctx->self_test_blocked){
+    DEBUG_PRINT("BackpropTools controller: triggered, but the policy self-test %s\n", self_test_state == SELF_TEST_FAILED ? "FAILED" : "is still running");
+  }
+  ctx->self_test_blocked = self_test_blocked;
+  bool pre_set_motors = triggered && !self_test_blocked;
+  bool set_motors = false;
 
-  if(tick % CONTROL_INTERVAL_MS == 0){
-    update_state(sensors, state);
+  if(!ctx->prev_pre_set_motors && pre_set_motors){
+    ctx->timestamp_pre_set_motors = now;
+  }
+  set_motors = pre_set_motors && (((now - ctx->timestamp_pre_set_motors) > WARMUP_TIME) || ctx->use_pre_set_warmup == 0);
+
+  ctx->log_set_motors = set_motors ? 1 : 0;
+  // set_rl_tools_overwrite_stabilizer(set_motors);
+  if(!ctx->prev_set_motors && set_motors){
+    ctx->waypoint_navigation_timestamp_start = now;
+    ctx->timestamp_controller_activation = now;
+    ctx->waypoint_navigation_dynamic_current_waypoint = 0;
+    ctx->origin[0] = state->position.x;
+    ctx->origin[1] = state->position.y;
+    ctx->origin[2] = state->position.z + (ctx->mode == FIGURE_EIGHT ? ctx->target_height_figure_eight : ctx->target_height);
+    ctx->figure_eight_last_invocation = now;
+    ctx->figure_eight_progress = 0;
+    ctx->activated = true;
+    classicControllersReset();
+    DEBUG_PRINT("Controller activated\n");
+    switch(ctx->mode){
+      case NORMAL:
+        DEBUG_PRINT("NORMAL mode \n");
+        DEBUG_PRINT("\t x mode: "); print_mode(setpoint->mode.x);
+        DEBUG_PRINT("\t y mode: "); print_mode(setpoint->mode.y);
+        DEBUG_PRINT("\t z mode: "); print_mode(setpoint->mode.z);
+        break;
+      case POSITION:
+        DEBUG_PRINT("POSITION mode\n");
+        break;
+      case WAYPOINT_NAVIGATION:
+        DEBUG_PRINT("WAYPOINT_NAVIGATION mode\n");
+        break;
+      case WAYPOINT_NAVIGATION_DYNAMIC:
+        DEBUG_PRINT("WAYPOINT_NAVIGATION_DYNAMIC mode\n");
+        break;
+      case FIGURE_EIGHT:
+        DEBUG_PRINT("FIGURE_EIGHT mode\n");
+        break;
+    }
+  }
+  if(ctx->prev_set_motors && !set_motors){
+    DEBUG_PRINT("Controller deactivated\n");
+    for(uint8_t i=0; i<4; i++){
+      setMotorRatio(ctx, i, 0);
+    }
+  }
+  // Absolute commander setpoints enter the jitter buffer when they show up, checked every tick so that no setpoint is
+  // missed; swarm targets are pushed on reception. setpoint_t.timestamp (tick count) only tells a new setpoint apart,
+  // the buffer runs on the usecTimestamp clock of now.
+  if(ctx->jitter_buffer_mode != JITTER_BUFFER_OFF && ctx->mode == NORMAL && !swarm_target_fresh(ctx, now) && setpoint->mode.x == modeAbs && setpoint->mode.y == modeAbs && setpoint->mode.z == modeAbs && setpoint->timestamp != ctx->jitter_buffer_setpoint_timestamp){
+    float position[3] = {setpoint->position.x, setpoint->position.y, setpoint->position.z};
+    jitter_buffer_push(&ctx->jitter_buffer, now, position, CONTROL_PACKET_TIMEOUT_USEC);
+    ctx->jitter_buffer_setpoint_timestamp = setpoint->timestamp;
+  }
+  // Reference stage at the policy rate: state_input only consumes it on inference ticks
+  bool inference_tick = tick % CONTROL_INTERVAL_MS == 0;
+  // The position relative to the origin and to the target (rltrp, rltte) follows the state every tick
+  ctx->relative_pos[0] = state->position.x - ctx->origin[0];
+  ctx->relative_pos[1] = state->position.y - ctx->origin[1];
+  ctx->relative_pos[2] = state->position.z - ctx->origin[2];
+  if(inference_tick || ctx->activated){
+    update_reference(ctx, setpoint, state, now);
+  }
+  else if(set_motors && ctx->use_orig_controller >= 1){
+    extrapolate_reference(ctx, now);
+  }
+  ctx->pos_error[0] = ctx->target_pos[0] - state->position.x;
+  ctx->pos_error[1] = ctx->target_pos[1] - state->position.y;
+  ctx->pos_error[2] = ctx->target_pos[2] - state->position.z;
+
+  trigger_every(ctx, ctx->controller_tick);
+  ctx->prev_set_motors = set_motors;
+  ctx->prev_pre_set_motors = pre_set_motors;
+
+  timelineMark(ctx, CONTROLLER_TIMELINE_SETPOINT);
+  if(inference_tick){
+    rl_tools_controller_context_update_state(ctx, sensors, state);
+    ctx->inference = true;
+    timelineMark(ctx, CONTROLLER_TIMELINE_OBSERVATION);
     {
       int64_t before = usecTimestamp();
-      if(use_orig_controller == 0){
-        rl_tools_control(state_input, action_output);
+      if(ctx->use_orig_controller == 0){
+        rl_tools_context_control(ctx->policy, ctx->state_input, ctx->action_output);
       }
       else{
-        action_output[0] = -0.8;
-        action_output[1] = -0.8;
-        action_output[2] = -0.8;
-        action_output[3] = -0.8;
+        ctx->action_output[0] = -0.8;
+        ctx->action_output[1] = -0.8;
+        ctx->action_output[2] = -0.8;
+        ctx->action_output[3] = -0.8;
       }
       int64_t after = usecTimestamp();
+      timelineMark(ctx, CONTROLLER_TIMELINE_POLICY);
+      ctx->inference_time = after - before;
       if (tick % (CONTROL_INTERVAL_MS * 10000) == 0){
         DEBUG_PRINT("rl_tools_control took %lldus\n", after - before);
       }
     }
+    if(ctx->use_battery_compensation){
+      battery_comp_update(&ctx->battery_comp, battery_voltage, ctx->battery_compensation_threshold);
+    }
     for(uint8_t i=0; i<4; i++){
       if (tick % (CONTROL_INTERVAL_MS * 1000) == 0){
-        DEBUG_PRINT("action_output[%d]: %f\n", i, action_output[i]);
+        DEBUG_PRINT("action_output[%d]: %f\n", i, ctx->action_output[i]);
       }
-      float a_pp = (action_output[i] + 1)/2;
+      ctx->motor_ratio[i] = 0;
+      float a_pp = (ctx->action_output[i] + 1)/2;
       float des_rpm = (MAX_RPM - MIN_RPM) * a_pp + MIN_RPM;
       float des_percentage = des_rpm / MAX_RPM;
-      motor_cmd[i] = des_percentage * UINT16_MAX;
-      if(set_motors && use_orig_controller == 0){
-        motorsSetRatio(motors[i], clip((float)motor_cmd[i] / motor_cmd_divider, 0, UINT16_MAX));
+      ctx->motor_cmd[i] = des_percentage * UINT16_MAX;
+      if(set_motors && ctx->use_orig_controller == 0){
+        // motor_cmd (and rltm) stay linear in RPM, the identified motor curve is compensated before the supply voltage
+        uint16_t motor_linear = motor_curve_linearize(ctx->motor_cmd[i]);
+        uint16_t motor_pwm = ctx->use_battery_compensation ? battery_comp_apply(&ctx->battery_comp, motor_linear) : motor_linear;
+        ctx->motor_ratio[i] = clip((float)motor_pwm / ctx->motor_cmd_divider, 0, UINT16_MAX);
+        setMotorRatio(ctx, i, ctx->motor_ratio[i]);
       }
     }
-    int64_t spare_time = CONTROL_INTERVAL_US - (now - timestamp_last_reset) ;
-    if(spare_time < 0 && (now - timestamp_last_behind_schedule_message > BEHIND_SCHEDULE_MESSAGE_MIN_INTERVAL)){
-      DEBUG_PRINT("Learned Controller is behind schedule: %lldus/%dus\n", (int64_t)(now-timestamp_last_reset), CONTROL_INTERVAL_US);
-      timestamp_last_behind_schedule_message = now;
+    int64_t spare_time = CONTROL_INTERVAL_US - (now - ctx->timestamp_last_reset) ;
+    ctx->behind_schedule = spare_time < 0;
+    if(spare_time < 0 && (now - ctx->timestamp_last_behind_schedule_message > BEHIND_SCHEDULE_MESSAGE_MIN_INTERVAL)){
+      DEBUG_PRINT("Learned Controller is behind schedule: %lldus/%dus\n", (int64_t)(now-ctx->timestamp_last_reset), CONTROL_INTERVAL_US);
+      ctx->timestamp_last_behind_schedule_message = now;
     }
-    timestamp_last_reset = usecTimestamp();
+    ctx->timestamp_last_reset = usecTimestamp();
   }
   if(!set_motors){
     if(pre_set_motors){
       for(uint8_t i=0; i<4; i++){
-        motorsSetRatio(motors[i], UINT16_MAX / motor_cmd_divider_warmup);
+        setMotorRatio(ctx, i, UINT16_MAX / ctx->motor_cmd_divider_warmup);
       }
     }
     else{
-      controllerPid(control, setpoint, sensors, state, tick);
-      powerDistribution(control, &motorThrustUncapped);
-      batteryCompensation(&motorThrustUncapped, &motorThrustBatCompUncapped);
-      powerDistributionCap(&motorThrustBatCompUncapped, &motorPwm);
-      setMotorRatios(&motorPwm);
+      classicControl(CLASSIC_PID, control, setpoint, sensors, state, tick);
+      powerDistribution(control, &ctx->motorThrustUncapped);
+      batteryCompensation(&ctx->motorThrustUncapped, &ctx->motorThrustBatCompUncapped, battery_voltage);
+      powerDistributionCap(&ctx->motorThrustBatCompUncapped, &ctx->motorPwm);
+      setMotorRatios(ctx, &ctx->motorPwm);
     }
   }
   else{
-    if(use_orig_controller >= 1){
+    if(ctx->use_orig_controller >= 1){
       setpoint->mode.x = modeAbs;
       setpoint->mode.y = modeAbs;
       setpoint->mode.z = modeAbs;
@@ -574,12 +952,12 @@ void controllerOutOfTree(control_t *control, setpoint_t *setpoint, const sensorD
       setpoint->mode.pitch = modeDisable;
       setpoint->mode.roll = modeDisable;
       setpoint->mode.quat = modeDisable;
-      setpoint->position.x = target_pos[0];
-      setpoint->position.y = target_pos[1];
-      setpoint->position.z = target_pos[2];
-      setpoint->velocity.x = target_vel[0];
-      setpoint->velocity.y = target_vel[1];
-      setpoint->velocity.z = target_vel[2];
+      setpoint->position.x = ctx->target_pos[0];
+      setpoint->position.y = ctx->target_pos[1];
+      setpoint->position.z = ctx->target_pos[2];
+      setpoint->velocity.x = ctx->target_vel[0];
+      setpoint->velocity.y = ctx->target_vel[1];
+      setpoint->velocity.z = ctx->target_vel[2];
       setpoint->acceleration.x = 0;
       setpoint->acceleration.y = 0;
       setpoint->acceleration.z = 0;
@@ -596,115 +974,283 @@ void controllerOutOfTree(control_t *control, setpoint_t *setpoint, const sensorD
       setpoint->attitudeRate.roll = 0;
 
       setpoint->timestamp = xTaskGetTickCount();
-      if(use_orig_controller == 1){
-        controllerPid(control, setpoint, sensors, state, tick);
+      if(ctx->use_orig_controller == 1){
+        classicControl(CLASSIC_PID, control, setpoint, sensors, state, tick);
       }
       else{
-        if(use_orig_controller == 2){
-          setpoint->position.x = state->position.x + clip(target_pos[0] - state->position.x, -pos_distance_limit_mellinger, pos_distance_limit_mellinger);
-          setpoint->position.y = state->position.y + clip(target_pos[1] - state->position.y, -pos_distance_limit_mellinger, pos_distance_limit_mellinger);
-          setpoint->position.z = state->position.z + clip(target_pos[2] - state->position.z, -pos_distance_limit_mellinger, pos_distance_limit_mellinger);
-          setpoint->velocity.x = state->velocity.x + clip(target_vel[0] - state->velocity.x, -vel_distance_limit_mellinger, vel_distance_limit_mellinger);
-          setpoint->velocity.y = state->velocity.y + clip(target_vel[1] - state->velocity.y, -vel_distance_limit_mellinger, vel_distance_limit_mellinger);
-          setpoint->velocity.z = state->velocity.z + clip(target_vel[2] - state->velocity.z, -vel_distance_limit_mellinger, vel_distance_limit_mellinger);
-          controllerMellingerFirmware(control, setpoint, sensors, state, tick);
+        if(ctx->use_orig_controller == 2){
+          setpoint->position.x = state->position.x + clip(ctx->target_pos[0] - state->position.x, -ctx->pos_distance_limit_mellinger, ctx->pos_distance_limit_mellinger);
+          setpoint->position.y = state->position.y + clip(ctx->target_pos[1] - state->position.y, -ctx->pos_distance_limit_mellinger, ctx->pos_distance_limit_mellinger);
+          setpoint->position.z = state->position.z + clip(ctx->target_pos[2] - state->position.z, -ctx->pos_distance_limit_mellinger, ctx->pos_distance_limit_mellinger);
+          setpoint->velocity.x = state->velocity.x + clip(ctx->target_vel[0] - state->velocity.x, -ctx->vel_distance_limit_mellinger, ctx->vel_distance_limit_mellinger);
+          setpoint->velocity.y = state->velocity.y + clip(ctx->target_vel[1] - state->velocity.y, -ctx->vel_distance_limit_mellinger, ctx->vel_distance_limit_mellinger);
+          setpoint->velocity.z = state->velocity.z + clip(ctx->target_vel[2] - state->velocity.z, -ctx->vel_distance_limit_mellinger, ctx->vel_distance_limit_mellinger);
+          classicControl(CLASSIC_MELLINGER, control, setpoint, sensors, state, tick);
         }
         else{
-          if(use_orig_controller == 3){
-            controllerINDI(control, setpoint, sensors, state, tick);
+          if(ctx->use_orig_controller == 3){
+            classicControl(CLASSIC_INDI, control, setpoint, sensors, state, tick);
           }
           else{
-            setpoint->position.x = state->position.x + clip(target_pos[0] - state->position.x, -pos_distance_limit_bresciani, pos_distance_limit_bresciani);
-            setpoint->position.y = state->position.y + clip(target_pos[1] - state->position.y, -pos_distance_limit_bresciani, pos_distance_limit_bresciani);
-            setpoint->position.z = state->position.z + clip(target_pos[2] - state->position.z, -pos_distance_limit_bresciani, pos_distance_limit_bresciani);
-            setpoint->velocity.x = state->velocity.x + clip(target_vel[0] - state->velocity.x, -vel_distance_limit_bresciani, vel_distance_limit_bresciani);
-            setpoint->velocity.y = state->velocity.y + clip(target_vel[1] - state->velocity.y, -vel_distance_limit_bresciani, vel_distance_limit_bresciani);
-            setpoint->velocity.z = state->velocity.z + clip(target_vel[2] - state->velocity.z, -vel_distance_limit_bresciani, vel_distance_limit_bresciani);
-            controllerBrescianini(control, setpoint, sensors, state, tick);
+            setpoint->position.x = state->position.x + clip(ctx->target_pos[0] - state->position.x, -ctx->pos_distance_limit_bresciani, ctx->pos_distance_limit_bresciani);
+            setpoint->position.y = state->position.y + clip(ctx->target_pos[1] - state->position.y, -ctx->pos_distance_limit_bresciani, ctx->pos_distance_limit_bresciani);
+            setpoint->position.z = state->position.z + clip(ctx->target_pos[2] - state->position.z, -ctx->pos_distance_limit_bresciani, ctx->pos_distance_limit_bresciani);
+            setpoint->velocity.x = state->velocity.x + clip(ctx->target_vel[0] - state->velocity.x, -ctx->vel_distance_limit_bresciani, ctx->vel_distance_limit_bresciani);
+            setpoint->velocity.y = state->velocity.y + clip(ctx->target_vel[1] - state->velocity.y, -ctx->vel_distance_limit_bresciani, ctx->vel_distance_limit_bresciani);
+            setpoint->velocity.z = state->velocity.z + clip(ctx->target_vel[2] - state->velocity.z, -ctx->vel_distance_limit_bresciani, ctx->vel_distance_limit_bresciani);
+            classicControl(CLASSIC_BRESCIANINI, control, setpoint, sensors, state, tick);
           }
         }
       }
-      powerDistribution(control, &motorThrustUncapped);
-      batteryCompensation(&motorThrustUncapped, &motorThrustBatCompUncapped);
-      powerDistributionCap(&motorThrustBatCompUncapped, &motorPwm);
-      setMotorRatios(&motorPwm);
+      powerDistribution(control, &ctx->motorThrustUncapped);
+      batteryCompensation(&ctx->motorThrustUncapped, &ctx->motorThrustBatCompUncapped, battery_voltage);
+      powerDistributionCap(&ctx->motorThrustBatCompUncapped, &ctx->motorPwm);
+      setMotorRatios(ctx, &ctx->motorPwm);
+    }
+  }
+  timelineMark(ctx, CONTROLLER_TIMELINE_CONTROL);
+  ctx->controller_tick++;
+}
+
+static inline void save_timestamp(uint32_t* out, uint64_t value){
+  out[0] = (uint32_t)value;
+  out[1] = (uint32_t)(value >> 32);
+}
+static inline uint64_t restore_timestamp(const uint32_t* in){
+  return (uint64_t)in[1] << 32 | in[0];
+}
+
+static void save_snapshot(const rl_tools_controller_context_t* ctx, controller_trace_snapshot_t* snapshot){
+  save_timestamp(snapshot->controller_tick, ctx->controller_tick);
+  save_timestamp(snapshot->timestamp_last_reset, ctx->timestamp_last_reset);
+  save_timestamp(snapshot->timestamp_last_behind_schedule_message, ctx->timestamp_last_behind_schedule_message);
+  save_timestamp(snapshot->timestamp_last_control_invocation, ctx->timestamp_last_control_invocation);
+  save_timestamp(snapshot->timestamp_last_control_packet_received, ctx->timestamp_last_control_packet_received);
+  save_timestamp(snapshot->timestamp_last_control_packet_received_hover, ctx->timestamp_last_control_packet_received_hover);
+  save_timestamp(snapshot->timestamp_controller_activation, ctx->timestamp_controller_activation);
+  save_timestamp(snapshot->timestamp_pre_set_motors, ctx->timestamp_pre_set_motors);
+  save_timestamp(snapshot->waypoint_navigation_timestamp_start, ctx->waypoint_navigation_timestamp_start);
+  save_timestamp(snapshot->figure_eight_last_invocation, ctx->figure_eight_last_invocation);
+  snapshot->control_invocation_interval = ctx->control_invocation_interval;
+  for(int i = 0; i < 3; i++){
+    snapshot->target_pos[i] = ctx->target_pos[i];
+    snapshot->target_vel[i] = ctx->target_vel[i];
+    snapshot->origin[i] = ctx->origin[i];
+  }
+  snapshot->figure_eight_progress = ctx->figure_eight_progress;
+  for(int i = 0; i < 4; i++){
+    snapshot->action_output[i] = ctx->action_output[i];
+    snapshot->motor_cmd[i] = ctx->motor_cmd[i];
+    snapshot->motor_ratio[i] = motorsGetRatio(motors[i]);
+  }
+  snapshot->battery_compensation_voltage = ctx->battery_comp.voltage;
+  snapshot->waypoint_navigation_dynamic_current_waypoint = ctx->waypoint_navigation_dynamic_current_waypoint;
+  snapshot->prev_set_motors = ctx->prev_set_motors;
+  snapshot->prev_pre_set_motors = ctx->prev_pre_set_motors;
+  snapshot->reserved = 0;
+  snapshot->adapter_state_size = rl_tools_context_save_state(ctx->policy, snapshot->adapter_state, CONTROLLER_TRACE_ADAPTER_STATE_SIZE);
+}
+
+bool rl_tools_controller_context_restore_snapshot(rl_tools_controller_context_t* ctx, const controller_trace_snapshot_t* snapshot){
+  if(!rl_tools_context_restore_state(ctx->policy, snapshot->adapter_state, snapshot->adapter_state_size)){
+    return false;
+  }
+  ctx->controller_tick = restore_timestamp(snapshot->controller_tick);
+  ctx->timestamp_last_reset = restore_timestamp(snapshot->timestamp_last_reset);
+  ctx->timestamp_last_behind_schedule_message = restore_timestamp(snapshot->timestamp_last_behind_schedule_message);
+  ctx->timestamp_last_control_invocation = restore_timestamp(snapshot->timestamp_last_control_invocation);
+  ctx->timestamp_last_control_packet_received = restore_timestamp(snapshot->timestamp_last_control_packet_received);
+  ctx->timestamp_last_control_packet_received_hover = restore_timestamp(snapshot->timestamp_last_control_packet_received_hover);
+  ctx->timestamp_controller_activation = restore_timestamp(snapshot->timestamp_controller_activation);
+  ctx->timestamp_pre_set_motors = restore_timestamp(snapshot->timestamp_pre_set_motors);
+  ctx->waypoint_navigation_timestamp_start = restore_timestamp(snapshot->waypoint_navigation_timestamp_start);
+  ctx->figure_eight_last_invocation = restore_timestamp(snapshot->figure_eight_last_invocation);
+  ctx->control_invocation_interval = snapshot->control_invocation_interval;
+  for(int i = 0; i < 3; i++){
+    ctx->target_pos[i] = snapshot->target_pos[i];
+    ctx->target_vel[i] = snapshot->target_vel[i];
+    ctx->origin[i] = snapshot->origin[i];
+  }
+  ctx->figure_eight_progress = snapshot->figure_eight_progress;
+  for(int i = 0; i < 4; i++){
+    ctx->action_output[i] = snapshot->action_output[i];
+    ctx->motor_cmd[i] = snapshot->motor_cmd[i];
+  }
+  battery_comp_update(&ctx->battery_comp, snapshot->battery_compensation_voltage, 0);
+  ctx->waypoint_navigation_dynamic_current_waypoint = snapshot->waypoint_navigation_dynamic_current_waypoint;
+  ctx->prev_set_motors = snapshot->prev_set_motors;
+  ctx->prev_pre_set_motors = snapshot->prev_pre_set_motors;
+  return true;
+}
+bool rl_tools_controller_restore_snapshot(const controller_trace_snapshot_t* snapshot){
+  return rl_tools_controller_context_restore_snapshot(&controller, snapshot);
+}
+
+void controllerOutOfTree(control_t *control, setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick) {
+  controller_timeline_begin(tick, usecTimestamp());
+  kernelsUpdate();
+  swarmPacketsUpdate();
+  uint64_t now = usecTimestamp();
+  controller_trace_snapshot_t* snapshot = controller_trace_recorder_begin(setpoint, sensors, state, tick, now, controller.timestamp_last_control_packet_received);
+  if(snapshot != 0){
+    save_snapshot(&controller, snapshot);
+  }
+  watchdogReset();
+  controller_timeline_mark(CONTROLLER_TIMELINE_PROLOGUE);
+  rl_tools_controller_context_step(&controller, control, setpoint, sensors, state, tick, now, pmGetBatteryVoltage());
+  if(controller.activated){
+    flight_metrics_reset();
+  }
+  if(controller.motor_output_set){
+    for(uint8_t i=0; i<4; i++){
+      motorsSetRatio(motors[i], controller.motor_output[i]);
     }
   }
-  controller_tick++;
+  controller_timeline_mark(CONTROLLER_TIMELINE_MOTORS);
+  if(controller.inference){
+    bool set_motors = controller.log_set_motors == 1;
+    if(set_motors && controller.use_orig_controller == 0){
+      flight_metrics_update(controller.pos_error, controller.action_output, controller.motor_ratio, CONTROL_INTERVAL_MS / 1000.0f, controller.inference_time);
+    }
+    packed_log_update(controller.state_input, controller.action_output, controller.motor_cmd, set_motors ? PACKED_LOG_FLAG_SET_MOTORS : 0);
+  }
+  controller_trace_recorder_end(controller.action_output, controller.motor_cmd);
+  uint32_t timeline_flags = (controller.inference ? CONTROLLER_TIMELINE_FLAG_INFERENCE : 0) | (controller.log_set_motors ? CONTROLLER_TIMELINE_FLAG_SET_MOTORS : 0);
+  controller_timeline_end(timeline_flags | (controller.behind_schedule ? CONTROLLER_TIMELINE_FLAG_BEHIND_SCHEDULE : 0));
 }
 
 
 
 PARAM_GROUP_START(rlt)
-PARAM_ADD(PARAM_UINT8, trigger, &trigger_mode)
-PARAM_ADD(PARAM_UINT8, motor_warmup, &use_pre_set_warmup)
-PARAM_ADD(PARAM_FLOAT, motor_div, &motor_cmd_divider)
-PARAM_ADD(PARAM_FLOAT, motor_div_wu, &motor_cmd_divider_warmup)
-PARAM_ADD(PARAM_FLOAT, target_z, &target_height)
-PARAM_ADD(PARAM_FLOAT, target_z_fe, &target_height_figure_eight)
-PARAM_ADD(PARAM_UINT8, smo, &set_motors_overwrite)
-PARAM_ADD(PARAM_UINT8, ht, &hand_test)
-PARAM_ADD(PARAM_UINT8, wn, &mode)
-PARAM_ADD(PARAM_FLOAT, ts, &waypoint_navigation_trajectory_scale)
-PARAM_ADD(PARAM_FLOAT, wpt, &waypoint_navigation_dynamic_threshold)
-PARAM_ADD(PARAM_FLOAT, wni, &waypoint_navigation_point_duration)
-PARAM_ADD(PARAM_FLOAT, fewt, &figure_eight_warmup_time)
-PARAM_ADD(PARAM_FLOAT, fei,  &figure_eight_interval)
-PARAM_ADD(PARAM_FLOAT, fes,  &figure_eight_scale)
-PARAM_ADD(PARAM_FLOAT, pdlp,  &pos_distance_limit_position)
-PARAM_ADD(PARAM_FLOAT, pdlfe, &pos_distance_limit_figure_eight)
-PARAM_ADD(PARAM_FLOAT, vdlp,  &vel_distance_limit_position)
-PARAM_ADD(PARAM_FLOAT, vdlfe, &vel_distance_limit_figure_eight)
-PARAM_ADD(PARAM_FLOAT, pdlm,  &pos_distance_limit_mellinger)
-PARAM_ADD(PARAM_FLOAT, vdlm,  &vel_distance_limit_mellinger)
-PARAM_ADD(PARAM_UINT8, orig, &use_orig_controller)
-PARAM_ADD(PARAM_FLOAT, vcmdm, &velocity_cmd_multiplier)
-PARAM_ADD(PARAM_FLOAT, vcmdp, &velocity_cmd_p_term)
+PARAM_ADD(PARAM_UINT8, trigger, &controller.trigger_mode)
+PARAM_ADD(PARAM_UINT8, motor_warmup, &controller.use_pre_set_warmup)
+PARAM_ADD(PARAM_FLOAT, motor_div, &controller.motor_cmd_divider)
+PARAM_ADD(PARAM_FLOAT, motor_div_wu, &controller.motor_cmd_divider_warmup)
+PARAM_ADD(PARAM_FLOAT, target_z, &controller.target_height)
+PARAM_ADD(PARAM_FLOAT, target_z_fe, &controller.target_height_figure_eight)
+PARAM_ADD(PARAM_UINT8, smo, &controller.set_motors_overwrite)
+PARAM_ADD(PARAM_UINT8, ht, &controller.hand_test)
+PARAM_ADD(PARAM_UINT8, wn, &controller.mode)
+PARAM_ADD(PARAM_FLOAT, ts, &controller.waypoint_navigation_trajectory_scale)
+PARAM_ADD(PARAM_FLOAT, wpt, &controller.waypoint_navigation_dynamic_threshold)
+PARAM_ADD(PARAM_FLOAT, wni, &controller.waypoint_navigation_point_duration)
+PARAM_ADD(PARAM_FLOAT, fewt, &controller.figure_eight_warmup_time)
+PARAM_ADD(PARAM_FLOAT, fei,  &controller.figure_eight_interval)
+PARAM_ADD(PARAM_FLOAT, fes,  &controller.figure_eight_scale)
+PARAM_ADD(PARAM_FLOAT, pdlp,  &controller.pos_distance_limit_position)
+PARAM_ADD(PARAM_FLOAT, pdlfe, &controller.pos_distance_limit_figure_eight)
+PARAM_ADD(PARAM_FLOAT, vdlp,  &controller.vel_distance_limit_position)
+PARAM_ADD(PARAM_FLOAT, vdlfe, &controller.vel_distance_limit_figure_eight)
+PARAM_ADD(PARAM_FLOAT, pdlm,  &controller.pos_distance_limit_mellinger)
+PARAM_ADD(PARAM_FLOAT, vdlm,  &controller.vel_distance_limit_mellinger)
+PARAM_ADD(PARAM_UINT8, orig, &controller.use_orig_controller)
+PARAM_ADD(PARAM_FLOAT, vcmdm, &controller.velocity_cmd_multiplier)
+PARAM_ADD(PARAM_FLOAT, vcmdp, &controller.velocity_cmd_p_term)
+PARAM_ADD(PARAM_UINT8, bc, &controller.use_battery_compensation)
+PARAM_ADD(PARAM_FLOAT, bcth, &controller.battery_compensation_threshold)
 PARAM_GROUP_STOP(rlt)
 
+PARAM_GROUP_START(rltk)
+PARAM_ADD(PARAM_UINT8 | PARAM_PERSISTENT, l0, &kernel_selection[0])
+PARAM_ADD(PARAM_UINT8 | PARAM_PERSISTENT, l1, &kernel_selection[1])
+PARAM_ADD(PARAM_UINT8 | PARAM_PERSISTENT, l2, &kernel_selection[2])
+PARAM_ADD(PARAM_UINT8, tune, &kernel_tune)
+PARAM_GROUP_STOP(rltk)
+
+LOG_GROUP_START(rltk)
+LOG_ADD(LOG_FLOAT, us, &kernel_time)
+LOG_ADD(LOG_FLOAT, us_rlt, &kernel_time_rl_tools)
+LOG_ADD(LOG_UINT32, stack, &kernel_tune_stack)
+LOG_GROUP_STOP(rltk)
+
+LOG_GROUP_START(rltboot)
+LOG_ADD(LOG_UINT8, st, &self_test_state)
+LOG_ADD(LOG_UINT8, blk, &controller.self_test_blocked)
+LOG_ADD(LOG_UINT32, init, &boot_profile.init)
+LOG_ADD(LOG_UINT32, rlt, &boot_profile.rl_tools)
+LOG_ADD(LOG_UINT32, test, &boot_profile.self_test)
+LOG_ADD(LOG_UINT32, ready, &boot_profile.ready)
+LOG_ADD(LOG_UINT32, pid, &boot_profile.classic[CLASSIC_PID])
+LOG_ADD(LOG_UINT32, mel, &boot_profile.classic[CLASSIC_MELLINGER])
+LOG_ADD(LOG_UINT32, indi, &boot_profile.classic[CLASSIC_INDI])
+LOG_ADD(LOG_UINT32, bres, &boot_profile.classic[CLASSIC_BRESCIANINI])
+LOG_ADD(LOG_UINT32, stack, &boot_profile.self_test_stack)
+LOG_GROUP_STOP(rltboot)
+
 
 LOG_GROUP_START(rltm)
-LOG_ADD(LOG_UINT16, m1, &motor_cmd[0])
-LOG_ADD(LOG_UINT16, m2, &motor_cmd[1])
-LOG_ADD(LOG_UINT16, m3, &motor_cmd[2])
-LOG_ADD(LOG_UINT16, m4, &motor_cmd[3])
+LOG_ADD(LOG_UINT16, m1, &controller.motor_cmd[0])
+LOG_ADD(LOG_UINT16, m2, &controller.motor_cmd[1])
+LOG_ADD(LOG_UINT16, m3, &controller.motor_cmd[2])
+LOG_ADD(LOG_UINT16, m4, &controller.motor_cmd[3])
 LOG_GROUP_STOP(rltm)
 
+PARAM_GROUP_START(rltsw)
+PARAM_ADD(PARAM_UINT8, id, &controller.swarm_id)
+PARAM_GROUP_STOP(rltsw)
+
+LOG_GROUP_START(rltsw)
+LOG_ADD(LOG_UINT8, frame, &controller.swarm_frame)
+LOG_ADD(LOG_UINT32, lost, &controller.swarm_frames_lost)
+LOG_GROUP_STOP(rltsw)
+
+PARAM_GROUP_START(rltjb)
+PARAM_ADD(PARAM_UINT8, mode, &controller.jitter_buffer_mode)
+PARAM_ADD(PARAM_FLOAT, lat, &controller.jitter_buffer_latency)
+PARAM_GROUP_STOP(rltjb)
+
+LOG_GROUP_START(rltjb)
+LOG_ADD(LOG_UINT8, depth, &controller.jitter_buffer.depth)
+LOG_ADD(LOG_FLOAT, dmean, &controller.jitter_buffer.depth_mean)
+LOG_ADD(LOG_UINT32, under, &controller.jitter_buffer.underruns)
+LOG_ADD(LOG_UINT32, over, &controller.jitter_buffer.overflows)
+LOG_GROUP_STOP(rltjb)
+
+LOG_GROUP_START(rltbc)
+LOG_ADD(LOG_FLOAT, v, &controller.battery_comp.voltage)
+LOG_GROUP_STOP(rltbc)
+
 LOG_GROUP_START(rlta)
-LOG_ADD(LOG_FLOAT, a1, &action_output[0])
-LOG_ADD(LOG_FLOAT, a2, &action_output[1])
-LOG_ADD(LOG_FLOAT, a3, &action_output[2])
-LOG_ADD(LOG_FLOAT, a4, &action_output[3])
+LOG_ADD(LOG_FLOAT, a1, &controller.action_output[0])
+LOG_ADD(LOG_FLOAT, a2, &controller.action_output[1])
+LOG_ADD(LOG_FLOAT, a3, &controller.action_output[2])
+LOG_ADD(LOG_FLOAT, a4, &controller.action_output[3])
 LOG_GROUP_STOP(rlta)
 
 LOG_GROUP_START(rltrp)
-LOG_ADD(LOG_FLOAT, x, &relative_pos[0])
-LOG_ADD(LOG_FLOAT, y, &relative_pos[1])
-LOG_ADD(LOG_FLOAT, z, &relative_pos[2])
-LOG_ADD(LOG_UINT8, sm, &log_set_motors)
+LOG_ADD(LOG_FLOAT, x, &controller.relative_pos[0])
+LOG_ADD(LOG_FLOAT, y, &controller.relative_pos[1])
+LOG_ADD(LOG_FLOAT, z, &controller.relative_pos[2])
+LOG_ADD(LOG_UINT8, sm, &controller.log_set_motors)
 LOG_GROUP_STOP(rltrp)
 
 LOG_GROUP_START(rlttp)
-LOG_ADD(LOG_FLOAT, x, &target_pos[0])
-LOG_ADD(LOG_FLOAT, y, &target_pos[1])
-LOG_ADD(LOG_FLOAT, z, &target_pos[2])
+LOG_ADD(LOG_FLOAT, x, &controller.target_pos[0])
+LOG_ADD(LOG_FLOAT, y, &controller.target_pos[1])
+LOG_ADD(LOG_FLOAT, z, &controller.target_pos[2])
 LOG_GROUP_STOP(rltrp)
 
+LOG_GROUP_START(rlttv)
+LOG_ADD(LOG_FLOAT, x, &controller.target_vel[0])
+LOG_ADD(LOG_FLOAT, y, &controller.target_vel[1])
+LOG_ADD(LOG_FLOAT, z, &controller.target_vel[2])
+LOG_GROUP_STOP(rlttv)
+
 LOG_GROUP_START(rltte)
-LOG_ADD(LOG_FLOAT, x, &pos_error[0])
-LOG_ADD(LOG_FLOAT, y, &pos_error[1])
-LOG_ADD(LOG_FLOAT, z, &pos_error[2])
+LOG_ADD(LOG_FLOAT, x, &controller.pos_error[0])
+LOG_ADD(LOG_FLOAT, y, &controller.pos_error[1])
+LOG_ADD(LOG_FLOAT, z, &controller.pos_error[2])
 LOG_GROUP_STOP(rltre)
 
 LOG_GROUP_START(quat)
-LOG_ADD(LOG_FLOAT, w, &state_input[3])
-LOG_ADD(LOG_FLOAT, x, &state_input[4])
-LOG_ADD(LOG_FLOAT, y, &state_input[5])
-LOG_ADD(LOG_FLOAT, z, &state_input[6])
+LOG_ADD(LOG_FLOAT, w, &controller.state_input[3])
+LOG_ADD(LOG_FLOAT, x, &controller.state_input[4])
+LOG_ADD(LOG_FLOAT, y, &controller.state_input[5])
+LOG_ADD(LOG_FLOAT, z, &controller.state_input[6])
 LOG_GROUP_STOP(quat)
 
 LOG_GROUP_START(gyro)
-LOG_ADD(LOG_FLOAT, x, &state_input[10])
-LOG_ADD(LOG_FLOAT, y, &state_input[11])
-LOG_ADD(LOG_FLOAT, z, &state_input[12])
+LOG_ADD(LOG_FLOAT, x, &controller.state_input[10])
+LOG_ADD(LOG_FLOAT, y, &controller.state_input[11])
+LOG_ADD(LOG_FLOAT, z, &controller.state_input[12])
 LOG_GROUP_STOP(gyro)
\ No newline at end of file
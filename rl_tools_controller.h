@@ -1,7 +1,157 @@
 #ifndef __RL_TOOLS_CONTROLLER_H__
 #define __RL_TOOLS_CONTROLLER_H__
 
+#include <stdint.h>
+#include <stdbool.h>
+#include "stabilizer_types.h"
+#include "rl_tools_adapter.h"
+#include "battery_comp.h"
+#include "controller_trace.h"
+#include "swarm_setpoint.h"
+#include "jitter_buffer.h"
+
+#define RL_TOOLS_CONTROLLER_NUM_MOTORS 4
+#define RL_TOOLS_CONTROLLER_INTERVAL_MS 2 // stabilizer ticks (ms) per policy inference
+
+typedef enum ControllerState{
+  STATE_RESET,
+  STATE_FORWARD,
+  STATE_FINISHED
+} ControllerState;
+
+// Complete state of one learned controller instance (one vehicle). The firmware entry points (controllerOutOfTree*,
+// rl_tools_controller_packet_received) run a single global context whose fields are the rlt* PARAM/LOG variables.
+// Further contexts can be stepped independently (e.g. one per simulated vehicle): time and battery voltage are inputs,
+// the motor commands are outputs. Different contexts can be stepped concurrently (after controllerOutOfTreeInit), each
+// from one thread at a time. Shared between contexts are the read-only policy weights and the classic fallback
+// controllers (PID, Mellinger, INDI, Brescianini): firmware singletons, serialized by a mutex, whose integrators and
+// filters carry over between the contexts that use them.
+typedef struct {
+  ControllerState controller_state;
+  rl_tools_context_t* policy;
+
+  // Counters
+  uint64_t controller_tick; // Number of control function invocations
+  uint64_t forward_tick; // Number of forward passes
+
+  // Timestamps
+  uint64_t timestamp_last_reset;
+  uint64_t timestamp_last_behind_schedule_message;
+  uint64_t timestamp_last_control_invocation;
+  uint64_t timestamp_last_control_packet_received;
+  uint64_t timestamp_last_control_packet_received_hover;
+  uint64_t timestamp_controller_activation;
+  uint64_t timestamp_pre_set_motors;
+  uint64_t timestamp_reference; // last reference update or extrapolation
+
+  // Logging variables
+  float control_invocation_interval;
+
+  // Control variables: input
+  float target_pos[3];
+  float target_vel[3];
+  float pos_error[3];
+  float relative_pos[3];
+  float origin[3];
+
+  float pos_distance_limit_position;
+  float vel_distance_limit_position;
+  float pos_distance_limit_figure_eight;
+  float vel_distance_limit_figure_eight;
+  float pos_distance_limit_mellinger;
+  float vel_distance_limit_mellinger;
+  float pos_distance_limit_bresciani;
+  float vel_distance_limit_bresciani;
+  uint8_t log_set_motors;
+  float velocity_cmd_multiplier, velocity_cmd_p_term;
+  uint8_t use_battery_compensation;
+  float battery_compensation_threshold;
+
+  uint8_t mode;
+  uint8_t trigger_mode;
+  float target_height;
+
+  uint64_t waypoint_navigation_timestamp_start;
+  uint8_t  waypoint_navigation_dynamic_current_waypoint;
+  float    waypoint_navigation_dynamic_threshold;
+  float    waypoint_navigation_point_duration;
+  float    waypoint_navigation_trajectory_scale;
+
+  float    figure_eight_interval;
+  float    figure_eight_warmup_time;
+  float    figure_eight_scale;
+  float    figure_eight_progress;
+  uint64_t figure_eight_last_invocation;
+  float    target_height_figure_eight;
+
+  float state_input[13];
+  float action_output[RL_TOOLS_CONTROLLER_NUM_MOTORS];
+
+  uint8_t set_motors_overwrite;
+  uint16_t motor_cmd[RL_TOOLS_CONTROLLER_NUM_MOTORS];
+  float motor_cmd_divider, motor_cmd_divider_warmup;
+  bool prev_set_motors, prev_pre_set_motors;
+  uint8_t use_pre_set_warmup;
+  battery_comp_t battery_comp;
+
+  motors_thrust_uncapped_t motorThrustUncapped;
+  motors_thrust_uncapped_t motorThrustBatCompUncapped;
+  motors_thrust_pwm_t motorPwm;
+
+  setpoint_t last_setpoint;
+
+  // Broadcast swarm setpoint (swarm_setpoint.h), the NORMAL-mode target while fresh
+  uint8_t swarm_id;
+  uint8_t swarm_frame; // frame id of swarm_target
+  uint32_t swarm_frames_lost; // frames skipped between two received targets
+  uint64_t timestamp_swarm_target;
+  swarm_setpoint_target_t swarm_target;
+
+  // NORMAL-mode position setpoints (commander or swarm) played back through a jitter buffer unless jitter_buffer_mode
+  // is JITTER_BUFFER_OFF
+  jitter_buffer_t jitter_buffer;
+  uint8_t jitter_buffer_mode;
+  float jitter_buffer_latency; // [ms]
+  uint32_t jitter_buffer_setpoint_timestamp; // setpoint_t.timestamp of the last commander setpoint pushed
+
+  uint8_t hand_test; // 0 = off; 1 = setpoint; 2 = angular velocity rejection; 3 = angular velocity rejection + orientation rejection;
+  uint8_t use_orig_controller;
+
+  // Outputs of the last step
+  bool activated; // the learned controller took over in this step
+  bool inference; // the policy ran in this step (state_input, action_output and motor_cmd are new)
+  bool behind_schedule; // more than CONTROL_INTERVAL_US since the previous inference
+  bool self_test_blocked; // triggered with rlt.orig = 0, but the policy self-test has not passed (rltboot.blk)
+  int64_t inference_time;
+  uint16_t motor_ratio[RL_TOOLS_CONTROLLER_NUM_MOTORS]; // learned-policy motor ratios (0 while not applied)
+  bool motor_output_set; // motor_output has to be applied, otherwise the motors keep their ratio
+  uint16_t motor_output[RL_TOOLS_CONTROLLER_NUM_MOTORS]; // M1..M4
+} rl_tools_controller_context_t;
+
 void rl_tools_controller_packet_received();
 void rl_tools_controller_hover_packet_received();
+// Broadcast swarm setpoint packet (swarm_setpoint.h, starting with the type byte) from a single receiving task
+// (swarm_app.c): queued with its reception time and handed to the context at the next controllerOutOfTree
+void rl_tools_controller_swarm_packet_received(const uint8_t* data, uint8_t size);
+// The context driven by controllerOutOfTree (read-only, e.g. for host-side telemetry)
+const rl_tools_controller_context_t* rl_tools_controller_context_global(void);
+// Inverse of the action -> motor_cmd mapping (up to the uint16 rounding), e.g. actions from logged rltm.* values
+float rl_tools_controller_action_from_motor_cmd(uint16_t motor_cmd);
+
+// Resets the context to the defaults of controllerOutOfTreeInit, policy is an initialized rl_tools_context_t
+void rl_tools_controller_context_init(rl_tools_controller_context_t* ctx, rl_tools_context_t* policy, uint64_t now);
+void rl_tools_controller_context_packet_received(rl_tools_controller_context_t* ctx, uint64_t now);
+// Takes the slot of ctx->swarm_id from a broadcast swarm setpoint packet unless it belongs to an older frame than the
+// current target. A new target also counts as a trigger packet. Returns true if the target was updated.
+bool rl_tools_controller_context_swarm_packet_received(rl_tools_controller_context_t* ctx, const uint8_t* data, uint8_t size, uint64_t now);
+// state_input of an inference step: position/velocity relative to target_pos/target_vel (clipped to the limits of the
+// mode), attitude, body rates in rad/s, subject to hand_test
+void rl_tools_controller_context_update_state(rl_tools_controller_context_t* ctx, const sensorData_t* sensors, const state_t* state);
+// One controllerOutOfTree invocation at time now [us]
+void rl_tools_controller_context_step(rl_tools_controller_context_t* ctx, control_t *control, setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick, uint64_t now, float battery_voltage);
+// Continues from a recorded state (controller_trace_recorder_begin); false if it was taken with another checkpoint.
+// The motor ratios held by the motor driver are not part of the context (snapshot->motor_ratio).
+bool rl_tools_controller_context_restore_snapshot(rl_tools_controller_context_t* ctx, const controller_trace_snapshot_t* snapshot);
+bool rl_tools_controller_restore_snapshot(const controller_trace_snapshot_t* snapshot); // global context
 
-#endif
\ No newline at end of file
+#endif
@@ -15,6 +15,8 @@ from cflib.utils import uri_helper
 from cflib.crtp.crtpstack import CRTPPacket, CRTPPort
 from cflib.crazyflie.commander import META_COMMAND_CHANNEL, SET_SETPOINT_CHANNEL, TYPE_HOVER
 
+from packedlog import PackedLog, FIELDS as PACKED_LOG_FIELDS
+
 # Only output errors from the logging framework
 logging.basicConfig(level=logging.ERROR)
 
@@ -80,6 +82,9 @@ class LoggingExample:
             self._lg_stab.add_variable('motor.m2', 'uint16_t')
             self._lg_stab.add_variable('motor.m3', 'uint16_t')
             self._lg_stab.add_variable('motor.m4', 'uint16_t')
+        elif self._config == 'packed':
+            # Controller internals are streamed separately (two packed groups, see packedlog.py)
+            self._start_packed_log()
         else:
             self._lg_stab.add_variable('stabilizer.roll', 'float')
             self._lg_stab.add_variable('stabilizer.pitch', 'float')
@@ -97,6 +102,17 @@ class LoggingExample:
         except AttributeError:
             print('Could not add Stabilizer log config, bad configuration.')
 
+    def _start_packed_log(self):
+        self._packed_log_file = self._log_file_path.with_name(self._log_file_path.stem + '_packed.csv').open('w', newline='')
+        self._packed_csv_writer = csv.writer(self._packed_log_file)
+        self._packed_csv_writer.writerow(['timestamp (ms)'] + PACKED_LOG_FIELDS)
+        self._packed_log = PackedLog(self._cf, self._log_period, self._packed_log_data)
+        self._packed_log.start()
+
+    def _packed_log_data(self, timestamp, snapshot):
+        if self._log_queue:
+            self._log_queue.put((self._packed_csv_writer, [timestamp] + [snapshot[name] for name in PACKED_LOG_FIELDS]))
+
     def exit(self):
         # Make shutdown idempotent
         if self._killed.is_set():
@@ -113,6 +129,8 @@ class LoggingExample:
         try:
             if hasattr(self, '_lg_stab'):
                 self._lg_stab.stop()
+            if hasattr(self, '_packed_log'):
+                self._packed_log.stop()
         except Exception:
             pass
         try:
@@ -142,6 +160,9 @@ class LoggingExample:
                     pass
                 self._log_file = None
                 self._csv_writer = None
+        if getattr(self, '_packed_log_file', None):
+            self._packed_log_file.close()
+            self._packed_log_file = None
         self._log_queue = None
 
     def _start_log_thread(self):
@@ -162,7 +183,11 @@ class LoggingExample:
                 continue
             if item is None:
                 break
-            if self._csv_writer:
+            if isinstance(item, tuple):
+                writer, row = item
+                writer.writerow(row)
+                self._packed_log_file.flush()
+            elif self._csv_writer:
                 self._csv_writer.writerow(item)
                 self._log_file.flush()
         # Drain any remaining items to unblock producers
@@ -282,6 +307,8 @@ class LoggingExample:
         try:
             if hasattr(self, '_lg_stab'):
                 self._lg_stab.stop()
+            if hasattr(self, '_packed_log'):
+                self._packed_log.stop()
             self._cf.close_link()
             print("Link closed")
         except Exception as e:
@@ -319,7 +346,7 @@ if __name__ == '__main__':
     parser.add_argument('--trajectory-interval', default=5.5, type=float)
     parser.add_argument('--transition-timeout', default=3, type=float)
     parser.add_argument('--run-name', default='test', type=str)
-    parser.add_argument('--config', default='velocity', choices=['velocity', 'attitude', 'motors'])
+    parser.add_argument('--config', default='velocity', choices=['velocity', 'attitude', 'motors', 'packed'])
     parser.add_argument('--timeout', default=None, type=float)
     parser.add_argument('--period', default=10, type=int)
     args = parser.parse_args()
@@ -327,6 +354,9 @@ if __name__ == '__main__':
     uri = uri_helper.uri_from_env(default=default_uri)
 
     cflib.crtp.init_drivers()
+    if uri.startswith('sim://'):
+        import simlink
+        simlink.register_driver()
 
     le = LoggingExample(uri, args.run_name, args.config, args.timeout, args.period, args.mode)
 
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""Reads the transition datasets written by sim/build/dataset (sim/dataset.h) as numpy memory maps.
+
+    import dataset
+    header, records = dataset.load('dataset-00000.rltd')
+    records['observation'], records['action'], records['next_observation']  # (count, dim) float32, not copied
+    policy = records[(records['flags'] & dataset.FLAG_POLICY) != 0]
+
+load_shards('dataset') opens all shards of a prefix. Run directly to print a summary of the shards.
+"""
+import argparse
+import glob
+import struct
+
+import numpy as np
+
+MAGIC = 0x44544c52
+VERSION = 1
+HEADER = struct.Struct('<IHHIIQIIIIIf64s')  # DatasetHeader
+RAW = 1 << 0
+FLAG_POLICY = 1 << 0
+FLAG_WARMUP = 1 << 1
+HEADER_FIELDS = ['magic', 'version', 'header_size', 'record_size', 'flags', 'count', 'shard', 'observation_dim',
+                 'state_dim', 'action_dim', 'action_history_length', 'period', 'checkpoint']
+
+
+def read_header(path):
+    with open(path, 'rb') as file:
+        header = dict(zip(HEADER_FIELDS, HEADER.unpack(file.read(HEADER.size))))
+    if header['magic'] != MAGIC or header['version'] != VERSION:
+        raise ValueError(f'{path}: not a version {VERSION} transition dataset')
+    header['checkpoint'] = header['checkpoint'].split(b'\0')[0].decode()
+    return header
+
+
+def record_dtype(header):
+    observation_dim, action_dim = header['observation_dim'], header['action_dim']
+    return np.dtype({
+        'names': ['timestamp', 'episode', 'flags', 'observation', 'action', 'next_observation'],
+        'formats': ['<u8', '<u4', '<u4', ('<f4', observation_dim), ('<f4', action_dim), ('<f4', observation_dim)],
+        'offsets': [0, 8, 12, 16, 16 + 4 * observation_dim, 16 + 4 * (observation_dim + action_dim)],
+        'itemsize': header['record_size'],
+    })
+
+
+def load(path):
+    """Returns (header, records) with records a read-only structured numpy.memmap"""
+    header = read_header(path)
+    if header['count'] == 0:
+        return header, np.zeros(0, dtype=record_dtype(header))
+    return header, np.memmap(path, dtype=record_dtype(header), mode='r', offset=header['header_size'], shape=(header['count'],))
+
+
+def load_shards(prefix):
+    return [load(path) for path in sorted(glob.glob(f'{prefix}-[0-9][0-9][0-9][0-9][0-9].rltd'))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('shards', nargs='+', help='shard files (.rltd)')
+    args = parser.parse_args()
+    for path in args.shards:
+        header, records = load(path)
+        flags = records['flags']
+        print(f"{path}: {header['count']} transitions, checkpoint {header['checkpoint']}, "
+              f"observation {header['observation_dim']} (state {header['state_dim']} + {header['action_history_length']} x {header['action_dim']} actions"
+              f"{', raw' if header['flags'] & RAW else ''}), period {header['period'] * 1000:g}ms")
+        if len(records):
+            print(f"  episodes {records['episode'].min()}..{records['episode'].max()}, "
+                  f"policy {np.count_nonzero(flags & FLAG_POLICY)}, warm-up {np.count_nonzero(flags & FLAG_WARMUP)}, "
+                  f"time {records['timestamp'][0] / 1e6:.3f}s..{records['timestamp'][-1] / 1e6:.3f}s")
+
+
+if __name__ == '__main__':
+    main()
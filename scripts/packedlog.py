@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""Host decoder for the packed controller telemetry (packed_log.c).
+
+The firmware quantizes state_input, action_output and motor_cmd into two LOG groups that share a sequence counter:
+    rltpa: seq, s0..s11
+    rltpb: seq, s12, a1..a4, m1..m4, flags
+PackedLog subscribes to both groups, pairs the halves by sequence number and hands decoded snapshots to a callback.
+Run directly to decode a CSV that contains the raw rltpa.*/rltpb.* columns (e.g. from sim/build/sim --log ...).
+"""
+import argparse
+import csv
+import sys
+
+FULL_SCALE = 32767
+FLAG_SET_MOTORS = 1 << 0
+
+STATE_NAMES = ['px', 'py', 'pz', 'qw', 'qx', 'qy', 'qz', 'vx', 'vy', 'vz', 'wx', 'wy', 'wz']
+# scale parameter (rltp.*) of each state_input element
+STATE_SCALES = ['sp'] * 3 + ['sq'] * 4 + ['sv'] * 3 + ['sw'] * 3
+DEFAULT_SCALES = {'sp': 1.0, 'sq': 1.0, 'sv': 4.0, 'sw': 35.0, 'sa': 1.0}
+
+GROUP_A = [('rltpa.seq', 'uint8_t')] + [(f'rltpa.s{i}', 'int16_t') for i in range(12)]
+GROUP_B = [('rltpb.seq', 'uint8_t'), ('rltpb.s12', 'int16_t')] + \
+          [(f'rltpb.a{i}', 'int16_t') for i in range(1, 5)] + \
+          [(f'rltpb.m{i}', 'uint16_t') for i in range(1, 5)] + \
+          [('rltpb.flags', 'uint8_t')]
+
+FIELDS = [f'state.{name}' for name in STATE_NAMES] + [f'action.a{i}' for i in range(1, 5)] + \
+         [f'motor_cmd.m{i}' for i in range(1, 5)] + ['set_motors', 'seq']
+
+
+def read_scales(cf):
+    return {name: float(cf.param.get_value(f'rltp.{name}')) for name in DEFAULT_SCALES}
+
+
+def decode(a, b, scales=DEFAULT_SCALES):
+    """Decodes one snapshot from the raw rltpa/rltpb values (dicts keyed by the full variable name)."""
+    raw_state = [a[f'rltpa.s{i}'] for i in range(12)] + [b['rltpb.s12']]
+    snapshot = {}
+    for name, scale, value in zip(STATE_NAMES, STATE_SCALES, raw_state):
+        snapshot[f'state.{name}'] = value / FULL_SCALE * scales[scale]
+    for i in range(1, 5):
+        snapshot[f'action.a{i}'] = b[f'rltpb.a{i}'] / FULL_SCALE * scales['sa']
+    for i in range(1, 5):
+        snapshot[f'motor_cmd.m{i}'] = int(b[f'rltpb.m{i}'])
+    snapshot['set_motors'] = int(b['rltpb.flags']) & FLAG_SET_MOTORS
+    snapshot['seq'] = int(a['rltpa.seq'])
+    return snapshot
+
+
+class PackedLog:
+    """Streams both packed groups and calls callback(timestamp, snapshot) for every matched pair."""
+
+    def __init__(self, cf, period_in_ms, callback, scales=None):
+        from cflib.crazyflie.log import LogConfig
+        self._callback = callback
+        self._scales = scales if scales is not None else read_scales(cf)
+        self._pending = {'a': None, 'b': None}
+        self.matched = 0
+        self.unmatched = 0
+        self._configs = []
+        for half, variables in (('a', GROUP_A), ('b', GROUP_B)):
+            config = LogConfig(name=f'rltp{half}', period_in_ms=period_in_ms)
+            for name, fetch_as in variables:
+                config.add_variable(name, fetch_as)
+            cf.log.add_config(config)
+            config.data_received_cb.add_callback(lambda timestamp, data, logconf, half=half: self._received(half, timestamp, data))
+            self._configs.append(config)
+
+    def _received(self, half, timestamp, data):
+        other = 'b' if half == 'a' else 'a'
+        seq = data[f'rltp{half}.seq']
+        pending = self._pending[other]
+        if pending is not None and pending[1][f'rltp{other}.seq'] == seq:
+            self._pending[other] = None
+            a, b = (data, pending[1]) if half == 'a' else (pending[1], data)
+            self.matched += 1
+            self._callback(timestamp, decode(a, b, self._scales))
+        else:
+            if self._pending[half] is not None:
+                self.unmatched += 1
+            self._pending[half] = (timestamp, data)
+
+    def start(self):
+        for config in self._configs:
+            config.start()
+
+    def stop(self):
+        for config in self._configs:
+            config.stop()
+
+
+def decode_csv(input_file, output_file, scales):
+    reader = csv.DictReader(input_file)
+    passthrough = [name for name in reader.fieldnames if not name.startswith('rltpa.') and not name.startswith('rltpb.')]
+    writer = csv.writer(output_file)
+    writer.writerow(passthrough + FIELDS)
+    for row in reader:
+        values = {name: float(value) for name, value in row.items() if name.startswith('rltp')}
+        if int(values['rltpa.seq']) != int(values['rltpb.seq']):
+            continue
+        snapshot = decode(values, values, scales)
+        writer.writerow([row[name] for name in passthrough] + [snapshot[name] for name in FIELDS])
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode raw rltpa/rltpb columns of a CSV log into physical units.")
+    parser.add_argument('input')
+    parser.add_argument('--output', default=None, help="Output CSV (default stdout)")
+    for name, default in DEFAULT_SCALES.items():
+        parser.add_argument(f'--{name}', default=default, type=float, help=f"Value of rltp.{name} during the flight")
+    args = parser.parse_args()
+    scales = {name: getattr(args, name) for name in DEFAULT_SCALES}
+    with open(args.input, newline='') as input_file:
+        if args.output is None:
+            decode_csv(input_file, sys.stdout, scales)
+        else:
+            with open(args.output, 'w', newline='') as output_file:
+                decode_csv(input_file, output_file, scales)
+
+
+if __name__ == '__main__':
+    main()
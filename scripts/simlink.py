@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""cflib link driver for the host simulation (sim/build/sim_link).
+
+URIs look like sim://127.0.0.1:19850. Call register_driver() after cflib.crtp.init_drivers() and the simulated
+firmware can be used like a radio-connected Crazyflie (param/log TOC, commander packets, console).
+
+Run directly to benchmark the link: parameter round-trip latency and log throughput.
+"""
+import argparse
+import queue
+import socket
+import statistics
+import threading
+import time
+from urllib.parse import urlparse
+
+import cflib.crtp
+from cflib.crtp.crtpdriver import CRTPDriver
+from cflib.crtp.crtpstack import CRTPPacket
+from cflib.crtp.exceptions import WrongUriType
+
+DEFAULT_URI = 'sim://127.0.0.1:19850'
+DEFAULT_PORT = 19850
+
+
+class SimDriver(CRTPDriver):
+    def __init__(self):
+        CRTPDriver.__init__(self)
+        self.needs_resending = False
+        self._socket = None
+        self._in_queue = queue.Queue()
+        self._reader = None
+        self._closed = threading.Event()
+
+    def connect(self, uri, link_quality_callback, link_error_callback):
+        if not uri.startswith('sim://'):
+            raise WrongUriType('Not a sim URI')
+        parsed = urlparse(uri)
+        self._socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self._socket.connect((parsed.hostname or '127.0.0.1', parsed.port or DEFAULT_PORT))
+        self._socket.settimeout(0.1)
+        self._link_error_callback = link_error_callback
+        self._reader = threading.Thread(target=self._read_loop, name='SimLinkReader', daemon=True)
+        self._reader.start()
+
+    def _read_loop(self):
+        while not self._closed.is_set():
+            try:
+                data = self._socket.recv(64)
+            except socket.timeout:
+                continue
+            except OSError as e:
+                if not self._closed.is_set() and self._link_error_callback:
+                    self._link_error_callback(f'Simulation link error: {e}')
+                return
+            if data:
+                self._in_queue.put(CRTPPacket(data[0], data[1:]))
+
+    def send_packet(self, pk):
+        self._socket.send(bytes([pk.header]) + bytes(pk.data))
+
+    def receive_packet(self, wait=0):
+        try:
+            if wait == 0:
+                return self._in_queue.get_nowait()
+            if wait < 0:
+                return self._in_queue.get()
+            return self._in_queue.get(timeout=wait)
+        except queue.Empty:
+            return None
+
+    def get_status(self):
+        return 'Host simulation link'
+
+    def get_name(self):
+        return 'sim'
+
+    def scan_interface(self, address=None):
+        return []
+
+    def close(self):
+        self._closed.set()
+        if self._reader is not None:
+            self._reader.join(timeout=1.0)
+        if self._socket is not None:
+            self._socket.close()
+            self._socket = None
+
+
+def register_driver():
+    # init_drivers() instantiates the built-in drivers into DRIVERS, which get_link_driver() tries in order
+    if not any(isinstance(driver, SimDriver) for driver in cflib.crtp.DRIVERS):
+        cflib.crtp.DRIVERS.append(SimDriver())
+
+
+def benchmark_params(cf, name, samples):
+    latencies = []
+    updated = threading.Event()
+    cf.param.add_update_callback(group=name.split('.')[0], name=name.split('.')[1], cb=lambda *_: updated.set())
+    original = float(cf.param.get_value(name))
+    for i in range(samples):
+        updated.clear()
+        start = time.monotonic()
+        cf.param.set_value(name, original + (i % 2) * 0.1)
+        if updated.wait(timeout=2.0):
+            latencies.append(time.monotonic() - start)
+    cf.param.set_value(name, original)
+    return latencies
+
+
+def benchmark_log(cf, variables, period_ms, duration):
+    from cflib.crazyflie.log import LogConfig
+    received = []
+    config = LogConfig(name='bench', period_in_ms=period_ms)
+    for variable, fetch_as in variables:
+        config.add_variable(variable, fetch_as)
+    cf.log.add_config(config)
+    config.data_received_cb.add_callback(lambda timestamp, data, logconf: received.append(timestamp))
+    config.start()
+    time.sleep(duration)
+    config.stop()
+    config.delete()
+    return received
+
+
+def main():
+    from cflib.crazyflie import Crazyflie
+    from cflib.crazyflie.syncCrazyflie import SyncCrazyflie
+
+    parser = argparse.ArgumentParser(description="Benchmark the simulated CRTP link (start sim/build/sim_link first).")
+    parser.add_argument('--uri', default=DEFAULT_URI)
+    parser.add_argument('--param', default='rlt.target_z', help="Float parameter used for the round-trip test")
+    parser.add_argument('--param-samples', default=50, type=int)
+    parser.add_argument('--period', default=10, type=int, help="Log period [ms]")
+    parser.add_argument('--duration', default=5, type=float, help="Log test duration [s]")
+    args = parser.parse_args()
+
+    cflib.crtp.init_drivers()
+    register_driver()
+
+    start = time.monotonic()
+    with SyncCrazyflie(args.uri, cf=Crazyflie(rw_cache='./build/cache')) as scf:
+        print(f"Connected (incl. TOC download) in {time.monotonic() - start:.3f}s")
+        latencies = benchmark_params(scf.cf, args.param, args.param_samples)
+        if latencies:
+            print(f"Param round trip ({len(latencies)}/{args.param_samples}): "
+                  f"median {statistics.median(latencies) * 1e3:.2f}ms, max {max(latencies) * 1e3:.2f}ms")
+        else:
+            print("Param round trip: no updates received")
+
+        blocks = {
+            'rltm': [('rltm.m1', 'uint16_t'), ('rltm.m2', 'uint16_t'), ('rltm.m3', 'uint16_t'), ('rltm.m4', 'uint16_t')],
+            'rlta': [('rlta.a1', 'float'), ('rlta.a2', 'float'), ('rlta.a3', 'float'), ('rlta.a4', 'float')],
+        }
+        for name, variables in blocks.items():
+            received = benchmark_log(scf.cf, variables, args.period, args.duration)
+            expected = args.duration * 1000 / args.period
+            print(f"Log block {name} @ {args.period}ms: {len(received) / args.duration:.1f} packets/s "
+                  f"({len(received)}/{expected:.0f} expected)")
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+"""Stress test of a checkpoint zoo: scenario x mode x policy matrix in the host simulation.
+
+The policy is compiled into the simulator, so every checkpoint gets its own build directory
+(make -C sim BUILD=build/zoo/<name> CHECKPOINT=<header>, incremental on reruns) whose sim/build/.../stress flies all
+scenarios and modes in parallel. The per-flight rows (pass, margin, crash, metrics) are merged into one CSV with a
+policy column and summarized as a pass matrix with the worst margin per cell. Checkpoints with another action-history
+decimation than the default 5 are given as <header>:<decimation>.
+
+Example:
+    python3 scripts/stress.py --checkpoint policies/*.h --checkpoint data/decimation_2.h:2 \\
+        --mode position,figure_eight --seeds 4 sim/scenarios/*.scn
+"""
+import argparse
+import os
+import subprocess
+import sys
+from pathlib import Path
+
+import pandas as pd
+
+SIM = Path(__file__).resolve().parent.parent / 'sim'
+
+
+def build(checkpoint, decimation, jobs):
+    name = checkpoint.stem
+    build_dir = f'build/zoo/{name}'
+    command = ['make', '-C', str(SIM), f'-j{jobs}', f'BUILD={build_dir}', f'CHECKPOINT={checkpoint.resolve()}', f'{build_dir}/stress']
+    if decimation is not None:
+        command.append(f'DECIMATION={decimation}')
+    result = subprocess.run(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+    if result.returncode != 0:
+        raise RuntimeError(f"building {checkpoint} failed:\n{result.stderr.strip()}")
+    return SIM / build_dir
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Scenario x mode x policy stress matrix in the host simulation.")
+    parser.add_argument('scenarios', nargs='+', type=Path, help="Scenario files (sim/scenario.h)")
+    parser.add_argument('--checkpoint', default=[], action='append', nargs='+', help="Checkpoint header[:decimation] (repeatable)")
+    parser.add_argument('--mode', default='position,figure_eight')
+    parser.add_argument('--seeds', default=1, type=int)
+    parser.add_argument('--param', default=[], action='append', help="Fixed parameter group.name=value")
+    parser.add_argument('--jobs', default=os.cpu_count(), type=int)
+    parser.add_argument('--output', default='stress.csv')
+    args = parser.parse_args()
+
+    checkpoints = [spec for specs in args.checkpoint for spec in specs] or ['../policies/l2f_action_history_delay_3M.h']
+    frames = []
+    for spec in checkpoints:
+        path, _, decimation = spec.partition(':')
+        checkpoint = Path(path) if Path(path).exists() else SIM / path
+        if not checkpoint.exists():
+            parser.error(f"{path} not found")
+        print(f"{checkpoint.stem}: building", flush=True)
+        build_dir = build(checkpoint, decimation or None, args.jobs)
+        output = build_dir / 'stress.csv'
+        command = [str(build_dir / 'stress'), '--mode', args.mode, '--seeds', str(args.seeds), '--jobs', str(args.jobs), '--output', str(output)]
+        for param in args.param:
+            command += ['--param', param]
+        command += [str(scenario) for scenario in args.scenarios]
+        # Exit code 2: completed with failed flights
+        result = subprocess.run(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+        if result.returncode not in (0, 2):
+            sys.exit(f"{' '.join(command)} failed: {result.stderr.strip()}")
+        frame = pd.read_csv(output)
+        frame.insert(0, 'policy', checkpoint.stem)
+        frames.append(frame)
+        print(f"{checkpoint.stem}: {int(frame['pass'].sum())}/{len(frame)} flights passed", flush=True)
+    results = pd.concat(frames, ignore_index=True)
+    results.to_csv(args.output, index=False)
+    print(f"Results written to {args.output}")
+
+    # passed/flights and worst margin per scenario and mode (rows) and policy (columns)
+    cells = results.groupby(['scenario', 'mode', 'policy'], sort=False).agg(passed=('pass', 'sum'), flights=('pass', 'size'), margin=('margin', 'min'))
+    cells['cell'] = [f"{p}/{n} {m:+.2f}" for p, n, m in zip(cells['passed'], cells['flights'], cells['margin'])]
+    matrix = cells['cell'].unstack('policy')
+    with pd.option_context('display.max_rows', None, 'display.max_columns', None, 'display.width', 200):
+        print("\npassed/flights worst margin")
+        print(matrix.to_string())
+
+
+if __name__ == '__main__':
+    main()
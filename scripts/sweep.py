@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+"""Parallel parameter sweep over the controller parameters in the host simulation (sim/build/sim).
+
+Each configuration is one closed-loop run; the runs are distributed over all cores. Dimensions are given as
+    --range rlt.pdlp=0.3:0.8      continuous, sampled on a grid (--grid N points per dimension) or by --lhs N
+    --values rlt.wn=1,4           discrete, always crossed with the continuous samples
+Fixed parameters (--param) are applied to every run. Tracking/stability metrics are computed over the time the
+learned controller is active and the Pareto front over --objectives is printed.
+
+Example:
+    python3 scripts/sweep.py --param rlt.wn=4 --range rlt.fes=0.2:0.6 --range rlt.vdlfe=0.5:3 --lhs 64 --duration 20
+"""
+import argparse
+import itertools
+import os
+import random
+import subprocess
+import tempfile
+from concurrent.futures import ThreadPoolExecutor
+from pathlib import Path
+
+import numpy as np
+import pandas as pd
+
+DEFAULT_SIM = Path(__file__).resolve().parent.parent / 'sim' / 'build' / 'sim'
+LOG_VARIABLES = ['rltte.x', 'rltte.y', 'rltte.z', 'rltrp.sm', 'rlta.a1', 'rlta.a2', 'rlta.a3', 'rlta.a4']
+METRICS = ['rmse', 'max_error', 'final_error', 'action_rate', 'saturation', 'crashed']
+CRASH_ERROR = 1.0  # [m] position error above which a run counts as crashed
+CRASH_HEIGHT = 0.02  # [m] touching the ground while active counts as crashed
+
+
+def parse_range(spec):
+    name, bounds = spec.split('=')
+    low, high = bounds.split(':')
+    return name, float(low), float(high)
+
+
+def parse_values(spec):
+    name, values = spec.split('=')
+    return name, [float(v) for v in values.split(',')]
+
+
+def continuous_samples(ranges, grid, lhs, rng):
+    if not ranges:
+        return [{}]
+    if lhs is not None:
+        # Latin hypercube: one sample per stratum in every dimension, strata permuted independently
+        columns = []
+        for _, low, high in ranges:
+            strata = (np.arange(lhs) + rng.random(lhs)) / lhs
+            rng.shuffle(strata)
+            columns.append(low + strata * (high - low))
+        return [{name: columns[d][i] for d, (name, _, _) in enumerate(ranges)} for i in range(lhs)]
+    axes = [np.linspace(low, high, grid) if grid > 1 else [(low + high) / 2] for _, low, high in ranges]
+    return [dict(zip([name for name, _, _ in ranges], point)) for point in itertools.product(*axes)]
+
+
+def configurations(ranges, values, grid, lhs, seed):
+    rng = np.random.default_rng(seed)
+    discrete = [dict(zip([name for name, _ in values], point)) for point in itertools.product(*[v for _, v in values])]
+    return [{**d, **c} for d in discrete for c in continuous_samples(ranges, grid, lhs, rng)]
+
+
+def metrics(df, settle_time):
+    active = df[df['rltrp.sm'] > 0.5]
+    if active.empty:
+        return {'rmse': np.nan, 'max_error': np.nan, 'final_error': np.nan, 'action_rate': np.nan, 'saturation': np.nan, 'crashed': 1}
+    active = active[active['timestamp (ms)'] >= active['timestamp (ms)'].iloc[0] + settle_time * 1000]
+    error = np.linalg.norm(active[['rltte.x', 'rltte.y', 'rltte.z']].to_numpy(), axis=1)
+    actions = active[['rlta.a1', 'rlta.a2', 'rlta.a3', 'rlta.a4']].to_numpy()
+    motors = active[['motor.m1', 'motor.m2', 'motor.m3', 'motor.m4']].to_numpy()
+    dt = np.diff(active['timestamp (ms)'].to_numpy()) / 1000
+    action_rate = np.mean(np.sum((np.diff(actions, axis=0) / dt[:, None]) ** 2, axis=1)) if len(dt) else np.nan
+    crashed = bool(np.any(error > CRASH_ERROR) or np.any(active['stateEstimate.z'] < CRASH_HEIGHT))
+    return {
+        'rmse': float(np.sqrt(np.mean(error ** 2))),
+        'max_error': float(np.max(error)),
+        'final_error': float(error[-1]),
+        'action_rate': float(action_rate),
+        'saturation': float(np.mean(np.any((motors >= 65535) | (motors <= 0), axis=1))),
+        'crashed': int(crashed),
+    }
+
+
+def run(sim, configuration, args):
+    with tempfile.NamedTemporaryFile(suffix='.csv') as output:
+        command = [str(sim), '--duration', str(args.duration), '--trigger-start', str(args.trigger_start),
+                   '--battery', str(args.battery), '--output', output.name]
+        for param in args.param:
+            command += ['--param', param]
+        for name, value in configuration.items():
+            command += ['--param', f'{name}={value}']
+        for variable in LOG_VARIABLES:
+            command += ['--log', variable]
+        result = subprocess.run(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+        if result.returncode != 0:
+            raise RuntimeError(f"{' '.join(command)} failed: {result.stderr.strip()}")
+        return {**configuration, **metrics(pd.read_csv(output.name), args.settle_time)}
+
+
+def pareto_front(results, objectives):
+    candidates = results[results['crashed'] == 0].dropna(subset=objectives)
+    values = candidates[objectives].to_numpy()
+    dominated = np.zeros(len(values), dtype=bool)
+    for i in range(len(values)):
+        dominated[i] = np.any(np.all(values <= values[i], axis=1) & np.any(values < values[i], axis=1))
+    return candidates[~dominated].sort_values(objectives[0])
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Parallel parameter sweep in the host simulation.")
+    parser.add_argument('--sim', default=DEFAULT_SIM, type=Path)
+    parser.add_argument('--range', default=[], action='append', help="Continuous dimension group.name=low:high")
+    parser.add_argument('--values', default=[], action='append', help="Discrete dimension group.name=v1,v2,...")
+    parser.add_argument('--grid', default=5, type=int, help="Grid points per continuous dimension")
+    parser.add_argument('--lhs', default=None, type=int, help="Number of Latin-hypercube samples (replaces the grid)")
+    parser.add_argument('--param', default=[], action='append', help="Fixed parameter group.name=value")
+    parser.add_argument('--duration', default=15, type=float)
+    parser.add_argument('--trigger-start', default=1, type=float)
+    parser.add_argument('--settle-time', default=2, type=float, help="Time after activation excluded from the metrics [s]")
+    parser.add_argument('--battery', default=0, type=float, help="Battery capacity [mAh], 0 = ideal supply")
+    parser.add_argument('--objectives', default='rmse,action_rate', help=f"Comma separated, minimized, out of {METRICS}")
+    parser.add_argument('--jobs', default=os.cpu_count(), type=int)
+    parser.add_argument('--seed', default=0, type=int)
+    parser.add_argument('--output', default='sweep.csv')
+    args = parser.parse_args()
+
+    if not args.sim.exists():
+        parser.error(f"{args.sim} not found, build it with make -C sim")
+    ranges = [parse_range(spec) for spec in args.range]
+    values = [parse_values(spec) for spec in args.values]
+    objectives = args.objectives.split(',')
+    configs = configurations(ranges, values, args.grid, args.lhs, args.seed)
+    print(f"Running {len(configs)} configurations on {args.jobs} workers")
+
+    rows = []
+    with ThreadPoolExecutor(max_workers=args.jobs) as executor:
+        for i, row in enumerate(executor.map(lambda c: run(args.sim, c, args), configs)):
+            rows.append(row)
+            if (i + 1) % max(1, len(configs) // 10) == 0:
+                print(f"{i + 1}/{len(configs)}")
+    results = pd.DataFrame(rows)
+    results.to_csv(args.output, index=False)
+    print(f"Results written to {args.output} ({int(results['crashed'].sum())} crashed)")
+
+    with pd.option_context('display.max_rows', None, 'display.width', 200):
+        print(f"\nPareto front ({', '.join(objectives)}):")
+        print(pareto_front(results, objectives).to_string(index=False))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""Live consumer of the simulator's shared-memory telemetry bus (sim/telemetry_bus.h).
+
+sim/build/sim, sim_link and replay publish every controllerOutOfTree invocation with --bus <name>. This script attaches
+without slowing the producer down (frames it falls behind on are counted as dropped) and either prints a once-per-second
+summary or records the frames to a CSV with the column names of sim/build/sim (plus the controller internals), so
+scripts/plot_*.py work on it. Waits for the bus to appear and stops when the producer closes it. Can also be imported:
+Reader(name).read() returns the new frames as a numpy structured array with the FRAME fields.
+
+Example:
+    python3 scripts/telemetry_bus.py &
+    sim/build/sim --duration 30 --bus /rl_tools_telemetry --output /dev/null
+    python3 scripts/telemetry_bus.py --output live.csv --every 10 && python3 scripts/plot_traj.py live.csv
+
+sim/build/sim runs much faster than real time: to record all of it, start the recorder first or use --history with a
+--bus-capacity that holds the whole run.
+"""
+import argparse
+import mmap
+import sys
+import time
+
+import numpy as np
+
+DEFAULT_NAME = '/rl_tools_telemetry'
+MAGIC = 0x4d4c4554
+VERSION = 1
+FLAG_SET_MOTORS = 1 << 0
+FLAG_INFERENCE = 1 << 1
+
+# TelemetryBusHeader and TelemetrySlot (sequence + TelemetryFrame)
+HEADER = np.dtype([('magic', '<u4'), ('version', '<u2'), ('frame_size', '<u2'), ('capacity', '<u4'), ('closed', '<u4'),
+                   ('write_index', '<u8'), ('padding', 'u1', 40)])
+FRAME = np.dtype([('tick', '<u8'), ('time_us', '<u8'),
+                  ('position', '<f4', 3), ('linear_velocity', '<f4', 3), ('orientation', '<f4', 4), ('angular_velocity', '<f4', 3),
+                  ('state_input', '<f4', 13), ('action_output', '<f4', 4), ('target_pos', '<f4', 3),
+                  ('motor_cmd', '<u2', 4), ('motor_ratio', '<u2', 4), ('battery_voltage', '<f4'),
+                  ('controller_us', '<f4'), ('flags', '<u4')])
+SLOT = np.dtype([('sequence', '<u8'), ('frame', FRAME)])
+assert HEADER.itemsize == 64 and FRAME.itemsize == 176
+
+
+class Reader:
+    def __init__(self, name=DEFAULT_NAME, history=False):
+        path = '/dev/shm/' + name.lstrip('/')
+        with open(path, 'rb') as file:
+            self.memory = mmap.mmap(file.fileno(), 0, access=mmap.ACCESS_READ)
+        self.header = np.frombuffer(self.memory, HEADER, 1, 0)
+        header = self.header[0]
+        if header['magic'] != MAGIC or header['version'] != VERSION or header['frame_size'] != FRAME.itemsize:
+            raise RuntimeError(f"{path}: not a version {VERSION} telemetry bus")
+        self.capacity = int(header['capacity'])
+        self.slots = np.frombuffer(self.memory, SLOT, self.capacity, HEADER.itemsize)
+        write_index = self.write_index()
+        self.cursor = max(write_index - self.capacity, 0) if history else write_index
+        self.dropped = 0
+
+    def write_index(self):
+        return int(self.header['write_index'][0])
+
+    def closed(self):
+        return self.header['closed'][0] != 0 and self.cursor == self.write_index()
+
+    def read(self):
+        """Frames published since the last call, minus the ones overwritten before they could be copied"""
+        write_index = self.write_index()
+        if write_index - self.cursor > self.capacity:
+            self.dropped += write_index - self.capacity - self.cursor
+            self.cursor = write_index - self.capacity
+        index = np.arange(self.cursor, write_index, dtype=np.uint64)
+        self.cursor = write_index
+        slots = self.slots[index % self.capacity]  # copy
+        # Seqlock check: complete before the copy and not overwritten since
+        expected = 2 * index + 2
+        valid = (slots['sequence'] == expected) & (self.slots['sequence'][index % self.capacity] == expected)
+        self.dropped += int(np.count_nonzero(~valid))
+        return slots['frame'][valid]
+
+
+def attach(name, history):
+    """Waits for a bus that is still being written (or, with history, for any bus)"""
+    while True:
+        try:
+            reader = Reader(name, history)
+            if history or reader.header['closed'][0] == 0:
+                return reader
+        except (FileNotFoundError, ValueError, RuntimeError):
+            pass
+        time.sleep(0.01)
+
+
+CSV_COLUMNS = (['timestamp (ms)', 'stateEstimate.x', 'stateEstimate.y', 'stateEstimate.z', 'stateEstimate.vx', 'stateEstimate.vy', 'stateEstimate.vz',
+                'motor.m1', 'motor.m2', 'motor.m3', 'motor.m4', 'pm.vbat'] +
+               ['bus.qw', 'bus.qx', 'bus.qy', 'bus.qz', 'bus.wx', 'bus.wy', 'bus.wz'] + [f'bus.s{i}' for i in range(13)] +
+               [f'rlta.a{i + 1}' for i in range(4)] + [f'rltm.m{i + 1}' for i in range(4)] +
+               ['rlttp.x', 'rlttp.y', 'rlttp.z', 'rltrp.sm', 'bus.inference', 'bus.controller_us'])
+
+
+def csv_rows(frames):
+    columns = [frames['time_us'] / 1000, frames['position'], frames['linear_velocity'], frames['motor_ratio'], frames['battery_voltage'],
+               frames['orientation'], frames['angular_velocity'], frames['state_input'], frames['action_output'],
+               frames['motor_cmd'], frames['target_pos'], (frames['flags'] & FLAG_SET_MOTORS) != 0,
+               (frames['flags'] & FLAG_INFERENCE) != 0, frames['controller_us']]
+    return np.column_stack([np.asarray(column, dtype=np.float64).reshape(len(frames), -1) for column in columns])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--bus', default=DEFAULT_NAME, help="bus name (sim --bus)")
+    parser.add_argument('--history', action='store_true', help="start with the frames still in the ring instead of the next one")
+    parser.add_argument('--output', help="record to this CSV instead of printing a summary")
+    parser.add_argument('--every', type=int, default=10, help="record every n-th tick (default 10, the sim --log-interval)")
+    args = parser.parse_args()
+
+    reader = attach(args.bus, args.history)
+    print(f"Attached to {args.bus} ({reader.capacity} frames)", file=sys.stderr)
+    output = open(args.output, 'w') if args.output else None
+    if output:
+        output.write(','.join(CSV_COLUMNS) + '\n')
+    frames_total = 0
+    window = []
+    last_report = time.monotonic()
+    try:
+        while True:
+            frames = reader.read()
+            if len(frames) == 0:
+                if reader.closed():
+                    break
+                time.sleep(0.005)
+            frames_total += len(frames)
+            if output:
+                frames = frames[frames['tick'] % args.every == 0]
+                np.savetxt(output, csv_rows(frames), fmt='%.6g', delimiter=',')
+            elif len(frames):
+                window.append(frames)
+            now = time.monotonic()
+            if not output and now - last_report >= 1.0 and window:
+                frames = np.concatenate(window)
+                latest = frames[-1]
+                print(f"t={latest['time_us'] / 1e6:7.2f}s {len(frames) / (now - last_report):8.0f} frames/s dropped {reader.dropped}"
+                      f" pos [{latest['position'][0]:6.2f} {latest['position'][1]:6.2f} {latest['position'][2]:6.2f}]"
+                      f" target [{latest['target_pos'][0]:6.2f} {latest['target_pos'][1]:6.2f} {latest['target_pos'][2]:6.2f}]"
+                      f" action [{' '.join(f'{a:5.2f}' for a in latest['action_output'])}]"
+                      f" controller {frames['controller_us'].mean():.1f}us (max {frames['controller_us'].max():.1f}us)"
+                      f" {'active' if latest['flags'] & FLAG_SET_MOTORS else 'inactive'}")
+                window = []
+                last_report = now
+    except KeyboardInterrupt:
+        pass
+    if output:
+        output.close()
+    print(f"{frames_total} frames, {reader.dropped} dropped", file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,236 @@
+#!/usr/bin/env python3
+"""Converts controller stage timelines (controller_timeline.h) into a Chrome trace (JSON) or a Perfetto trace.
+
+Input is a timeline file of sim/build/sim --timeline or sim/build/replay --timeline (host clock), or the on-board
+recorder buffer downloaded with scripts/tracedump.py --timeline. Every controllerOutOfTree invocation becomes a slice
+on the "stabilizer" track with its stages nested in it (prologue, setpoint, observation, policy with its layers when
+evaluated layer by layer, control, motors, telemetry); invocations the controller flagged as behind schedule get an
+instant event on the "schedule" track, and the interval between invocations and their duration are counter tracks.
+Records are converted one chunk at a time and the output is written as it goes, so traces of any length fit.
+
+Open the output in https://ui.perfetto.dev (both formats) or chrome://tracing (JSON).
+
+Example:
+    sim/build/sim --duration 20 --param rlt.wn=4 --param rltk.l0=3 --param rltk.l1=3 --param rltk.l2=3 --timeline timeline.bin > /dev/null
+    python3 scripts/timeline_trace.py timeline.bin --output timeline.json
+    python3 scripts/timeline_trace.py timeline.bin --output timeline.pftrace --ticks 5000:6000
+"""
+import argparse
+import json
+import struct
+import sys
+
+MAGIC = 0x4c545452
+VERSION = 1
+HEADER = struct.Struct('<IHHIII')  # controller_timeline_header_t
+STAGES = ['prologue', 'setpoint', 'observation', 'layer 0', 'layer 1', 'layer 2', 'policy', 'control', 'motors', 'telemetry']
+RECORD = struct.Struct(f'<4I{len(STAGES)}I')  # controller_timeline_record_t
+LAYERS = [3, 4, 5]
+POLICY = 6
+FLAG_INFERENCE = 1 << 0
+FLAG_SET_MOTORS = 1 << 1
+FLAG_BEHIND_SCHEDULE = 1 << 2
+FLAG_LAYERS = 1 << 3
+CHUNK = 4096  # records per read
+
+
+def read_records(file, header_count):
+    """Yields (tick, timestamp_us, flags, stage_end) without holding more than one chunk"""
+    remaining = header_count if header_count else None
+    while remaining is None or remaining > 0:
+        count = CHUNK if remaining is None else min(CHUNK, remaining)
+        data = file.read(count * RECORD.size)
+        if len(data) < RECORD.size:
+            return
+        for fields in RECORD.iter_unpack(data[:len(data) - len(data) % RECORD.size]):
+            tick, low, high, flags = fields[:4]
+            yield tick, high << 32 | low, flags, fields[4:]
+        if remaining is not None:
+            remaining -= len(data) // RECORD.size
+
+
+def slices(record, clock_hz):
+    """(name, depth, start, end) of the invocation and its stages, in us relative to the invocation start"""
+    tick, timestamp_us, flags, stage_end = record
+    scale = 1e6 / clock_hz
+    end = stage_end[-1] * scale
+    result = [('controllerOutOfTree', 0, 0.0, end)]
+    previous = 0.0
+    for stage, name in enumerate(STAGES):
+        if stage in LAYERS or stage_end[stage] == 0:
+            continue
+        stage_stop = min(max(stage_end[stage] * scale, previous), end)
+        result.append((name, 1, previous, stage_stop))
+        if stage == POLICY and flags & FLAG_LAYERS:
+            layer_start = previous
+            for layer in LAYERS:
+                layer_stop = min(max(stage_end[layer] * scale, layer_start), stage_stop)
+                result.append((STAGES[layer], 2, layer_start, layer_stop))
+                layer_start = layer_stop
+        previous = stage_stop
+    return result
+
+
+class ChromeWriter:
+    """JSON object format, events written one by one"""
+
+    def __init__(self, output):
+        self.output = output
+        self.first = True
+        self.output.write('{"displayTimeUnit": "ns", "traceEvents": [\n')
+        self.event({'ph': 'M', 'pid': 1, 'name': 'process_name', 'args': {'name': 'Crazyflie'}})
+        self.event({'ph': 'M', 'pid': 1, 'tid': 1, 'name': 'thread_name', 'args': {'name': 'stabilizer'}})
+        self.event({'ph': 'M', 'pid': 1, 'tid': 2, 'name': 'thread_name', 'args': {'name': 'schedule'}})
+
+    def event(self, event):
+        self.output.write(('' if self.first else ',\n') + json.dumps(event, separators=(',', ':')))
+        self.first = False
+
+    def record(self, record, clock_hz, interval):
+        tick, timestamp_us, flags, stage_end = record
+        for name, depth, start, end in slices(record, clock_hz):
+            event = {'ph': 'X', 'pid': 1, 'tid': 1, 'name': name, 'ts': timestamp_us + start, 'dur': end - start}
+            if depth == 0:
+                event['args'] = {'tick': tick, 'inference': bool(flags & FLAG_INFERENCE), 'set_motors': bool(flags & FLAG_SET_MOTORS)}
+            self.event(event)
+        if flags & FLAG_BEHIND_SCHEDULE:
+            self.event({'ph': 'i', 'pid': 1, 'tid': 2, 's': 't', 'name': 'behind schedule', 'ts': timestamp_us, 'args': {'tick': tick}})
+        self.event({'ph': 'C', 'pid': 1, 'name': 'duration', 'ts': timestamp_us, 'args': {'us': stage_end[-1] * 1e6 / clock_hz}})
+        if interval is not None:
+            self.event({'ph': 'C', 'pid': 1, 'name': 'interval', 'ts': timestamp_us, 'args': {'us': interval}})
+
+    def close(self):
+        self.output.write('\n]}\n')
+
+
+def varint(value):
+    result = bytearray()
+    while True:
+        byte = value & 0x7f
+        value >>= 7
+        if value:
+            result.append(byte | 0x80)
+        else:
+            result.append(byte)
+            return bytes(result)
+
+
+def field_varint(number, value):
+    return varint(number << 3) + varint(value)
+
+
+def field_bytes(number, value):
+    return varint(number << 3 | 2) + varint(len(value)) + value
+
+
+def field_double(number, value):
+    return varint(number << 3 | 1) + struct.pack('<d', value)
+
+
+class PerfettoWriter:
+    """Trace proto: one length-delimited TracePacket (field 1 of Trace) per event with TrackEvents on explicit tracks"""
+    SEQUENCE = 1
+    SLICE_BEGIN, SLICE_END, INSTANT, COUNTER = 1, 2, 3, 4
+    STABILIZER, SCHEDULE, DURATION, INTERVAL = 1, 2, 3, 4
+
+    def __init__(self, output):
+        self.output = output
+        self.first = True
+        self.track(self.STABILIZER, 'stabilizer')
+        self.track(self.SCHEDULE, 'schedule')
+        self.track(self.DURATION, 'duration [us]', counter=True)
+        self.track(self.INTERVAL, 'interval [us]', counter=True)
+
+    def packet(self, body):
+        body += field_varint(10, self.SEQUENCE)  # trusted_packet_sequence_id
+        if self.first:
+            body += field_varint(13, 1)  # sequence_flags: SEQ_INCREMENTAL_STATE_CLEARED
+            self.first = False
+        self.output.write(field_bytes(1, body))
+
+    def track(self, uuid, name, counter=False):
+        descriptor = field_varint(1, uuid) + field_bytes(2, name.encode())  # uuid, name
+        if counter:
+            descriptor += field_bytes(8, b'')  # CounterDescriptor
+        self.packet(field_bytes(60, descriptor))  # track_descriptor
+
+    def event(self, timestamp_ns, track, event_type, name=None, value=None, tick=None):
+        event = field_varint(9, event_type) + field_varint(11, track)  # type, track_uuid
+        if name is not None:
+            event += field_bytes(23, name.encode())
+        if value is not None:
+            event += field_double(44, value)  # double_counter_value
+        if tick is not None:
+            event += field_bytes(4, field_bytes(10, b'tick') + field_varint(4, tick))  # debug_annotations: name, int_value
+        self.packet(field_varint(8, int(timestamp_ns)) + field_bytes(11, event))  # timestamp, track_event
+
+    def record(self, record, clock_hz, interval):
+        tick, timestamp_us, flags, stage_end = record
+        base = timestamp_us * 1000
+        open_slices = []
+        for name, depth, start, end in slices(record, clock_hz):
+            while open_slices and open_slices[-1][0] >= depth:
+                self.event(base + open_slices.pop()[1] * 1000, self.STABILIZER, self.SLICE_END)
+            self.event(base + start * 1000, self.STABILIZER, self.SLICE_BEGIN, name, tick=tick if depth == 0 else None)
+            open_slices.append((depth, end))
+        while open_slices:
+            self.event(base + open_slices.pop()[1] * 1000, self.STABILIZER, self.SLICE_END)
+        if flags & FLAG_BEHIND_SCHEDULE:
+            self.event(base, self.SCHEDULE, self.INSTANT, 'behind schedule', tick=tick)
+        self.event(base, self.DURATION, self.COUNTER, value=stage_end[-1] * 1e6 / clock_hz)
+        if interval is not None:
+            self.event(base, self.INTERVAL, self.COUNTER, value=interval)
+
+    def close(self):
+        pass
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('timeline', help="timeline file (sim --timeline, replay --timeline, tracedump.py --timeline), - for stdin")
+    parser.add_argument('--output', required=True, help="trace file, .json for Chrome JSON, otherwise Perfetto protobuf (e.g. .pftrace)")
+    parser.add_argument('--format', choices=['json', 'perfetto'], help="override the format chosen by the extension")
+    parser.add_argument('--ticks', help="only ticks first:last (either may be omitted)")
+    args = parser.parse_args()
+
+    first_tick, last_tick = 0, None
+    if args.ticks:
+        first, _, last = args.ticks.partition(':')
+        first_tick = int(first) if first else 0
+        last_tick = int(last) if last else None
+    file = sys.stdin.buffer if args.timeline == '-' else open(args.timeline, 'rb')
+    header = file.read(HEADER.size)
+    if len(header) < HEADER.size:
+        sys.exit(f"{args.timeline}: no timeline header")
+    magic, version, record_size, clock_hz, count, dropped = HEADER.unpack(header)
+    if magic != MAGIC or version != VERSION or record_size != RECORD.size:
+        sys.exit(f"{args.timeline}: not a version {VERSION} controller timeline (magic {magic:#x}, version {version}, record size {record_size})")
+
+    perfetto = args.format == 'perfetto' or (args.format is None and not args.output.endswith('.json'))
+    output = open(args.output, 'wb' if perfetto else 'w')
+    writer = PerfettoWriter(output) if perfetto else ChromeWriter(output)
+    converted = behind_schedule = 0
+    longest = (0.0, None)
+    previous_timestamp = None
+    for record in read_records(file, count):
+        tick, timestamp_us, flags, stage_end = record
+        if tick < first_tick:
+            continue
+        if last_tick is not None and tick > last_tick:
+            break
+        interval = timestamp_us - previous_timestamp if previous_timestamp is not None else None
+        previous_timestamp = timestamp_us
+        writer.record(record, clock_hz, interval)
+        converted += 1
+        behind_schedule += bool(flags & FLAG_BEHIND_SCHEDULE)
+        duration = stage_end[-1] * 1e6 / clock_hz
+        if duration > longest[0]:
+            longest = (duration, tick)
+    writer.close()
+    output.close()
+    print(f"{converted} invocations ({dropped} dropped by the recorder), {behind_schedule} behind schedule, "
+          f"longest {longest[0]:.1f}us (tick {longest[1]}) -> {args.output}", file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
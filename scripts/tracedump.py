@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""Arms and downloads the on-board controller trace recorder (controller_trace.c) or stage timeline recorder
+(controller_timeline.c, --timeline).
+
+The recorder (compiled in with -DCONTROLLER_TRACE_RECORDER_LENGTH=<n>) keeps the latest (rltrec.mode=1, ring) or the
+first (rltrec.mode=2, one-shot) n controllerOutOfTree invocations, inputs and outputs, in RAM together with a snapshot of
+the controller state in front of them, and exposes them as an APP memory. Downloading stops the recorder and writes the
+records in the format of sim/build/sim --trace and the snapshot to <output>.snapshot, so they can be checked with
+    sim/build/replay <file> --snapshot <file>.snapshot --param ...
+which is printed with the current rlt.* parameter values. With --timeline, rlttl.mode is used instead and the stage
+timing of the latest/first CONTROLLER_TIMELINE_RECORDER_LENGTH invocations is written in the format of
+sim/build/sim --timeline, for scripts/timeline_trace.py.
+
+Example:
+    python3 scripts/tracedump.py --uri radio://0/80/2M/E7E7E7E7E7 --arm ring
+    python3 scripts/tracedump.py --uri radio://0/80/2M/E7E7E7E7E7 --output anomaly.bin
+    python3 scripts/tracedump.py --uri radio://0/80/2M/E7E7E7E7E7 --timeline --output timeline.bin
+"""
+import argparse
+import struct
+import threading
+import time
+
+import cflib.crtp
+from cflib.crazyflie import Crazyflie
+from cflib.crazyflie.syncCrazyflie import SyncCrazyflie
+
+MEM_TYPE_APP = 0x18
+MAGIC = 0x43525452
+VERSION = 2
+HEADER = struct.Struct('<IHHIIHH')  # controller_trace_header_t
+TIMELINE_MAGIC = 0x4c545452
+TIMELINE_VERSION = 1
+TIMELINE_HEADER = struct.Struct('<IHHIII')  # controller_timeline_header_t
+MODES = {'stop': 0, 'ring': 1, 'one-shot': 2}
+
+
+def read_memory(cf, memory, address, length, timeout=30.0):
+    done = threading.Event()
+    result = {}
+
+    def new_data(mem, addr, data):
+        result['data'] = bytes(data)
+        done.set()
+
+    def new_data_failed(mem, addr, data=None):
+        done.set()
+
+    memory.new_data = new_data
+    memory.new_data_failed = new_data_failed
+    cf.mem.read(memory, address, length)
+    if not done.wait(timeout) or 'data' not in result:
+        raise RuntimeError(f"Reading {length} bytes at {address} failed (is the recorder stopped?)")
+    return result['data']
+
+
+def download(cf, magic, version, header_format):
+    """Finds the APP memory whose header starts with magic (both recorders register one), returns it and its header"""
+    memories = cf.mem.get_mems(MEM_TYPE_APP)
+    if not memories:
+        raise RuntimeError("No APP memory, the firmware is built without the recorders "
+                           "(CONTROLLER_TRACE_RECORDER_LENGTH, controller_timeline.o)")
+    for attempt in range(10):
+        # The mode write is asynchronous, reads fail until the recorder has stopped. The other recorder's memory
+        # is not readable while that one is running.
+        for memory in memories:
+            try:
+                header = read_memory(cf, memory, 0, header_format.size, timeout=2.0)
+            except RuntimeError:
+                continue
+            fields = header_format.unpack(header)
+            if fields[0] == magic:
+                break
+        else:
+            if attempt == 9:
+                raise RuntimeError(f"No stopped recorder with magic {magic:#x} found")
+            time.sleep(0.2)
+            continue
+        break
+    if fields[1] != version:
+        raise RuntimeError(f"Unexpected recorder header (magic {magic:#x}, version {fields[1]})")
+    return memory, header, fields
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Arm or download the on-board controller trace recorder.")
+    parser.add_argument('--uri', default='radio://0/80/2M/E7E7E7E7E7')
+    parser.add_argument('--arm', choices=list(MODES), default=None, help="Only set rltrec.mode (rlttl.mode) and exit")
+    parser.add_argument('--timeline', action='store_true', help="Stage timeline recorder instead of the trace recorder")
+    parser.add_argument('--output', default=None, help="Default: trace.bin, timeline.bin with --timeline")
+    args = parser.parse_args()
+    mode_parameter = 'rlttl.mode' if args.timeline else 'rltrec.mode'
+    output = args.output or ('timeline.bin' if args.timeline else 'trace.bin')
+
+    cflib.crtp.init_drivers()
+    if args.uri.startswith('sim://'):
+        import simlink
+        simlink.register_driver()
+
+    with SyncCrazyflie(args.uri, cf=Crazyflie(rw_cache='./build/cache')) as scf:
+        cf = scf.cf
+        if args.arm is not None:
+            cf.param.set_value(mode_parameter, MODES[args.arm])
+            print(f"Recorder mode: {args.arm}")
+            return
+        cf.param.set_value(mode_parameter, MODES['stop'])
+        snapshot = b''
+        if args.timeline:
+            memory, header, fields = download(cf, TIMELINE_MAGIC, TIMELINE_VERSION, TIMELINE_HEADER)
+            _, _, record_size, _, count, dropped = fields
+            records = read_memory(cf, memory, TIMELINE_HEADER.size, count * record_size) if count else b''
+        else:
+            memory, header, fields = download(cf, MAGIC, VERSION, HEADER)
+            _, _, record_size, count, dropped, snapshot_size, _ = fields
+            if snapshot_size:
+                snapshot = read_memory(cf, memory, HEADER.size, snapshot_size)
+            records = read_memory(cf, memory, HEADER.size + snapshot_size, count * record_size) if count else b''
+        with open(output, 'wb') as f:
+            if args.timeline:
+                f.write(header)  # timeline files keep the header (clock_hz)
+            f.write(records)
+        replay = f"sim/build/replay {output}"
+        if snapshot:
+            with open(output + '.snapshot', 'wb') as f:
+                f.write(snapshot)
+            replay += f" --snapshot {output}.snapshot"
+        ticks = [struct.unpack_from('<I', records, i * record_size)[0] for i in range(count)]
+        span = f", ticks {ticks[0]}..{ticks[-1]}" if ticks else ""
+        print(f"{count} records ({record_size} bytes each{span}, {dropped} dropped) written to {output}")
+        if args.timeline:
+            print(f"Convert: python3 scripts/timeline_trace.py {output} --output {output.rsplit('.', 1)[0]}.json")
+            return
+        names = sorted(cf.param.values.get('rlt', {}))
+        params = ' '.join(f"--param rlt.{name}={cf.param.get_value(f'rlt.{name}')}" for name in names)
+        print(f"Replay: {replay} {params}")
+
+
+if __name__ == '__main__':
+    main()
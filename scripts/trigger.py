@@ -164,6 +164,9 @@ if __name__ == '__main__':
     args = parser.parse_args()
     uri = uri_helper.uri_from_env(default=default_uri)
     cflib.crtp.init_drivers()
+    if uri.startswith('sim://'):
+        import simlink
+        simlink.register_driver()
 
     cf = Crazyflie(rw_cache='./build/cache')
 
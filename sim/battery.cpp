@@ -0,0 +1,88 @@
+#include "battery.h"
+
+#include <cmath>
+
+static constexpr float OCV_SOC[] = {0.0f, 0.1f, 0.3f, 0.5f, 0.7f, 0.9f, 1.0f};
+static constexpr float OCV_VOLTAGE[] = {3.2f, 3.6f, 3.72f, 3.8f, 3.9f, 4.05f, 4.2f};
+static constexpr int OCV_POINTS = sizeof(OCV_SOC) / sizeof(OCV_SOC[0]);
+static constexpr int BACK_EMF_ITERATIONS = 8; // fixed point of the supply sag under the motor current
+
+float battery_open_circuit_voltage(float state_of_charge){
+    if(state_of_charge <= OCV_SOC[0]){
+        return OCV_VOLTAGE[0];
+    }
+    for(int point_i = 1; point_i < OCV_POINTS; point_i++){
+        if(state_of_charge <= OCV_SOC[point_i]){
+            float alpha = (state_of_charge - OCV_SOC[point_i - 1]) / (OCV_SOC[point_i] - OCV_SOC[point_i - 1]);
+            return OCV_VOLTAGE[point_i - 1] + alpha * (OCV_VOLTAGE[point_i] - OCV_VOLTAGE[point_i - 1]);
+        }
+    }
+    return OCV_VOLTAGE[OCV_POINTS - 1];
+}
+
+void battery_step(const BatteryParameters& parameters, BatteryState& state, const float pwm_ratio[4], const float rpm_fraction[4], float dt){
+    if(parameters.capacity <= 0){
+        state.voltage = parameters.nominal_voltage;
+        state.current = 0;
+        return;
+    }
+    float current = 0;
+    for(int motor_i = 0; motor_i < 4; motor_i++){
+        float f = rpm_fraction[motor_i];
+        if(parameters.motor_model == BATTERY_MOTOR_BACK_EMF){
+            // The propeller load sets the motor current, the battery supplies it while the PWM is on
+            current += pwm_ratio[motor_i] * parameters.max_motor_current * f * f;
+        }
+        else{
+            current += parameters.max_motor_current * f * f * f;
+        }
+    }
+    state.current = current;
+    state.state_of_charge -= current * dt / (parameters.capacity * 3.6f);
+    state.state_of_charge = state.state_of_charge < 0 ? 0 : state.state_of_charge;
+    state.voltage = battery_open_circuit_voltage(state.state_of_charge) - current * parameters.internal_resistance;
+}
+
+float battery_motor_rpm_fraction(const BatteryParameters& parameters, float pwm_ratio, float voltage){
+    if(parameters.capacity <= 0){
+        return pwm_ratio;
+    }
+    float fraction = pwm_ratio * voltage / parameters.nominal_voltage;
+    return fraction > 1 ? 1 : fraction;
+}
+
+// Steady state of motor_voltage = R I + k_e w with I = I_max w^2 (w: fraction of the max RPM), k_e such that the
+// motor reaches the max RPM at nominal_voltage
+static float back_emf_rpm_fraction(const BatteryParameters& parameters, float motor_voltage){
+    float a = parameters.motor_resistance * parameters.max_motor_current;
+    float k_e = parameters.nominal_voltage - a;
+    motor_voltage = motor_voltage < 0 ? 0 : motor_voltage;
+    return (-k_e + std::sqrt(k_e * k_e + 4 * a * motor_voltage)) / (2 * a);
+}
+
+void battery_motor_rpm_fractions(const BatteryParameters& parameters, const BatteryState& state, float voltage, const float pwm_ratio[4], float rpm_fraction[4]){
+    if(parameters.motor_model != BATTERY_MOTOR_BACK_EMF){
+        for(int motor_i = 0; motor_i < 4; motor_i++){
+            rpm_fraction[motor_i] = battery_motor_rpm_fraction(parameters, pwm_ratio[motor_i], voltage);
+        }
+        return;
+    }
+    if(parameters.capacity <= 0){
+        for(int motor_i = 0; motor_i < 4; motor_i++){
+            rpm_fraction[motor_i] = back_emf_rpm_fraction(parameters, pwm_ratio[motor_i] * parameters.nominal_voltage);
+        }
+        return;
+    }
+    // The mean terminal voltage includes the sag of the mean current. While on (edge-aligned PWM, all motors switch
+    // on together), the motors draw their full current.
+    float open_circuit = voltage + state.current * parameters.internal_resistance;
+    float on_voltage = voltage;
+    for(int iteration_i = 0; iteration_i < BACK_EMF_ITERATIONS; iteration_i++){
+        float current = 0;
+        for(int motor_i = 0; motor_i < 4; motor_i++){
+            rpm_fraction[motor_i] = back_emf_rpm_fraction(parameters, pwm_ratio[motor_i] * on_voltage);
+            current += parameters.max_motor_current * rpm_fraction[motor_i] * rpm_fraction[motor_i];
+        }
+        on_voltage = open_circuit - current * parameters.internal_resistance;
+    }
+}
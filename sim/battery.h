@@ -0,0 +1,40 @@
+// LiPo discharge model and brushed-motor drive model for the host simulation
+#ifndef __SIM_BATTERY_H__
+#define __SIM_BATTERY_H__
+
+enum BatteryMotorModel{
+    // RPM follows the mean motor voltage PWM ratio * supply voltage (the assumption battery_comp.c is built on)
+    BATTERY_MOTOR_MEAN_VOLTAGE,
+    // DC motor with winding resistance, back-EMF and propeller load (current ~ rpm^2). While the PWM is on the motors
+    // draw their current through the battery's internal resistance, so they see a lower supply than the mean terminal
+    // voltage the firmware measures. Independent of the compensation's model, for validating it.
+    BATTERY_MOTOR_BACK_EMF,
+};
+
+struct BatteryParameters{
+    float capacity = 250; // mAh, 0 => ideal supply at nominal_voltage
+    float nominal_voltage = 4.2f;
+    float internal_resistance = 0.1f; // Ohm
+    float max_motor_current = 1.8f; // A per motor at max RPM
+    BatteryMotorModel motor_model = BATTERY_MOTOR_MEAN_VOLTAGE;
+    float motor_resistance = 0.8f; // Ohm, winding (BATTERY_MOTOR_BACK_EMF)
+};
+
+struct BatteryState{
+    float state_of_charge = 1;
+    float voltage = 4.2f; // mean terminal voltage
+    float current = 0; // mean
+};
+
+float battery_open_circuit_voltage(float state_of_charge);
+void battery_step(const BatteryParameters& parameters, BatteryState& state, const float pwm_ratio[4], const float rpm_fraction[4], float dt);
+// Command of the motor model (quadrotor_motor_rpm, fraction of the max RPM at nominal_voltage) for a PWM ratio (0..1)
+// and supply voltage: a brushed motor follows its mean voltage, PWM ratio * supply voltage, up to the RPM at
+// nominal_voltage. Independent of the firmware's thrust/voltage fit (motorsCompensateBatteryVoltage).
+float battery_motor_rpm_fraction(const BatteryParameters& parameters, float pwm_ratio, float voltage);
+// Steady-state commands of the four motors for their PWM ratios at the mean terminal voltage voltage of a battery
+// drawing state.current, for the parameters' motor model (the back-EMF model at nominal_voltage is the identity at
+// full PWM)
+void battery_motor_rpm_fractions(const BatteryParameters& parameters, const BatteryState& state, float voltage, const float pwm_ratio[4], float rpm_fraction[4]);
+
+#endif
@@ -0,0 +1,159 @@
+// Residual thrust error of the battery compensation (battery_comp.c) over a discharge
+// For each state of charge and motor command, the four motors and the battery are settled at their steady state (the
+// supply sags under the current, the firmware measures the mean terminal voltage) with the compensation off and on,
+// and the thrust (~ rpm^2) is compared with the thrust of the same command on the ideal 4.2 V supply the policy was
+// trained with. The compensation assumes that a motor follows its mean voltage, which the mean_voltage model shares
+// (its residual only shows saturation). The back_emf model (battery.h) does not: its motors see the supply sagging
+// under their full current while the PWM is on, which the mean terminal voltage underestimates. The firmware's thrust
+// fit (motorsCompensateBatteryVoltage) maps thrust to a mean motor voltage as well, so it is no independent check.
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "battery_comp.h"
+}
+#include "battery.h"
+
+constexpr int SETTLE_ITERATIONS = 50;
+
+struct Config{
+    std::vector<float> commands = {0.3f, 0.5f, 0.7f, 0.9f};
+    float soc_step = 0.1f;
+    float tolerance = 0; // max |error| of the compensated back-EMF thrust outside saturation, 0 = report only
+    BatteryParameters battery;
+};
+
+static void usage(const char* name){
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --commands <c,c,...>      motor commands, fraction of the PWM range (default 0.3,0.5,0.7,0.9)\n"
+        "  --soc-step <fraction>     state of charge step (default 0.1)\n"
+        "  --internal-resistance <Ohm>  battery (default 0.1)\n"
+        "  --motor-resistance <Ohm>  winding, back_emf model (default 0.8)\n"
+        "  --tolerance <fraction>    fail if the compensated back_emf thrust error exceeds it outside saturation\n", name);
+}
+
+static bool parse(int argc, char** argv, Config& config){
+    for(int arg_i = 1; arg_i < argc; arg_i++){
+        std::string arg = argv[arg_i];
+        bool has_value = arg_i + 1 < argc;
+        if(has_value && arg == "--commands"){
+            config.commands.clear();
+            for(char* token = argv[++arg_i]; *token != 0;){
+                char* end;
+                config.commands.push_back(strtof(token, &end));
+                if(end == token || config.commands.back() < 0 || config.commands.back() > 1){
+                    return false;
+                }
+                token = *end == ',' ? end + 1 : end;
+            }
+        }
+        else if(has_value && arg == "--soc-step"){
+            config.soc_step = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--internal-resistance"){
+            config.battery.internal_resistance = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--motor-resistance"){
+            config.battery.motor_resistance = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--tolerance"){
+            config.tolerance = strtof(argv[++arg_i], nullptr);
+        }
+        else{
+            return false;
+        }
+    }
+    return !config.commands.empty() && config.soc_step > 0 && config.battery.motor_resistance > 0;
+}
+
+struct Operating{
+    float voltage; // mean terminal voltage, as measured by the firmware
+    float thrust_error; // relative to the ideal supply
+    bool saturated; // compensated command capped to the PWM range
+};
+
+static float ideal_rpm_fraction(const BatteryParameters& parameters, float command){
+    BatteryParameters ideal = parameters;
+    ideal.capacity = 0;
+    float ratio[4] = {command, command, command, command};
+    float fraction[4];
+    battery_motor_rpm_fractions(ideal, BatteryState{}, ideal.nominal_voltage, ratio, fraction);
+    return fraction[0];
+}
+
+static Operating settle(const BatteryParameters& parameters, float state_of_charge, float command, bool compensate){
+    BatteryState state;
+    state.state_of_charge = state_of_charge;
+    state.voltage = battery_open_circuit_voltage(state_of_charge);
+    battery_comp_t comp;
+    battery_comp_init(&comp);
+    uint16_t command_pwm = (uint16_t)(command * UINT16_MAX + 0.5f);
+    Operating operating = {};
+    float fraction[4] = {0, 0, 0, 0};
+    for(int iteration_i = 0; iteration_i < SETTLE_ITERATIONS; iteration_i++){
+        uint16_t pwm = command_pwm;
+        if(compensate){
+            battery_comp_update(&comp, state.voltage, 0);
+            pwm = battery_comp_apply(&comp, command_pwm);
+        }
+        operating.saturated = compensate && pwm == UINT16_MAX && command_pwm != UINT16_MAX;
+        float r = pwm / (float)UINT16_MAX;
+        float ratio[4] = {r, r, r, r};
+        battery_motor_rpm_fractions(parameters, state, state.voltage, ratio, fraction);
+        battery_step(parameters, state, ratio, fraction, 0);
+    }
+    float reference = ideal_rpm_fraction(parameters, command);
+    operating.voltage = state.voltage;
+    operating.thrust_error = reference > 0 ? fraction[0] * fraction[0] / (reference * reference) - 1 : 0;
+    return operating;
+}
+
+int main(int argc, char** argv){
+    Config config;
+    if(!parse(argc, argv, config)){
+        usage(argv[0]);
+        return 1;
+    }
+    const BatteryMotorModel models[] = {BATTERY_MOTOR_MEAN_VOLTAGE, BATTERY_MOTOR_BACK_EMF};
+    const char* model_names[] = {"mean_voltage", "back_emf"};
+    float max_error[2][2] = {}; // model, compensation (outside saturation)
+    for(int model_i = 0; model_i < 2; model_i++){
+        BatteryParameters parameters = config.battery;
+        parameters.motor_model = models[model_i];
+        printf("%s: thrust error vs. ideal 4.2 V supply, compensation off / on (* saturated)\n", model_names[model_i]);
+        printf("%5s %6s", "soc", "ocv");
+        for(float command : config.commands){
+            printf("   cmd %.2f: vbat     off      on", command);
+        }
+        printf("\n");
+        int steps = (int)std::lround(1 / config.soc_step);
+        for(int step_i = 0; step_i <= steps; step_i++){
+            float soc = 1 - step_i * config.soc_step;
+            soc = soc < 0 ? 0 : soc;
+            printf("%5.2f %6.3f", soc, battery_open_circuit_voltage(soc));
+            for(float command : config.commands){
+                Operating off = settle(parameters, soc, command, false);
+                Operating on = settle(parameters, soc, command, true);
+                printf("        %6.3f %+6.1f%% %+6.1f%%%c", on.voltage, 100 * off.thrust_error, 100 * on.thrust_error, on.saturated ? '*' : ' ');
+                max_error[model_i][0] = std::fmax(max_error[model_i][0], std::fabs(off.thrust_error));
+                if(!on.saturated){
+                    max_error[model_i][1] = std::fmax(max_error[model_i][1], std::fabs(on.thrust_error));
+                }
+            }
+            printf("\n");
+        }
+        printf("\n");
+    }
+    for(int model_i = 0; model_i < 2; model_i++){
+        printf("%-12s max |thrust error| compensation off %5.1f%%, on %5.1f%% (outside saturation)\n", model_names[model_i], 100 * max_error[model_i][0], 100 * max_error[model_i][1]);
+    }
+    if(config.tolerance > 0 && max_error[1][1] > config.tolerance){
+        fprintf(stderr, "back_emf: compensated thrust error %.1f%% exceeds the tolerance of %.1f%%\n", 100 * max_error[1][1], 100 * config.tolerance);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,37 @@
+# Classic controllers of the firmware (rlt.orig 1..4: PID, Mellinger, INDI, Brescianini) built from
+# external/crazyflie-firmware (git submodule update --init -- external/crazyflie-firmware) in place of the zero-output
+# stand-ins of firmware.c: make CLASSIC=1. Included by sim/Makefile and bench/Makefile after ROOT and BUILD are set.
+# The sources are compiled against the stand-ins in sim/firmware ahead of the firmware's headers, so they share the
+# structure layouts (setpoint_t, state_t, control_t) of the code they are linked with; only the controllers' own
+# headers and the firmware's math3d.h come from the firmware tree.
+CLASSIC ?= 0
+CLASSIC_FIRMWARE := $(ROOT)/external/crazyflie-firmware
+CLASSIC_SOURCES := \
+	src/modules/src/controller/controller_pid.c \
+	src/modules/src/controller/attitude_pid_controller.c \
+	src/modules/src/controller/position_controller_pid.c \
+	src/modules/src/controller/controller_mellinger.c \
+	src/modules/src/controller/controller_indi.c \
+	src/modules/src/controller/position_controller_indi.c \
+	src/modules/src/controller/controller_brescianini.c \
+	src/utils/src/pid.c \
+	src/utils/src/filter.c \
+	src/utils/src/num.c
+ifeq ($(CLASSIC),1)
+CLASSIC_MISSING := $(filter-out $(wildcard $(addprefix $(CLASSIC_FIRMWARE)/,$(CLASSIC_SOURCES))),$(addprefix $(CLASSIC_FIRMWARE)/,$(CLASSIC_SOURCES)))
+ifneq ($(CLASSIC_MISSING),)
+$(error CLASSIC=1: $(words $(CLASSIC_MISSING)) of the classic controller sources are missing, e.g. $(firstword $(CLASSIC_MISSING)) (git submodule update --init -- external/crazyflie-firmware))
+endif
+CLASSIC_OBJS += $(addprefix $(BUILD)/classic/,$(notdir $(CLASSIC_SOURCES:.c=.o)))
+endif
+CLASSIC_CPPFLAGS = -I$(CLASSIC_FIRMWARE)/src/modules/interface/controller $(CPPFLAGS) -DSIM_FIRMWARE_MATH3D \
+	-I$(CLASSIC_FIRMWARE)/src/modules/interface -I$(CLASSIC_FIRMWARE)/src/utils/interface \
+	-I$(CLASSIC_FIRMWARE)/src/config -I$(CLASSIC_FIRMWARE)/src/platform/interface
+
+$(BUILD)/classic/%.o: $(CLASSIC_FIRMWARE)/src/modules/src/controller/%.c
+	@mkdir -p $(@D)
+	$(CC) $(CLASSIC_CPPFLAGS) $(CFLAGS) -c -o $@ $<
+
+$(BUILD)/classic/%.o: $(CLASSIC_FIRMWARE)/src/utils/src/%.c
+	@mkdir -p $(@D)
+	$(CC) $(CLASSIC_CPPFLAGS) $(CFLAGS) -c -o $@ $<
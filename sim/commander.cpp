@@ -0,0 +1,603 @@
+// Paced flight commander
+// Sends the trigger (META_COMMAND) / TYPE_HOVER / TYPE_POSITION packets of scripts/trigger.py from an epoll loop on an
+// absolute timerfd schedule, so the packet interval seen by CONTROL_PACKET_TIMEOUT_USEC does not depend on the
+// scheduling jitter of a Python sleep loop. The lateness of every send and the link round trip (linkctrl echo) are
+// recorded. The commander speaks CRTP over UDP, i.e. to sim_link (sim://127.0.0.1:19850) or a CRTP-over-UDP bridge.
+// In swarm_trajectory mode the setpoints of --vehicles drones are packed into broadcast swarm setpoint frames
+// (swarm_setpoint.h); each vehicle takes the slot of its rltsw.id.
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "firmware/param.h"
+#include "swarm_setpoint.h"
+}
+#include "crtp.h"
+
+constexpr int REQUEST_TIMEOUT_MS = 200;
+constexpr int REQUEST_RETRIES = 5;
+constexpr int STOP_PACKETS = 3;
+
+enum class Mode{
+    HOVER_LEARNED,
+    HOVER_ORIGINAL,
+    TAKEOFF_AND_SWITCH,
+    TRAJECTORY_TRACKING,
+    NORMAL_TRAJECTORY,
+    SWARM_TRAJECTORY
+};
+
+struct Config{
+    std::string host = "127.0.0.1";
+    uint16_t port = 19850;
+    Mode mode = Mode::HOVER_LEARNED;
+    float rate = 100; // packets/s
+    float duration = 0; // 0 = until SIGINT
+    float height = 0.5;
+    float trajectory_scale = 0.3;
+    float trajectory_interval = 5.5;
+    float transition_timeout = 3;
+    float center[2] = {0, 0};
+    unsigned vehicles = 1;
+    float spacing = 1.5; // [m] between the figure eight centers of consecutive drone ids
+    float echo_rate = 10;
+    std::vector<std::string> params;
+    const char* timing_output = nullptr;
+    bool console = false;
+};
+
+struct ParamEntry{
+    uint16_t id;
+    uint8_t type;
+};
+
+struct Commander{
+    Config config;
+    int socket_fd = -1;
+    std::map<std::string, ParamEntry> params;
+    int64_t start_ns = 0;
+    uint64_t ticks = 0; // scheduled ticks elapsed
+    uint64_t packets = 0;
+    uint64_t missed_ticks = 0;
+    uint32_t echo_sequence = 0;
+    uint8_t swarm_frame = 0;
+    std::vector<double> lateness_us;
+    std::vector<double> round_trip_us;
+    FILE* timing = nullptr;
+};
+
+static int64_t now_ns(){
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool send_packet(const Commander& commander, uint8_t port, uint8_t channel, const uint8_t* data, size_t size){
+    uint8_t buffer[1 + CRTP_MAX_DATA_SIZE];
+    buffer[0] = crtp_header(port, channel);
+    memcpy(buffer + 1, data, size);
+    return send(commander.socket_fd, buffer, 1 + size, 0) == (ssize_t)(1 + size);
+}
+
+static void handle_console(const Commander& commander, const uint8_t* data, size_t size){
+    if(commander.config.console){
+        fwrite(data, 1, size, stdout);
+        fflush(stdout);
+    }
+}
+
+// Synchronous request/response used during setup (TOC download, param writes), before the paced loop starts
+template <typename MATCH>
+static bool request(const Commander& commander, uint8_t port, uint8_t channel, const uint8_t* data, size_t size, MATCH match, uint8_t* response, size_t& response_size){
+    for(int attempt = 0; attempt < REQUEST_RETRIES; attempt++){
+        send_packet(commander, port, channel, data, size);
+        int64_t deadline = now_ns() + (int64_t)REQUEST_TIMEOUT_MS * 1000000;
+        while(true){
+            int remaining_ms = (int)((deadline - now_ns()) / 1000000);
+            if(remaining_ms <= 0){
+                break;
+            }
+            pollfd fd = {commander.socket_fd, POLLIN, 0};
+            if(poll(&fd, 1, remaining_ms) <= 0){
+                break;
+            }
+            uint8_t buffer[64];
+            ssize_t received = recv(commander.socket_fd, buffer, sizeof(buffer), 0);
+            if(received < 1){
+                continue;
+            }
+            uint8_t received_port = crtp_port(buffer[0]);
+            if(received_port == CRTP_PORT_CONSOLE){
+                handle_console(commander, buffer + 1, received - 1);
+            }
+            if(received_port == port && crtp_channel(buffer[0]) == channel && match(buffer + 1, (size_t)(received - 1))){
+                response_size = received - 1;
+                memcpy(response, buffer + 1, response_size);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool fetch_param_toc(Commander& commander){
+    uint8_t response[CRTP_MAX_DATA_SIZE];
+    size_t response_size;
+    uint8_t info[] = {CMD_TOC_INFO_V2};
+    auto is_info = [](const uint8_t* data, size_t size){ return size >= 3 && data[0] == CMD_TOC_INFO_V2; };
+    if(!request(commander, CRTP_PORT_PARAM, TOC_CHANNEL, info, sizeof(info), is_info, response, response_size)){
+        return false;
+    }
+    uint16_t count = response[1] | response[2] << 8;
+    for(uint16_t id = 0; id < count; id++){
+        uint8_t item[] = {CMD_TOC_ITEM_V2, (uint8_t)(id & 0xFF), (uint8_t)(id >> 8)};
+        auto is_item = [id](const uint8_t* data, size_t size){ return size >= 4 && data[0] == CMD_TOC_ITEM_V2 && (data[1] | data[2] << 8) == id; };
+        if(!request(commander, CRTP_PORT_PARAM, TOC_CHANNEL, item, sizeof(item), is_item, response, response_size)){
+            return false;
+        }
+        const char* group = (const char*)response + 4;
+        size_t group_length = strnlen(group, response_size - 4);
+        if(4 + group_length + 1 >= response_size){
+            return false;
+        }
+        const char* name = group + group_length + 1;
+        std::string full_name = std::string(group, group_length) + "." + std::string(name, strnlen(name, response_size - 4 - group_length - 1));
+        commander.params[full_name] = {id, response[3]};
+    }
+    return true;
+}
+
+static size_t encode_param(uint8_t type, float value, uint8_t* out){
+    switch(type & ~PARAM_RONLY){
+        case PARAM_UINT8:  { uint8_t v = (uint8_t)value; memcpy(out, &v, 1); return 1; }
+        case PARAM_INT8:   { int8_t v = (int8_t)value; memcpy(out, &v, 1); return 1; }
+        case PARAM_UINT16: { uint16_t v = (uint16_t)value; memcpy(out, &v, 2); return 2; }
+        case PARAM_INT16:  { int16_t v = (int16_t)value; memcpy(out, &v, 2); return 2; }
+        case PARAM_UINT32: { uint32_t v = (uint32_t)value; memcpy(out, &v, 4); return 4; }
+        case PARAM_INT32:  { int32_t v = (int32_t)value; memcpy(out, &v, 4); return 4; }
+        case PARAM_FLOAT:  { memcpy(out, &value, 4); return 4; }
+        default: return 0;
+    }
+}
+
+static bool set_param(const Commander& commander, const std::string& assignment){
+    size_t separator = assignment.find('=');
+    if(separator == std::string::npos){
+        fprintf(stderr, "invalid parameter assignment: %s\n", assignment.c_str());
+        return false;
+    }
+    std::string name = assignment.substr(0, separator);
+    auto entry = commander.params.find(name);
+    if(entry == commander.params.end()){
+        fprintf(stderr, "unknown parameter: %s\n", name.c_str());
+        return false;
+    }
+    uint16_t id = entry->second.id;
+    uint8_t packet[2 + 4] = {(uint8_t)(id & 0xFF), (uint8_t)(id >> 8)};
+    size_t value_size = encode_param(entry->second.type, strtof(assignment.c_str() + separator + 1, nullptr), packet + 2);
+    if(value_size == 0){
+        fprintf(stderr, "unsupported parameter type: %s\n", name.c_str());
+        return false;
+    }
+    uint8_t response[CRTP_MAX_DATA_SIZE];
+    size_t response_size;
+    auto is_echo = [id](const uint8_t* data, size_t size){ return size >= 2 && (data[0] | data[1] << 8) == id; };
+    if(!request(commander, CRTP_PORT_PARAM, PARAM_WRITE_CHANNEL, packet, 2 + value_size, is_echo, response, response_size)){
+        fprintf(stderr, "no response setting %s\n", assignment.c_str());
+        return false;
+    }
+    fprintf(stderr, "Parameter %s\n", assignment.c_str());
+    return true;
+}
+
+static std::vector<std::string> mode_params(const Config& config){
+    auto assign = [](const char* name, float value){ return std::string(name) + "=" + std::to_string(value); };
+    std::vector<std::string> params = {assign("rlt.trigger", 0)};
+    switch(config.mode){
+        case Mode::HOVER_LEARNED:
+            params.push_back(assign("rlt.wn", 1));
+            params.push_back(assign("rlt.motor_warmup", 1));
+            params.push_back(assign("rlt.target_z", config.height));
+            break;
+        case Mode::HOVER_ORIGINAL:
+            break;
+        case Mode::TAKEOFF_AND_SWITCH:
+            params.push_back(assign("rlt.wn", 1));
+            params.push_back(assign("rlt.target_z", 0));
+            params.push_back(assign("rlt.motor_warmup", 0));
+            break;
+        case Mode::TRAJECTORY_TRACKING:
+            params.push_back(assign("rlt.motor_warmup", 0));
+            params.push_back(assign("rlt.wn", 4));
+            params.push_back(assign("rlt.fei", config.trajectory_interval));
+            params.push_back(assign("rlt.fes", config.trajectory_scale));
+            params.push_back(assign("rlt.target_z", config.height));
+            break;
+        case Mode::NORMAL_TRAJECTORY:
+        case Mode::SWARM_TRAJECTORY:
+            params.push_back(assign("rlt.motor_warmup", 0));
+            params.push_back(assign("rlt.wn", 0));
+            break;
+    }
+    params.insert(params.end(), config.params.begin(), config.params.end());
+    return params;
+}
+
+static void send_hover(const Commander& commander, float height){
+    uint8_t data[17] = {TYPE_HOVER};
+    float values[4] = {0, 0, 0, height}; // vx, vy, yawrate, z
+    memcpy(data + 1, values, sizeof(values));
+    send_packet(commander, CRTP_PORT_COMMANDER_GENERIC, SET_SETPOINT_CHANNEL, data, sizeof(data));
+}
+
+static void send_position(const Commander& commander, float x, float y, float z){
+    uint8_t data[17] = {TYPE_POSITION};
+    float values[4] = {x, y, z, 0}; // x, y, z, yaw
+    memcpy(data + 1, values, sizeof(values));
+    send_packet(commander, CRTP_PORT_COMMANDER_GENERIC, SET_SETPOINT_CHANNEL, data, sizeof(data));
+}
+
+static void send_trigger(const Commander& commander){
+    uint8_t data[] = {META_RL_TOOLS_TRIGGER};
+    send_packet(commander, CRTP_PORT_COMMANDER_GENERIC, META_COMMAND_CHANNEL, data, sizeof(data));
+}
+
+static void send_stop(const Commander& commander){
+    uint8_t data[] = {TYPE_STOP};
+    send_packet(commander, CRTP_PORT_COMMANDER_GENERIC, SET_SETPOINT_CHANNEL, data, sizeof(data));
+}
+
+// Same figure eight the firmware generates in FIGURE_EIGHT mode, streamed as absolute setpoints for NORMAL mode
+static void send_figure_eight(const Commander& commander, float t){
+    const Config& config = commander.config;
+    float phase = t / config.trajectory_interval * 2 * (float)M_PI + (float)M_PI / 2;
+    float x = config.center[0] + cosf(phase) * config.trajectory_scale;
+    float y = config.center[1] + sinf(2 * phase) / 2.0f * config.trajectory_scale;
+    send_position(commander, x, y, config.height);
+}
+
+// One frame of figure eights for drone ids 0..vehicles-1, each centered spacing further along x; the broadcast frame
+// is the trigger as well
+static void send_swarm_frame(Commander& commander, float t){
+    const Config& config = commander.config;
+    float phase = t / config.trajectory_interval * 2 * (float)M_PI + (float)M_PI / 2;
+    float speed = 2 * (float)M_PI / config.trajectory_interval * config.trajectory_scale;
+    for(unsigned first_id = 0; first_id < config.vehicles; first_id += SWARM_SETPOINT_SLOTS){
+        swarm_setpoint_target_t targets[SWARM_SETPOINT_SLOTS];
+        uint8_t count = (uint8_t)std::min<unsigned>(SWARM_SETPOINT_SLOTS, config.vehicles - first_id);
+        for(uint8_t slot_i = 0; slot_i < count; slot_i++){
+            swarm_setpoint_target_t& target = targets[slot_i];
+            target.position[0] = config.center[0] + (first_id + slot_i) * config.spacing + cosf(phase) * config.trajectory_scale;
+            target.position[1] = config.center[1] + sinf(2 * phase) / 2.0f * config.trajectory_scale;
+            target.position[2] = config.height;
+            target.velocity[0] = -sinf(phase) * speed;
+            target.velocity[1] = cosf(2 * phase) * speed;
+            target.velocity[2] = 0;
+        }
+        uint8_t data[CRTP_MAX_DATA_SIZE];
+        uint8_t size = swarm_setpoint_pack(data, commander.swarm_frame, (uint8_t)first_id, targets, count);
+        send_packet(commander, CRTP_PORT_PLATFORM, PLATFORM_APP_CHANNEL, data, size);
+    }
+    commander.swarm_frame++;
+}
+
+static void tick(Commander& commander, float t){
+    const Config& config = commander.config;
+    bool transition = t < config.transition_timeout;
+    switch(config.mode){
+        case Mode::HOVER_LEARNED:
+            send_trigger(commander);
+            break;
+        case Mode::HOVER_ORIGINAL:
+            send_hover(commander, config.height);
+            break;
+        case Mode::TAKEOFF_AND_SWITCH:
+        case Mode::TRAJECTORY_TRACKING:
+            if(transition){
+                send_hover(commander, config.height);
+            }
+            else{
+                send_trigger(commander);
+            }
+            break;
+        case Mode::NORMAL_TRAJECTORY:
+            if(transition){
+                send_hover(commander, config.height);
+            }
+            else{
+                // Setpoint first so it is in place when the trigger activates the controller
+                send_figure_eight(commander, t - config.transition_timeout);
+                send_trigger(commander);
+            }
+            break;
+        case Mode::SWARM_TRAJECTORY:
+            if(transition){
+                send_hover(commander, config.height);
+            }
+            else{
+                send_swarm_frame(commander, t - config.transition_timeout);
+            }
+            break;
+    }
+    commander.packets++;
+}
+
+static void send_echo(Commander& commander){
+    uint8_t data[12];
+    uint32_t sequence = commander.echo_sequence++;
+    int64_t timestamp = now_ns();
+    memcpy(data, &sequence, 4);
+    memcpy(data + 4, &timestamp, 8);
+    send_packet(commander, CRTP_PORT_LINKCTRL, LINKCTRL_ECHO_CHANNEL, data, sizeof(data));
+}
+
+static void receive(Commander& commander){
+    uint8_t buffer[64];
+    while(true){
+        ssize_t size = recv(commander.socket_fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if(size < 1){
+            return;
+        }
+        uint8_t port = crtp_port(buffer[0]);
+        if(port == CRTP_PORT_CONSOLE){
+            handle_console(commander, buffer + 1, size - 1);
+        }
+        else if(port == CRTP_PORT_LINKCTRL && crtp_channel(buffer[0]) == LINKCTRL_ECHO_CHANNEL && size == 1 + 12){
+            uint32_t sequence;
+            int64_t timestamp;
+            memcpy(&sequence, buffer + 1, 4);
+            memcpy(&timestamp, buffer + 5, 8);
+            int64_t now = now_ns();
+            double round_trip = (now - timestamp) / 1e3;
+            commander.round_trip_us.push_back(round_trip);
+            if(commander.timing){
+                fprintf(commander.timing, "echo,%u,%.1f,%.1f\n", sequence, (now - commander.start_ns) / 1e3, round_trip);
+            }
+        }
+    }
+}
+
+static int make_timer(int64_t start_ns, double interval_s){
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    int64_t interval_ns = (int64_t)(interval_s * 1e9);
+    itimerspec spec = {};
+    spec.it_interval.tv_sec = interval_ns / 1000000000;
+    spec.it_interval.tv_nsec = interval_ns % 1000000000;
+    spec.it_value.tv_sec = start_ns / 1000000000;
+    spec.it_value.tv_nsec = start_ns % 1000000000;
+    timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+    return fd;
+}
+
+static double percentile(std::vector<double> values, double p){
+    if(values.empty()){
+        return NAN;
+    }
+    std::sort(values.begin(), values.end());
+    return values[(size_t)(p * (values.size() - 1) + 0.5)];
+}
+
+static void report(const Commander& commander, int64_t end_ns){
+    double elapsed = (end_ns - commander.start_ns) / 1e9;
+    fprintf(stderr, "Sent %llu ticks in %.2fs (%.2f/s, target %.2f/s), %llu missed\n", (unsigned long long)commander.packets, elapsed,
+        commander.packets / elapsed, commander.config.rate, (unsigned long long)commander.missed_ticks);
+    fprintf(stderr, "Send lateness [us]: median %.1f, p99 %.1f, max %.1f\n", percentile(commander.lateness_us, 0.5),
+        percentile(commander.lateness_us, 0.99), percentile(commander.lateness_us, 1.0));
+    fprintf(stderr, "Round trip [us]: median %.1f, p99 %.1f, max %.1f (%zu/%u echoes returned)\n", percentile(commander.round_trip_us, 0.5),
+        percentile(commander.round_trip_us, 0.99), percentile(commander.round_trip_us, 1.0), commander.round_trip_us.size(), commander.echo_sequence);
+}
+
+static bool parse_mode(const std::string& name, Mode& mode){
+    if(name == "hover_learned"){ mode = Mode::HOVER_LEARNED; return true; }
+    if(name == "hover_original"){ mode = Mode::HOVER_ORIGINAL; return true; }
+    if(name == "takeoff_and_switch"){ mode = Mode::TAKEOFF_AND_SWITCH; return true; }
+    if(name == "trajectory_tracking"){ mode = Mode::TRAJECTORY_TRACKING; return true; }
+    if(name == "normal_trajectory"){ mode = Mode::NORMAL_TRAJECTORY; return true; }
+    if(name == "swarm_trajectory"){ mode = Mode::SWARM_TRAJECTORY; return true; }
+    return false;
+}
+
+static bool parse(int argc, char** argv, Config& config){
+    for(int arg_i = 1; arg_i < argc; arg_i++){
+        std::string arg = argv[arg_i];
+        bool has_value = arg_i + 1 < argc;
+        if(arg == "--console"){
+            config.console = true;
+        }
+        else if(has_value && arg == "--host"){
+            config.host = argv[++arg_i];
+        }
+        else if(has_value && arg == "--port"){
+            config.port = (uint16_t)atoi(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--mode"){
+            if(!parse_mode(argv[++arg_i], config.mode)){
+                return false;
+            }
+        }
+        else if(has_value && arg == "--rate"){
+            config.rate = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--duration"){
+            config.duration = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--height"){
+            config.height = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--trajectory-scale"){
+            config.trajectory_scale = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--trajectory-interval"){
+            config.trajectory_interval = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--transition-timeout"){
+            config.transition_timeout = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--center"){
+            if(sscanf(argv[++arg_i], "%f,%f", &config.center[0], &config.center[1]) != 2){
+                return false;
+            }
+        }
+        else if(has_value && arg == "--vehicles"){
+            config.vehicles = (unsigned)atoi(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--spacing"){
+            config.spacing = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--echo-rate"){
+            config.echo_rate = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--param"){
+            config.params.push_back(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--timing"){
+            config.timing_output = argv[++arg_i];
+        }
+        else{
+            return false;
+        }
+    }
+    return config.rate > 0 && config.echo_rate >= 0 && config.vehicles >= 1 && config.vehicles <= 256;
+}
+
+int main(int argc, char** argv){
+    Commander commander;
+    Config& config = commander.config;
+    if(!parse(argc, argv, config)){
+        fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --host <address>            CRTP-over-UDP endpoint (default 127.0.0.1, i.e. sim_link)\n"
+            "  --port <port>               (default 19850)\n"
+            "  --mode <mode>               hover_learned | hover_original | takeoff_and_switch | trajectory_tracking |\n"
+            "                              normal_trajectory | swarm_trajectory (default hover_learned)\n"
+            "  --rate <packets/s>          setpoint/trigger rate (default 100)\n"
+            "  --duration <s>              stop after this time (default: run until SIGINT)\n"
+            "  --height <m>                (default 0.5)\n"
+            "  --trajectory-scale <m>      figure eight scale (default 0.3)\n"
+            "  --trajectory-interval <s>   figure eight period (default 5.5)\n"
+            "  --transition-timeout <s>    hover time before switching to the learned controller (default 3)\n"
+            "  --center <x,y>              figure eight center in normal_trajectory mode (default 0,0)\n"
+            "  --vehicles <n>              drone ids 0..n-1 in the swarm_trajectory frames (default 1)\n"
+            "  --spacing <m>               x offset between the figure eights of consecutive ids (default 1.5)\n"
+            "  --echo-rate <Hz>            round-trip probes, 0 = off (default 10)\n"
+            "  --param <group.name=v>      set a parameter before starting, after the mode defaults (repeatable)\n"
+            "  --timing <file>             CSV of every send (lateness) and echo (round trip)\n"
+            "  --console                   print the firmware console\n", argv[0]);
+        return 1;
+    }
+
+    commander.socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(config.port);
+    if(commander.socket_fd < 0 || inet_pton(AF_INET, config.host.c_str(), &address.sin_addr) != 1 || connect(commander.socket_fd, (sockaddr*)&address, sizeof(address)) != 0){
+        perror("connect");
+        return 1;
+    }
+    if(!fetch_param_toc(commander)){
+        fprintf(stderr, "Could not download the parameter TOC from %s:%u\n", config.host.c_str(), config.port);
+        return 1;
+    }
+    for(const auto& param: mode_params(config)){
+        if(!set_param(commander, param)){
+            return 1;
+        }
+    }
+    if(config.timing_output){
+        commander.timing = fopen(config.timing_output, "w");
+        if(commander.timing == nullptr){
+            perror(config.timing_output);
+            return 1;
+        }
+        fprintf(commander.timing, "event,index,time (us),value (us)\n");
+    }
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, nullptr);
+    int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK);
+
+    double period = 1.0 / config.rate;
+    commander.start_ns = now_ns() + 1000000; // first tick 1ms from now
+    int tick_fd = make_timer(commander.start_ns, period);
+    int echo_fd = config.echo_rate > 0 ? make_timer(commander.start_ns, 1.0 / config.echo_rate) : -1;
+
+    int epoll_fd = epoll_create1(0);
+    for(int fd: {tick_fd, echo_fd, signal_fd, commander.socket_fd}){
+        if(fd >= 0){
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+        }
+    }
+
+    bool running = true;
+    while(running){
+        epoll_event events[4];
+        int count = epoll_wait(epoll_fd, events, 4, -1);
+        for(int event_i = 0; event_i < count; event_i++){
+            int fd = events[event_i].data.fd;
+            if(fd == tick_fd){
+                uint64_t expirations;
+                if(read(tick_fd, &expirations, sizeof(expirations)) != sizeof(expirations)){
+                    continue;
+                }
+                commander.missed_ticks += expirations - 1;
+                commander.ticks += expirations;
+                int64_t scheduled = commander.start_ns + (int64_t)((commander.ticks - 1) * period * 1e9);
+                float t = (scheduled - commander.start_ns) / 1e9f;
+                if(config.duration > 0 && t >= config.duration){
+                    running = false;
+                    break;
+                }
+                tick(commander, t);
+                double lateness = (now_ns() - scheduled) / 1e3;
+                commander.lateness_us.push_back(lateness);
+                if(commander.timing){
+                    fprintf(commander.timing, "send,%llu,%.1f,%.1f\n", (unsigned long long)(commander.ticks - 1), (scheduled - commander.start_ns) / 1e3, lateness);
+                }
+            }
+            else if(fd == echo_fd){
+                uint64_t expirations;
+                if(read(echo_fd, &expirations, sizeof(expirations)) == sizeof(expirations)){
+                    send_echo(commander);
+                }
+            }
+            else if(fd == signal_fd){
+                running = false;
+            }
+            else if(fd == commander.socket_fd){
+                receive(commander);
+            }
+        }
+    }
+    int64_t end = now_ns();
+    for(int i = 0; i < STOP_PACKETS; i++){
+        send_stop(commander);
+    }
+    report(commander, end);
+    if(commander.timing){
+        fclose(commander.timing);
+    }
+    return 0;
+}
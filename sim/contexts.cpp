@@ -0,0 +1,201 @@
+// Concurrent stepping of independent controller contexts (rl_tools_controller.h)
+// --contexts vehicles, each with its own controller and policy context, fly the POSITION mode from a ground grid on
+// the host quadrotor model (ideal supply, a trigger packet every tick); every --classic-every-th of them flies the
+// classic controllers behind rlt.orig=1..4 in turn instead of the policy. All flights run twice: on the calling thread,
+// one vehicle after the other, and spread over --threads threads that step their vehicles tick by tick at the same
+// time. Time and battery voltage are step inputs, so a policy vehicle has to fly bit for bit the same in both runs
+// (compared through a hash of its motor outputs and positions). The classic controllers are firmware singletons shared
+// by the vehicles that fall back to them (serialized by the controller), so their flights depend on the interleaving
+// and are only required to complete. Exits with 1 on a mismatch.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "rl_tools_controller.h"
+#include "rl_tools_adapter.h"
+void controllerOutOfTreeInit(void);
+bool controllerOutOfTreeTest(void);
+}
+#include "firmware.h"
+#include "simulation.h"
+
+constexpr float SUPPLY_VOLTAGE = 4.2f;
+constexpr uint64_t HASH_OFFSET = 1469598103934665603ull; // FNV-1a
+constexpr uint64_t HASH_PRIME = 1099511628211ull;
+
+struct Config{
+    unsigned contexts = 16;
+    unsigned threads = 0;
+    unsigned classic_every = 4; // 0 = policy only
+    float duration = 5;
+    float spacing = 1;
+    std::vector<std::string> params;
+    bool verbose = false;
+};
+
+struct Vehicle{
+    rl_tools_controller_context_t controller;
+    std::vector<unsigned char> policy;
+    QuadrotorState quadrotor;
+    uint16_t motor_ratio[RL_TOOLS_CONTROLLER_NUM_MOTORS] = {0, 0, 0, 0}; // the motors keep their ratio until set
+    uint64_t hash = HASH_OFFSET;
+    uint32_t active_ticks = 0;
+};
+
+static void usage(const char* name){
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --contexts <n>            vehicles, one controller and policy context each (default 16)\n"
+        "  --threads <n>             threads of the concurrent run (default: online CPUs, at least 2)\n"
+        "  --classic-every <n>       every n-th vehicle flies a classic controller, 0 = none (default 4)\n"
+        "  --duration <s>            simulated time per flight (default 5)\n"
+        "  --spacing <m>             distance of the vehicles on the ground grid (default 1)\n"
+        "  --param <group.name=v>    set a firmware parameter before the contexts are copied (repeatable)\n"
+        "  --verbose                 print DEBUG_PRINT output to stderr\n", name);
+}
+
+static bool parse(int argc, char** argv, Config& config){
+    for(int arg_i = 1; arg_i < argc; arg_i++){
+        std::string arg = argv[arg_i];
+        bool has_value = arg_i + 1 < argc;
+        if(has_value && arg == "--contexts"){
+            config.contexts = (unsigned)strtoul(argv[++arg_i], nullptr, 10);
+        }
+        else if(has_value && arg == "--threads"){
+            config.threads = (unsigned)strtoul(argv[++arg_i], nullptr, 10);
+        }
+        else if(has_value && arg == "--classic-every"){
+            config.classic_every = (unsigned)strtoul(argv[++arg_i], nullptr, 10);
+        }
+        else if(has_value && arg == "--duration"){
+            config.duration = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--spacing"){
+            config.spacing = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--param"){
+            config.params.push_back(argv[++arg_i]);
+        }
+        else if(arg == "--verbose"){
+            config.verbose = true;
+        }
+        else{
+            return false;
+        }
+    }
+    if(config.threads == 0){
+        config.threads = std::max(2u, std::thread::hardware_concurrency());
+    }
+    return config.contexts > 0 && config.duration > 0;
+}
+
+static void hash_bytes(uint64_t& hash, const void* data, size_t size){
+    for(size_t byte_i = 0; byte_i < size; byte_i++){
+        hash = (hash ^ ((const uint8_t*)data)[byte_i]) * HASH_PRIME;
+    }
+}
+
+// Vehicles start from the global context (parameters applied), each on its own policy context
+static std::vector<Vehicle> vehicles_init(const Config& config){
+    std::vector<Vehicle> vehicles(config.contexts);
+    unsigned columns = (unsigned)std::ceil(std::sqrt((float)config.contexts));
+    unsigned classic_i = 0;
+    for(unsigned vehicle_i = 0; vehicle_i < config.contexts; vehicle_i++){
+        Vehicle& vehicle = vehicles[vehicle_i];
+        vehicle.policy.resize(rl_tools_context_size());
+        vehicle.controller = *rl_tools_controller_context_global();
+        vehicle.controller.policy = rl_tools_context_init(vehicle.policy.data());
+        bool classic = config.classic_every > 0 && vehicle_i % config.classic_every == config.classic_every - 1;
+        vehicle.controller.use_orig_controller = classic ? (uint8_t)(1 + classic_i++ % 4) : 0;
+        vehicle.quadrotor.position[0] = (vehicle_i % columns) * config.spacing;
+        vehicle.quadrotor.position[1] = (vehicle_i / columns) * config.spacing;
+    }
+    return vehicles;
+}
+
+static void step(const QuadrotorParameters& parameters, Vehicle& vehicle, uint32_t tick){
+    uint64_t now = (uint64_t)tick * 1000000 / SIMULATION_STABILIZER_RATE;
+    rl_tools_controller_context_packet_received(&vehicle.controller, now);
+    state_t state = {};
+    sensorData_t sensors = {};
+    setpoint_t setpoint = {};
+    control_t control = {};
+    simulation_observe(parameters, vehicle.quadrotor, state, sensors);
+    rl_tools_controller_context_step(&vehicle.controller, &control, &setpoint, &sensors, &state, tick, now, SUPPLY_VOLTAGE);
+    float rpm_setpoint[4];
+    for(uint32_t motor_i = 0; motor_i < 4; motor_i++){
+        if(vehicle.controller.motor_output_set){
+            vehicle.motor_ratio[motor_i] = vehicle.controller.motor_output[motor_i];
+        }
+        rpm_setpoint[motor_i] = quadrotor_motor_rpm(parameters, vehicle.motor_ratio[motor_i] / (float)UINT16_MAX);
+    }
+    const float no_force[3] = {0, 0, 0};
+    quadrotor_step(parameters, vehicle.quadrotor, rpm_setpoint, no_force, 1.0f / SIMULATION_STABILIZER_RATE);
+    hash_bytes(vehicle.hash, vehicle.motor_ratio, sizeof(vehicle.motor_ratio));
+    hash_bytes(vehicle.hash, vehicle.quadrotor.position, sizeof(vehicle.quadrotor.position));
+    vehicle.active_ticks += vehicle.controller.log_set_motors;
+}
+
+int main(int argc, char** argv){
+    Config config;
+    if(!parse(argc, argv, config)){
+        usage(argv[0]);
+        return 1;
+    }
+    sim_firmware_set_verbose(config.verbose);
+    sim_firmware_set_time(0);
+    sim_firmware_set_battery_voltage(SUPPLY_VOLTAGE);
+    controllerOutOfTreeInit();
+    controllerOutOfTreeTest();
+    for(const auto& param: config.params){
+        if(!sim_firmware_set_param_string(param.c_str())){
+            fprintf(stderr, "unknown parameter assignment: %s\n", param.c_str());
+            return 1;
+        }
+    }
+    const QuadrotorParameters parameters;
+    const uint32_t ticks = (uint32_t)(config.duration * SIMULATION_STABILIZER_RATE);
+
+    std::vector<Vehicle> sequential = vehicles_init(config);
+    for(Vehicle& vehicle: sequential){
+        for(uint32_t tick = 0; tick < ticks; tick++){
+            step(parameters, vehicle, tick);
+        }
+    }
+
+    std::vector<Vehicle> concurrent = vehicles_init(config);
+    std::vector<std::thread> threads;
+    for(unsigned thread_i = 0; thread_i < config.threads; thread_i++){
+        threads.emplace_back([&, thread_i](){
+            for(uint32_t tick = 0; tick < ticks; tick++){
+                for(unsigned vehicle_i = thread_i; vehicle_i < concurrent.size(); vehicle_i += config.threads){
+                    step(parameters, concurrent[vehicle_i], tick);
+                }
+            }
+        });
+    }
+    for(auto& thread: threads){
+        thread.join();
+    }
+
+    unsigned policy_vehicles = 0, mismatches = 0;
+    printf("%7s %5s %8s %16s %16s\n", "context", "orig", "active", "sequential", "concurrent");
+    for(unsigned vehicle_i = 0; vehicle_i < config.contexts; vehicle_i++){
+        const Vehicle& a = sequential[vehicle_i];
+        const Vehicle& b = concurrent[vehicle_i];
+        bool policy = a.controller.use_orig_controller == 0;
+        bool match = a.hash == b.hash && a.active_ticks == b.active_ticks;
+        policy_vehicles += policy;
+        mismatches += policy && !match;
+        printf("%7u %5u %7.1f%% %016llx %016llx%s\n", vehicle_i, a.controller.use_orig_controller, 100.0f * b.active_ticks / ticks,
+            (unsigned long long)a.hash, (unsigned long long)b.hash, policy ? (match ? "" : "  MISMATCH") : "  (shared classic state)");
+    }
+    printf("%u contexts on %u threads: %u of %u policy contexts identical to the sequential run\n", config.contexts, config.threads, policy_vehicles - mismatches, policy_vehicles);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,375 @@
+// Side-by-side benchmark of the controllers behind rlt.orig (learned policy, PID, Mellinger, INDI, Brescianini)
+// Every controller x mode combination is one closed-loop flight (as sim: trigger packets every 10 ms from
+// --trigger-start, ideal supply by default) in its own forked process, at most --jobs at a time. From the settle time
+// after the activation, every controllerOutOfTree call is timed on the wall clock and runs on a painted stack whose
+// untouched bytes give the stack high-water mark; the flight is scored on the tracking error of the true position
+// against the controller's target (the reference stage is shared, so all controllers follow the same targets), motor
+// saturation and the share of the time in control. The classic controllers are zero-output stand-ins in the host
+// simulation (firmware.c) unless the firmware's are linked (make CLASSIC=1 or CLASSIC_OBJS); a selected controller that
+// is only a stand-in is refused unless --allow-stubs, which flies it and marks its rows "stub". Cycles on the flight
+// MCU: make -C bench run ORIG=<n> CLASSIC=1.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern "C" {
+#include "firmware/motors.h"
+#include "rl_tools_controller.h"
+#include "rl_tools_adapter.h"
+}
+#include "firmware.h"
+#include "simulation.h"
+
+constexpr unsigned TRIGGER_PACKET_INTERVAL_MS = 10;
+constexpr float CRASH_ERROR = 1.0f; // [m]
+constexpr uint8_t STACK_PATTERN = 0xA5;
+
+struct Option{
+    const char* name;
+    uint8_t value;
+};
+static const Option CONTROLLERS[] = {{"rl", 0}, {"pid", 1}, {"mellinger", 2}, {"indi", 3}, {"brescianini", 4}}; // rlt.orig
+static const Option MODES[] = {{"position", 1}, {"figure_eight", 4}}; // rlt.wn
+
+struct Config{
+    std::vector<Option> controllers;
+    std::vector<Option> modes;
+    float duration = 15;
+    float trigger_start = 1;
+    float settle_time = 2;
+    float battery = 0;
+    size_t stack_size = 256 * 1024;
+    std::vector<std::string> params;
+    const char* output = nullptr;
+    unsigned jobs = 0;
+    bool allow_stubs = false;
+    bool verbose = false;
+};
+
+struct Flight{
+    unsigned controller;
+    unsigned mode;
+};
+
+// Written by the flight's process into shared memory
+struct Result{
+    bool done;
+    bool activated;
+    bool crashed;
+    bool stub; // a classic controller stand-in produced the control
+    uint32_t ticks;
+    float tick_us_mean, tick_us_p99, tick_us_max; // controllerOutOfTree per tick in control [us]
+    uint32_t stack; // stack high-water mark of controllerOutOfTree [bytes]
+    float rmse, max_error; // [m]
+    float saturation; // share of the ticks in control with a motor at 0 or UINT16_MAX
+    float active; // share of the scored time the controller stayed in control
+};
+
+static void usage(const char* name){
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --controller <list>       comma-separated controllers: rl, pid, mellinger, indi, brescianini (default all)\n"
+        "  --mode <list>             comma-separated modes: position, figure_eight (default both)\n"
+        "  --duration <s>            simulated time per flight (default 15)\n"
+        "  --trigger-start <s>       time at which trigger packets start (default 1)\n"
+        "  --settle <s>              unscored time after the activation (default 2)\n"
+        "  --battery <mAh>           battery capacity, 0 = ideal 4.2V supply (default 0)\n"
+        "  --stack <bytes>           stack of controllerOutOfTree (default 262144)\n"
+        "  --param <group.name=v>    set a firmware parameter in every flight (repeatable)\n"
+        "  --output <file>           CSV with one row per flight\n"
+        "  --jobs <n>                flights running at the same time (default: online CPUs; 1 for the quietest timing)\n"
+        "  --allow-stubs             fly classic controllers that only have their zero-output stand-in, marked \"stub\"\n"
+        "  --verbose                 print DEBUG_PRINT output to stderr\n", name);
+}
+
+static bool parse_options(const char* list, const Option* begin, const Option* end, std::vector<Option>& options){
+    options.clear();
+    std::string text = list;
+    for(size_t start = 0; start <= text.size();){
+        size_t separator = std::min(text.find(',', start), text.size());
+        std::string name = text.substr(start, separator - start);
+        const Option* option = std::find_if(begin, end, [&](const Option& o){ return name == o.name; });
+        if(option == end){
+            fprintf(stderr, "unknown option: %s\n", name.c_str());
+            return false;
+        }
+        options.push_back(*option);
+        start = separator + 1;
+    }
+    return true;
+}
+
+static bool parse(int argc, char** argv, Config& config){
+    config.controllers.assign(std::begin(CONTROLLERS), std::end(CONTROLLERS));
+    config.modes.assign(std::begin(MODES), std::end(MODES));
+    for(int arg_i = 1; arg_i < argc; arg_i++){
+        std::string arg = argv[arg_i];
+        bool has_value = arg_i + 1 < argc;
+        if(arg == "--verbose"){
+            config.verbose = true;
+        }
+        else if(arg == "--allow-stubs"){
+            config.allow_stubs = true;
+        }
+        else if(has_value && arg == "--controller"){
+            if(!parse_options(argv[++arg_i], std::begin(CONTROLLERS), std::end(CONTROLLERS), config.controllers)){
+                return false;
+            }
+        }
+        else if(has_value && arg == "--mode"){
+            if(!parse_options(argv[++arg_i], std::begin(MODES), std::end(MODES), config.modes)){
+                return false;
+            }
+        }
+        else if(has_value && arg == "--duration"){
+            config.duration = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--trigger-start"){
+            config.trigger_start = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--settle"){
+            config.settle_time = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--battery"){
+            config.battery = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--stack"){
+            config.stack_size = (size_t)strtoul(argv[++arg_i], nullptr, 10);
+        }
+        else if(has_value && arg == "--param"){
+            config.params.push_back(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--output"){
+            config.output = argv[++arg_i];
+        }
+        else if(has_value && arg == "--jobs"){
+            config.jobs = (unsigned)atoi(argv[++arg_i]);
+        }
+        else{
+            return false;
+        }
+    }
+    return config.duration > config.trigger_start && config.stack_size >= 16 * 1024;
+}
+
+static double percentile(std::vector<float>& values, double p){
+    if(values.empty()){
+        return NAN;
+    }
+    size_t index = std::min(values.size() - 1, (size_t)(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+static bool fly(const Config& config, const Option& controller_option, const Option& mode, Result& result){
+    // Painted stack below a guard page: an overflow ends the flight instead of corrupting memory
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t stack_size = (config.stack_size + page - 1) / page * page;
+    uint8_t* guard = (uint8_t*)mmap(nullptr, stack_size + page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(guard == MAP_FAILED || mprotect(guard, page, PROT_NONE) != 0){
+        perror("stack");
+        return false;
+    }
+    uint8_t* stack = guard + page;
+
+    BatteryParameters battery;
+    battery.capacity = config.battery;
+    Simulation simulation;
+    simulation_init(simulation, battery);
+    for(const auto& param: config.params){
+        if(!sim_firmware_set_param_string(param.c_str())){
+            fprintf(stderr, "unknown parameter assignment: %s\n", param.c_str());
+            return false;
+        }
+    }
+    std::string orig = "rlt.orig=" + std::to_string(controller_option.value);
+    std::string wn = "rlt.wn=" + std::to_string(mode.value);
+    sim_firmware_set_param_string(orig.c_str());
+    sim_firmware_set_param_string(wn.c_str());
+    simulation.controller_stack = stack;
+    simulation.controller_stack_size = stack_size;
+    const rl_tools_controller_context_t* controller = rl_tools_controller_context_global();
+
+    uint32_t steps = (uint32_t)(config.duration * SIMULATION_STABILIZER_RATE);
+    float activation = -1;
+    uint32_t ticks = 0, active_ticks = 0, saturated_ticks = 0;
+    uint64_t stub_calls = 0;
+    double error_square_sum = 0, tick_us_sum = 0;
+    float max_error = 0;
+    bool painted = false;
+    std::vector<float> tick_us;
+    tick_us.reserve(steps);
+    while(simulation.tick < steps){
+        uint32_t next_tick = simulation.tick + 1;
+        float next_time = (float)next_tick / SIMULATION_STABILIZER_RATE;
+        if(next_time >= config.trigger_start && next_tick % TRIGGER_PACKET_INTERVAL_MS == 0){
+            rl_tools_controller_packet_received();
+        }
+        if(!painted && activation >= 0 && next_time >= activation + config.settle_time){
+            // The high-water mark covers the scored ticks only
+            memset(stack, STACK_PATTERN, stack_size);
+            painted = true;
+        }
+        uint64_t stub_calls_before = sim_firmware_classic_stub_calls();
+        simulation_step(simulation);
+        bool active = controller->log_set_motors == 1;
+        if(activation < 0 && active){
+            activation = next_time;
+        }
+        if(activation < 0 || next_time < activation + config.settle_time){
+            continue;
+        }
+        ticks++;
+        const float* position = simulation.quadrotor.position;
+        float error = std::sqrt(std::pow(controller->target_pos[0] - position[0], 2) + std::pow(controller->target_pos[1] - position[1], 2) + std::pow(controller->target_pos[2] - position[2], 2));
+        error_square_sum += error * error;
+        max_error = std::max(max_error, error);
+        if(active){
+            active_ticks++;
+            stub_calls += sim_firmware_classic_stub_calls() - stub_calls_before;
+            float us = simulation.controller_ns / 1000.0f;
+            tick_us.push_back(us);
+            tick_us_sum += us;
+            bool saturated = false;
+            for(uint32_t motor_i = 0; motor_i < RL_TOOLS_CONTROLLER_NUM_MOTORS; motor_i++){
+                uint16_t ratio = motorsGetRatio(motor_i);
+                saturated = saturated || ratio == 0 || ratio == UINT16_MAX;
+            }
+            saturated_ticks += saturated;
+        }
+        if(error > CRASH_ERROR){
+            result.crashed = true;
+            break;
+        }
+    }
+    size_t untouched = 0;
+    while(painted && untouched < stack_size && stack[untouched] == STACK_PATTERN){
+        untouched++;
+    }
+    result.activated = ticks > 0;
+    result.stub = stub_calls > 0;
+    result.ticks = active_ticks;
+    result.tick_us_mean = active_ticks > 0 ? (float)(tick_us_sum / active_ticks) : NAN;
+    result.tick_us_max = tick_us.empty() ? NAN : *std::max_element(tick_us.begin(), tick_us.end());
+    result.tick_us_p99 = (float)percentile(tick_us, 0.99);
+    result.stack = painted ? (uint32_t)(stack_size - untouched) : 0;
+    result.rmse = ticks > 0 ? (float)std::sqrt(error_square_sum / ticks) : NAN;
+    result.max_error = ticks > 0 ? max_error : NAN;
+    result.saturation = active_ticks > 0 ? (float)saturated_ticks / active_ticks : NAN;
+    result.active = ticks > 0 ? (float)active_ticks / ticks : NAN;
+    return true;
+}
+
+int main(int argc, char** argv){
+    Config config;
+    if(!parse(argc, argv, config)){
+        usage(argv[0]);
+        return 1;
+    }
+    unsigned stubbed = 0;
+    for(const Option& controller: config.controllers){
+        if(sim_firmware_classic_stubbed(controller.value)){
+            fprintf(stderr, "%s: only the zero-output stand-in of sim/firmware.c is linked, build with CLASSIC=1 (or CLASSIC_OBJS) for the firmware's controller\n", controller.name);
+            stubbed++;
+        }
+    }
+    if(stubbed > 0 && !config.allow_stubs){
+        fprintf(stderr, "not comparing stand-ins: leave them out with --controller, or pass --allow-stubs to fly them marked \"stub\"\n");
+        return 1;
+    }
+    FILE* output = nullptr;
+    if(config.output){
+        output = fopen(config.output, "w");
+        if(output == nullptr){
+            perror(config.output);
+            return 1;
+        }
+    }
+    sim_firmware_set_verbose(config.verbose);
+    if(config.jobs == 0){
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        config.jobs = cpus > 0 ? (unsigned)cpus : 1;
+    }
+    std::vector<Flight> flights;
+    for(unsigned controller_i = 0; controller_i < config.controllers.size(); controller_i++){
+        for(unsigned mode_i = 0; mode_i < config.modes.size(); mode_i++){
+            flights.push_back({controller_i, mode_i});
+        }
+    }
+
+    // The firmware state is global, so every flight gets a fresh process; the results come back through shared memory
+    size_t results_size = flights.size() * sizeof(Result);
+    Result* results = (Result*)mmap(nullptr, results_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(results == MAP_FAILED){
+        perror("mmap");
+        return 1;
+    }
+    memset(results, 0, results_size);
+    fprintf(stderr, "%zu flights (%zu controllers x %zu modes) on %u jobs, checkpoint %s\n", flights.size(), config.controllers.size(), config.modes.size(), config.jobs, rl_tools_get_checkpoint_name());
+    fflush(nullptr);
+    unsigned running = 0;
+    for(size_t flight_i = 0; flight_i <= flights.size(); flight_i++){
+        while(running > 0 && (running >= config.jobs || flight_i == flights.size())){
+            int status;
+            if(wait(&status) > 0){
+                running--;
+            }
+        }
+        if(flight_i == flights.size()){
+            break;
+        }
+        pid_t pid = fork();
+        if(pid == 0){
+            const Flight& flight = flights[flight_i];
+            Result& result = results[flight_i];
+            bool ok = fly(config, config.controllers[flight.controller], config.modes[flight.mode], result);
+            result.done = ok;
+            _exit(ok ? 0 : 1);
+        }
+        if(pid < 0){
+            perror("fork");
+            continue;
+        }
+        running++;
+    }
+
+    if(output){
+        fprintf(output, "checkpoint,controller,mode,stub,ticks,tick_us_mean,tick_us_p99,tick_us_max,stack,rmse,max_error,saturation,active,crashed\n");
+    }
+    printf("%-12s %-13s %9s %9s %9s %8s %8s %8s %7s %7s %8s %5s\n", "controller", "mode", "tick", "tick_p99", "tick_max", "stack", "rmse", "max_err", "sat", "active", "crashed", "note");
+    unsigned errors = 0;
+    for(size_t flight_i = 0; flight_i < flights.size(); flight_i++){
+        const Flight& flight = flights[flight_i];
+        const Result& result = results[flight_i];
+        const char* controller_name = config.controllers[flight.controller].name;
+        const char* mode_name = config.modes[flight.mode].name;
+        if(!result.done){
+            fprintf(stderr, "%s %s: flight failed (stack overflow above %zu bytes?)\n", controller_name, mode_name, config.stack_size);
+            errors++;
+            continue;
+        }
+        const char* note = result.stub ? "stub" : !result.activated ? "idle" : "";
+        printf("%-12s %-13s %7.2fus %7.2fus %7.2fus %8u %8.4f %8.4f %6.1f%% %6.1f%% %8d %5s\n", controller_name, mode_name, result.tick_us_mean, result.tick_us_p99, result.tick_us_max,
+            result.stack, result.rmse, result.max_error, result.saturation * 100, result.active * 100, result.crashed, note);
+        if(output){
+            fprintf(output, "%s,%s,%s,%d,%u,%f,%f,%f,%u,%f,%f,%f,%f,%d\n", rl_tools_get_checkpoint_name(), controller_name, mode_name, result.stub, result.ticks, result.tick_us_mean, result.tick_us_p99,
+                result.tick_us_max, result.stack, result.rmse, result.max_error, result.saturation, result.active, result.crashed);
+        }
+    }
+    if(output){
+        fclose(output);
+    }
+    munmap(results, results_size);
+    if(errors > 0){
+        fprintf(stderr, "%u of %zu flights did not complete\n", errors, flights.size());
+        return 1;
+    }
+    return 0;
+}
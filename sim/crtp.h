@@ -0,0 +1,54 @@
+// CRTP protocol constants shared by the link stand-in (link.cpp) and the host tools talking to it
+#ifndef __SIM_CRTP_H__
+#define __SIM_CRTP_H__
+
+#include <cstdint>
+
+constexpr uint8_t CRTP_PORT_CONSOLE = 0;
+constexpr uint8_t CRTP_PORT_PARAM = 2;
+constexpr uint8_t CRTP_PORT_MEM = 4;
+constexpr uint8_t CRTP_PORT_LOG = 5;
+constexpr uint8_t CRTP_PORT_COMMANDER_GENERIC = 7;
+constexpr uint8_t CRTP_PORT_PLATFORM = 13;
+constexpr uint8_t CRTP_PORT_LINKCTRL = 15;
+constexpr uint8_t CRTP_MAX_DATA_SIZE = 30;
+constexpr uint8_t CRTP_NULL_HEADER = 0xFF;
+
+constexpr uint8_t TOC_CHANNEL = 0;
+constexpr uint8_t CMD_TOC_ITEM_V2 = 2;
+constexpr uint8_t CMD_TOC_INFO_V2 = 3;
+constexpr uint8_t PARAM_READ_CHANNEL = 1;
+constexpr uint8_t PARAM_WRITE_CHANNEL = 2;
+constexpr uint8_t LOG_CONTROL_CHANNEL = 1;
+constexpr uint8_t LOG_DATA_CHANNEL = 2;
+constexpr uint8_t CMD_DELETE_BLOCK = 2;
+constexpr uint8_t CMD_START_LOGGING = 3;
+constexpr uint8_t CMD_STOP_LOGGING = 4;
+constexpr uint8_t CMD_RESET_LOGGING = 5;
+constexpr uint8_t CMD_CREATE_BLOCK_V2 = 6;
+constexpr uint8_t CMD_APPEND_BLOCK_V2 = 7;
+constexpr uint8_t SET_SETPOINT_CHANNEL = 0;
+constexpr uint8_t META_COMMAND_CHANNEL = 1;
+constexpr uint8_t TYPE_STOP = 0;
+constexpr uint8_t TYPE_HOVER = 5;
+constexpr uint8_t TYPE_POSITION = 7;
+constexpr uint8_t META_RL_TOOLS_TRIGGER = 1;
+constexpr uint8_t PLATFORM_APP_CHANNEL = 2; // swarm setpoints (swarm_app.c)
+constexpr uint8_t LINKCTRL_ECHO_CHANNEL = 0;
+constexpr uint8_t MEM_INFO_CHANNEL = 0;
+constexpr uint8_t MEM_READ_CHANNEL = 1;
+constexpr uint8_t MEM_WRITE_CHANNEL = 2;
+constexpr uint8_t CMD_MEM_GET_NUMBER = 1;
+constexpr uint8_t CMD_MEM_GET_INFO = 2;
+
+inline uint8_t crtp_header(uint8_t port, uint8_t channel){
+    return (uint8_t)((port & 0x0F) << 4 | 3 << 2 | (channel & 0x03));
+}
+inline uint8_t crtp_port(uint8_t header){
+    return header >> 4;
+}
+inline uint8_t crtp_channel(uint8_t header){
+    return header & 0x03;
+}
+
+#endif
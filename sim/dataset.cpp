@@ -0,0 +1,527 @@
+// Flight-log to transition dataset (dataset.h) for offline fine-tuning, distillation and system identification
+// Inputs are controller traces (sim --trace, on-board recordings downloaded with scripts/tracedump.py), CSV logs
+// (scripts/basiclog.py, cfclient, sim --log) and uSD-card logs (meta/config_*.txt, usddeck binary format). Traces are
+// replayed through rl_tools_controller.c on the virtual clock as in replay.cpp, so every inference step contributes its
+// state_input and the recorded action. Logs are resampled onto the inference period (linear interpolation, quaternions
+// renormalized, actions and flags held) and their state_input is computed by
+// rl_tools_controller_context_update_state with the target taken from the log. Either way the observations come from
+// rl_tools_context_observe, i.e. the adapter's own observation layout and action-history bookkeeping.
+// Logs are read once, keeping only the columns used here; the records are written as they are produced, in shards of
+// --shard-records transitions.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "firmware/motors.h"
+#include "rl_tools_controller.h"
+#include "rl_tools_adapter.h"
+#include "controller_trace.h"
+void controllerOutOfTreeInit(void);
+bool controllerOutOfTreeTest(void);
+void controllerOutOfTree(control_t *control, setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick);
+}
+#include "firmware.h"
+#include "dataset.h"
+#include "flight_log.h"
+
+struct Config{
+    std::vector<std::string> inputs;
+    std::vector<std::string> params;
+    const char* output = "dataset";
+    unsigned shard_records = 1 << 18;
+    float period = RL_TOOLS_CONTROLLER_INTERVAL_MS; // [ms]
+    float max_gap = 50; // [ms]
+    float target[3] = {0, 0, 0};
+    bool gyro_rad = false;
+    bool raw = false;
+    bool verbose = false;
+};
+
+static void usage(const char* name){
+    fprintf(stderr,
+        "usage: %s [options] <input> [<input> ...]\n"
+        "  input: a controller trace, or a CSV or uSD-card log; logs recorded together are joined with commas\n"
+        "         (e.g. run_state.csv,run_motors.csv) and aligned by their timestamps\n"
+        "  --param <group.name=v>    set a firmware parameter after init, as during the flight (repeatable)\n"
+        "  --output <prefix>         shards <prefix>-00000.rltd, ... (default dataset)\n"
+        "  --shard-records <n>       transitions per shard (default 262144)\n"
+        "  --period <ms>             log resampling period (default %d, the inference period the action history assumes)\n"
+        "  --max-gap <ms>            longer gaps between log samples split the episode (default 50)\n"
+        "  --target <x,y,z>          position target of logs without rltte.*/rlttp.* columns (default 0,0,0), the velocity\n"
+        "                            target is rlttv.* or zero\n"
+        "  --gyro-rad                the log's gyro.* columns are rad/s (the controller's group), not deg/s\n"
+        "  --raw                     observations without the checkpoint's observation normalization\n"
+        "  --verbose                 print DEBUG_PRINT output to stderr\n", name, RL_TOOLS_CONTROLLER_INTERVAL_MS);
+}
+
+static bool parse(int argc, char** argv, Config& config){
+    for(int arg_i = 1; arg_i < argc; arg_i++){
+        std::string arg = argv[arg_i];
+        bool has_value = arg_i + 1 < argc;
+        if(arg == "--gyro-rad"){
+            config.gyro_rad = true;
+        }
+        else if(arg == "--raw"){
+            config.raw = true;
+        }
+        else if(arg == "--verbose"){
+            config.verbose = true;
+        }
+        else if(has_value && arg == "--param"){
+            config.params.push_back(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--output"){
+            config.output = argv[++arg_i];
+        }
+        else if(has_value && arg == "--shard-records"){
+            config.shard_records = (unsigned)atoi(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--period"){
+            config.period = atof(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--max-gap"){
+            config.max_gap = atof(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--target"){
+            if(sscanf(argv[++arg_i], "%f,%f,%f", &config.target[0], &config.target[1], &config.target[2]) != 3){
+                return false;
+            }
+        }
+        else if(arg[0] != '-'){
+            config.inputs.push_back(arg);
+        }
+        else{
+            return false;
+        }
+    }
+    return !config.inputs.empty() && config.shard_records > 0 && config.period > 0;
+}
+
+// Sharded output
+struct Dataset{
+    Config config;
+    DatasetHeader header;
+    FILE* file = nullptr;
+    std::vector<unsigned char> record;
+    uint64_t transitions = 0;
+    uint32_t episodes = 0;
+};
+
+static bool dataset_close_shard(Dataset& dataset){
+    if(dataset.file == nullptr){
+        return true;
+    }
+    bool ok = fseek(dataset.file, 0, SEEK_SET) == 0 && fwrite(&dataset.header, sizeof(dataset.header), 1, dataset.file) == 1;
+    ok = fclose(dataset.file) == 0 && ok;
+    dataset.file = nullptr;
+    dataset.header.shard++;
+    return ok;
+}
+
+static bool dataset_write(Dataset& dataset, uint32_t episode, uint64_t timestamp, uint32_t flags, const float* observation, const float* action, const float* next_observation){
+    if(dataset.file != nullptr && dataset.header.count == dataset.config.shard_records && !dataset_close_shard(dataset)){
+        return false;
+    }
+    if(dataset.file == nullptr){
+        char path[1024];
+        snprintf(path, sizeof(path), "%s-%05u.rltd", dataset.config.output, dataset.header.shard);
+        dataset.file = fopen(path, "wb");
+        if(dataset.file == nullptr){
+            perror(path);
+            return false;
+        }
+        dataset.header.count = 0;
+        fwrite(&dataset.header, sizeof(dataset.header), 1, dataset.file);
+    }
+    size_t observation_size = dataset.header.observation_dim * sizeof(float);
+    size_t action_size = dataset.header.action_dim * sizeof(float);
+    unsigned char* record = dataset.record.data();
+    memcpy(record, &timestamp, sizeof(timestamp));
+    memcpy(record + 8, &episode, sizeof(episode));
+    memcpy(record + 12, &flags, sizeof(flags));
+    memcpy(record + DATASET_RECORD_HEADER_SIZE, observation, observation_size);
+    memcpy(record + DATASET_RECORD_HEADER_SIZE + observation_size, action, action_size);
+    memcpy(record + DATASET_RECORD_HEADER_SIZE + observation_size + action_size, next_observation, observation_size);
+    if(fwrite(record, dataset.record.size(), 1, dataset.file) != 1){
+        perror(dataset.config.output);
+        return false;
+    }
+    dataset.header.count++;
+    dataset.transitions++;
+    return true;
+}
+
+// Consecutive inference steps of one flight: observations on a teacher-forced policy context, a transition per step
+// after the first
+struct Episode{
+    rl_tools_context_t* policy = nullptr;
+    std::vector<float> observation, previous_observation;
+    float previous_action[RL_TOOLS_CONTROLLER_NUM_MOTORS];
+    uint64_t previous_timestamp;
+    uint32_t previous_flags;
+    uint32_t index;
+    unsigned steps;
+    unsigned history_steps;
+    bool from_init;
+};
+
+static void episode_start(Dataset& dataset, Episode& episode, bool from_init){
+    rl_tools_context_init(episode.policy);
+    episode.index = dataset.episodes++;
+    episode.steps = 0;
+    episode.from_init = from_init;
+}
+
+static bool episode_step(Dataset& dataset, Episode& episode, float* state_input, const float* action, uint64_t timestamp, bool policy){
+    if(!rl_tools_context_observe(episode.policy, state_input, action, episode.observation.data(), !dataset.config.raw)){
+        fprintf(stderr, "the adapter does not provide teacher-forced observations\n");
+        return false;
+    }
+    if(episode.steps > 0 && !dataset_write(dataset, episode.index, episode.previous_timestamp, episode.previous_flags, episode.previous_observation.data(), episode.previous_action, episode.observation.data())){
+        return false;
+    }
+    std::swap(episode.observation, episode.previous_observation);
+    memcpy(episode.previous_action, action, sizeof(episode.previous_action));
+    episode.previous_timestamp = timestamp;
+    episode.previous_flags = (policy ? DATASET_FLAG_POLICY : 0) | (!episode.from_init && episode.steps < episode.history_steps ? DATASET_FLAG_WARMUP : 0);
+    episode.steps++;
+    return true;
+}
+
+static bool controller_init(const Config& config, float battery_voltage){
+    sim_firmware_set_time(0);
+    sim_firmware_set_battery_voltage(battery_voltage);
+    for(uint32_t motor_i = 0; motor_i < NBR_OF_MOTORS; motor_i++){
+        motorsSetRatio(motor_i, 0);
+    }
+    controllerOutOfTreeInit();
+    controllerOutOfTreeTest();
+    for(const auto& param: config.params){
+        if(!sim_firmware_set_param_string(param.c_str())){
+            fprintf(stderr, "unknown parameter assignment: %s\n", param.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool convert_trace(Dataset& dataset, Episode& episode, const char* path){
+    if(dataset.config.period != RL_TOOLS_CONTROLLER_INTERVAL_MS){
+        fprintf(stderr, "%s: traces are converted at the inference period (%dms), not --period\n", path, RL_TOOLS_CONTROLLER_INTERVAL_MS);
+        return false;
+    }
+    FILE* file = fopen(path, "rb");
+    if(file == nullptr){
+        perror(path);
+        return false;
+    }
+    controller_trace_record_t record;
+    bool first = true;
+    uint32_t last_tick = 0;
+    unsigned steps = 0, diverged = 0;
+    uint64_t transitions = dataset.transitions;
+    uint32_t episodes = dataset.episodes;
+    uint64_t last_packet = 0;
+    while(fread(&record, sizeof(record), 1, file) == 1){
+        if(first){
+            if(!controller_init(dataset.config, record.battery_voltage)){
+                fclose(file);
+                return false;
+            }
+            if(record.tick > 1){
+                fprintf(stderr, "%s: warning: the recording starts at tick %u, not at controller init; the first steps are flagged as warm-up\n", path, record.tick);
+            }
+            episode_start(dataset, episode, record.tick <= 1);
+            first = false;
+        }
+        else if(record.tick != last_tick + 1){
+            fprintf(stderr, "%s: warning: ticks %u to %u are missing, the replay is no longer exact\n", path, last_tick + 1, record.tick - 1);
+        }
+        last_tick = record.tick;
+        uint64_t packet = controller_trace_packet_timestamp(&record);
+        if(packet != last_packet){
+            sim_firmware_set_time(packet);
+            rl_tools_controller_packet_received();
+            last_packet = packet;
+        }
+        setpoint_t setpoint;
+        sensorData_t sensors;
+        state_t state;
+        control_t control = {};
+        controller_trace_unpack(&record, &setpoint, &sensors, &state);
+        sim_firmware_set_time(controller_trace_timestamp(&record));
+        sim_firmware_set_battery_voltage(record.battery_voltage);
+        controllerOutOfTree(&control, &setpoint, &sensors, &state, record.tick);
+
+        const rl_tools_controller_context_t* controller = rl_tools_controller_context_global();
+        if(controller->inference){
+            diverged += memcmp(controller->action_output, record.action, sizeof(record.action)) != 0;
+            float state_input[13];
+            memcpy(state_input, controller->state_input, sizeof(state_input));
+            if(!episode_step(dataset, episode, state_input, record.action, controller_trace_timestamp(&record), controller->log_set_motors)){
+                fclose(file);
+                return false;
+            }
+            steps++;
+        }
+    }
+    bool complete = feof(file) && ftell(file) % sizeof(record) == 0;
+    fclose(file);
+    if(!complete){
+        fprintf(stderr, "%s: not a sequence of %zu-byte controller_trace_record_t\n", path, sizeof(record));
+        return false;
+    }
+    if(diverged > 0){
+        fprintf(stderr, "%s: warning: the replayed actions differ from the recorded ones in %u of %u inference steps (check --param)\n", path, diverged, steps);
+    }
+    printf("%s: trace, %u inference steps, %llu transitions in %u episodes\n", path, steps, (unsigned long long)(dataset.transitions - transitions), dataset.episodes - episodes);
+    return true;
+}
+
+// Columns the log conversion reads (see resolve)
+static bool wanted(const std::string& name){
+    static const char* PREFIXES[] = {"state.", "stateEstimate.", "quat.", "gyro.", "rltte.", "rlttp.", "rlttv.", "rlta.", "rltm.", "action."};
+    if(name == "set_motors" || name == "rltrp.sm"){
+        return true;
+    }
+    for(const char* prefix: PREFIXES){
+        if(name.compare(0, strlen(prefix), prefix) == 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+struct Signals{
+    FlightLogChannel* state[13] = {}; // state.* of the packed log (scripts/packedlog.py): state_input itself
+    FlightLogChannel* position[3] = {};
+    FlightLogChannel* target[3] = {};
+    bool target_is_error = false; // rltte.* = target - position
+    FlightLogChannel* target_velocity[3] = {};
+    FlightLogChannel* quaternion[4] = {}; // w, x, y, z
+    FlightLogChannel* velocity[3] = {};
+    FlightLogChannel* gyro[3] = {};
+    FlightLogChannel* action[4] = {};
+    bool action_is_motor_cmd = false; // rltm.*
+    FlightLogChannel* policy = nullptr;
+};
+
+static bool resolve(const char* input, FlightLog& log, Signals& signals){
+    size_t chosen;
+    bool state = flight_log_find(log, {{"state.px", "state.py", "state.pz", "state.qw", "state.qx", "state.qy", "state.qz", "state.vx", "state.vy", "state.vz", "state.wx", "state.wy", "state.wz"}}, signals.state);
+    if(!state){
+        const char* missing = nullptr;
+        if(!flight_log_find(log, {{"stateEstimate.x", "stateEstimate.y", "stateEstimate.z"}, {"stateEstimate.px", "stateEstimate.py", "stateEstimate.pz"}}, signals.position)){
+            missing = "position (stateEstimate.x/y/z or stateEstimate.px/py/pz)";
+        }
+        else if(!flight_log_find(log, {{"stateEstimate.qw", "stateEstimate.qx", "stateEstimate.qy", "stateEstimate.qz"}, {"quat.w", "quat.x", "quat.y", "quat.z"}}, signals.quaternion)){
+            missing = "attitude (stateEstimate.qw/qx/qy/qz or quat.w/x/y/z)";
+        }
+        else if(!flight_log_find(log, {{"stateEstimate.vx", "stateEstimate.vy", "stateEstimate.vz"}}, signals.velocity)){
+            missing = "velocity (stateEstimate.vx/vy/vz)";
+        }
+        else if(!flight_log_find(log, {{"gyro.x", "gyro.y", "gyro.z"}}, signals.gyro)){
+            missing = "body rates (gyro.x/y/z)";
+        }
+        if(missing != nullptr){
+            fprintf(stderr, "%s: no state.* columns and no %s\n", input, missing);
+            return false;
+        }
+        if(flight_log_find(log, {{"rltte.x", "rltte.y", "rltte.z"}, {"rlttp.x", "rlttp.y", "rlttp.z"}}, signals.target, &chosen)){
+            signals.target_is_error = chosen == 0;
+        }
+        flight_log_find(log, {{"rlttv.x", "rlttv.y", "rlttv.z"}}, signals.target_velocity);
+    }
+    if(!flight_log_find(log, {{"action.a1", "action.a2", "action.a3", "action.a4"}, {"rlta.a1", "rlta.a2", "rlta.a3", "rlta.a4"}, {"rltm.m1", "rltm.m2", "rltm.m3", "rltm.m4"}}, signals.action, &chosen)){
+        fprintf(stderr, "%s: no actions (action.a1..a4, rlta.a1..a4 or rltm.m1..m4)\n", input);
+        return false;
+    }
+    signals.action_is_motor_cmd = chosen == 2;
+    flight_log_find(log, {{"set_motors"}, {"rltrp.sm"}}, &signals.policy);
+    return true;
+}
+
+static void normalize_quaternion(float* q){
+    float norm = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    for(int i = 0; i < 4; i++){
+        q[i] = norm > 0 ? q[i] / norm : (i == 0);
+    }
+}
+
+static bool convert_logs(Dataset& dataset, Episode& episode, const std::string& input){
+    FlightLog log;
+    if(!flight_log_read(input, log, wanted)){
+        return false;
+    }
+    Signals signals;
+    if(!resolve(input.c_str(), log, signals)){
+        return false;
+    }
+    std::vector<FlightLogChannel*> all;
+    for(auto& [name, channel]: log){
+        all.push_back(&channel);
+    }
+    double start, end;
+    flight_log_range(all.data(), (unsigned)all.size(), start, end);
+    const float max_gap = dataset.config.max_gap;
+
+    // Clip limits, mode and hand test of the configured controller (--param)
+    rl_tools_controller_context_t controller = *rl_tools_controller_context_global();
+    for(int axis_i = 0; axis_i < 3; axis_i++){
+        controller.target_pos[axis_i] = dataset.config.target[axis_i];
+        controller.target_vel[axis_i] = 0;
+    }
+    uint64_t transitions = dataset.transitions;
+    uint32_t episodes = dataset.episodes;
+    unsigned steps = 0, skipped = 0;
+    bool in_episode = false;
+    for(uint64_t step_i = 0; start + step_i * (double)dataset.config.period <= end; step_i++){
+        double time = start + step_i * (double)dataset.config.period;
+        float state_input[13], action[4], policy = 1;
+        bool valid;
+        if(signals.state[0] != nullptr){
+            valid = flight_log_sample_all(signals.state, 13, time, max_gap, false, state_input);
+            normalize_quaternion(state_input + 3);
+        }
+        else{
+            float position[3], quaternion[4], velocity[3], gyro[3], target[3];
+            valid = flight_log_sample_all(signals.position, 3, time, max_gap, false, position);
+            valid = flight_log_sample_all(signals.quaternion, 4, time, max_gap, false, quaternion) && valid;
+            valid = flight_log_sample_all(signals.velocity, 3, time, max_gap, false, velocity) && valid;
+            valid = flight_log_sample_all(signals.gyro, 3, time, max_gap, false, gyro) && valid;
+            if(signals.target[0] != nullptr){
+                valid = flight_log_sample_all(signals.target, 3, time, max_gap, false, target) && valid;
+                for(int axis_i = 0; axis_i < 3; axis_i++){
+                    controller.target_pos[axis_i] = signals.target_is_error ? position[axis_i] + target[axis_i] : target[axis_i];
+                }
+            }
+            if(signals.target_velocity[0] != nullptr){
+                valid = flight_log_sample_all(signals.target_velocity, 3, time, max_gap, false, controller.target_vel) && valid;
+            }
+            normalize_quaternion(quaternion);
+            state_t state = {};
+            sensorData_t sensors = {};
+            state.position.x = position[0];
+            state.position.y = position[1];
+            state.position.z = position[2];
+            state.attitudeQuaternion.w = quaternion[0];
+            state.attitudeQuaternion.x = quaternion[1];
+            state.attitudeQuaternion.y = quaternion[2];
+            state.attitudeQuaternion.z = quaternion[3];
+            state.velocity.x = velocity[0];
+            state.velocity.y = velocity[1];
+            state.velocity.z = velocity[2];
+            float gyro_scale = dataset.config.gyro_rad ? (float)(180 / M_PI) : 1;
+            sensors.gyro.x = gyro[0] * gyro_scale;
+            sensors.gyro.y = gyro[1] * gyro_scale;
+            sensors.gyro.z = gyro[2] * gyro_scale;
+            rl_tools_controller_context_update_state(&controller, &sensors, &state);
+            memcpy(state_input, controller.state_input, sizeof(state_input));
+        }
+        valid = flight_log_sample_all(signals.action, 4, time, max_gap, true, action) && valid;
+        if(signals.policy != nullptr){
+            valid = flight_log_sample(signals.policy, time, max_gap, true, policy) && valid;
+        }
+        if(!valid){
+            in_episode = false;
+            skipped++;
+            continue;
+        }
+        if(signals.action_is_motor_cmd){
+            for(int action_i = 0; action_i < 4; action_i++){
+                action[action_i] = rl_tools_controller_action_from_motor_cmd((uint16_t)action[action_i]);
+            }
+        }
+        if(!in_episode){
+            episode_start(dataset, episode, false);
+            in_episode = true;
+        }
+        if(!episode_step(dataset, episode, state_input, action, (uint64_t)std::llround(time * 1000), policy != 0)){
+            return false;
+        }
+        steps++;
+    }
+    printf("%s: log (%s), %u steps of %gms, %u in gaps, %llu transitions in %u episodes\n", input.c_str(),
+        signals.state[0] != nullptr ? "state_input" : (signals.target[0] != nullptr ? (signals.target_is_error ? "state, rltte" : "state, rlttp") : "state, --target"),
+        steps, dataset.config.period, skipped, (unsigned long long)(dataset.transitions - transitions), dataset.episodes - episodes);
+    return true;
+}
+
+static bool is_trace(const std::string& input){
+    if(input.find(',') != std::string::npos){
+        return false;
+    }
+    FILE* file = fopen(input.c_str(), "rb");
+    if(file == nullptr){
+        return false;
+    }
+    bool empty = fgetc(file) == EOF;
+    fclose(file);
+    return !empty && !flight_log_is_log(input.c_str());
+}
+
+int main(int argc, char** argv){
+    Config config;
+    if(!parse(argc, argv, config)){
+        usage(argv[0]);
+        return 1;
+    }
+    sim_firmware_set_verbose(config.verbose);
+    if(!controller_init(config, 4.2f)){
+        return 1;
+    }
+
+    Dataset dataset;
+    dataset.config = config;
+    DatasetHeader& header = dataset.header;
+    memset(&header, 0, sizeof(header));
+    header.magic = DATASET_MAGIC;
+    header.version = DATASET_VERSION;
+    header.header_size = sizeof(header);
+    header.flags = config.raw ? DATASET_RAW : 0;
+    unsigned int output_dim;
+    rl_tools_layer_dims(0, &header.observation_dim, &output_dim);
+    unsigned int history_steps = rl_tools_observation_layout(&header.state_dim, &header.action_dim);
+    if(header.observation_dim == 0 || header.action_dim != RL_TOOLS_CONTROLLER_NUM_MOTORS){
+        fprintf(stderr, "the adapter does not provide teacher-forced observations\n");
+        return 1;
+    }
+    header.action_history_length = (header.observation_dim - header.state_dim) / header.action_dim;
+    header.period = config.period / 1000.0f;
+    snprintf(header.checkpoint, sizeof(header.checkpoint), "%s", rl_tools_get_checkpoint_name());
+    header.record_size = (DATASET_RECORD_HEADER_SIZE + (2 * header.observation_dim + header.action_dim) * sizeof(float) + 7) / 8 * 8;
+    dataset.record.assign(header.record_size, 0);
+
+    Episode episode;
+    std::vector<unsigned char> policy_memory(rl_tools_context_size());
+    episode.policy = rl_tools_context_init(policy_memory.data());
+    episode.observation.resize(header.observation_dim);
+    episode.previous_observation.resize(header.observation_dim);
+    episode.history_steps = history_steps;
+
+    bool ok = true;
+    for(const auto& input: config.inputs){
+        if(is_trace(input)){
+            ok = convert_trace(dataset, episode, input.c_str());
+        }
+        else{
+            if(!controller_init(config, 4.2f)){
+                return 1;
+            }
+            ok = convert_logs(dataset, episode, input);
+        }
+        if(!ok){
+            break;
+        }
+    }
+    ok = dataset_close_shard(dataset) && ok;
+    printf("%llu transitions, %u episodes, %u shards of %u-byte records (%s, observation %u = state %u + %u x %u actions)\n",
+        (unsigned long long)dataset.transitions, dataset.episodes, header.shard, header.record_size, rl_tools_get_checkpoint_name(),
+        header.observation_dim, header.state_dim, header.action_history_length, header.action_dim);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+// Transition dataset written by sim/build/dataset (scripts/dataset.py reads it with numpy.memmap)
+// Each shard is a DatasetHeader followed by count fixed-size records, native byte order:
+//   uint64_t timestamp   [us] of the observation
+//   uint32_t episode     consecutive samples without a gap, numbered over all inputs
+//   uint32_t flags       DATASET_FLAG_*
+//   float observation[observation_dim], action[action_dim], next_observation[observation_dim]
+//   zero padding to record_size (a multiple of 8)
+// observation is the policy input exactly as rl_tools_adapter.cpp builds it (state part, then the action history),
+// normalized with the checkpoint's observation normalization unless DATASET_RAW is set; next_observation is the
+// following inference step, whose action history already contains action.
+#ifndef __SIM_DATASET_H__
+#define __SIM_DATASET_H__
+
+#include <stdint.h>
+
+#define DATASET_MAGIC 0x44544c52 // "RLTD"
+#define DATASET_VERSION 1
+#define DATASET_CHECKPOINT_NAME_LENGTH 64
+#define DATASET_RECORD_HEADER_SIZE 16
+
+// DatasetHeader.flags
+#define DATASET_RAW (1 << 0)
+
+// Record flags
+#define DATASET_FLAG_POLICY (1 << 0) // the policy's motor commands were applied (set_motors)
+#define DATASET_FLAG_WARMUP (1 << 1) // the action history does not yet reach back to the start of a flight
+
+struct DatasetHeader{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t record_size;
+    uint32_t flags;
+    uint64_t count;
+    uint32_t shard;
+    uint32_t observation_dim;
+    uint32_t state_dim; // leading part of the observation, the rest is action_history_length * action_dim
+    uint32_t action_dim;
+    uint32_t action_history_length;
+    float period; // [s] between observation and next_observation
+    char checkpoint[DATASET_CHECKPOINT_NAME_LENGTH];
+};
+
+#endif
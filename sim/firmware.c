@@ -0,0 +1,458 @@
+#include "firmware.h"
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __unix__
+#include <ucontext.h>
+#endif
+
+#include "debug.h"
+#include "usec_time.h"
+#include "watchdog.h"
+#include "cfassert.h"
+#include "task.h"
+#include "semphr.h"
+#include "pm.h"
+#include "motors.h"
+#include "log.h"
+#include "param.h"
+#include "param_logic.h"
+#include "mem.h"
+#include "power_distribution.h"
+#include "controller_pid.h"
+#include "controller_mellinger.h"
+#include "controller_indi.h"
+#include "controller_brescianini.h"
+
+// The virtual clock is per thread on the host, so that independent contexts can fly on threads of their own
+#ifdef __unix__
+static _Thread_local uint64_t time_us = 0;
+#else
+static uint64_t time_us = 0;
+#endif
+static uint32_t tick_offset = 0; // [ms]
+static float battery_voltage = 4.2f;
+static float accelerometer[3];
+static bool verbose = false;
+static void (*console_sink)(const char* text, int length) = NULL;
+static uint16_t motor_ratios[NBR_OF_MOTORS];
+#define SIM_MEMORY_MAX_HANDLERS 8
+static const MemoryHandlerDef_t* memory_handlers[SIM_MEMORY_MAX_HANDLERS];
+static int memory_handler_count = 0;
+
+// Section bounds provided by the linker for the collected LOG/PARAM groups
+extern const struct log_s __start_sim_log[];
+extern const struct log_s __stop_sim_log[];
+extern const struct param_s __start_sim_param[];
+extern const struct param_s __stop_sim_param[];
+
+void sim_firmware_set_time(uint64_t t){
+  time_us = t;
+}
+void sim_firmware_set_tick_offset(uint32_t offset_ms){
+  tick_offset = offset_ms;
+}
+void sim_firmware_set_battery_voltage(float voltage){
+  battery_voltage = voltage;
+}
+void sim_firmware_set_accelerometer(float x, float y, float z){
+  accelerometer[0] = x;
+  accelerometer[1] = y;
+  accelerometer[2] = z;
+}
+void sim_firmware_set_verbose(bool v){
+  verbose = v;
+}
+void sim_firmware_set_console(void (*console)(const char* text, int length)){
+  console_sink = console;
+}
+
+LOG_GROUP_START(acc)
+LOG_ADD(LOG_FLOAT, x, &accelerometer[0])
+LOG_ADD(LOG_FLOAT, y, &accelerometer[1])
+LOG_ADD(LOG_FLOAT, z, &accelerometer[2])
+LOG_GROUP_STOP(acc)
+
+void sim_debug_print(const char* fmt, ...){
+  if(!verbose && console_sink == NULL){
+    return;
+  }
+  char text[256];
+  va_list args;
+  va_start(args, fmt);
+  int length = vsnprintf(text, sizeof(text), fmt, args);
+  va_end(args);
+  length = length < (int)sizeof(text) ? length : (int)sizeof(text) - 1;
+  if(verbose){
+    fputs(text, stderr);
+  }
+  if(console_sink != NULL && length > 0){
+    console_sink(text, length);
+  }
+}
+
+uint64_t usecTimestamp(void){
+  return time_us;
+}
+TickType_t xTaskGetTickCount(void){
+  return (TickType_t)(time_us / 1000 + tick_offset);
+}
+#ifdef __unix__
+// Tasks run on a painted stack of their own (large enough for the host's stack frames and printf), the high-water
+// mark is measured against the depth the task was created with
+#define SIM_TASK_STACK_SIZE (256 * 1024)
+#define SIM_TASK_STACK_PATTERN 0xA5
+static uint8_t* task_stack = NULL;
+static uint16_t task_stack_depth = 0; // [words] of the running task, 0 outside of a task
+static TaskFunction_t task_function;
+static void* task_parameters;
+static ucontext_t task_caller;
+static ucontext_t task_callee;
+static void run_task(void){
+  task_function(task_parameters);
+}
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint16_t stack_depth, void* parameters, UBaseType_t priority, TaskHandle_t* handle){
+  (void)name; (void)priority;
+  if(handle != NULL){
+    *handle = NULL;
+  }
+  if(task_stack_depth != 0){
+    function(parameters); // created by a task: no second stack
+    return pdPASS;
+  }
+  if(task_stack == NULL && (task_stack = malloc(SIM_TASK_STACK_SIZE)) == NULL){
+    return pdFAIL;
+  }
+  memset(task_stack, SIM_TASK_STACK_PATTERN, SIM_TASK_STACK_SIZE);
+  task_function = function;
+  task_parameters = parameters;
+  task_stack_depth = stack_depth;
+  getcontext(&task_callee);
+  task_callee.uc_stack.ss_sp = task_stack;
+  task_callee.uc_stack.ss_size = SIM_TASK_STACK_SIZE;
+  task_callee.uc_link = &task_caller;
+  makecontext(&task_callee, run_task, 0);
+  swapcontext(&task_caller, &task_callee);
+  task_stack_depth = 0;
+  return pdPASS;
+}
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task){
+  (void)task;
+  if(task_stack_depth == 0){
+    return 0;
+  }
+  size_t unused = 0;
+  while(unused < SIM_TASK_STACK_SIZE && task_stack[unused] == SIM_TASK_STACK_PATTERN){
+    unused++;
+  }
+  size_t used = (SIM_TASK_STACK_SIZE - unused + sizeof(StackType_t) - 1) / sizeof(StackType_t);
+  return used < task_stack_depth ? task_stack_depth - used : 0;
+}
+#else
+// Bare metal (bench): the task runs on the caller's stack, which the harness measures as a whole
+static uint16_t task_stack_depth = 0;
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint16_t stack_depth, void* parameters, UBaseType_t priority, TaskHandle_t* handle){
+  (void)name; (void)priority;
+  if(handle != NULL){
+    *handle = NULL;
+  }
+  task_stack_depth = stack_depth;
+  function(parameters);
+  task_stack_depth = 0;
+  return pdPASS;
+}
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task){
+  (void)task;
+  return task_stack_depth; // not measured per task
+}
+#endif
+void vTaskDelete(TaskHandle_t task){
+  (void)task;
+}
+#ifdef __unix__
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t* buffer){
+  return pthread_mutex_init(&buffer->mutex, NULL) == 0 ? buffer : NULL;
+}
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks){
+  (void)ticks;
+  return pthread_mutex_lock(&semaphore->mutex) == 0 ? pdPASS : pdFAIL;
+}
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore){
+  return pthread_mutex_unlock(&semaphore->mutex) == 0 ? pdPASS : pdFAIL;
+}
+#else
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t* buffer){
+  buffer->taken = 0;
+  return buffer;
+}
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks){
+  (void)ticks;
+  if(semaphore->taken){
+    return pdFAIL; // single thread: would never be given back
+  }
+  semaphore->taken = 1;
+  return pdPASS;
+}
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore){
+  if(!semaphore->taken){
+    return pdFAIL;
+  }
+  semaphore->taken = 0;
+  return pdPASS;
+}
+#endif
+void* pvPortMalloc(size_t size){
+  return malloc(size);
+}
+void vPortFree(void* memory){
+  free(memory);
+}
+void watchdogReset(void){ }
+void assertFail(char *exp, char *file, int line){
+  fprintf(stderr, "Assert failed %s:%d: %s\n", file, line, exp);
+  abort();
+}
+float pmGetBatteryVoltage(void){
+  return battery_voltage;
+}
+
+void motorsSetRatio(uint32_t id, uint16_t ratio){
+  motor_ratios[id] = ratio;
+}
+uint16_t motorsGetRatio(uint32_t id){
+  return motor_ratios[id];
+}
+float motorsCompensateBatteryVoltage(uint32_t id, float iThrust, float supplyVoltage){
+  (void)id;
+  if(supplyVoltage < 2.0f){
+    return iThrust;
+  }
+  float thrust = (iThrust / 65536.0f) * 60;
+  float volts = -0.0006239f * thrust * thrust + 0.088f * thrust;
+  float ratio = volts / supplyVoltage;
+  return UINT16_MAX * ratio;
+}
+
+// Force/torque mixing of the firmware's quadrotor power distribution (Brescianini), Crazyflie 2.x constants
+#define POWER_DISTRIBUTION_ARM_LENGTH 0.046f // [m]
+#define POWER_DISTRIBUTION_THRUST_TO_TORQUE 0.005964552f
+#define POWER_DISTRIBUTION_PWM_TO_THRUST_A 0.091492681f
+#define POWER_DISTRIBUTION_PWM_TO_THRUST_B 0.067673604f
+static void powerDistributionForceTorque(const control_t *control, motors_thrust_uncapped_t* motorThrustUncapped){
+  const float arm = 0.707106781f * POWER_DISTRIBUTION_ARM_LENGTH;
+  const float roll_part = 0.25f / arm * control->torqueX;
+  const float pitch_part = 0.25f / arm * control->torqueY;
+  const float thrust_part = 0.25f * control->thrustSi; // [N] per rotor
+  const float yaw_part = 0.25f * control->torqueZ / POWER_DISTRIBUTION_THRUST_TO_TORQUE;
+  const float motor_forces[STABILIZER_NR_OF_MOTORS] = {
+    thrust_part - roll_part - pitch_part - yaw_part,
+    thrust_part - roll_part + pitch_part + yaw_part,
+    thrust_part + roll_part + pitch_part - yaw_part,
+    thrust_part + roll_part - pitch_part + yaw_part,
+  };
+  for(int motor_i = 0; motor_i < STABILIZER_NR_OF_MOTORS; motor_i++){
+    float force = motor_forces[motor_i] < 0 ? 0 : motor_forces[motor_i];
+    const float a = POWER_DISTRIBUTION_PWM_TO_THRUST_A, b = POWER_DISTRIBUTION_PWM_TO_THRUST_B;
+    float pwm = (-b + sqrtf(b * b + 4.0f * a * force)) / (2.0f * a);
+    motorThrustUncapped->list[motor_i] = pwm * UINT16_MAX;
+  }
+}
+
+void powerDistribution(const control_t *control, motors_thrust_uncapped_t* motorThrustUncapped){
+  if(control->controlMode == controlModeForceTorque){
+    powerDistributionForceTorque(control, motorThrustUncapped);
+    return;
+  }
+  if(control->controlMode == controlModeForce){
+    for(int motor_i = 0; motor_i < STABILIZER_NR_OF_MOTORS; motor_i++){
+      motorThrustUncapped->list[motor_i] = control->normalizedForces[motor_i] * UINT16_MAX;
+    }
+    return;
+  }
+  int16_t r = control->roll / 2.0f;
+  int16_t p = control->pitch / 2.0f;
+  motorThrustUncapped->motors.m1 = control->thrust - r + p + control->yaw;
+  motorThrustUncapped->motors.m2 = control->thrust - r - p - control->yaw;
+  motorThrustUncapped->motors.m3 = control->thrust + r - p + control->yaw;
+  motorThrustUncapped->motors.m4 = control->thrust + r + p - control->yaw;
+}
+bool powerDistributionCap(const motors_thrust_uncapped_t* motorThrustBatCompUncapped, motors_thrust_pwm_t* motorPwm){
+  bool capped = false;
+  for(int motor_i = 0; motor_i < STABILIZER_NR_OF_MOTORS; motor_i++){
+    int32_t value = motorThrustBatCompUncapped->list[motor_i];
+    if(value < 0){
+      value = 0;
+      capped = true;
+    }
+    if(value > UINT16_MAX){
+      value = UINT16_MAX;
+      capped = true;
+    }
+    motorPwm->list[motor_i] = (uint16_t)value;
+  }
+  return capped;
+}
+
+void memoryRegisterHandler(const MemoryHandlerDef_t* handlerDef){
+  if(memory_handler_count < SIM_MEMORY_MAX_HANDLERS){
+    memory_handlers[memory_handler_count++] = handlerDef;
+  }
+}
+int sim_memory_count(void){
+  return memory_handler_count;
+}
+const MemoryHandlerDef_t* sim_memory_get(int id){
+  return id >= 0 && id < memory_handler_count ? memory_handlers[id] : NULL;
+}
+
+// The classic controllers live in the firmware tree and are not part of the host simulation unless built with it
+// (classic.mk). The stubs are weak aliases, so the firmware's implementations take their place if they are linked;
+// sim_firmware_classic_stubbed and sim_firmware_classic_stub_calls tell the two apart.
+static uint64_t classic_stub_calls = 0;
+uint64_t sim_firmware_classic_stub_calls(void){
+  return classic_stub_calls;
+}
+#define SIM_STUB_CONTROLLER(NAME) \
+  static void sim_stub_##NAME##Init(void){ } \
+  static bool sim_stub_##NAME##Test(void){ return true; } \
+  static void sim_stub_##NAME(control_t *control, const setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick){ \
+    (void)setpoint; (void)sensors; (void)state; (void)tick; \
+    memset(control, 0, sizeof(*control)); \
+    classic_stub_calls++; \
+  } \
+  void controller##NAME##Init(void) __attribute__((weak, alias("sim_stub_" #NAME "Init"))); \
+  bool controller##NAME##Test(void) __attribute__((weak, alias("sim_stub_" #NAME "Test"))); \
+  void controller##NAME(control_t *control, const setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick) __attribute__((weak, alias("sim_stub_" #NAME)));
+SIM_STUB_CONTROLLER(Pid)
+SIM_STUB_CONTROLLER(MellingerFirmware)
+SIM_STUB_CONTROLLER(INDI)
+SIM_STUB_CONTROLLER(Brescianini)
+bool sim_firmware_classic_stubbed(uint8_t orig){
+  switch(orig){
+    case 1:
+      return controllerPid == sim_stub_Pid;
+    case 2:
+      return controllerMellingerFirmware == sim_stub_MellingerFirmware;
+    case 3:
+      return controllerINDI == sim_stub_INDI;
+    case 4:
+      return controllerBrescianini == sim_stub_Brescianini;
+    default:
+      return false;
+  }
+}
+
+// LOG/PARAM TOC
+static const void* find_variable(const void* begin, const void* end, size_t stride, const char* full_name){
+  const char* dot = strchr(full_name, '.');
+  if(dot == NULL){
+    return NULL;
+  }
+  size_t group_length = dot - full_name;
+  const char* group = NULL;
+  for(const char* entry = begin; entry < (const char*)end; entry += stride){
+    // log_s and param_s share the {type, name, address} layout
+    const struct log_s* variable = (const struct log_s*)entry;
+    if(variable->type & LOG_GROUP){
+      group = (variable->type & LOG_START) ? variable->name : NULL;
+      continue;
+    }
+    if(group != NULL && strlen(group) == group_length && strncmp(group, full_name, group_length) == 0 && strcmp(variable->name, dot + 1) == 0){
+      return variable;
+    }
+  }
+  return NULL;
+}
+
+const struct log_s* sim_log_begin(void){
+  return __start_sim_log;
+}
+const struct log_s* sim_log_end(void){
+  return __stop_sim_log;
+}
+const struct log_s* sim_log_find(const char* full_name){
+  return find_variable(__start_sim_log, __stop_sim_log, sizeof(struct log_s), full_name);
+}
+int sim_log_size(uint8_t type){
+  switch(type){
+    case LOG_UINT8: case LOG_INT8: return 1;
+    case LOG_UINT16: case LOG_INT16: case LOG_FP16: return 2;
+    default: return 4;
+  }
+}
+float sim_log_value(const struct log_s* variable){
+  switch(variable->type){
+    case LOG_UINT8:  return *(uint8_t*)variable->address;
+    case LOG_UINT16: return *(uint16_t*)variable->address;
+    case LOG_UINT32: return *(uint32_t*)variable->address;
+    case LOG_INT8:   return *(int8_t*)variable->address;
+    case LOG_INT16:  return *(int16_t*)variable->address;
+    case LOG_INT32:  return *(int32_t*)variable->address;
+    case LOG_FLOAT:  return *(float*)variable->address;
+    default: return 0;
+  }
+}
+
+const struct param_s* sim_param_begin(void){
+  return __start_sim_param;
+}
+const struct param_s* sim_param_end(void){
+  return __stop_sim_param;
+}
+const struct param_s* sim_param_find(const char* full_name){
+  return find_variable(__start_sim_param, __stop_sim_param, sizeof(struct param_s), full_name);
+}
+paramVarId_t paramGetVarId(const char* group, const char* name){
+  char full_name[64];
+  paramVarId_t id = {.id = 0xffffu, .ptr = 0xffffu};
+  snprintf(full_name, sizeof(full_name), "%s.%s", group, name);
+  const struct param_s* param = sim_param_find(full_name);
+  if(param != NULL){
+    id.id = id.ptr = (uint16_t)(param - __start_sim_param);
+  }
+  return id;
+}
+bool paramPersistentStore(const paramVarId_t paramId){
+  return PARAM_VARID_IS_VALID(paramId);
+}
+float sim_param_get(const struct param_s* param){
+  switch(param->type & ~PARAM_RONLY){
+    case PARAM_UINT8:  return *(uint8_t*)param->address;
+    case PARAM_INT8:   return *(int8_t*)param->address;
+    case PARAM_UINT16: return *(uint16_t*)param->address;
+    case PARAM_INT16:  return *(int16_t*)param->address;
+    case PARAM_UINT32: return *(uint32_t*)param->address;
+    case PARAM_INT32:  return *(int32_t*)param->address;
+    case PARAM_FLOAT:  return *(float*)param->address;
+    default: return 0;
+  }
+}
+void sim_param_set(const struct param_s* param, float value){
+  switch(param->type & ~PARAM_RONLY){
+    case PARAM_UINT8:  *(uint8_t*)param->address = (uint8_t)value; break;
+    case PARAM_INT8:   *(int8_t*)param->address = (int8_t)value; break;
+    case PARAM_UINT16: *(uint16_t*)param->address = (uint16_t)value; break;
+    case PARAM_INT16:  *(int16_t*)param->address = (int16_t)value; break;
+    case PARAM_UINT32: *(uint32_t*)param->address = (uint32_t)value; break;
+    case PARAM_INT32:  *(int32_t*)param->address = (int32_t)value; break;
+    case PARAM_FLOAT:  *(float*)param->address = value; break;
+  }
+}
+bool sim_firmware_set_param_string(const char* assignment){
+  char name[64];
+  const char* equals = strchr(assignment, '=');
+  if(equals == NULL || (size_t)(equals - assignment) >= sizeof(name)){
+    return false;
+  }
+  memcpy(name, assignment, equals - assignment);
+  name[equals - assignment] = 0;
+  const struct param_s* param = sim_param_find(name);
+  if(param == NULL){
+    return false;
+  }
+  sim_param_set(param, strtof(equals + 1, NULL));
+  return true;
+}
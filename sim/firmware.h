@@ -0,0 +1,34 @@
+// Simulation-side controls for the host stand-ins in firmware/
+#ifndef __SIM_FIRMWARE_H__
+#define __SIM_FIRMWARE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Virtual clock of usecTimestamp and xTaskGetTickCount, per thread (threads start at 0)
+void sim_firmware_set_time(uint64_t time_us);
+// Offset of the FreeRTOS tick count (xTaskGetTickCount [ms]) from the microsecond clock (usecTimestamp / 1000). On the
+// vehicle the two are unrelated; a non-zero offset checks that no code mixes them (default 0).
+void sim_firmware_set_tick_offset(uint32_t offset_ms);
+void sim_firmware_set_battery_voltage(float voltage);
+// Accelerometer reading [g] logged as acc.x/y/z, as by the firmware's sensors task
+void sim_firmware_set_accelerometer(float x, float y, float z);
+void sim_firmware_set_verbose(bool verbose);
+// Receives DEBUG_PRINT output (e.g. to forward it as CRTP console packets)
+void sim_firmware_set_console(void (*console)(const char* text, int length));
+// Sets a parameter given as "group.name=value", returns false if the parameter does not exist
+bool sim_firmware_set_param_string(const char* assignment);
+// Invocations of the zero-output stand-ins of the classic controllers (rlt.orig 1..4) so far
+uint64_t sim_firmware_classic_stub_calls(void);
+// Whether the classic controller behind rlt.orig is the zero-output stand-in, i.e. the firmware's is not linked
+bool sim_firmware_classic_stubbed(uint8_t orig);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,22 @@
+// Host stand-in for FreeRTOS.h (types, priorities and the heap used by the app)
+#ifndef __SIM_FREERTOS_H__
+#define __SIM_FREERTOS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t StackType_t;
+
+#define pdFAIL 0
+#define pdPASS 1
+
+#define tskIDLE_PRIORITY 0
+#define portMAX_DELAY 0xffffffffUL
+#define configMINIMAL_STACK_SIZE 150 // words
+
+void* pvPortMalloc(size_t size);
+void vPortFree(void* memory);
+
+#endif
@@ -0,0 +1,8 @@
+// Host stand-in for crazyflie-firmware app.h (app layer entry point)
+#ifndef __SIM_APP_H__
+#define __SIM_APP_H__
+
+// Not called on the host: sim_link hands app channel packets to the controller directly
+void appMain(void);
+
+#endif
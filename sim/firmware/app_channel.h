@@ -0,0 +1,14 @@
+// Host stand-in for crazyflie-firmware app_channel.h (CRTP_PORT_PLATFORM, channel 2)
+#ifndef __SIM_APP_CHANNEL_H__
+#define __SIM_APP_CHANNEL_H__
+
+#include <stddef.h>
+
+#define APPCHANNEL_WAIT_FOREVER (-1)
+#define APPCHANNEL_MTU (31)
+
+// Declared only, so that the app tasks compile against the firmware's interface (not linked on the host)
+void appchannelSendDataPacket(void* data, size_t length);
+size_t appchannelReceiveDataPacket(void* buffer, size_t max_length, int timeout_ms);
+
+#endif
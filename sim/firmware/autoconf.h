@@ -0,0 +1,8 @@
+// Host stand-in for the firmware's Kconfig-generated autoconf.h, for the classic controllers built from its tree
+// (classic.mk): the Crazyflie 2.x platform defaults
+#ifndef __SIM_AUTOCONF_H__
+#define __SIM_AUTOCONF_H__
+
+#define CONFIG_PLATFORM_CF2 1
+
+#endif
@@ -0,0 +1,10 @@
+// Host stand-in for crazyflie-firmware cfassert.h
+#ifndef __SIM_CFASSERT_H__
+#define __SIM_CFASSERT_H__
+
+#define ASSERT(e)  if (e) ; \
+        else assertFail( #e, __FILE__, __LINE__ )
+
+void assertFail(char *exp, char *file, int line);
+
+#endif
@@ -0,0 +1,11 @@
+// Host stand-in for crazyflie-firmware controller_brescianini.h (zero-output stand-in in firmware.c unless the firmware's is built, classic.mk)
+#ifndef __SIM_CONTROLLER_BRESCIANINI_H__
+#define __SIM_CONTROLLER_BRESCIANINI_H__
+
+#include "stabilizer_types.h"
+
+void controllerBrescianiniInit(void);
+bool controllerBrescianiniTest(void);
+void controllerBrescianini(control_t *control, const setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick);
+
+#endif
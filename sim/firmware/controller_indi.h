@@ -0,0 +1,11 @@
+// Host stand-in for crazyflie-firmware controller_indi.h (zero-output stand-in in firmware.c unless the firmware's is built, classic.mk)
+#ifndef __SIM_CONTROLLER_INDI_H__
+#define __SIM_CONTROLLER_INDI_H__
+
+#include "stabilizer_types.h"
+
+void controllerINDIInit(void);
+bool controllerINDITest(void);
+void controllerINDI(control_t *control, const setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick);
+
+#endif
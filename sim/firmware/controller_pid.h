@@ -0,0 +1,11 @@
+// Host stand-in for crazyflie-firmware controller_pid.h (zero-output stand-in in firmware.c unless the firmware's is built, classic.mk)
+#ifndef __SIM_CONTROLLER_PID_H__
+#define __SIM_CONTROLLER_PID_H__
+
+#include "stabilizer_types.h"
+
+void controllerPidInit(void);
+bool controllerPidTest(void);
+void controllerPid(control_t *control, const setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick);
+
+#endif
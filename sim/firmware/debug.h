@@ -0,0 +1,9 @@
+// Host stand-in for crazyflie-firmware debug.h
+#ifndef __SIM_DEBUG_H__
+#define __SIM_DEBUG_H__
+
+// No format attribute: the app's format strings assume the 32-bit target ABI (e.g. %lld for int64_t)
+void sim_debug_print(const char* fmt, ...);
+#define DEBUG_PRINT(fmt, ...) sim_debug_print(fmt, ##__VA_ARGS__)
+
+#endif
@@ -0,0 +1,48 @@
+// Host stand-in for crazyflie-firmware log.h
+// Groups are collected into the "sim_log" section, mirroring how the firmware builds its log TOC, so the simulation
+// can resolve "group.name" variables at runtime.
+#ifndef __SIM_LOG_H__
+#define __SIM_LOG_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LOG_UINT8  1
+#define LOG_UINT16 2
+#define LOG_UINT32 3
+#define LOG_INT8   4
+#define LOG_INT16  5
+#define LOG_INT32  6
+#define LOG_FLOAT  7
+#define LOG_FP16   8
+
+#define LOG_GROUP 0x80
+#define LOG_START 1
+#define LOG_STOP  0
+
+struct log_s {
+  uint8_t type;
+  const char* name;
+  void* address;
+};
+
+#define LOG_GROUP_START(NAME) \
+  static const struct log_s __logs_##NAME[] __attribute__((section("sim_log"), used, aligned(sizeof(void*)))) = { \
+  { .type = LOG_GROUP | LOG_START, .name = #NAME, .address = 0 },
+
+#define LOG_ADD(TYPE, NAME, ADDRESS) \
+  { .type = TYPE, .name = #NAME, .address = (void*)(ADDRESS) },
+#define LOG_ADD_CORE(TYPE, NAME, ADDRESS) LOG_ADD(TYPE, NAME, ADDRESS)
+
+#define LOG_GROUP_STOP(NAME) \
+  { .type = LOG_GROUP | LOG_STOP, .name = #NAME, .address = 0 } \
+  };
+
+// Simulation side: iterate/resolve the collected TOC
+const struct log_s* sim_log_begin(void);
+const struct log_s* sim_log_end(void);
+const struct log_s* sim_log_find(const char* full_name);
+float sim_log_value(const struct log_s* variable);
+int sim_log_size(uint8_t type);
+
+#endif
@@ -0,0 +1,17 @@
+// Host stand-in for crazyflie-firmware math3d.h (only what the app uses); the classic controllers built from the firmware
+// tree (classic.mk) get the firmware's own
+#ifdef SIM_FIRMWARE_MATH3D
+#include_next "math3d.h"
+#elif !defined(__SIM_MATH3D_H__)
+#define __SIM_MATH3D_H__
+
+#include <math.h>
+
+#ifndef M_PI_F
+#define M_PI_F ((float)M_PI)
+#endif
+
+static inline float radians(float degrees) { return (M_PI_F / 180.0f) * degrees; }
+static inline float degrees(float radians) { return (180.0f / M_PI_F) * radians; }
+
+#endif
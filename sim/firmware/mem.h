@@ -0,0 +1,36 @@
+// Host stand-in for crazyflie-firmware mem.h (registered handlers are served by the link stand-in on the MEM port)
+#ifndef __SIM_MEM_H__
+#define __SIM_MEM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+  MEM_TYPE_EEPROM   = 0x00,
+  MEM_TYPE_OW       = 0x01,
+  MEM_TYPE_LED12    = 0x10,
+  MEM_TYPE_LOCO     = 0x11,
+  MEM_TYPE_TRAJ     = 0x12,
+  MEM_TYPE_LOCO2    = 0x13,
+  MEM_TYPE_LH       = 0x14,
+  MEM_TYPE_TESTER   = 0x15,
+  MEM_TYPE_USD      = 0x16,
+  MEM_TYPE_LEDMEM   = 0x17,
+  MEM_TYPE_APP      = 0x18,
+  MEM_TYPE_DECK_MEM = 0x19,
+} MemoryType_t;
+
+typedef struct {
+  const MemoryType_t type;
+  uint32_t (*getSize)(void);
+  bool (*read)(const uint32_t memAddr, const uint8_t readLen, uint8_t* buffer);
+  bool (*write)(const uint32_t memAddr, const uint8_t writeLen, const uint8_t* buffer);
+} MemoryHandlerDef_t;
+
+void memoryRegisterHandler(const MemoryHandlerDef_t* handlerDef);
+
+// Simulation side: registered handlers in registration order (the memory id)
+int sim_memory_count(void);
+const MemoryHandlerDef_t* sim_memory_get(int id);
+
+#endif
@@ -0,0 +1,18 @@
+// Host stand-in for crazyflie-firmware motors.h (ratios are captured by the simulation)
+#ifndef __SIM_MOTORS_H__
+#define __SIM_MOTORS_H__
+
+#include <stdint.h>
+
+#define NBR_OF_MOTORS 4
+#define MOTOR_M1 0
+#define MOTOR_M2 1
+#define MOTOR_M3 2
+#define MOTOR_M4 3
+
+void motorsSetRatio(uint32_t id, uint16_t ratio);
+uint16_t motorsGetRatio(uint32_t id);
+// Brushed-motor battery compensation law of the firmware (motors.c)
+float motorsCompensateBatteryVoltage(uint32_t id, float iThrust, float supplyVoltage);
+
+#endif
@@ -0,0 +1,70 @@
+// Host stand-in for crazyflie-firmware param.h
+// Groups are collected into the "sim_param" section, mirroring how the firmware builds its param TOC, so the
+// simulation can set "group.name" parameters at runtime.
+#ifndef __SIM_PARAM_H__
+#define __SIM_PARAM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PARAM_1BYTE  0x00
+#define PARAM_2BYTES 0x01
+#define PARAM_4BYTES 0x02
+#define PARAM_8BYTES 0x03
+
+#define PARAM_TYPE_INT   (0x00 << 2)
+#define PARAM_TYPE_FLOAT (0x01 << 2)
+
+#define PARAM_SIGNED   (0x00 << 3)
+#define PARAM_UNSIGNED (0x01 << 3)
+
+#define PARAM_VARIABLE (0x00 << 7)
+#define PARAM_GROUP    (0x01 << 7)
+
+#define PARAM_RONLY (1 << 6)
+#define PARAM_PERSISTENT 0 // no storage on the host: persistent parameters start from their defaults every run
+
+#define PARAM_START 1
+#define PARAM_STOP  0
+
+#define PARAM_UINT8  (PARAM_1BYTE | PARAM_TYPE_INT | PARAM_UNSIGNED)
+#define PARAM_INT8   (PARAM_1BYTE | PARAM_TYPE_INT | PARAM_SIGNED)
+#define PARAM_UINT16 (PARAM_2BYTES | PARAM_TYPE_INT | PARAM_UNSIGNED)
+#define PARAM_INT16  (PARAM_2BYTES | PARAM_TYPE_INT | PARAM_SIGNED)
+#define PARAM_UINT32 (PARAM_4BYTES | PARAM_TYPE_INT | PARAM_UNSIGNED)
+#define PARAM_INT32  (PARAM_4BYTES | PARAM_TYPE_INT | PARAM_SIGNED)
+#define PARAM_FLOAT  (PARAM_4BYTES | PARAM_TYPE_FLOAT | PARAM_SIGNED)
+
+struct param_s {
+  uint8_t type;
+  const char* name;
+  void* address;
+};
+
+#define PARAM_GROUP_START(NAME) \
+  static const struct param_s __params_##NAME[] __attribute__((section("sim_param"), used, aligned(sizeof(void*)))) = { \
+  { .type = PARAM_GROUP | PARAM_START, .name = #NAME, .address = 0 },
+
+#define PARAM_ADD(TYPE, NAME, ADDRESS) \
+  { .type = TYPE, .name = #NAME, .address = (void*)(ADDRESS) },
+#define PARAM_ADD_CORE(TYPE, NAME, ADDRESS) PARAM_ADD(TYPE, NAME, ADDRESS)
+
+#define PARAM_GROUP_STOP(NAME) \
+  { .type = PARAM_GROUP | PARAM_STOP, .name = #NAME, .address = 0 } \
+  };
+
+typedef struct paramVarId_s {
+  uint16_t id;
+  uint16_t ptr;
+} __attribute__((packed)) paramVarId_t;
+#define PARAM_VARID_IS_VALID(varId) (varId.id != 0xffffu)
+paramVarId_t paramGetVarId(const char* group, const char* name);
+
+// Simulation side: iterate/resolve the collected TOC
+const struct param_s* sim_param_begin(void);
+const struct param_s* sim_param_end(void);
+const struct param_s* sim_param_find(const char* full_name);
+float sim_param_get(const struct param_s* param);
+void sim_param_set(const struct param_s* param, float value);
+
+#endif
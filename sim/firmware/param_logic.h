@@ -0,0 +1,12 @@
+// Host stand-in for crazyflie-firmware param_logic.h (persistent parameter store)
+#ifndef __SIM_PARAM_LOGIC_H__
+#define __SIM_PARAM_LOGIC_H__
+
+#include <stdbool.h>
+#include "param.h"
+
+// There is no storage on the host: accepts valid ids and keeps nothing, persistent parameters start from their
+// defaults every run
+bool paramPersistentStore(const paramVarId_t paramId);
+
+#endif
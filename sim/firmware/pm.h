@@ -0,0 +1,7 @@
+// Host stand-in for crazyflie-firmware pm.h (voltage comes from the simulated battery)
+#ifndef __SIM_PM_H__
+#define __SIM_PM_H__
+
+float pmGetBatteryVoltage(void);
+
+#endif
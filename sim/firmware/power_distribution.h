@@ -0,0 +1,10 @@
+// Host stand-in for crazyflie-firmware power_distribution.h (legacy quad-X mixer)
+#ifndef __SIM_POWER_DISTRIBUTION_H__
+#define __SIM_POWER_DISTRIBUTION_H__
+
+#include "stabilizer_types.h"
+
+void powerDistribution(const control_t *control, motors_thrust_uncapped_t* motorThrustUncapped);
+bool powerDistributionCap(const motors_thrust_uncapped_t* motorThrustBatCompUncapped, motors_thrust_pwm_t* motorPwm);
+
+#endif
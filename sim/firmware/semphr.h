@@ -0,0 +1,26 @@
+// Host stand-in for FreeRTOS semphr.h (mutexes only). On the host the mutex is a pthread mutex, so contexts stepped
+// from several threads serialize on it; bare metal (bench) has a single thread and only tracks the holder count.
+#ifndef __SIM_SEMPHR_H__
+#define __SIM_SEMPHR_H__
+
+#include "FreeRTOS.h"
+#include "task.h"
+#ifdef __unix__
+#include <pthread.h>
+#endif
+
+typedef struct {
+#ifdef __unix__
+  pthread_mutex_t mutex;
+#else
+  uint8_t taken;
+#endif
+} StaticSemaphore_t;
+typedef StaticSemaphore_t* SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t* buffer);
+// Blocks until the mutex is available whatever the timeout
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+
+#endif
@@ -0,0 +1,165 @@
+// Host stand-in for crazyflie-firmware stabilizer_types.h (subset of the fields the app touches)
+#ifndef __SIM_STABILIZER_TYPES_H__
+#define __SIM_STABILIZER_TYPES_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define STABILIZER_NR_OF_MOTORS 4
+
+// Stabilizer loop rates of the classic controllers
+#define RATE_1000_HZ 1000
+#define RATE_500_HZ 500
+#define RATE_250_HZ 250
+#define RATE_100_HZ 100
+#define RATE_50_HZ 50
+#define RATE_25_HZ 25
+#define RATE_MAIN_LOOP RATE_1000_HZ
+#define ATTITUDE_RATE RATE_500_HZ
+#define POSITION_RATE RATE_100_HZ
+#define RATE_DO_EXECUTE(RATE_HZ, TICK) ((TICK % (RATE_MAIN_LOOP / RATE_HZ)) == 0)
+
+typedef struct {
+  uint32_t timestamp;
+  float roll;
+  float pitch;
+  float yaw;
+} attitude_t;
+
+typedef struct {
+  uint32_t timestamp;
+  union {
+    struct {
+      float q0;
+      float q1;
+      float q2;
+      float q3;
+    };
+    struct {
+      float x;
+      float y;
+      float z;
+      float w;
+    };
+  };
+} quaternion_t;
+
+typedef struct {
+  uint32_t timestamp;
+  float x;
+  float y;
+  float z;
+} vector_t;
+
+typedef vector_t point_t;
+typedef vector_t velocity_t;
+typedef vector_t acc_t;
+
+typedef struct {
+  union {
+    struct {
+      float x;
+      float y;
+      float z;
+    };
+    float axis[3];
+  };
+} Axis3f;
+
+typedef struct {
+  Axis3f acc;  // Gs
+  Axis3f gyro; // deg/s
+  Axis3f mag;  // gauss
+  uint64_t interruptTimestamp;
+} sensorData_t;
+
+typedef struct {
+  attitude_t attitude;
+  quaternion_t attitudeQuaternion;
+  point_t position;
+  velocity_t velocity;
+  acc_t acc;
+} state_t;
+
+typedef enum {
+  controlModeLegacy = 0,
+  controlModeForceTorque = 1,
+  controlModeForce = 2,
+} control_mode_t;
+
+// Layout of the firmware, which the classic controllers built from its tree (classic.mk) write
+typedef struct control_s {
+  union {
+    // controlModeLegacy
+    struct {
+      int16_t roll;
+      int16_t pitch;
+      int16_t yaw;
+      float thrust;
+    };
+    // controlModeForceTorque
+    struct {
+      float thrustSi; // N
+      union { // Nm
+        float torque[3];
+        struct {
+          float torqueX;
+          float torqueY;
+          float torqueZ;
+        };
+      };
+    };
+    // controlModeForce
+    float normalizedForces[STABILIZER_NR_OF_MOTORS]; // 0.0 ... 1.0
+  };
+  control_mode_t controlMode;
+} control_t;
+
+typedef union {
+  int32_t list[STABILIZER_NR_OF_MOTORS];
+  struct {
+    int32_t m1;
+    int32_t m2;
+    int32_t m3;
+    int32_t m4;
+  } motors;
+} motors_thrust_uncapped_t;
+
+typedef union {
+  uint16_t list[STABILIZER_NR_OF_MOTORS];
+  struct {
+    uint16_t m1;
+    uint16_t m2;
+    uint16_t m3;
+    uint16_t m4;
+  } motors;
+} motors_thrust_pwm_t;
+
+typedef enum mode_e {
+  modeDisable = 0,
+  modeAbs,
+  modeVelocity
+} stab_mode_t;
+
+typedef struct {
+  uint32_t timestamp;
+  attitude_t attitude;
+  attitude_t attitudeRate;
+  quaternion_t attitudeQuaternion;
+  float thrust;
+  point_t position;
+  velocity_t velocity;
+  acc_t acceleration;
+  bool velocity_body;
+  struct {
+    stab_mode_t x;
+    stab_mode_t y;
+    stab_mode_t z;
+    stab_mode_t roll;
+    stab_mode_t pitch;
+    stab_mode_t yaw;
+    stab_mode_t quat;
+  } mode;
+} setpoint_t;
+
+#endif
@@ -0,0 +1,21 @@
+// Host stand-in for FreeRTOS task.h (tick = 1ms, derived from the virtual clock)
+#ifndef __SIM_TASK_H__
+#define __SIM_TASK_H__
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+typedef uint32_t TickType_t;
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void* parameters);
+
+TickType_t xTaskGetTickCount(void);
+// There is no scheduler on the host: the task runs to completion inside xTaskCreate (it has to end with
+// vTaskDelete(NULL)), before the caller continues. Keeps the simulation deterministic.
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint16_t stack_depth, void* parameters, UBaseType_t priority, TaskHandle_t* handle);
+void vTaskDelete(TaskHandle_t task);
+// Running task only (NULL): the stack depth [words] it has never used so far, measured in host stack frames (bare
+// metal: not measured, the full depth)
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+#endif
@@ -0,0 +1,9 @@
+// Host stand-in for crazyflie-firmware usec_time.h (virtual clock driven by the simulation)
+#ifndef __SIM_USEC_TIME_H__
+#define __SIM_USEC_TIME_H__
+
+#include <stdint.h>
+
+uint64_t usecTimestamp(void);
+
+#endif
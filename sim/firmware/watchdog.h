@@ -0,0 +1,7 @@
+// Host stand-in for crazyflie-firmware watchdog.h
+#ifndef __SIM_WATCHDOG_H__
+#define __SIM_WATCHDOG_H__
+
+void watchdogReset(void);
+
+#endif
@@ -0,0 +1,336 @@
+#include "flight_log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern "C" {
+#include "rl_tools_adapter.h"
+}
+#include "rl_tools_adapter_precision.h"
+
+static bool read_csv(const char* path, FILE* file, FlightLog& log, bool (*wanted)(const std::string& name)){
+    char* line = nullptr;
+    size_t capacity = 0;
+    if(getline(&line, &capacity, file) < 0){
+        fprintf(stderr, "%s: empty log\n", path);
+        free(line);
+        return false;
+    }
+    int time_column = -1;
+    std::vector<FlightLogChannel*> columns;
+    for(char* saveptr = nullptr, *token = strtok_r(line, ",\r\n", &saveptr); token != nullptr; token = strtok_r(nullptr, ",\r\n", &saveptr)){
+        std::string name = token;
+        name.erase(0, name.find_first_not_of(' '));
+        if(name == "timestamp (ms)" || name == "timestamp"){
+            time_column = (int)columns.size();
+        }
+        columns.push_back(wanted(name) && log.count(name) == 0 ? &log[name] : nullptr);
+    }
+    if(time_column < 0){
+        fprintf(stderr, "%s: no timestamp (ms) column\n", path);
+        free(line);
+        return false;
+    }
+    while(getline(&line, &capacity, file) >= 0){
+        char* field = line;
+        double time = NAN;
+        std::vector<std::pair<FlightLogChannel*, float>> row;
+        for(size_t column_i = 0; column_i < columns.size() && field != nullptr; column_i++){
+            char* end = field;
+            double value = strtod(field, &end);
+            bool present = end != field;
+            if(present && (int)column_i == time_column){
+                time = value;
+            }
+            else if(present && columns[column_i] != nullptr){
+                row.emplace_back(columns[column_i], (float)value);
+            }
+            field = strchr(field, ',');
+            field = field != nullptr ? field + 1 : nullptr;
+        }
+        if(std::isnan(time)){
+            continue;
+        }
+        for(auto& [channel, value]: row){
+            channel->time.push_back(time);
+            channel->value.push_back(value);
+        }
+    }
+    free(line);
+    return true;
+}
+
+// usddeck format: 0xBC, uint16 version, uint16 event types; per type uint16 id and "name(variable:type,...)"; then
+// events of uint16 id, timestamp (version 1: uint32 ms, version 2: uint64 us) and the packed variables
+static bool read_usd(const char* path, const std::vector<unsigned char>& data, FlightLog& log, bool (*wanted)(const std::string& name)){
+    struct Variable{
+        FlightLogChannel* channel;
+        char type;
+    };
+    struct EventType{
+        std::vector<Variable> variables;
+        size_t size = 0;
+    };
+    auto read = [&](size_t offset, void* value, size_t size){
+        if(offset + size > data.size()){
+            return false;
+        }
+        memcpy(value, data.data() + offset, size);
+        return true;
+    };
+    uint16_t version = 0, event_types = 0;
+    if(!read(1, &version, 2) || !read(3, &event_types, 2) || (version != 1 && version != 2)){
+        fprintf(stderr, "%s: unsupported uSD log version\n", path);
+        return false;
+    }
+    std::map<uint16_t, EventType> types;
+    size_t offset = 5;
+    for(uint16_t type_i = 0; type_i < event_types; type_i++){
+        uint16_t id = 0;
+        if(!read(offset, &id, 2)){
+            break;
+        }
+        offset += 2;
+        const char* begin = (const char*)data.data() + offset;
+        const char* end = (const char*)memchr(begin, ')', data.size() - offset);
+        const char* open = (const char*)memchr(begin, '(', data.size() - offset);
+        if(end == nullptr || open == nullptr || open > end){
+            fprintf(stderr, "%s: malformed uSD log header\n", path);
+            return false;
+        }
+        EventType& type = types[id];
+        std::string variables(open + 1, end);
+        for(size_t start = 0; start < variables.size();){
+            size_t stop = variables.find(',', start);
+            stop = stop == std::string::npos ? variables.size() : stop;
+            std::string variable = variables.substr(start, stop - start);
+            size_t colon = variable.rfind(':');
+            if(colon == std::string::npos || colon + 2 != variable.size()){
+                fprintf(stderr, "%s: malformed uSD log variable %s\n", path, variable.c_str());
+                return false;
+            }
+            std::string name = variable.substr(0, colon);
+            char format = variable[colon + 1];
+            static const std::map<char, size_t> SIZES = {{'b', 1}, {'B', 1}, {'h', 2}, {'H', 2}, {'e', 2}, {'i', 4}, {'I', 4}, {'f', 4}};
+            if(SIZES.count(format) == 0){
+                fprintf(stderr, "%s: unknown uSD log type %c of %s\n", path, format, name.c_str());
+                return false;
+            }
+            type.variables.push_back({wanted(name) && log.count(name) == 0 ? &log[name] : nullptr, format});
+            type.size += SIZES.at(format);
+            start = stop + 1;
+        }
+        offset = end + 1 - (const char*)data.data();
+    }
+    size_t timestamp_size = version == 1 ? 4 : 8;
+    while(offset + 2 + timestamp_size <= data.size()){
+        uint16_t id = 0;
+        read(offset, &id, 2);
+        auto type = types.find(id);
+        if(type == types.end() || offset + 2 + timestamp_size + type->second.size > data.size()){
+            break; // trailing CRC or a truncated last event
+        }
+        double time;
+        if(version == 1){
+            uint32_t timestamp = 0;
+            read(offset + 2, &timestamp, 4);
+            time = timestamp;
+        }
+        else{
+            uint64_t timestamp = 0;
+            read(offset + 2, &timestamp, 8);
+            time = timestamp / 1000.0;
+        }
+        offset += 2 + timestamp_size;
+        for(const auto& variable: type->second.variables){
+            float value = 0;
+            switch(variable.type){
+                case 'b': { int8_t v = 0; read(offset, &v, 1); value = v; offset += 1; } break;
+                case 'B': { uint8_t v = 0; read(offset, &v, 1); value = v; offset += 1; } break;
+                case 'h': { int16_t v = 0; read(offset, &v, 2); value = v; offset += 2; } break;
+                case 'H': { uint16_t v = 0; read(offset, &v, 2); value = v; offset += 2; } break;
+                case 'e': { uint16_t v = 0; read(offset, &v, 2); value = rl_tools_adapter::precision::half_to_float(v); offset += 2; } break;
+                case 'i': { int32_t v = 0; read(offset, &v, 4); value = v; offset += 4; } break;
+                case 'I': { uint32_t v = 0; read(offset, &v, 4); value = v; offset += 4; } break;
+                case 'f': { read(offset, &value, 4); offset += 4; } break;
+            }
+            if(variable.channel != nullptr){
+                variable.channel->time.push_back(time);
+                variable.channel->value.push_back(value);
+            }
+        }
+    }
+    if(offset + 4 < data.size()){
+        fprintf(stderr, "%s: warning: %zu bytes after the last complete event ignored\n", path, data.size() - offset);
+    }
+    return true;
+}
+
+static bool read_log(const char* path, FlightLog& log, bool (*wanted)(const std::string& name)){
+    FILE* file = fopen(path, "rb");
+    if(file == nullptr){
+        perror(path);
+        return false;
+    }
+    int first = fgetc(file);
+    bool ok;
+    if(first == FLIGHT_LOG_USD_MAGIC){
+        std::vector<unsigned char> data(1, FLIGHT_LOG_USD_MAGIC);
+        unsigned char buffer[1 << 16];
+        size_t read;
+        while((read = fread(buffer, 1, sizeof(buffer), file)) > 0){
+            data.insert(data.end(), buffer, buffer + read);
+        }
+        ok = read_usd(path, data, log, wanted);
+    }
+    else{
+        ungetc(first, file);
+        ok = read_csv(path, file, log, wanted);
+    }
+    fclose(file);
+    return ok;
+}
+
+bool flight_log_read(const std::string& paths, FlightLog& log, bool (*wanted)(const std::string& name)){
+    for(size_t start = 0; start < paths.size();){
+        size_t stop = paths.find(',', start);
+        stop = stop == std::string::npos ? paths.size() : stop;
+        if(!read_log(paths.substr(start, stop - start).c_str(), log, wanted)){
+            return false;
+        }
+        start = stop + 1;
+    }
+    // Samples in time order per channel (the logs of a flight may be concatenated or interleaved)
+    for(auto& [name, channel]: log){
+        std::vector<size_t> order(channel.time.size());
+        for(size_t i = 0; i < order.size(); i++){
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){ return channel.time[a] < channel.time[b]; });
+        std::vector<double> time(order.size());
+        std::vector<float> value(order.size());
+        for(size_t i = 0; i < order.size(); i++){
+            time[i] = channel.time[order[i]];
+            value[i] = channel.value[order[i]];
+        }
+        channel.time.swap(time);
+        channel.value.swap(value);
+        channel.cursor = 0;
+    }
+    return true;
+}
+
+bool flight_log_is_log(const char* path){
+    FILE* file = fopen(path, "rb");
+    if(file == nullptr){
+        return false;
+    }
+    char start[9] = {};
+    size_t read = fread(start, 1, sizeof(start), file);
+    fclose(file);
+    // CSV logs start with their timestamp column
+    return read > 0 && ((unsigned char)start[0] == FLIGHT_LOG_USD_MAGIC || (read == sizeof(start) && memcmp(start, "timestamp", sizeof(start)) == 0));
+}
+
+void flight_log_range(FlightLogChannel* const* channels, unsigned count, double& start, double& end){
+    start = -INFINITY;
+    end = INFINITY;
+    for(unsigned channel_i = 0; channel_i < count; channel_i++){
+        if(channels[channel_i] != nullptr && !channels[channel_i]->time.empty()){
+            start = std::max(start, channels[channel_i]->time.front());
+            end = std::min(end, channels[channel_i]->time.back());
+        }
+    }
+}
+
+bool flight_log_find(FlightLog& log, const std::vector<std::vector<std::string>>& alternatives, FlightLogChannel** result, size_t* chosen){
+    for(size_t alternative_i = 0; alternative_i < alternatives.size(); alternative_i++){
+        const auto& names = alternatives[alternative_i];
+        bool complete = true;
+        for(const auto& name: names){
+            auto channel = log.find(name);
+            complete = complete && channel != log.end() && !channel->second.time.empty();
+        }
+        if(complete){
+            for(size_t name_i = 0; name_i < names.size(); name_i++){
+                result[name_i] = &log.at(names[name_i]);
+            }
+            if(chosen != nullptr){
+                *chosen = alternative_i;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+// Position of time in the channel: the sample at or before it and the interpolation weight of the next one. False if
+// time is outside the samples or in a gap longer than max_gap.
+static bool locate(FlightLogChannel& channel, double time, float max_gap, float& weight){
+    size_t& cursor = channel.cursor;
+    while(cursor + 1 < channel.time.size() && channel.time[cursor + 1] <= time){
+        cursor++;
+    }
+    if(time < channel.time[cursor]){
+        return false;
+    }
+    if(cursor + 1 == channel.time.size()){
+        weight = 0;
+        return time == channel.time[cursor];
+    }
+    double interval = channel.time[cursor + 1] - channel.time[cursor];
+    weight = interval > 0 ? (float)((time - channel.time[cursor]) / interval) : 0;
+    return interval <= max_gap;
+}
+
+bool flight_log_sample(FlightLogChannel* channel, double time, float max_gap, bool hold, float& value){
+    float weight;
+    if(!locate(*channel, time, max_gap, weight)){
+        return false;
+    }
+    size_t index = channel->cursor;
+    value = hold || weight == 0 ? channel->value[index] : channel->value[index] + weight * (channel->value[index + 1] - channel->value[index]);
+    return true;
+}
+
+bool flight_log_average(FlightLogChannel* channel, double start, double end, float max_gap, float& mean, float* mean_square){
+    float weight;
+    if(!locate(*channel, start, max_gap, weight)){
+        return false;
+    }
+    double sum = 0, square_sum = 0, time = start;
+    size_t index = channel->cursor;
+    auto add = [&](double until){
+        double value = channel->value[index];
+        sum += value * (until - time);
+        square_sum += value * value * (until - time);
+        time = until;
+    };
+    for(; index + 1 < channel->time.size() && channel->time[index + 1] < end; index++){
+        if(channel->time[index + 1] - channel->time[index] > max_gap){
+            return false;
+        }
+        add(channel->time[index + 1]);
+    }
+    if(index + 1 == channel->time.size() && end - channel->time[index] > max_gap){
+        return false;
+    }
+    add(end);
+    double duration = end - start;
+    mean = duration > 0 ? (float)(sum / duration) : channel->value[index];
+    if(mean_square != nullptr){
+        *mean_square = duration > 0 ? (float)(square_sum / duration) : channel->value[index] * channel->value[index];
+    }
+    return true;
+}
+
+bool flight_log_sample_all(FlightLogChannel* const* channels, unsigned count, double time, float max_gap, bool hold, float* values){
+    bool valid = true;
+    for(unsigned channel_i = 0; channel_i < count; channel_i++){
+        valid = flight_log_sample(channels[channel_i], time, max_gap, hold, values[channel_i]) && valid;
+    }
+    return valid;
+}
@@ -0,0 +1,37 @@
+// Flight logs on the host: CSV logs (scripts/basiclog.py, cfclient, sim --log) and uSD-card logs (meta/config_*.txt,
+// usddeck binary format) read into one sample series per logged variable, for the offline tools (dataset, sysid)
+#ifndef __SIM_FLIGHT_LOG_H__
+#define __SIM_FLIGHT_LOG_H__
+
+#include <map>
+#include <string>
+#include <vector>
+
+#define FLIGHT_LOG_USD_MAGIC 0xBC
+
+// One logged variable: its samples in time order [ms]
+struct FlightLogChannel{
+    std::vector<double> time;
+    std::vector<float> value;
+    size_t cursor = 0; // sampling position, advanced by flight_log_sample
+};
+using FlightLog = std::map<std::string, FlightLogChannel>;
+
+// Reads the logs of one flight (paths separated by commas, aligned by their timestamps), keeping the variables wanted
+// accepts; of a variable logged in several files the first one is kept
+bool flight_log_read(const std::string& paths, FlightLog& log, bool (*wanted)(const std::string& name));
+// True if path starts like a CSV or uSD-card log
+bool flight_log_is_log(const char* path);
+// Time span covered by all of the channels (null entries are skipped)
+void flight_log_range(FlightLogChannel* const* channels, unsigned count, double& start, double& end);
+// The first alternative whose variables are all present and non-empty, in its order; chosen is its index
+bool flight_log_find(FlightLog& log, const std::vector<std::vector<std::string>>& alternatives, FlightLogChannel** result, size_t* chosen = nullptr);
+// Value at time, linearly interpolated or held from the sample at or before it. False outside the samples or in a gap
+// longer than max_gap [ms]. Times have to be non-decreasing per channel between flight_log_read and the next rewind.
+bool flight_log_sample(FlightLogChannel* channel, double time, float max_gap, bool hold, float& value);
+// Mean (and mean square) of the held values over [start, end), e.g. of a command logged faster than the resampling
+// period. False under the same conditions as flight_log_sample.
+bool flight_log_average(FlightLogChannel* channel, double start, double end, float max_gap, float& mean, float* mean_square = nullptr);
+bool flight_log_sample_all(FlightLogChannel* const* channels, unsigned count, double time, float max_gap, bool hold, float* values);
+
+#endif
@@ -0,0 +1,169 @@
+// Load generator for the inference server
+// Runs --clients closed-loop clients (one connection each, like one simulator process each) that send --requests
+// requests of --rows random actor inputs and reports throughput, round-trip latency and the server-side queue/compute
+// time and batch size as reported in the responses.
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "inference_protocol.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Config{
+    std::string path = INFERENCE_DEFAULT_SOCKET;
+    uint32_t clients = 8;
+    uint32_t requests = 1000;
+    uint32_t rows = 1;
+};
+
+struct ClientResult{
+    bool ok = false;
+    std::vector<double> round_trip_us;
+    double queue_us = 0;
+    double compute_us = 0;
+    double batch_rows = 0;
+};
+
+static bool parse(int argc, char** argv, Config& config){
+    for(int arg_i = 1; arg_i < argc; arg_i++){
+        std::string arg = argv[arg_i];
+        if(arg_i + 1 >= argc){
+            return false;
+        }
+        if(arg == "--socket"){
+            config.path = argv[++arg_i];
+        }
+        else if(arg == "--clients"){
+            config.clients = (uint32_t)atoi(argv[++arg_i]);
+        }
+        else if(arg == "--requests"){
+            config.requests = (uint32_t)atoi(argv[++arg_i]);
+        }
+        else if(arg == "--rows"){
+            config.rows = (uint32_t)atoi(argv[++arg_i]);
+        }
+        else{
+            return false;
+        }
+    }
+    return config.clients >= 1 && config.requests >= 1 && config.rows >= 1;
+}
+
+static int connect_server(const std::string& path, InferenceInfo& info){
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    if(fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) != 0){
+        perror(path.c_str());
+        if(fd >= 0){
+            close(fd);
+        }
+        return -1;
+    }
+    if(recv(fd, &info, sizeof(info), 0) != sizeof(info) || info.magic != INFERENCE_MAGIC){
+        fprintf(stderr, "%s: not an inference server\n", path.c_str());
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void run_client(const Config& config, uint32_t client_i, ClientResult& result){
+    InferenceInfo info;
+    int fd = connect_server(config.path, info);
+    if(fd < 0){
+        return;
+    }
+    std::mt19937 rng(client_i);
+    std::uniform_real_distribution<float> distribution(-1, 1);
+    std::vector<uint8_t> request_message(sizeof(InferenceRequest) + config.rows * info.input_dim * sizeof(float));
+    std::vector<uint8_t> response_message(sizeof(InferenceResponse) + config.rows * info.output_dim * sizeof(float));
+    float* input = (float*)(request_message.data() + sizeof(InferenceRequest));
+    result.round_trip_us.reserve(config.requests);
+    for(uint32_t request_i = 0; request_i < config.requests; request_i++){
+        InferenceRequest request = {INFERENCE_MAGIC, request_i, info.input_dim, config.rows};
+        memcpy(request_message.data(), &request, sizeof(request));
+        for(uint32_t value_i = 0; value_i < config.rows * info.input_dim; value_i++){
+            input[value_i] = distribution(rng);
+        }
+        auto start = Clock::now();
+        if(send(fd, request_message.data(), request_message.size(), MSG_NOSIGNAL) != (ssize_t)request_message.size()){
+            perror("send");
+            close(fd);
+            return;
+        }
+        ssize_t size = recv(fd, response_message.data(), response_message.size(), 0);
+        auto end = Clock::now();
+        InferenceResponse response;
+        if(size < (ssize_t)sizeof(response)){
+            fprintf(stderr, "client %u: connection closed\n", client_i);
+            close(fd);
+            return;
+        }
+        memcpy(&response, response_message.data(), sizeof(response));
+        if(response.status != INFERENCE_OK || response.id != request_i){
+            fprintf(stderr, "client %u: request %u failed with status %u\n", client_i, request_i, response.status);
+            close(fd);
+            return;
+        }
+        result.round_trip_us.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+        result.queue_us += response.queue_us;
+        result.compute_us += response.compute_us;
+        result.batch_rows += response.batch_rows;
+    }
+    close(fd);
+    result.ok = true;
+}
+
+int main(int argc, char** argv){
+    Config config;
+    if(!parse(argc, argv, config)){
+        fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --socket <path>           UNIX socket (default " INFERENCE_DEFAULT_SOCKET ")\n"
+            "  --clients <n>             concurrent clients (default 8)\n"
+            "  --requests <n>            requests per client (default 1000)\n"
+            "  --rows <n>                actor inputs per request (default 1)\n", argv[0]);
+        return 1;
+    }
+    std::vector<ClientResult> results(config.clients);
+    std::vector<std::thread> clients;
+    auto start = Clock::now();
+    for(uint32_t client_i = 0; client_i < config.clients; client_i++){
+        clients.emplace_back(run_client, std::cref(config), client_i, std::ref(results[client_i]));
+    }
+    for(auto& client: clients){
+        client.join();
+    }
+    double duration = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<double> round_trip_us;
+    double queue_us = 0, compute_us = 0, batch_rows = 0;
+    for(const auto& result: results){
+        if(!result.ok){
+            return 1;
+        }
+        round_trip_us.insert(round_trip_us.end(), result.round_trip_us.begin(), result.round_trip_us.end());
+        queue_us += result.queue_us;
+        compute_us += result.compute_us;
+        batch_rows += result.batch_rows;
+    }
+    std::sort(round_trip_us.begin(), round_trip_us.end());
+    size_t requests = round_trip_us.size();
+    printf("%zu requests in %.2fs: %.0f requests/s, %.0f rows/s\n", requests, duration, requests / duration, requests * config.rows / duration);
+    printf("round trip: median %.1fus, p99 %.1fus, max %.1fus\n", round_trip_us[requests / 2], round_trip_us[(requests * 99) / 100], round_trip_us.back());
+    printf("server: queue %.1fus, compute %.1fus/batch, %.1f rows/batch\n", queue_us / requests, compute_us / requests, batch_rows / requests);
+    return 0;
+}
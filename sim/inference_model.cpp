@@ -0,0 +1,95 @@
+#include "inference_model.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <rl_tools/operations/arm.h>
+#include <rl_tools/nn/layers/dense/operations_arm/opt.h>
+#include <rl_tools/nn_models/sequential/operations_generic.h>
+
+// Same checkpoint selection as rl_tools_adapter.cpp; the inputs are complete actor inputs (observation, action history
+// and normalization are the client's business)
+#ifndef RL_TOOLS_CHECKPOINT
+#define RL_TOOLS_CHECKPOINT "policies/l2f_action_history_delay_3M.h"
+#endif
+#include RL_TOOLS_CHECKPOINT
+
+namespace rlt = rl_tools;
+
+using DEV_SPEC = rlt::devices::DefaultARMSpecification;
+using DEVICE = rlt::devices::arm::OPT<DEV_SPEC>;
+static DEVICE device;
+using ACTOR_TYPE = rlt::checkpoint::actor::MODEL;
+using TI = typename ACTOR_TYPE::SPEC::TI;
+using T = typename ACTOR_TYPE::SPEC::T;
+constexpr TI INPUT_DIM = ACTOR_TYPE::SPEC::INPUT_DIM;
+constexpr TI OUTPUT_DIM = ACTOR_TYPE::SPEC::OUTPUT_DIM;
+static_assert((INFERENCE_MAX_BATCH & (INFERENCE_MAX_BATCH - 1)) == 0, "INFERENCE_MAX_BATCH has to be a power of two");
+
+static rlt::MatrixStatic<rlt::matrix::Specification<T, TI, INFERENCE_MAX_BATCH, INPUT_DIM>> input;
+static rlt::MatrixStatic<rlt::matrix::Specification<T, TI, INFERENCE_MAX_BATCH, OUTPUT_DIM>> output;
+
+// The batch is evaluated as one matrix product per layer on the first BATCH_SIZE rows, rows beyond the request hold
+// stale inputs whose outputs are ignored
+template <TI BATCH_SIZE>
+static void evaluate_batch(){
+    static ACTOR_TYPE::template Buffer<BATCH_SIZE, rlt::MatrixStaticTag> buffers;
+    auto input_batch = rlt::view(device, input, rlt::matrix::ViewSpec<BATCH_SIZE, INPUT_DIM>{}, 0, 0);
+    auto output_batch = rlt::view(device, output, rlt::matrix::ViewSpec<BATCH_SIZE, OUTPUT_DIM>{}, 0, 0);
+    rlt::evaluate(device, rlt::checkpoint::actor::model, input_batch, output_batch, buffers);
+}
+
+template <TI BATCH_SIZE>
+static void dispatch(TI rows){
+    if constexpr(BATCH_SIZE >= INFERENCE_MAX_BATCH){
+        evaluate_batch<INFERENCE_MAX_BATCH>();
+    }
+    else{
+        if(rows <= BATCH_SIZE){
+            evaluate_batch<BATCH_SIZE>();
+        }
+        else{
+            dispatch<BATCH_SIZE * 2>(rows);
+        }
+    }
+}
+
+InferenceModelInfo inference_model_info(){
+    return {(uint32_t)INPUT_DIM, (uint32_t)OUTPUT_DIM, rlt::checkpoint::meta::name};
+}
+
+float inference_model_test(){
+    static float input_rows[INFERENCE_MAX_BATCH * INPUT_DIM];
+    static float output_rows[INFERENCE_MAX_BATCH * OUTPUT_DIM];
+    for(TI row_i = 0; row_i < INFERENCE_MAX_BATCH; row_i++){
+        for(TI input_i = 0; input_i < INPUT_DIM; input_i++){
+            input_rows[row_i * INPUT_DIM + input_i] = rlt::get(rlt::checkpoint::observation::container, 0, input_i);
+        }
+    }
+    float absdiff = 0;
+    for(TI rows: {(TI)1, (TI)3, (TI)INFERENCE_MAX_BATCH}){
+        inference_model_evaluate(input_rows, rows, output_rows);
+        for(TI row_i = 0; row_i < rows; row_i++){
+            float row_absdiff = 0;
+            for(TI output_i = 0; output_i < OUTPUT_DIM; output_i++){
+                row_absdiff += std::abs(output_rows[row_i * OUTPUT_DIM + output_i] - rlt::get(rlt::checkpoint::action::container, 0, output_i));
+            }
+            absdiff = std::max(absdiff, row_absdiff);
+        }
+    }
+    return absdiff;
+}
+
+void inference_model_evaluate(const float* input_rows, uint32_t rows, float* output_rows){
+    for(TI row_i = 0; row_i < rows; row_i++){
+        for(TI input_i = 0; input_i < INPUT_DIM; input_i++){
+            rlt::set(input, row_i, input_i, input_rows[row_i * INPUT_DIM + input_i]);
+        }
+    }
+    dispatch<1>(rows);
+    for(TI row_i = 0; row_i < rows; row_i++){
+        for(TI output_i = 0; output_i < OUTPUT_DIM; output_i++){
+            output_rows[row_i * OUTPUT_DIM + output_i] = rlt::get(output, row_i, output_i);
+        }
+    }
+}
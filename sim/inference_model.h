@@ -0,0 +1,27 @@
+// Batched evaluation of the checkpoint actor for the inference server
+#ifndef __SIM_INFERENCE_MODEL_H__
+#define __SIM_INFERENCE_MODEL_H__
+
+#include <stdint.h>
+
+// Largest batch evaluated at once; batches are padded to the next power of two (one buffer set per size)
+#ifndef INFERENCE_MAX_BATCH
+#define INFERENCE_MAX_BATCH 64
+#endif
+
+struct InferenceModelInfo{
+    uint32_t input_dim;
+    uint32_t output_dim;
+    const char* checkpoint;
+};
+
+InferenceModelInfo inference_model_info();
+// input: rows * input_dim floats, output: rows * output_dim floats, rows <= INFERENCE_MAX_BATCH. Not re-entrant.
+void inference_model_evaluate(const float* input, uint32_t rows, float* output);
+#define INFERENCE_TEST_TOLERANCE 0.2f // as the controller's SELF_TEST_TOLERANCE
+
+// Golden-output check: the checkpoint's reference observation in every row of batches of 1, 3 and INFERENCE_MAX_BATCH
+// rows; returns the largest summed absolute deviation of a row from the reference action
+float inference_model_test();
+
+#endif
@@ -0,0 +1,47 @@
+// Wire format of the inference server (inference_server.cpp) on a UNIX SOCK_SEQPACKET socket, one message per packet,
+// native byte order (clients run on the same host)
+#ifndef __SIM_INFERENCE_PROTOCOL_H__
+#define __SIM_INFERENCE_PROTOCOL_H__
+
+#include <stdint.h>
+
+#define INFERENCE_DEFAULT_SOCKET "/tmp/rl_tools_inference.sock"
+#define INFERENCE_MAGIC 0x46524e49 // "INRF"
+#define INFERENCE_CHECKPOINT_NAME_LENGTH 64
+
+enum InferenceStatus{
+    INFERENCE_OK = 0,
+    INFERENCE_BAD_REQUEST = 1, // wrong magic, input dimension or size
+    INFERENCE_TOO_MANY_ROWS = 2, // more rows than max_batch
+};
+
+// Sent by the server after accept
+struct InferenceInfo{
+    uint32_t magic;
+    uint32_t input_dim;
+    uint32_t output_dim;
+    uint32_t max_batch;
+    char checkpoint[INFERENCE_CHECKPOINT_NAME_LENGTH];
+};
+
+// Followed by rows * input_dim floats (row-major); the rows of one request are evaluated in the same batch
+struct InferenceRequest{
+    uint32_t magic;
+    uint32_t id; // echoed in the response
+    uint32_t input_dim;
+    uint32_t rows;
+};
+
+// Followed by rows * output_dim floats if status == INFERENCE_OK
+struct InferenceResponse{
+    uint32_t id;
+    uint32_t status;
+    uint32_t output_dim;
+    uint32_t rows;
+    uint32_t queue_us; // receive to start of the batch evaluation
+    uint32_t compute_us; // batch evaluation
+    uint32_t batch_rows; // rows evaluated together with this request
+    uint32_t reserved;
+};
+
+#endif
@@ -0,0 +1,291 @@
+// Local inference service for simulation campaigns
+// Serves the checkpoint actor (inference_model.cpp) on a UNIX SOCK_SEQPACKET socket to any number of simulator
+// processes. Requests that arrive while a batch is open are coalesced until the batch is full (--max-batch rows) or the
+// oldest request has waited --deadline microseconds, then evaluated as one batch (one matrix product per layer instead
+// of one matrix-vector product per request). Every response carries its queue and compute time, the server prints
+// throughput and batch statistics periodically. Protocol: inference_protocol.h, load generator: inference_load.cpp.
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "inference_model.h"
+#include "inference_protocol.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Config{
+    std::string path = INFERENCE_DEFAULT_SOCKET;
+    uint32_t max_batch = INFERENCE_MAX_BATCH;
+    uint32_t deadline_us = 200;
+    float report_interval = 10; // s, 0 = off
+};
+
+struct PendingRequest{
+    int fd; // -1 if the client disconnected before the batch was evaluated
+    uint32_t id;
+    uint32_t rows;
+    uint32_t row_offset;
+    Clock::time_point received_at;
+};
+
+struct Statistics{
+    uint64_t requests = 0;
+    uint64_t rows = 0;
+    uint64_t batches = 0;
+    uint64_t rejected = 0;
+    double queue_us = 0;
+    double compute_us = 0;
+};
+
+struct Server{
+    Config config;
+    InferenceModelInfo model;
+    int listen_fd = -1;
+    int epoll_fd = -1;
+    std::vector<PendingRequest> pending;
+    uint32_t pending_rows = 0;
+    std::vector<float> input; // max_batch * input_dim
+    std::vector<float> output; // max_batch * output_dim
+    std::vector<uint8_t> message;
+    Statistics statistics;
+    Statistics reported;
+};
+
+static volatile sig_atomic_t running = 1;
+
+static void stop(int){
+    running = 0;
+}
+
+static bool parse(int argc, char** argv, Config& config){
+    for(int arg_i = 1; arg_i < argc; arg_i++){
+        std::string arg = argv[arg_i];
+        if(arg_i + 1 >= argc){
+            return false;
+        }
+        if(arg == "--socket"){
+            config.path = argv[++arg_i];
+        }
+        else if(arg == "--max-batch"){
+            config.max_batch = (uint32_t)atoi(argv[++arg_i]);
+        }
+        else if(arg == "--deadline"){
+            config.deadline_us = (uint32_t)atoi(argv[++arg_i]);
+        }
+        else if(arg == "--report"){
+            config.report_interval = atof(argv[++arg_i]);
+        }
+        else{
+            return false;
+        }
+    }
+    return config.max_batch >= 1 && config.max_batch <= INFERENCE_MAX_BATCH;
+}
+
+static void send_response(int fd, const InferenceResponse& response, const float* output){
+    if(fd < 0){
+        return;
+    }
+    iovec parts[2] = {{(void*)&response, sizeof(response)}, {(void*)output, response.status == INFERENCE_OK ? response.rows * response.output_dim * sizeof(float) : 0}};
+    msghdr message = {};
+    message.msg_iov = parts;
+    message.msg_iovlen = 2;
+    sendmsg(fd, &message, MSG_NOSIGNAL); // a client that went away is noticed by epoll
+}
+
+static void reject(Server& server, int fd, uint32_t id, InferenceStatus status){
+    InferenceResponse response = {};
+    response.id = id;
+    response.status = status;
+    response.output_dim = server.model.output_dim;
+    send_response(fd, response, nullptr);
+    server.statistics.rejected++;
+}
+
+static void evaluate(Server& server){
+    if(server.pending.empty()){
+        return;
+    }
+    auto start = Clock::now();
+    inference_model_evaluate(server.input.data(), server.pending_rows, server.output.data());
+    auto end = Clock::now();
+    uint32_t compute_us = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    for(const PendingRequest& request: server.pending){
+        InferenceResponse response = {};
+        response.id = request.id;
+        response.status = INFERENCE_OK;
+        response.output_dim = server.model.output_dim;
+        response.rows = request.rows;
+        response.queue_us = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(start - request.received_at).count();
+        response.compute_us = compute_us;
+        response.batch_rows = server.pending_rows;
+        send_response(request.fd, response, server.output.data() + request.row_offset * server.model.output_dim);
+        server.statistics.queue_us += response.queue_us;
+    }
+    server.statistics.requests += server.pending.size();
+    server.statistics.rows += server.pending_rows;
+    server.statistics.batches++;
+    server.statistics.compute_us += compute_us;
+    server.pending.clear();
+    server.pending_rows = 0;
+}
+
+static void receive(Server& server, int fd, Clock::time_point now){
+    ssize_t size = recv(fd, server.message.data(), server.message.size(), MSG_DONTWAIT | MSG_TRUNC);
+    if(size <= 0){
+        if(size == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)){
+            epoll_ctl(server.epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+            close(fd);
+            for(PendingRequest& request: server.pending){
+                if(request.fd == fd){
+                    request.fd = -1;
+                }
+            }
+        }
+        return;
+    }
+    InferenceRequest request;
+    if((size_t)size < sizeof(request)){
+        reject(server, fd, 0, INFERENCE_BAD_REQUEST);
+        return;
+    }
+    memcpy(&request, server.message.data(), sizeof(request));
+    size_t expected = sizeof(request) + (size_t)request.rows * server.model.input_dim * sizeof(float);
+    if(request.magic != INFERENCE_MAGIC || request.input_dim != server.model.input_dim || request.rows == 0 || (size_t)size != expected){
+        reject(server, fd, request.id, INFERENCE_BAD_REQUEST);
+        return;
+    }
+    if(request.rows > server.config.max_batch){
+        reject(server, fd, request.id, INFERENCE_TOO_MANY_ROWS);
+        return;
+    }
+    if(server.pending_rows + request.rows > server.config.max_batch){
+        evaluate(server);
+    }
+    memcpy(server.input.data() + server.pending_rows * server.model.input_dim, server.message.data() + sizeof(request), request.rows * server.model.input_dim * sizeof(float));
+    server.pending.push_back({fd, request.id, request.rows, server.pending_rows, now});
+    server.pending_rows += request.rows;
+    if(server.pending_rows == server.config.max_batch){
+        evaluate(server);
+    }
+}
+
+static void report(Server& server, double interval){
+    Statistics& now = server.statistics;
+    Statistics& last = server.reported;
+    uint64_t requests = now.requests - last.requests;
+    uint64_t batches = now.batches - last.batches;
+    if(requests > 0){
+        fprintf(stderr, "%.0f requests/s, %.0f rows/s, %.1f rows/batch, queue %.1fus, compute %.1fus/batch, %llu rejected\n",
+            requests / interval, (now.rows - last.rows) / interval, (double)(now.rows - last.rows) / batches,
+            (now.queue_us - last.queue_us) / requests, (now.compute_us - last.compute_us) / batches, (unsigned long long)(now.rejected - last.rejected));
+    }
+    last = now;
+}
+
+int main(int argc, char** argv){
+    Server server;
+    if(!parse(argc, argv, server.config)){
+        fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --socket <path>           UNIX socket (default " INFERENCE_DEFAULT_SOCKET ")\n"
+            "  --max-batch <rows>        rows per batch, 1..%d (default %d)\n"
+            "  --deadline <us>           longest wait of a request for the batch to fill (default 200)\n"
+            "  --report <s>              statistics interval, 0 = off (default 10)\n", argv[0], INFERENCE_MAX_BATCH, INFERENCE_MAX_BATCH);
+        return 1;
+    }
+    server.model = inference_model_info();
+    // The batched kernels have to reproduce the checkpoint's reference action before anything is served
+    float absdiff = inference_model_test();
+    if(!(absdiff <= INFERENCE_TEST_TOLERANCE)){
+        fprintf(stderr, "%s: golden-output check failed (abs diff %f)\n", server.model.checkpoint, absdiff);
+        return 1;
+    }
+    server.input.resize(server.config.max_batch * server.model.input_dim);
+    server.output.resize(server.config.max_batch * server.model.output_dim);
+    server.message.resize(sizeof(InferenceRequest) + server.config.max_batch * server.model.input_dim * sizeof(float));
+
+    server.listen_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, server.config.path.c_str(), sizeof(address.sun_path) - 1);
+    unlink(server.config.path.c_str());
+    if(server.listen_fd < 0 || bind(server.listen_fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(server.listen_fd, 128) != 0){
+        perror(server.config.path.c_str());
+        return 1;
+    }
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    server.epoll_fd = epoll_create1(0);
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = server.listen_fd;
+    epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, server.listen_fd, &event);
+    fprintf(stderr, "Serving %s on %s (input %u, output %u, max batch %u, deadline %uus)\n", server.model.checkpoint, server.config.path.c_str(),
+        server.model.input_dim, server.model.output_dim, server.config.max_batch, server.config.deadline_us);
+
+    InferenceInfo info = {};
+    info.magic = INFERENCE_MAGIC;
+    info.input_dim = server.model.input_dim;
+    info.output_dim = server.model.output_dim;
+    info.max_batch = server.config.max_batch;
+    strncpy(info.checkpoint, server.model.checkpoint, sizeof(info.checkpoint) - 1);
+
+    auto last_report = Clock::now();
+    while(running){
+        int timeout_ms = -1;
+        if(!server.pending.empty()){
+            auto deadline = server.pending.front().received_at + std::chrono::microseconds(server.config.deadline_us);
+            auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - Clock::now()).count();
+            timeout_ms = remaining > 0 ? (int)((remaining + 999) / 1000) : 0;
+            // Sub-millisecond deadlines: poll without blocking instead of sleeping a full millisecond
+            if(remaining > 0 && remaining < 1000){
+                timeout_ms = 0;
+            }
+        }
+        else if(server.config.report_interval > 0){
+            timeout_ms = (int)(server.config.report_interval * 1000);
+        }
+        epoll_event events[64];
+        int count = epoll_wait(server.epoll_fd, events, 64, timeout_ms);
+        auto now = Clock::now();
+        for(int event_i = 0; event_i < count; event_i++){
+            int fd = events[event_i].data.fd;
+            if(fd == server.listen_fd){
+                int client_fd = accept(server.listen_fd, nullptr, nullptr);
+                if(client_fd >= 0){
+                    send(client_fd, &info, sizeof(info), MSG_NOSIGNAL);
+                    epoll_event client_event = {};
+                    client_event.events = EPOLLIN;
+                    client_event.data.fd = client_fd;
+                    epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, client_fd, &client_event);
+                }
+            }
+            else{
+                receive(server, fd, now);
+            }
+        }
+        if(!server.pending.empty() && Clock::now() - server.pending.front().received_at >= std::chrono::microseconds(server.config.deadline_us)){
+            evaluate(server);
+        }
+        double since_report = std::chrono::duration<double>(Clock::now() - last_report).count();
+        if(server.config.report_interval > 0 && since_report >= server.config.report_interval){
+            report(server, since_report);
+            last_report = Clock::now();
+        }
+    }
+    evaluate(server);
+    close(server.listen_fd);
+    unlink(server.config.path.c_str());
+    return 0;
+}
@@ -0,0 +1,725 @@
+// Local CRTP link stand-in
+// Runs the closed-loop simulation in (scaled) real time and serves CRTP packets over UDP on localhost with the
+// packet semantics of the firmware: param and log TOC (v2), param read/write, log blocks, generic commander
+// (TYPE_HOVER / TYPE_POSITION setpoints, the META_COMMAND trigger), swarm setpoints on the app channel, memory reads
+// and console output. Link throughput, latency and uplink jitter are emulated so the host workflow
+// (scripts/basiclog.py, scripts/trigger.py via scripts/simlink.py) can be run and benchmarked without a radio.
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "firmware/log.h"
+#include "firmware/param.h"
+#include "firmware/mem.h"
+#include "firmware/task.h"
+#include "rl_tools_controller.h"
+}
+#include "crtp.h"
+#include "firmware.h"
+#include "simulation.h"
+
+constexpr uint8_t LOG_MAX_BLOCKS = 16;
+constexpr uint8_t LOG_MAX_BLOCK_SIZE = 26;
+constexpr uint8_t PROTOCOL_VERSION = 7;
+constexpr uint64_t COMMANDER_TIMEOUT_US = 500 * 1000;
+constexpr size_t DOWNLINK_QUEUE_SIZE = 32; // log packets that do not fit are dropped, like a full CRTP TX queue
+
+constexpr uint8_t ENOENT_ERROR = 2;
+constexpr uint8_t EIO_ERROR = 5;
+constexpr uint8_t E2BIG_ERROR = 7;
+constexpr uint8_t ENOMEM_ERROR = 12;
+constexpr uint8_t EEXIST_ERROR = 17;
+
+using Clock = std::chrono::steady_clock;
+
+struct Packet{
+    Clock::time_point deliver_at;
+    uint8_t header;
+    uint8_t size;
+    uint8_t data[CRTP_MAX_DATA_SIZE];
+};
+
+struct LogBlockVariable{
+    const log_s* variable;
+    uint8_t fetch_type;
+};
+
+struct LogBlock{
+    bool allocated = false;
+    bool running = false;
+    uint32_t period_ms = 0;
+    uint64_t next_sample_us = 0;
+    std::vector<LogBlockVariable> variables;
+};
+
+struct Config{
+    uint16_t port = 19850;
+    float speed = 1;
+    float link_rate = 1000; // packets/s per direction
+    float link_latency_ms = 2; // one-way
+    float link_jitter_ms = 0; // additional uniformly distributed uplink delay, in order
+    uint32_t tick_offset_ms = 0;
+    std::vector<std::string> params;
+    BatteryParameters battery;
+    const char* bus = nullptr;
+    bool verbose = false;
+};
+
+struct Link{
+    Config config;
+    int socket_fd = -1;
+    sockaddr_in client = {};
+    bool has_client = false;
+    std::deque<Packet> uplink;
+    std::deque<Packet> downlink;
+    Clock::time_point uplink_free_at;
+    Clock::time_point uplink_last_deliver_at;
+    std::mt19937 random;
+    Clock::time_point downlink_free_at;
+    std::vector<const log_s*> log_toc;
+    std::vector<const param_s*> param_toc;
+    uint32_t log_toc_crc = 0;
+    uint32_t param_toc_crc = 0;
+    LogBlock log_blocks[LOG_MAX_BLOCKS];
+    uint64_t timestamp_last_setpoint = 0;
+    uint64_t packets_up = 0;
+    uint64_t packets_down = 0;
+    uint64_t packets_dropped = 0;
+};
+
+static Link link_state;
+
+static uint32_t crc32_update(uint32_t crc, const void* data, size_t size){
+    const uint8_t* bytes = (const uint8_t*)data;
+    crc = ~crc;
+    for(size_t byte_i = 0; byte_i < size; byte_i++){
+        crc ^= bytes[byte_i];
+        for(int bit_i = 0; bit_i < 8; bit_i++){
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+// The TOC ids are the indices of the variables (group entries excluded) in section order, as in the firmware
+template <typename ENTRY>
+static void build_toc(const ENTRY* begin, const ENTRY* end, std::vector<const ENTRY*>& toc, uint32_t& crc){
+    crc = 0;
+    for(const ENTRY* entry = begin; entry < end; entry++){
+        if(entry->name == nullptr || (entry->type & 0x80)){
+            continue;
+        }
+        toc.push_back(entry);
+        crc = crc32_update(crc, &entry->type, 1);
+        crc = crc32_update(crc, entry->name, strlen(entry->name));
+    }
+}
+
+template <typename ENTRY>
+static const char* group_of(const ENTRY* variable){
+    for(const ENTRY* entry = variable; ; entry--){
+        if(entry->type & 0x80){
+            return entry->name;
+        }
+    }
+}
+
+static void send(uint8_t port, uint8_t channel, const uint8_t* data, size_t size){
+    Link& link = link_state;
+    Packet packet;
+    packet.header = crtp_header(port, channel);
+    packet.size = (uint8_t)(size > CRTP_MAX_DATA_SIZE ? CRTP_MAX_DATA_SIZE : size);
+    memcpy(packet.data, data, packet.size);
+    packet.deliver_at = Clock::now() + std::chrono::microseconds((int64_t)(link.config.link_latency_ms * 1000));
+    link.downlink.push_back(packet);
+}
+
+static void console(const char* text, int length){
+    for(int offset = 0; offset < length; offset += CRTP_MAX_DATA_SIZE){
+        int size = length - offset < CRTP_MAX_DATA_SIZE ? length - offset : CRTP_MAX_DATA_SIZE;
+        send(CRTP_PORT_CONSOLE, 0, (const uint8_t*)text + offset, size);
+    }
+}
+
+static size_t toc_item(uint8_t command, uint16_t id, uint8_t type, const char* group, const char* name, uint8_t* response){
+    size_t size = 0;
+    response[size++] = command;
+    response[size++] = id & 0xFF;
+    response[size++] = id >> 8;
+    response[size++] = type;
+    for(const char* part: {group, name}){
+        size_t length = strlen(part) + 1;
+        length = size + length > CRTP_MAX_DATA_SIZE ? CRTP_MAX_DATA_SIZE - size : length;
+        memcpy(response + size, part, length);
+        size += length;
+    }
+    return size;
+}
+
+static size_t toc_info(uint8_t command, uint16_t count, uint32_t crc, uint8_t* response){
+    response[0] = command;
+    response[1] = count & 0xFF;
+    response[2] = count >> 8;
+    memcpy(response + 3, &crc, 4);
+    return 7;
+}
+
+static int param_size(uint8_t type){
+    return 1 << (type & 0x03);
+}
+
+static void handle_param(uint8_t channel, const uint8_t* data, uint8_t size){
+    Link& link = link_state;
+    uint8_t response[CRTP_MAX_DATA_SIZE];
+    if(channel == TOC_CHANNEL && size >= 1){
+        if(data[0] == CMD_TOC_INFO_V2){
+            send(CRTP_PORT_PARAM, TOC_CHANNEL, response, toc_info(CMD_TOC_INFO_V2, (uint16_t)link.param_toc.size(), link.param_toc_crc, response));
+        }
+        else if(data[0] == CMD_TOC_ITEM_V2 && size >= 3){
+            uint16_t id = data[1] | data[2] << 8;
+            if(id < link.param_toc.size()){
+                const param_s* param = link.param_toc[id];
+                send(CRTP_PORT_PARAM, TOC_CHANNEL, response, toc_item(CMD_TOC_ITEM_V2, id, param->type, group_of(param), param->name, response));
+            }
+        }
+        return;
+    }
+    if(size < 2){
+        return;
+    }
+    uint16_t id = data[0] | data[1] << 8;
+    if(id >= link.param_toc.size()){
+        return;
+    }
+    const param_s* param = link.param_toc[id];
+    int value_size = param_size(param->type);
+    if(channel == PARAM_READ_CHANNEL){
+        response[0] = data[0];
+        response[1] = data[1];
+        response[2] = 0;
+        memcpy(response + 3, param->address, value_size);
+        send(CRTP_PORT_PARAM, PARAM_READ_CHANNEL, response, 3 + value_size);
+    }
+    else if(channel == PARAM_WRITE_CHANNEL && size >= 2 + value_size){
+        if(!(param->type & PARAM_RONLY)){
+            memcpy(param->address, data + 2, value_size);
+        }
+        response[0] = data[0];
+        response[1] = data[1];
+        memcpy(response + 2, param->address, value_size);
+        send(CRTP_PORT_PARAM, PARAM_WRITE_CHANNEL, response, 2 + value_size);
+    }
+}
+
+static size_t log_block_size(const LogBlock& block){
+    size_t size = 0;
+    for(const auto& variable: block.variables){
+        size += sim_log_size(variable.fetch_type);
+    }
+    return size;
+}
+
+static uint8_t log_append(LogBlock& block, const uint8_t* data, uint8_t size){
+    Link& link = link_state;
+    for(uint8_t offset = 0; offset + 3 <= size; offset += 3){
+        uint8_t fetch_type = data[offset] & 0x0F;
+        uint16_t id = data[offset + 1] | data[offset + 2] << 8;
+        if(id >= link.log_toc.size()){
+            return ENOENT_ERROR;
+        }
+        if(fetch_type == 0){
+            fetch_type = link.log_toc[id]->type;
+        }
+        block.variables.push_back({link.log_toc[id], fetch_type});
+        if(log_block_size(block) > LOG_MAX_BLOCK_SIZE){
+            block.variables.pop_back();
+            return E2BIG_ERROR;
+        }
+    }
+    return 0;
+}
+
+static void handle_log(uint8_t channel, const uint8_t* data, uint8_t size, uint64_t now){
+    Link& link = link_state;
+    uint8_t response[CRTP_MAX_DATA_SIZE];
+    if(size < 1){
+        return;
+    }
+    if(channel == TOC_CHANNEL){
+        if(data[0] == CMD_TOC_INFO_V2){
+            size_t response_size = toc_info(CMD_TOC_INFO_V2, (uint16_t)link.log_toc.size(), link.log_toc_crc, response);
+            response[response_size++] = LOG_MAX_BLOCK_SIZE;
+            response[response_size++] = LOG_MAX_BLOCKS;
+            send(CRTP_PORT_LOG, TOC_CHANNEL, response, response_size);
+        }
+        else if(data[0] == CMD_TOC_ITEM_V2 && size >= 3){
+            uint16_t id = data[1] | data[2] << 8;
+            if(id < link.log_toc.size()){
+                const log_s* variable = link.log_toc[id];
+                send(CRTP_PORT_LOG, TOC_CHANNEL, response, toc_item(CMD_TOC_ITEM_V2, id, variable->type, group_of(variable), variable->name, response));
+            }
+        }
+        return;
+    }
+    if(channel != LOG_CONTROL_CHANNEL){
+        return;
+    }
+    uint8_t command = data[0];
+    uint8_t block_id = size >= 2 ? data[1] : 0;
+    uint8_t error = 0;
+    LogBlock* block = block_id < LOG_MAX_BLOCKS ? &link.log_blocks[block_id] : nullptr;
+    switch(command){
+        case CMD_CREATE_BLOCK_V2:
+            if(block == nullptr){
+                error = ENOMEM_ERROR;
+            }
+            else if(block->allocated){
+                error = EEXIST_ERROR;
+            }
+            else{
+                *block = LogBlock{};
+                block->allocated = true;
+                error = log_append(*block, data + 2, size - 2);
+                if(error){
+                    block->allocated = false;
+                }
+            }
+            break;
+        case CMD_APPEND_BLOCK_V2:
+            error = block != nullptr && block->allocated ? log_append(*block, data + 2, size - 2) : ENOENT_ERROR;
+            break;
+        case CMD_DELETE_BLOCK:
+            if(block != nullptr && block->allocated){
+                *block = LogBlock{};
+            }
+            else{
+                error = ENOENT_ERROR;
+            }
+            break;
+        case CMD_START_LOGGING:
+            if(block != nullptr && block->allocated && size >= 3){
+                block->running = true;
+                block->period_ms = data[2] * 10;
+                block->period_ms = block->period_ms == 0 ? 1 : block->period_ms;
+                block->next_sample_us = now;
+            }
+            else{
+                error = ENOENT_ERROR;
+            }
+            break;
+        case CMD_STOP_LOGGING:
+            if(block != nullptr && block->allocated){
+                block->running = false;
+            }
+            else{
+                error = ENOENT_ERROR;
+            }
+            break;
+        case CMD_RESET_LOGGING:
+            for(auto& b: link.log_blocks){
+                b = LogBlock{};
+            }
+            break;
+        default:
+            return;
+    }
+    response[0] = command;
+    response[1] = block_id;
+    response[2] = error;
+    send(CRTP_PORT_LOG, LOG_CONTROL_CHANNEL, response, 3);
+}
+
+static uint16_t float_to_fp16(float value){
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = ((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if(exponent <= 0){
+        return sign;
+    }
+    if(exponent >= 31){
+        return sign | 0x7C00;
+    }
+    return sign | (exponent << 10) | (mantissa >> 13);
+}
+
+static size_t pack_log_value(const LogBlockVariable& variable, uint8_t* out){
+    float value = sim_log_value(variable.variable);
+    switch(variable.fetch_type){
+        case LOG_UINT8:  { uint8_t v = (uint8_t)value; memcpy(out, &v, 1); return 1; }
+        case LOG_INT8:   { int8_t v = (int8_t)value; memcpy(out, &v, 1); return 1; }
+        case LOG_UINT16: { uint16_t v = (uint16_t)value; memcpy(out, &v, 2); return 2; }
+        case LOG_INT16:  { int16_t v = (int16_t)value; memcpy(out, &v, 2); return 2; }
+        case LOG_UINT32: { uint32_t v = (uint32_t)value; memcpy(out, &v, 4); return 4; }
+        case LOG_INT32:  { int32_t v = (int32_t)value; memcpy(out, &v, 4); return 4; }
+        case LOG_FP16:   { uint16_t v = float_to_fp16(value); memcpy(out, &v, 2); return 2; }
+        default:         { memcpy(out, &value, 4); return 4; }
+    }
+}
+
+static void sample_log_blocks(uint64_t now){
+    Link& link = link_state;
+    for(uint8_t block_id = 0; block_id < LOG_MAX_BLOCKS; block_id++){
+        LogBlock& block = link.log_blocks[block_id];
+        if(!block.running || now < block.next_sample_us){
+            continue;
+        }
+        block.next_sample_us += block.period_ms * 1000;
+        if(link.downlink.size() >= DOWNLINK_QUEUE_SIZE){
+            link.packets_dropped++;
+            continue;
+        }
+        uint8_t packet[CRTP_MAX_DATA_SIZE];
+        uint32_t timestamp_ms = (uint32_t)(now / 1000);
+        packet[0] = block_id;
+        packet[1] = timestamp_ms & 0xFF;
+        packet[2] = (timestamp_ms >> 8) & 0xFF;
+        packet[3] = (timestamp_ms >> 16) & 0xFF;
+        size_t size = 4;
+        for(const auto& variable: block.variables){
+            size += pack_log_value(variable, packet + size);
+        }
+        send(CRTP_PORT_LOG, LOG_DATA_CHANNEL, packet, size);
+    }
+}
+
+static float unpack_float(const uint8_t* data){
+    float value;
+    memcpy(&value, data, 4);
+    return value;
+}
+
+static void handle_commander(Simulation& simulation, uint8_t channel, const uint8_t* data, uint8_t size, uint64_t now){
+    Link& link = link_state;
+    if(size < 1){
+        return;
+    }
+    if(channel == META_COMMAND_CHANNEL){
+        if(data[0] == META_RL_TOOLS_TRIGGER){
+            rl_tools_controller_packet_received();
+        }
+        return;
+    }
+    if(channel != SET_SETPOINT_CHANNEL){
+        return;
+    }
+    setpoint_t setpoint = {};
+    setpoint.timestamp = xTaskGetTickCount(); // as the firmware's commander
+    switch(data[0]){
+        case TYPE_STOP:
+            break;
+        case TYPE_HOVER:
+            if(size < 17){
+                return;
+            }
+            setpoint.mode.x = modeVelocity;
+            setpoint.mode.y = modeVelocity;
+            setpoint.mode.z = modeAbs;
+            setpoint.mode.yaw = modeVelocity;
+            setpoint.velocity.x = unpack_float(data + 1);
+            setpoint.velocity.y = unpack_float(data + 5);
+            setpoint.attitudeRate.yaw = -unpack_float(data + 9);
+            setpoint.position.z = unpack_float(data + 13);
+            setpoint.velocity_body = true;
+            break;
+        case TYPE_POSITION:
+            if(size < 17){
+                return;
+            }
+            setpoint.mode.x = modeAbs;
+            setpoint.mode.y = modeAbs;
+            setpoint.mode.z = modeAbs;
+            setpoint.mode.yaw = modeAbs;
+            setpoint.position.x = unpack_float(data + 1);
+            setpoint.position.y = unpack_float(data + 5);
+            setpoint.position.z = unpack_float(data + 9);
+            setpoint.attitude.yaw = unpack_float(data + 13);
+            break;
+        default:
+            return;
+    }
+    simulation.commanded_setpoint = setpoint;
+    link.timestamp_last_setpoint = now;
+}
+
+static void handle_platform(uint8_t channel, const uint8_t* data, uint8_t size){
+    if(channel == PLATFORM_APP_CHANNEL){
+        rl_tools_controller_swarm_packet_received(data, size); // as swarm_app.c
+        return;
+    }
+    if(channel != 1 || size < 1){
+        return; // arming requests etc. need no reply
+    }
+    uint8_t response[CRTP_MAX_DATA_SIZE] = {data[0]};
+    switch(data[0]){
+        case 0: // protocol version
+            response[1] = PROTOCOL_VERSION;
+            send(CRTP_PORT_PLATFORM, 1, response, 2);
+            break;
+        case 1: // firmware version
+            send(CRTP_PORT_PLATFORM, 1, response, 6);
+            break;
+        case 2: { // device type name
+            const char* name = "Crazyflie host simulation";
+            memcpy(response + 1, name, strlen(name));
+            send(CRTP_PORT_PLATFORM, 1, response, 1 + strlen(name));
+            break;
+        }
+    }
+}
+
+static void handle_mem(uint8_t channel, const uint8_t* data, uint8_t size){
+    uint8_t response[CRTP_MAX_DATA_SIZE];
+    if(channel == MEM_INFO_CHANNEL && size >= 1){
+        response[0] = data[0];
+        if(data[0] == CMD_MEM_GET_NUMBER){
+            response[1] = (uint8_t)sim_memory_count();
+            send(CRTP_PORT_MEM, MEM_INFO_CHANNEL, response, 2);
+        }
+        else if(data[0] == CMD_MEM_GET_INFO && size >= 2){
+            const MemoryHandlerDef_t* memory = sim_memory_get(data[1]);
+            response[1] = data[1];
+            if(memory == nullptr){
+                send(CRTP_PORT_MEM, MEM_INFO_CHANNEL, response, 2);
+                return;
+            }
+            uint32_t memory_size = memory->getSize();
+            uint64_t address = 0;
+            response[2] = memory->type;
+            memcpy(response + 3, &memory_size, 4);
+            memcpy(response + 7, &address, 8);
+            send(CRTP_PORT_MEM, MEM_INFO_CHANNEL, response, 15);
+        }
+    }
+    else if((channel == MEM_READ_CHANNEL || channel == MEM_WRITE_CHANNEL) && size >= 5){
+        // [id, address (uint32), length] -> [id, address, status, data...]
+        const MemoryHandlerDef_t* memory = sim_memory_get(data[0]);
+        memcpy(response, data, 5);
+        uint32_t address;
+        memcpy(&address, data + 1, 4);
+        if(channel == MEM_READ_CHANNEL && size >= 6){
+            uint8_t length = data[5] < CRTP_MAX_DATA_SIZE - 6 ? data[5] : CRTP_MAX_DATA_SIZE - 6;
+            bool ok = memory != nullptr && memory->read != nullptr && memory->read(address, length, response + 6);
+            response[5] = ok ? 0 : EIO_ERROR;
+            send(CRTP_PORT_MEM, MEM_READ_CHANNEL, response, ok ? 6 + length : 6);
+        }
+        else if(channel == MEM_WRITE_CHANNEL){
+            bool ok = memory != nullptr && memory->write != nullptr && memory->write(address, size - 5, data + 5);
+            response[5] = ok ? 0 : EIO_ERROR;
+            send(CRTP_PORT_MEM, MEM_WRITE_CHANNEL, response, 6);
+        }
+    }
+}
+
+static void handle_linkctrl(uint8_t channel, const uint8_t* data, uint8_t size){
+    if(channel == LINKCTRL_ECHO_CHANNEL){
+        send(CRTP_PORT_LINKCTRL, LINKCTRL_ECHO_CHANNEL, data, size);
+    }
+    else if(channel == 1){
+        const char* source = "Bitcraze Crazyflie";
+        send(CRTP_PORT_LINKCTRL, 1, (const uint8_t*)source, strlen(source));
+    }
+}
+
+static void handle(Simulation& simulation, const Packet& packet, uint64_t now){
+    uint8_t port = crtp_port(packet.header);
+    uint8_t channel = crtp_channel(packet.header);
+    if(packet.header == CRTP_NULL_HEADER){
+        return; // null/keep-alive packet
+    }
+    switch(port){
+        case CRTP_PORT_PARAM: handle_param(channel, packet.data, packet.size); break;
+        case CRTP_PORT_LOG: handle_log(channel, packet.data, packet.size, now); break;
+        case CRTP_PORT_COMMANDER_GENERIC: handle_commander(simulation, channel, packet.data, packet.size, now); break;
+        case CRTP_PORT_PLATFORM: handle_platform(channel, packet.data, packet.size); break;
+        case CRTP_PORT_MEM: handle_mem(channel, packet.data, packet.size); break;
+        case CRTP_PORT_LINKCTRL: handle_linkctrl(channel, packet.data, packet.size); break;
+    }
+}
+
+static void receive(){
+    Link& link = link_state;
+    uint8_t buffer[64];
+    sockaddr_in from;
+    socklen_t from_length = sizeof(from);
+    while(true){
+        ssize_t size = recvfrom(link.socket_fd, buffer, sizeof(buffer), MSG_DONTWAIT, (sockaddr*)&from, &from_length);
+        if(size <= 0){
+            return;
+        }
+        link.client = from;
+        link.has_client = true;
+        // Uplink bandwidth: packets queue behind each other at the emulated link rate
+        auto now = Clock::now();
+        auto slot = link.uplink_free_at > now ? link.uplink_free_at : now;
+        link.uplink_free_at = slot + std::chrono::microseconds((int64_t)(1e6 / link.config.link_rate));
+        Packet packet;
+        packet.header = buffer[0];
+        packet.size = (uint8_t)(size - 1 > CRTP_MAX_DATA_SIZE ? CRTP_MAX_DATA_SIZE : size - 1);
+        memcpy(packet.data, buffer + 1, packet.size);
+        float jitter_ms = std::uniform_real_distribution<float>(0, link.config.link_jitter_ms)(link.random);
+        packet.deliver_at = slot + std::chrono::microseconds((int64_t)((link.config.link_latency_ms + jitter_ms) * 1000));
+        if(packet.deliver_at < link.uplink_last_deliver_at){
+            packet.deliver_at = link.uplink_last_deliver_at;
+        }
+        link.uplink_last_deliver_at = packet.deliver_at;
+        link.uplink.push_back(packet);
+        link.packets_up++;
+    }
+}
+
+static void transmit(){
+    Link& link = link_state;
+    auto now = Clock::now();
+    while(!link.downlink.empty() && link.downlink.front().deliver_at <= now && link.downlink_free_at <= now){
+        const Packet& packet = link.downlink.front();
+        if(link.has_client){
+            uint8_t buffer[1 + CRTP_MAX_DATA_SIZE];
+            buffer[0] = packet.header;
+            memcpy(buffer + 1, packet.data, packet.size);
+            sendto(link.socket_fd, buffer, 1 + packet.size, 0, (const sockaddr*)&link.client, sizeof(link.client));
+            link.packets_down++;
+        }
+        else{
+            link.packets_dropped++;
+        }
+        link.downlink.pop_front();
+        link.downlink_free_at = now + std::chrono::microseconds((int64_t)(1e6 / link.config.link_rate));
+    }
+}
+
+static bool parse(int argc, char** argv, Config& config){
+    for(int arg_i = 1; arg_i < argc; arg_i++){
+        std::string arg = argv[arg_i];
+        bool has_value = arg_i + 1 < argc;
+        if(arg == "--verbose"){
+            config.verbose = true;
+        }
+        else if(has_value && arg == "--port"){
+            config.port = (uint16_t)atoi(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--speed"){
+            config.speed = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--link-rate"){
+            config.link_rate = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--link-latency"){
+            config.link_latency_ms = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--link-jitter"){
+            config.link_jitter_ms = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--tick-offset"){
+            config.tick_offset_ms = (uint32_t)strtoul(argv[++arg_i], nullptr, 10);
+        }
+        else if(has_value && arg == "--param"){
+            config.params.push_back(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--battery"){
+            config.battery.capacity = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--bus"){
+            config.bus = argv[++arg_i];
+        }
+        else{
+            return false;
+        }
+    }
+    return config.speed > 0 && config.link_rate > 0 && config.link_jitter_ms >= 0;
+}
+
+int main(int argc, char** argv){
+    Link& link = link_state;
+    if(!parse(argc, argv, link.config)){
+        fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --port <port>             UDP port on 127.0.0.1 (default 19850, URI sim://127.0.0.1:19850)\n"
+            "  --speed <factor>          simulated time per wall-clock time (default 1)\n"
+            "  --link-rate <packets/s>   emulated link throughput per direction (default 1000)\n"
+            "  --link-latency <ms>       emulated one-way latency (default 2)\n"
+            "  --link-jitter <ms>        additional uniformly distributed uplink delay, in order (default 0)\n"
+            "  --tick-offset <ms>        offset of the firmware tick count from the microsecond clock (default 0)\n"
+            "  --param <group.name=v>    set a firmware parameter after init (repeatable)\n"
+            "  --battery <mAh>           battery capacity, 0 = ideal 4.2V supply (default 250)\n"
+            "  --bus <name>              publish every controller invocation on a shared-memory telemetry bus\n"
+            "  --verbose                 also print DEBUG_PRINT output to stderr\n", argv[0]);
+        return 1;
+    }
+    link.socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(link.config.port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(link.socket_fd < 0 || bind(link.socket_fd, (sockaddr*)&address, sizeof(address)) != 0){
+        perror("bind");
+        return 1;
+    }
+
+    sim_firmware_set_verbose(link.config.verbose);
+    sim_firmware_set_tick_offset(link.config.tick_offset_ms);
+    sim_firmware_set_console(console);
+    Simulation simulation;
+    simulation_init(simulation, link.config.battery);
+    for(const auto& param: link.config.params){
+        if(!sim_firmware_set_param_string(param.c_str())){
+            fprintf(stderr, "unknown parameter assignment: %s\n", param.c_str());
+            return 1;
+        }
+    }
+    TelemetryBus bus;
+    if(link.config.bus){
+        if(!telemetry_bus_create(bus, link.config.bus, TELEMETRY_BUS_DEFAULT_CAPACITY)){
+            return 1;
+        }
+        simulation.telemetry = &bus;
+    }
+    build_toc(sim_log_begin(), sim_log_end(), link.log_toc, link.log_toc_crc);
+    build_toc(sim_param_begin(), sim_param_end(), link.param_toc, link.param_toc_crc);
+    fprintf(stderr, "Serving sim://127.0.0.1:%u (%zu log variables, %zu params)\n", link.config.port, link.log_toc.size(), link.param_toc.size());
+
+    auto start = Clock::now();
+    auto last_report = start;
+    while(true){
+        auto tick_deadline = start + std::chrono::microseconds((int64_t)((simulation.tick + 1) * (1e6 / SIMULATION_STABILIZER_RATE) / link.config.speed));
+        do{
+            receive();
+            auto now = Clock::now();
+            while(!link.uplink.empty() && link.uplink.front().deliver_at <= now){
+                handle(simulation, link.uplink.front(), simulation_time(simulation));
+                link.uplink.pop_front();
+            }
+            transmit();
+            if(now < tick_deadline){
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        } while(Clock::now() < tick_deadline);
+
+        if(simulation_time(simulation) - link.timestamp_last_setpoint > COMMANDER_TIMEOUT_US){
+            simulation.commanded_setpoint = setpoint_t{};
+        }
+        simulation_step(simulation);
+        sample_log_blocks(simulation_time(simulation));
+
+        auto now = Clock::now();
+        if(now - last_report > std::chrono::seconds(10)){
+            fprintf(stderr, "t=%.1fs packets up/down/dropped: %llu/%llu/%llu, downlink queue: %zu\n", simulation_time(simulation) / 1e6,
+                (unsigned long long)link.packets_up, (unsigned long long)link.packets_down, (unsigned long long)link.packets_dropped, link.downlink.size());
+            last_report = now;
+        }
+    }
+}
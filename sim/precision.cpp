@@ -0,0 +1,328 @@
+// Per-layer mixed-precision search for the adapter (rl_tools_adapter_precision.h)
+// Calibrates the fixed-point activation ranges on a controller trace (sim --trace or an on-board recording) and a
+// closed-loop run, then evaluates the per-layer weight/activation formats from the cheapest (estimated Cortex-M4
+// cycles or flash) upwards: the action error against fp32 on the replayed trace and the tracking RMSE (rltfq.rmse) of
+// the closed-loop run. The first assignment within both budgets is written as a compiled configuration
+// (-DRL_TOOLS_PRECISION_CONFIG) for the firmware and bench builds.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "firmware/motors.h"
+#include "firmware/log.h"
+#include "rl_tools_controller.h"
+#include "rl_tools_adapter.h"
+#include "controller_trace.h"
+void controllerOutOfTreeInit(void);
+bool controllerOutOfTreeTest(void);
+void controllerOutOfTree(control_t *control, setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick);
+}
+#include "firmware.h"
+#include "simulation.h"
+
+constexpr unsigned TRIGGER_PACKET_INTERVAL_MS = 10;
+constexpr unsigned LAYERS = RL_TOOLS_KERNEL_MAX_LAYERS;
+constexpr float RANGE_MARGIN = 1.25f; // headroom of the fixed-point range over the calibrated maximum
+
+// Coarse Cortex-M4F cost model of the kernels in rl_tools_adapter_precision.h / rl_tools_adapter_kernels.h (-Os):
+// cycles per multiply-accumulate (weight and input loads included), per output and per input of a fixed-point layer.
+// Measure a written configuration with make -C bench PRECISION=<file>.
+struct Format{
+    unsigned char weights;
+    unsigned char activations;
+    float cycles_per_mac;
+    float cycles_per_output;
+    float cycles_per_input;
+    unsigned weight_bytes;
+    unsigned scale_bytes; // per output
+};
+constexpr Format FORMATS[] = {
+    {RL_TOOLS_PRECISION_FP32, RL_TOOLS_PRECISION_ACTIVATIONS_FP32, 3.0f, 4, 0, 4, 0},
+    {RL_TOOLS_PRECISION_FP16, RL_TOOLS_PRECISION_ACTIVATIONS_FP32, 4.0f, 4, 0, 2, 0}, // + VCVTB per weight
+    {RL_TOOLS_PRECISION_INT16, RL_TOOLS_PRECISION_ACTIVATIONS_FP32, 5.0f, 6, 0, 2, 4}, // + sign extension, VMOV, VCVT
+    {RL_TOOLS_PRECISION_INT16, RL_TOOLS_PRECISION_ACTIVATIONS_FIXED, 3.0f, 10, 8, 2, 4}, // SMLAL (64-bit accumulator)
+    {RL_TOOLS_PRECISION_INT8, RL_TOOLS_PRECISION_ACTIVATIONS_FP32, 5.0f, 6, 0, 1, 4},
+    {RL_TOOLS_PRECISION_INT8, RL_TOOLS_PRECISION_ACTIVATIONS_FIXED, 3.0f, 8, 8, 1, 4}, // MLA (32-bit accumulator)
+};
+constexpr unsigned FORMAT_COUNT = sizeof(FORMATS) / sizeof(FORMATS[0]);
+
+struct Config{
+    const char* trace = nullptr;
+    std::vector<std::string> params;
+    float duration = 10;
+    float trigger_start = 1;
+    float action_budget = 0.05f;
+    float tracking_budget = 0.01f;
+    bool objective_flash = true;
+    const char* output = "precision.h";
+    bool all = false;
+    bool verbose = false;
+};
+
+struct Candidate{
+    unsigned format[LAYERS];
+    float cycles = 0;
+    unsigned flash = 0;
+    float action_error = NAN;
+    float rmse = NAN;
+};
+
+static void usage(const char* name){
+    fprintf(stderr,
+        "usage: %s [options] <trace>\n"
+        "  --param <group.name=v>    set a firmware parameter after init, for the replay and the closed-loop run (repeatable)\n"
+        "  --duration <s>            closed-loop run (default 10)\n"
+        "  --trigger-start <s>       time at which trigger packets start in the closed-loop run (default 1)\n"
+        "  --action-budget <a>       max. |action - fp32 action| over the trace (default 0.05)\n"
+        "  --tracking-budget <m>     max. increase of the closed-loop tracking RMSE over fp32 (default 0.01)\n"
+        "  --objective <o>           flash or cycles (estimated, default flash)\n"
+        "  --output <file>           compiled configuration (default precision.h)\n"
+        "  --all                     print every evaluated assignment\n"
+        "  --verbose                 print DEBUG_PRINT output to stderr\n", name);
+}
+
+static bool parse(int argc, char** argv, Config& config){
+    for(int arg_i = 1; arg_i < argc; arg_i++){
+        std::string arg = argv[arg_i];
+        bool has_value = arg_i + 1 < argc;
+        if(arg == "--verbose"){
+            config.verbose = true;
+        }
+        else if(arg == "--all"){
+            config.all = true;
+        }
+        else if(has_value && arg == "--param"){
+            config.params.push_back(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--duration"){
+            config.duration = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--trigger-start"){
+            config.trigger_start = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--action-budget"){
+            config.action_budget = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--tracking-budget"){
+            config.tracking_budget = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--objective"){
+            std::string objective = argv[++arg_i];
+            if(objective != "flash" && objective != "cycles"){
+                return false;
+            }
+            config.objective_flash = objective == "flash";
+        }
+        else if(has_value && arg == "--output"){
+            config.output = argv[++arg_i];
+        }
+        else if(arg[0] != '-' && config.trace == nullptr){
+            config.trace = argv[arg_i];
+        }
+        else{
+            return false;
+        }
+    }
+    return config.trace != nullptr && config.duration > 0;
+}
+
+static bool read_trace(const char* path, std::vector<controller_trace_record_t>& records){
+    FILE* file = fopen(path, "rb");
+    if(file == nullptr){
+        perror(path);
+        return false;
+    }
+    controller_trace_record_t record;
+    while(fread(&record, sizeof(record), 1, file) == 1){
+        records.push_back(record);
+    }
+    bool complete = feof(file) && ftell(file) % sizeof(record) == 0;
+    fclose(file);
+    if(!complete){
+        fprintf(stderr, "%s: not a sequence of %zu-byte controller_trace_record_t\n", path, sizeof(record));
+    }
+    return complete;
+}
+
+static void apply_params(const Config& config){
+    for(const auto& param: config.params){
+        if(!sim_firmware_set_param_string(param.c_str())){
+            fprintf(stderr, "unknown parameter assignment: %s\n", param.c_str());
+            exit(1);
+        }
+    }
+}
+
+// After controller init, which resets the precision (rl_tools_init). Without a candidate, fp32 with range calibration.
+static void apply_precision(const Candidate* candidate, const float* ranges){
+    for(unsigned layer_i = 0; layer_i < LAYERS; layer_i++){
+        const Format& format = FORMATS[candidate != nullptr ? candidate->format[layer_i] : 0];
+        rl_tools_precision_set(layer_i, format.weights, format.activations, ranges[layer_i] * RANGE_MARGIN);
+    }
+    rl_tools_precision_track_ranges(rl_tools_context_default(), candidate == nullptr); // the controller runs on the default context
+}
+
+// Actions of every replayed invocation (as replay: virtual clock and trigger packets from the records)
+static void replay(const Config& config, const std::vector<controller_trace_record_t>& records, const Candidate* candidate, const float* ranges, std::vector<float>& actions){
+    sim_firmware_set_time(0);
+    sim_firmware_set_battery_voltage(records.front().battery_voltage);
+    for(uint32_t motor_i = 0; motor_i < NBR_OF_MOTORS; motor_i++){
+        motorsSetRatio(motor_i, 0);
+    }
+    controllerOutOfTreeInit();
+    controllerOutOfTreeTest();
+    apply_params(config);
+    apply_precision(candidate, ranges);
+    const float* action = (const float*)sim_log_find("rlta.a1")->address;
+    actions.clear();
+    uint64_t last_packet = 0;
+    for(const auto& record: records){
+        uint64_t packet = controller_trace_packet_timestamp(&record);
+        if(packet != last_packet){
+            sim_firmware_set_time(packet);
+            rl_tools_controller_packet_received();
+            last_packet = packet;
+        }
+        setpoint_t setpoint;
+        sensorData_t sensors;
+        state_t state;
+        control_t control = {};
+        controller_trace_unpack(&record, &setpoint, &sensors, &state);
+        sim_firmware_set_time(controller_trace_timestamp(&record));
+        sim_firmware_set_battery_voltage(record.battery_voltage);
+        controllerOutOfTree(&control, &setpoint, &sensors, &state, record.tick);
+        actions.insert(actions.end(), action, action + 4);
+    }
+}
+
+// Tracking RMSE of the learned controller in closed loop (as sim: trigger packets every 10 ms from --trigger-start)
+static float closed_loop(const Config& config, const Candidate* candidate, const float* ranges){
+    Simulation simulation;
+    simulation_init(simulation, BatteryParameters{});
+    apply_params(config);
+    apply_precision(candidate, ranges);
+    uint32_t steps = (uint32_t)(config.duration * SIMULATION_STABILIZER_RATE);
+    while(simulation.tick < steps){
+        uint32_t next_tick = simulation.tick + 1;
+        if(next_tick >= config.trigger_start * SIMULATION_STABILIZER_RATE && next_tick % TRIGGER_PACKET_INTERVAL_MS == 0){
+            rl_tools_controller_packet_received();
+        }
+        simulation_step(simulation);
+    }
+    return sim_log_value(sim_log_find("rltfq.rmse"));
+}
+
+static std::string describe(const Candidate& candidate){
+    std::string description;
+    for(unsigned layer_i = 0; layer_i < LAYERS; layer_i++){
+        const Format& format = FORMATS[candidate.format[layer_i]];
+        description += (layer_i > 0 ? " " : "") + std::string(rl_tools_precision_name(format.weights, format.activations));
+    }
+    return description;
+}
+
+int main(int argc, char** argv){
+    Config config;
+    if(!parse(argc, argv, config)){
+        usage(argv[0]);
+        return 1;
+    }
+    std::vector<controller_trace_record_t> records;
+    if(!read_trace(config.trace, records) || records.empty()){
+        return 1;
+    }
+    sim_firmware_set_verbose(config.verbose);
+    if(rl_tools_kernel_layers() != LAYERS){
+        fprintf(stderr, "the adapter has no per-layer precision\n");
+        return 1;
+    }
+
+    // fp32 reference; the layer input ranges are calibrated on the trace and the closed-loop run
+    float ranges[LAYERS] = {};
+    float calibration[LAYERS];
+    std::vector<float> reference;
+    std::vector<float> actions;
+    replay(config, records, nullptr, ranges, reference);
+    rl_tools_precision_ranges(rl_tools_context_default(), ranges);
+    float reference_rmse = closed_loop(config, nullptr, ranges);
+    rl_tools_precision_ranges(rl_tools_context_default(), calibration);
+    for(unsigned layer_i = 0; layer_i < LAYERS; layer_i++){
+        ranges[layer_i] = std::max(ranges[layer_i], calibration[layer_i]);
+    }
+    printf("fp32: tracking RMSE %.4f m, layer input ranges", reference_rmse);
+    for(unsigned layer_i = 0; layer_i < LAYERS; layer_i++){
+        printf(" %.3g", ranges[layer_i]);
+    }
+    printf("\n");
+
+    std::vector<Candidate> candidates;
+    unsigned dims[LAYERS][2];
+    for(unsigned layer_i = 0; layer_i < LAYERS; layer_i++){
+        rl_tools_layer_dims(layer_i, &dims[layer_i][0], &dims[layer_i][1]);
+    }
+    for(unsigned index = 0; index < FORMAT_COUNT * FORMAT_COUNT * FORMAT_COUNT; index++){
+        Candidate candidate;
+        for(unsigned layer_i = 0, rest = index; layer_i < LAYERS; layer_i++, rest /= FORMAT_COUNT){
+            candidate.format[layer_i] = rest % FORMAT_COUNT;
+            const Format& format = FORMATS[candidate.format[layer_i]];
+            unsigned inputs = dims[layer_i][0];
+            unsigned outputs = dims[layer_i][1];
+            candidate.cycles += format.cycles_per_mac * inputs * outputs + format.cycles_per_output * outputs + format.cycles_per_input * inputs;
+            candidate.flash += format.weight_bytes * inputs * outputs + (4 + format.scale_bytes) * outputs;
+        }
+        candidates.push_back(candidate);
+    }
+    std::stable_sort(candidates.begin(), candidates.end(), [&config](const Candidate& a, const Candidate& b){
+        return config.objective_flash ? (a.flash != b.flash ? a.flash < b.flash : a.cycles < b.cycles) : (a.cycles != b.cycles ? a.cycles < b.cycles : a.flash < b.flash);
+    });
+    const Candidate& fp32 = *std::find_if(candidates.begin(), candidates.end(), [](const Candidate& candidate){
+        return candidate.format[0] == 0 && candidate.format[1] == 0 && candidate.format[2] == 0;
+    });
+    printf("fp32: estimated %.0f cycles, %u bytes\n", fp32.cycles, fp32.flash);
+
+    const Candidate* selected = nullptr;
+    unsigned evaluated = 0;
+    for(auto& candidate: candidates){
+        replay(config, records, &candidate, ranges, actions);
+        candidate.action_error = 0;
+        for(size_t action_i = 0; action_i < actions.size(); action_i++){
+            candidate.action_error = std::max(candidate.action_error, std::abs(actions[action_i] - reference[action_i]));
+        }
+        bool feasible = candidate.action_error <= config.action_budget;
+        if(feasible){
+            candidate.rmse = closed_loop(config, &candidate, ranges);
+            feasible = candidate.rmse <= reference_rmse + config.tracking_budget;
+        }
+        evaluated++;
+        if(config.all || feasible){
+            printf("%-32s %8.0f cycles %7u bytes  action error %.2e  tracking RMSE %s\n", describe(candidate).c_str(), candidate.cycles, candidate.flash,
+                candidate.action_error, std::isnan(candidate.rmse) ? "-" : std::to_string(candidate.rmse).c_str());
+        }
+        if(feasible){
+            selected = &candidate;
+            break;
+        }
+    }
+    if(selected == nullptr){
+        fprintf(stderr, "no assignment within the budgets (%u evaluated)\n", evaluated);
+        return 2;
+    }
+
+    rl_tools_init();
+    apply_precision(selected, ranges);
+    char comment[256];
+    snprintf(comment, sizeof(comment), "%s: action error %.3g (budget %.3g), tracking RMSE %.4f m (fp32 %.4f m, budget +%.3g m), estimated %.0f cycles, %u bytes",
+        describe(*selected).c_str(), selected->action_error, config.action_budget, selected->rmse, reference_rmse, config.tracking_budget, selected->cycles, selected->flash);
+    if(!rl_tools_precision_write_config(config.output, comment)){
+        perror(config.output);
+        return 1;
+    }
+    printf("selected after %u of %zu assignments: %s\n", evaluated, candidates.size(), comment);
+    printf("written to %s (-DRL_TOOLS_PRECISION_CONFIG='\"%s\"')\n", config.output, config.output);
+    return 0;
+}
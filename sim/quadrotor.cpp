@@ -0,0 +1,82 @@
+#include "quadrotor.h"
+
+#include <cmath>
+
+static inline void rotate(const float q[4], const float v[3], float out[3]){
+    float w = q[0], x = q[1], y = q[2], z = q[3];
+    out[0] = (1 - 2*y*y - 2*z*z) * v[0] + (2*x*y - 2*w*z) * v[1] + (2*x*z + 2*w*y) * v[2];
+    out[1] = (2*x*y + 2*w*z) * v[0] + (1 - 2*x*x - 2*z*z) * v[1] + (2*y*z - 2*w*x) * v[2];
+    out[2] = (2*x*z - 2*w*y) * v[0] + (2*y*z + 2*w*x) * v[1] + (1 - 2*x*x - 2*y*y) * v[2];
+}
+
+float quadrotor_hover_rpm(const QuadrotorParameters& parameters){
+    return std::sqrt(parameters.mass * parameters.gravity / 4 / parameters.thrust_constant);
+}
+
+float quadrotor_motor_rpm(const QuadrotorParameters& parameters, float command){
+    return (command + parameters.rpm_curvature * (command * command - command)) * parameters.max_rpm;
+}
+
+void quadrotor_step(const QuadrotorParameters& parameters, QuadrotorState& state, const float rpm_setpoint[4], const float disturbance_force[3], float dt){
+    float alpha = dt / parameters.motor_time_constant;
+    alpha = alpha > 1 ? 1 : alpha;
+    float thrust_total = 0;
+    float torque[3] = {0, 0, 0};
+    for(int rotor_i = 0; rotor_i < 4; rotor_i++){
+        float setpoint = rpm_setpoint[rotor_i];
+        setpoint = setpoint < 0 ? 0 : (setpoint > parameters.max_rpm ? parameters.max_rpm : setpoint);
+        state.rpm[rotor_i] += alpha * (setpoint - state.rpm[rotor_i]);
+        float thrust = parameters.thrust_constant * state.rpm[rotor_i] * state.rpm[rotor_i];
+        thrust_total += thrust;
+        torque[0] += parameters.rotor_positions[rotor_i][1] * thrust;
+        torque[1] -= parameters.rotor_positions[rotor_i][0] * thrust;
+        torque[2] += parameters.rotor_torque_directions[rotor_i] * parameters.torque_constant * thrust;
+    }
+
+    float thrust_body[3] = {0, 0, thrust_total};
+    float thrust_world[3];
+    rotate(state.orientation, thrust_body, thrust_world);
+    for(int axis_i = 0; axis_i < 3; axis_i++){
+        state.linear_acceleration[axis_i] = (thrust_world[axis_i] + disturbance_force[axis_i]) / parameters.mass;
+    }
+    state.linear_acceleration[2] -= parameters.gravity;
+
+    const float* J = parameters.inertia;
+    const float* w = state.angular_velocity;
+    float gyroscopic[3] = {
+        w[1] * J[2] * w[2] - w[2] * J[1] * w[1],
+        w[2] * J[0] * w[0] - w[0] * J[2] * w[2],
+        w[0] * J[1] * w[1] - w[1] * J[0] * w[0],
+    };
+    float angular_acceleration[3];
+    for(int axis_i = 0; axis_i < 3; axis_i++){
+        angular_acceleration[axis_i] = (torque[axis_i] - gyroscopic[axis_i]) / J[axis_i];
+    }
+
+    for(int axis_i = 0; axis_i < 3; axis_i++){
+        state.linear_velocity[axis_i] += state.linear_acceleration[axis_i] * dt;
+        state.position[axis_i] += state.linear_velocity[axis_i] * dt;
+        state.angular_velocity[axis_i] += angular_acceleration[axis_i] * dt;
+    }
+
+    float* q = state.orientation;
+    float qw = q[0], qx = q[1], qy = q[2], qz = q[3];
+    float wx = state.angular_velocity[0], wy = state.angular_velocity[1], wz = state.angular_velocity[2];
+    q[0] += 0.5f * dt * (-qx*wx - qy*wy - qz*wz);
+    q[1] += 0.5f * dt * ( qw*wx + qy*wz - qz*wy);
+    q[2] += 0.5f * dt * ( qw*wy - qx*wz + qz*wx);
+    q[3] += 0.5f * dt * ( qw*wz + qx*wy - qy*wx);
+    float norm = std::sqrt(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+    for(int i = 0; i < 4; i++){
+        q[i] /= norm;
+    }
+
+    // Ground contact: the vehicle rests on the floor until it produces enough thrust to lift off
+    if(state.position[2] < 0){
+        state.position[2] = 0;
+        for(int axis_i = 0; axis_i < 3; axis_i++){
+            state.linear_velocity[axis_i] = 0;
+            state.angular_velocity[axis_i] = 0;
+        }
+    }
+}
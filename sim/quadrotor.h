@@ -0,0 +1,44 @@
+// Crazyflie rigid-body model for the host simulation (parameters match the learning-to-fly training environment)
+#ifndef __SIM_QUADROTOR_H__
+#define __SIM_QUADROTOR_H__
+
+// Motor and thrust model identified from flight logs by build/sysid (sysid.cpp), selected with make SYSID=sysid.h
+#ifdef SYSID_CONFIG
+#include SYSID_CONFIG
+#else
+#define SYSID_THRUST_CONSTANT 3.16e-10f
+#define SYSID_TORQUE_CONSTANT 0.005964552f
+#define SYSID_MOTOR_TIME_CONSTANT 0.15f
+#define SYSID_INERTIA_X 3.85e-6f
+#define SYSID_INERTIA_Y 3.85e-6f
+#define SYSID_RPM_CURVATURE 0.0f
+#endif
+
+struct QuadrotorParameters{
+    float mass = 0.027f;
+    float inertia[3] = {SYSID_INERTIA_X, SYSID_INERTIA_Y, 5.9675e-6f};
+    float rotor_positions[4][2] = {{0.028f, -0.028f}, {-0.028f, -0.028f}, {-0.028f, 0.028f}, {0.028f, 0.028f}};
+    float rotor_torque_directions[4] = {-1, +1, -1, +1};
+    float thrust_constant = SYSID_THRUST_CONSTANT; // N / RPM^2
+    float torque_constant = SYSID_TORQUE_CONSTANT; // Nm / N
+    float motor_time_constant = SYSID_MOTOR_TIME_CONSTANT; // s
+    float max_rpm = 21702.1f;
+    float rpm_curvature = SYSID_RPM_CURVATURE; // rpm / max_rpm = c + rpm_curvature * (c^2 - c) for the command fraction c
+    float gravity = 9.81f;
+};
+
+struct QuadrotorState{
+    float position[3] = {0, 0, 0};
+    float orientation[4] = {1, 0, 0, 0}; // w, x, y, z
+    float linear_velocity[3] = {0, 0, 0};
+    float angular_velocity[3] = {0, 0, 0}; // body frame
+    float rpm[4] = {0, 0, 0, 0};
+    float linear_acceleration[3] = {0, 0, 0}; // world frame, without gravity
+};
+
+void quadrotor_step(const QuadrotorParameters& parameters, QuadrotorState& state, const float rpm_setpoint[4], const float disturbance_force[3], float dt);
+float quadrotor_hover_rpm(const QuadrotorParameters& parameters);
+// RPM a motor settles at for a command fraction (0..1, linear in RPM for an ideal motor)
+float quadrotor_motor_rpm(const QuadrotorParameters& parameters, float command);
+
+#endif
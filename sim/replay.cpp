@@ -0,0 +1,251 @@
+// Bit-exact replay of recorded controllerOutOfTree invocations
+// Feeds controller_trace.h records (sim --trace, or an on-board recording downloaded with scripts/tracedump.py)
+// back into rl_tools_controller.c + rl_tools_adapter.cpp on the virtual clock, including the trigger packets, and
+// checks that the actions, motor commands and motor ratios match the recorded ones bit for bit. A window recorded
+// mid-flight is replayed from the controller state snapshot taken in front of it (--snapshot).
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "firmware/motors.h"
+#include "firmware/log.h"
+#include "rl_tools_controller.h"
+#include "controller_trace.h"
+#include "rl_tools_adapter.h"
+#include "controller_timeline.h"
+void controllerOutOfTreeInit(void);
+bool controllerOutOfTreeTest(void);
+void controllerOutOfTree(control_t *control, setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick);
+}
+#include "firmware.h"
+#include "telemetry_bus.h"
+
+struct Config{
+    const char* trace = nullptr;
+    const char* snapshot = nullptr;
+    std::vector<std::string> params;
+    unsigned max_report = 10;
+    const char* bus = nullptr;
+    const char* timeline = nullptr;
+    bool verbose = false;
+};
+
+static void usage(const char* name){
+    fprintf(stderr,
+        "usage: %s [options] <trace>\n"
+        "  --param <group.name=v>    set a firmware parameter after init, as during the recording (repeatable)\n"
+        "  --snapshot <file>         controller state in front of the recording (scripts/tracedump.py)\n"
+        "  --max-report <n>          mismatching invocations printed (default 10)\n"
+        "  --bus <name>              publish every replayed invocation on a shared-memory telemetry bus\n"
+        "  --timeline <file>         record the host stage timing of every replayed invocation (see scripts/timeline_trace.py)\n"
+        "  --verbose                 print DEBUG_PRINT output to stderr\n", name);
+}
+
+static bool parse(int argc, char** argv, Config& config){
+    for(int arg_i = 1; arg_i < argc; arg_i++){
+        std::string arg = argv[arg_i];
+        bool has_value = arg_i + 1 < argc;
+        if(arg == "--verbose"){
+            config.verbose = true;
+        }
+        else if(has_value && arg == "--param"){
+            config.params.push_back(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--snapshot"){
+            config.snapshot = argv[++arg_i];
+        }
+        else if(has_value && arg == "--max-report"){
+            config.max_report = (unsigned)atoi(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--bus"){
+            config.bus = argv[++arg_i];
+        }
+        else if(has_value && arg == "--timeline"){
+            config.timeline = argv[++arg_i];
+        }
+        else if(arg[0] != '-' && config.trace == nullptr){
+            config.trace = argv[arg_i];
+        }
+        else{
+            return false;
+        }
+    }
+    return config.trace != nullptr;
+}
+
+static bool read_trace(const char* path, std::vector<controller_trace_record_t>& records){
+    FILE* file = fopen(path, "rb");
+    if(file == nullptr){
+        perror(path);
+        return false;
+    }
+    controller_trace_record_t record;
+    while(fread(&record, sizeof(record), 1, file) == 1){
+        records.push_back(record);
+    }
+    bool complete = feof(file) && ftell(file) % sizeof(record) == 0;
+    fclose(file);
+    if(!complete){
+        fprintf(stderr, "%s: not a sequence of %zu-byte controller_trace_record_t\n", path, sizeof(record));
+    }
+    return complete;
+}
+
+static FILE* timeline_file = nullptr;
+static void write_timeline(const controller_timeline_record_t* record){
+    fwrite(record, sizeof(*record), 1, timeline_file);
+}
+
+static const void* log_address(const char* name){
+    const log_s* variable = sim_log_find(name);
+    if(variable == nullptr){
+        fprintf(stderr, "unknown log variable: %s\n", name);
+        exit(1);
+    }
+    return variable->address;
+}
+
+static bool read_snapshot(const char* path, controller_trace_snapshot_t& snapshot){
+    FILE* file = fopen(path, "rb");
+    if(file == nullptr){
+        perror(path);
+        return false;
+    }
+    bool complete = fread(&snapshot, sizeof(snapshot), 1, file) == 1 && fgetc(file) == EOF;
+    fclose(file);
+    if(!complete){
+        fprintf(stderr, "%s: not a %zu-byte controller_trace_snapshot_t\n", path, sizeof(snapshot));
+    }
+    return complete;
+}
+
+int main(int argc, char** argv){
+    Config config;
+    if(!parse(argc, argv, config)){
+        usage(argv[0]);
+        return 1;
+    }
+    std::vector<controller_trace_record_t> records;
+    if(!read_trace(config.trace, records) || records.empty()){
+        return 1;
+    }
+    sim_firmware_set_verbose(config.verbose);
+
+    // Same start as simulation_init: clock at zero, motors off, controller init + self test
+    sim_firmware_set_time(0);
+    sim_firmware_set_battery_voltage(records.front().battery_voltage);
+    for(uint32_t motor_i = 0; motor_i < NBR_OF_MOTORS; motor_i++){
+        motorsSetRatio(motor_i, 0);
+    }
+    controllerOutOfTreeInit();
+    controllerOutOfTreeTest();
+    for(const auto& param: config.params){
+        if(!sim_firmware_set_param_string(param.c_str())){
+            fprintf(stderr, "unknown parameter assignment: %s\n", param.c_str());
+            return 1;
+        }
+    }
+    if(config.snapshot != nullptr){
+        controller_trace_snapshot_t snapshot;
+        if(!read_snapshot(config.snapshot, snapshot)){
+            return 1;
+        }
+        if(snapshot.tick != records.front().tick){
+            fprintf(stderr, "the snapshot was taken before tick %u, the recording starts at tick %u\n", snapshot.tick, records.front().tick);
+            return 1;
+        }
+        if(!rl_tools_controller_restore_snapshot(&snapshot)){
+            fprintf(stderr, "the snapshot holds %u words of adapter state, not those of checkpoint %s\n", snapshot.adapter_state_size, rl_tools_get_checkpoint_name());
+            return 1;
+        }
+        for(uint32_t motor_i = 0; motor_i < NBR_OF_MOTORS; motor_i++){
+            motorsSetRatio(motor_i, snapshot.motor_ratio[motor_i]);
+        }
+    }
+    else if(records.front().tick > 1){
+        fprintf(stderr, "warning: the recording starts at tick %u, not at controller init, and no --snapshot was given; the controller's internal state differs\n", records.front().tick);
+    }
+    TelemetryBus bus;
+    if(config.bus && !telemetry_bus_create(bus, config.bus, TELEMETRY_BUS_DEFAULT_CAPACITY)){
+        return 1;
+    }
+    if(config.timeline){
+        timeline_file = fopen(config.timeline, "wb");
+        if(timeline_file == nullptr){
+            perror(config.timeline);
+            return 1;
+        }
+        controller_timeline_header_t header;
+        controller_timeline_file_header(&header);
+        fwrite(&header, sizeof(header), 1, timeline_file);
+        controller_timeline_set_sink(write_timeline);
+    }
+    const float* action = (const float*)log_address("rlta.a1");
+    const uint16_t* motor_cmd = (const uint16_t*)log_address("rltm.m1");
+
+    uint64_t last_packet = 0;
+    size_t mismatches = 0;
+    std::vector<double> durations;
+    durations.reserve(records.size());
+    for(size_t record_i = 0; record_i < records.size(); record_i++){
+        const controller_trace_record_t& record = records[record_i];
+        uint64_t packet = controller_trace_packet_timestamp(&record);
+        if(packet != last_packet){
+            // Trigger packets arrive between invocations; replaying them at their own time reproduces the timeouts
+            sim_firmware_set_time(packet);
+            rl_tools_controller_packet_received();
+            last_packet = packet;
+        }
+        setpoint_t setpoint;
+        sensorData_t sensors;
+        state_t state;
+        control_t control = {};
+        controller_trace_unpack(&record, &setpoint, &sensors, &state);
+        sim_firmware_set_time(controller_trace_timestamp(&record));
+        sim_firmware_set_battery_voltage(record.battery_voltage);
+
+        auto start = std::chrono::steady_clock::now();
+        controllerOutOfTree(&control, &setpoint, &sensors, &state, record.tick);
+        durations.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        if(config.bus){
+            telemetry_bus_publish_controller(bus, record.tick, controller_trace_timestamp(&record), state, sensors, record.battery_voltage, (float)durations.back());
+        }
+
+        uint16_t motor_ratio[4];
+        for(uint32_t motor_i = 0; motor_i < 4; motor_i++){
+            motor_ratio[motor_i] = motorsGetRatio(motor_i);
+        }
+        bool match = memcmp(action, record.action, sizeof(record.action)) == 0 &&
+                     memcmp(motor_cmd, record.motor_cmd, sizeof(record.motor_cmd)) == 0 &&
+                     memcmp(motor_ratio, record.motor_ratio, sizeof(record.motor_ratio)) == 0;
+        if(!match){
+            if(mismatches < config.max_report){
+                printf("tick %u: action [%a %a %a %a] recorded [%a %a %a %a], motor_cmd [%u %u %u %u] recorded [%u %u %u %u], ratio [%u %u %u %u] recorded [%u %u %u %u]\n",
+                    record.tick, action[0], action[1], action[2], action[3],
+                    record.action[0], record.action[1], record.action[2], record.action[3],
+                    motor_cmd[0], motor_cmd[1], motor_cmd[2], motor_cmd[3],
+                    record.motor_cmd[0], record.motor_cmd[1], record.motor_cmd[2], record.motor_cmd[3],
+                    motor_ratio[0], motor_ratio[1], motor_ratio[2], motor_ratio[3],
+                    record.motor_ratio[0], record.motor_ratio[1], record.motor_ratio[2], record.motor_ratio[3]);
+            }
+            mismatches++;
+        }
+    }
+
+    if(config.bus){
+        telemetry_bus_close(bus);
+    }
+    if(timeline_file != nullptr){
+        fclose(timeline_file);
+    }
+    std::sort(durations.begin(), durations.end());
+    printf("%zu invocations replayed, %zu mismatching (%s)\n", records.size(), mismatches, mismatches == 0 ? "bit-exact" : "DIVERGED");
+    printf("host time per invocation: median %.2fus, p99 %.2fus, max %.2fus\n",
+        durations[durations.size() / 2], durations[(durations.size() * 99) / 100], durations.back());
+    return mismatches == 0 ? 0 : 2;
+}
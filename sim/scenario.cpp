@@ -0,0 +1,336 @@
+#include "scenario.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+static bool parse_float(const std::string& text, float& value){
+    char* end = nullptr;
+    value = strtof(text.c_str(), &end);
+    return end != text.c_str() && *end == '\0';
+}
+
+static bool parse_vector(const std::string& text, float* vector){
+    char end;
+    return sscanf(text.c_str(), "%f,%f,%f%c", &vector[0], &vector[1], &vector[2], &end) == 3;
+}
+
+static bool parse_signal(const std::string& text, ScenarioSignal& signal){
+    static const std::pair<const char*, ScenarioSignal> signals[] = {
+        {"position", ScenarioSignal::POSITION}, {"velocity", ScenarioSignal::VELOCITY}, {"attitude", ScenarioSignal::ATTITUDE},
+        {"gyro", ScenarioSignal::GYRO}, {"acc", ScenarioSignal::ACC}};
+    for(const auto& [name, value]: signals){
+        if(text == name){
+            signal = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_criterion(const std::string& text, ScenarioCriterion& criterion){
+    size_t op = text.find_first_of("<>");
+    if(op == std::string::npos){
+        return false;
+    }
+    std::string metric = text.substr(0, op);
+    criterion.metric = std::find(SCENARIO_METRICS, SCENARIO_METRICS + SCENARIO_METRIC_COUNT, metric) - SCENARIO_METRICS;
+    criterion.less = text[op] == '<';
+    return criterion.metric < SCENARIO_METRIC_COUNT && parse_float(text.substr(op + 1), criterion.limit);
+}
+
+// key=value options of an effect: the window (at, until, rise) and the keys of its type
+static bool parse_options(std::istringstream& tokens, ScenarioEffect& effect){
+    std::string token;
+    while(tokens >> token){
+        size_t equals = token.find('=');
+        if(equals == std::string::npos){
+            return false;
+        }
+        std::string key = token.substr(0, equals);
+        std::string value = token.substr(equals + 1);
+        bool ok;
+        if(key == "at"){
+            ok = parse_float(value, effect.window.at);
+        }
+        else if(key == "until"){
+            ok = parse_float(value, effect.window.until);
+        }
+        else if(key == "rise"){
+            ok = parse_float(value, effect.window.rise) && effect.window.rise >= 0;
+        }
+        else if(key == "force" && effect.type == ScenarioEffect::GUST){
+            ok = parse_vector(value, effect.vector);
+        }
+        else if(key == "bias" && effect.type == ScenarioEffect::NOISE){
+            ok = parse_vector(value, effect.vector);
+        }
+        else if(key == "std" && (effect.type == ScenarioEffect::TURBULENCE || effect.type == ScenarioEffect::NOISE)){
+            ok = parse_float(value, effect.value) && effect.value >= 0;
+        }
+        else if(key == "tau" && effect.type == ScenarioEffect::TURBULENCE){
+            ok = parse_float(value, effect.time_constant) && effect.time_constant > 0;
+        }
+        else if(key == "thrust" && effect.type == ScenarioEffect::MOTOR){
+            ok = parse_float(value, effect.value) && effect.value >= 0;
+        }
+        else if(key == "p" && effect.type == ScenarioEffect::LOSS){
+            ok = parse_float(value, effect.value) && effect.value >= 0 && effect.value < 1;
+        }
+        else if(key == "burst" && effect.type == ScenarioEffect::LOSS){
+            ok = parse_float(value, effect.burst) && effect.burst >= 1;
+        }
+        else{
+            ok = false;
+        }
+        if(!ok){
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool parse_line(const std::string& line, Scenario& scenario){
+    std::istringstream tokens(line);
+    std::string keyword, argument;
+    tokens >> keyword;
+    if(keyword == "name"){
+        std::getline(tokens >> std::ws, scenario.name);
+        scenario.name.erase(scenario.name.find_last_not_of(" \t\r") + 1);
+        return !scenario.name.empty();
+    }
+    if(keyword == "duration" || keyword == "trigger-start" || keyword == "settle" || keyword == "battery"){
+        float& value = keyword == "duration" ? scenario.duration : keyword == "trigger-start" ? scenario.trigger_start : keyword == "settle" ? scenario.settle_time : scenario.battery;
+        return tokens >> argument && parse_float(argument, value) && value >= 0 && !(tokens >> argument);
+    }
+    if(keyword == "delay"){
+        float delay;
+        bool ok = tokens >> argument && parse_float(argument, delay) && delay >= 0 && !(tokens >> argument);
+        scenario.estimator_delay_ms = ok ? (unsigned)lroundf(delay) : 0;
+        return ok;
+    }
+    if(keyword == "param"){
+        bool any = false;
+        while(tokens >> argument){
+            if(argument.find('=') == std::string::npos){
+                return false;
+            }
+            scenario.params.push_back(argument);
+            any = true;
+        }
+        return any;
+    }
+    if(keyword == "pass"){
+        bool any = false;
+        while(tokens >> argument){
+            ScenarioCriterion criterion;
+            if(!parse_criterion(argument, criterion)){
+                return false;
+            }
+            scenario.criteria.push_back(criterion);
+            any = true;
+        }
+        return any;
+    }
+    ScenarioEffect effect;
+    if(keyword == "gust"){
+        effect.type = ScenarioEffect::GUST;
+    }
+    else if(keyword == "turbulence"){
+        effect.type = ScenarioEffect::TURBULENCE;
+        effect.time_constant = 0.5f;
+    }
+    else if(keyword == "motor"){
+        effect.type = ScenarioEffect::MOTOR;
+        effect.value = 1;
+        int motor = tokens >> argument ? atoi(argument.c_str()) : 0;
+        if(motor < 1 || motor > 4){
+            return false;
+        }
+        effect.motor = (unsigned)(motor - 1);
+    }
+    else if(keyword == "noise"){
+        effect.type = ScenarioEffect::NOISE;
+        if(!(tokens >> argument) || !parse_signal(argument, effect.signal)){
+            return false;
+        }
+    }
+    else if(keyword == "loss"){
+        effect.type = ScenarioEffect::LOSS;
+    }
+    else if(keyword == "sag"){
+        effect.type = ScenarioEffect::SAG;
+        if(!(tokens >> argument) || !parse_float(argument, effect.value)){
+            return false;
+        }
+    }
+    else{
+        return false;
+    }
+    if(!parse_options(tokens, effect)){
+        return false;
+    }
+    scenario.effects.push_back(effect);
+    return true;
+}
+
+bool scenario_read(const char* path, Scenario& scenario){
+    std::ifstream file(path);
+    if(!file){
+        perror(path);
+        return false;
+    }
+    scenario = Scenario{};
+    scenario.name = path;
+    scenario.name = scenario.name.substr(scenario.name.find_last_of('/') + 1);
+    scenario.name = scenario.name.substr(0, scenario.name.find_last_of('.'));
+    std::string line;
+    for(unsigned line_i = 1; std::getline(file, line); line_i++){
+        line = line.substr(0, line.find('#'));
+        if(line.find_first_not_of(" \t\r") == std::string::npos){
+            continue;
+        }
+        if(!parse_line(line, scenario)){
+            fprintf(stderr, "%s:%u: invalid line: %s\n", path, line_i, line.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+static float weight(const ScenarioWindow& window, float time){
+    if(time < window.at || (window.until >= 0 && time >= window.until)){
+        return 0;
+    }
+    float w = 1;
+    if(window.rise > 0){
+        w = std::min(w, (time - window.at) / window.rise);
+        if(window.until >= 0){
+            w = std::min(w, (window.until - time) / window.rise);
+        }
+    }
+    return w;
+}
+
+void scenario_start(ScenarioRun& run, const Scenario& scenario, uint32_t seed){
+    run = ScenarioRun{};
+    run.scenario = &scenario;
+    run.random.seed(seed);
+    run.turbulence.assign(3 * scenario.effects.size(), 0);
+    run.burst.assign(scenario.effects.size(), 0);
+}
+
+void scenario_actuate(ScenarioRun& run, float time, float dt, float* force, float* motor_thrust, float& voltage){
+    std::normal_distribution<float> normal;
+    const auto& effects = run.scenario->effects;
+    for(size_t effect_i = 0; effect_i < effects.size(); effect_i++){
+        const ScenarioEffect& effect = effects[effect_i];
+        float w = weight(effect.window, time);
+        switch(effect.type){
+            case ScenarioEffect::GUST:
+                for(int axis_i = 0; axis_i < 3; axis_i++){
+                    force[axis_i] += w * effect.vector[axis_i];
+                }
+                break;
+            case ScenarioEffect::TURBULENCE:
+                // Ornstein-Uhlenbeck process with standard deviation std and correlation time tau, kept running
+                // outside of the window so that it fades in and out continuously
+                for(int axis_i = 0; axis_i < 3; axis_i++){
+                    float& state = run.turbulence[3 * effect_i + axis_i];
+                    state += -state * dt / effect.time_constant + effect.value * std::sqrt(2 * dt / effect.time_constant) * normal(run.random);
+                    force[axis_i] += w * state;
+                }
+                break;
+            case ScenarioEffect::MOTOR:
+                motor_thrust[effect.motor] *= 1 - w * (1 - effect.value);
+                break;
+            case ScenarioEffect::SAG:
+                voltage -= w * effect.value;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void scenario_observe(ScenarioRun& run, float time, state_t& state, sensorData_t& sensors){
+    const Scenario& scenario = *run.scenario;
+    if(scenario.estimator_delay_ms > 0){
+        if(run.history.empty()){
+            run.history.assign(scenario.estimator_delay_ms + 1, state);
+        }
+        run.history[run.history_head] = state;
+        run.history_head = (run.history_head + 1) % run.history.size();
+        state = run.history[run.history_head];
+    }
+    std::normal_distribution<float> normal;
+    for(const auto& effect: scenario.effects){
+        float w = effect.type == ScenarioEffect::NOISE ? weight(effect.window, time) : 0;
+        if(w == 0){
+            continue;
+        }
+        float offset[3];
+        for(int axis_i = 0; axis_i < 3; axis_i++){
+            offset[axis_i] = w * (effect.vector[axis_i] + effect.value * normal(run.random));
+        }
+        switch(effect.signal){
+            case ScenarioSignal::POSITION:
+                state.position.x += offset[0];
+                state.position.y += offset[1];
+                state.position.z += offset[2];
+                break;
+            case ScenarioSignal::VELOCITY:
+                state.velocity.x += offset[0];
+                state.velocity.y += offset[1];
+                state.velocity.z += offset[2];
+                break;
+            case ScenarioSignal::ATTITUDE:{
+                // q * (1, offset / 2), renormalized
+                auto& q = state.attitudeQuaternion;
+                float dx = offset[0] / 2, dy = offset[1] / 2, dz = offset[2] / 2;
+                float rw = q.w - q.x * dx - q.y * dy - q.z * dz;
+                float rx = q.x + q.w * dx + q.y * dz - q.z * dy;
+                float ry = q.y + q.w * dy - q.x * dz + q.z * dx;
+                float rz = q.z + q.w * dz + q.x * dy - q.y * dx;
+                float norm = std::sqrt(rw * rw + rx * rx + ry * ry + rz * rz);
+                q.w = rw / norm;
+                q.x = rx / norm;
+                q.y = ry / norm;
+                q.z = rz / norm;
+                break;
+            }
+            case ScenarioSignal::GYRO:
+                sensors.gyro.x += offset[0];
+                sensors.gyro.y += offset[1];
+                sensors.gyro.z += offset[2];
+                break;
+            case ScenarioSignal::ACC:
+                sensors.acc.x += offset[0];
+                sensors.acc.y += offset[1];
+                sensors.acc.z += offset[2];
+                break;
+        }
+    }
+}
+
+bool scenario_packet(ScenarioRun& run, float time){
+    std::uniform_real_distribution<float> uniform;
+    const auto& effects = run.scenario->effects;
+    bool lost = false;
+    for(size_t effect_i = 0; effect_i < effects.size(); effect_i++){
+        const ScenarioEffect& effect = effects[effect_i];
+        if(effect.type != ScenarioEffect::LOSS || weight(effect.window, time) == 0){
+            continue;
+        }
+        // Gilbert model: a burst continues with probability 1 - 1/burst and starts with the probability that makes
+        // the long-run loss rate p
+        float start = std::min(1.0f, effect.value / (effect.burst * (1 - effect.value)));
+        float u = uniform(run.random);
+        run.burst[effect_i] = run.burst[effect_i] ? u >= 1 / effect.burst : u < start;
+        lost = lost || run.burst[effect_i];
+    }
+    return !lost;
+}
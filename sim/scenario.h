@@ -0,0 +1,88 @@
+// Fault scenarios for the host simulation: wind gusts and turbulence, motor thrust loss, sensor noise and bias,
+// estimator delay, trigger packet loss and battery sag, declared line by line in a scenario file (format in
+// README.MD, examples in scenarios/) and applied to a running Simulation. The random effects are drawn from a
+// generator seeded per run, so a (scenario, seed) pair always reproduces the same flight.
+#ifndef __SIM_SCENARIO_H__
+#define __SIM_SCENARIO_H__
+
+#include <stdint.h>
+#include <random>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "firmware/stabilizer_types.h"
+}
+
+enum class ScenarioSignal{
+    POSITION, // state.position [m]
+    VELOCITY, // state.velocity [m/s]
+    ATTITUDE, // rotation of state.attitudeQuaternion about the body axes [rad]
+    GYRO, // sensors.gyro [deg/s]
+    ACC // sensors.acc [g]
+};
+
+// Simulated time span of an effect [s], ramped in and out over rise
+struct ScenarioWindow{
+    float at = 0;
+    float until = -1; // < 0: until the end of the run
+    float rise = 0;
+};
+
+struct ScenarioEffect{
+    enum Type{GUST, TURBULENCE, MOTOR, NOISE, LOSS, SAG} type;
+    ScenarioWindow window;
+    float vector[3] = {0, 0, 0}; // gust force [N], noise bias
+    float value = 0; // turbulence / noise standard deviation, remaining motor thrust fraction, loss probability, sag [V]
+    float time_constant = 0; // turbulence correlation time [s]
+    float burst = 1; // mean number of packets lost in a row
+    unsigned motor = 0; // 0..3 (M1..M4)
+    ScenarioSignal signal = ScenarioSignal::POSITION;
+};
+
+// Metrics of a run in the stress engine (stress.cpp) that pass criteria can refer to
+constexpr const char* SCENARIO_METRICS[] = {"rmse", "max_error", "final_error", "min_height", "action_rate", "saturation", "active"};
+constexpr unsigned SCENARIO_METRIC_COUNT = sizeof(SCENARIO_METRICS) / sizeof(SCENARIO_METRICS[0]);
+
+// Pass criterion "<metric><limit" or "<metric>>limit"
+struct ScenarioCriterion{
+    unsigned metric = 0; // index in SCENARIO_METRICS
+    bool less = true;
+    float limit = 0;
+};
+
+struct Scenario{
+    std::string name;
+    float duration = 15;
+    float trigger_start = 1;
+    float settle_time = 2; // after the activation of the learned controller, excluded from the metrics
+    float battery = 250; // capacity [mAh], 0 = ideal 4.2V supply
+    unsigned estimator_delay_ms = 0;
+    std::vector<std::string> params;
+    std::vector<ScenarioEffect> effects;
+    std::vector<ScenarioCriterion> criteria;
+};
+
+// Reads a scenario file; the name defaults to the file name without directory and extension
+bool scenario_read(const char* path, Scenario& scenario);
+
+// State of one run of a scenario
+struct ScenarioRun{
+    const Scenario* scenario = nullptr;
+    std::mt19937 random;
+    std::vector<float> turbulence; // 3 force components per TURBULENCE effect [N]
+    std::vector<uint8_t> burst; // per LOSS effect: currently dropping packets
+    std::vector<state_t> history; // estimator delay line
+    uint32_t history_head = 0;
+};
+
+void scenario_start(ScenarioRun& run, const Scenario& scenario, uint32_t seed);
+// Actuation faults of the tick at time [s]: adds gusts and turbulence to the disturbance force [N], scales the thrust
+// of each motor and lowers the supply voltage [V]
+void scenario_actuate(ScenarioRun& run, float time, float dt, float* force, float* motor_thrust, float& voltage);
+// Sensor faults: delays the state estimate and adds noise and bias to it and to the sensor data
+void scenario_observe(ScenarioRun& run, float time, state_t& state, sensorData_t& sensors);
+// False if the trigger packet sent at time [s] is lost
+bool scenario_packet(ScenarioRun& run, float time);
+
+#endif
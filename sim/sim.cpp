@@ -0,0 +1,422 @@
+// Host closed-loop simulation of the out-of-tree controller
+// Runs rl_tools_controller.c + rl_tools_adapter.cpp against the firmware stand-ins in firmware/ at the 1 kHz
+// stabilizer rate and writes a CSV with the same column names basiclog.py produces, so scripts/plot_*.py work on it.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern "C" {
+#include "firmware/motors.h"
+#include "firmware/log.h"
+#include "rl_tools_controller.h"
+#include "controller_timeline.h"
+}
+#include "firmware.h"
+#include "simulation.h"
+#include "scenario.h"
+
+constexpr unsigned TRIGGER_PACKET_INTERVAL_MS = 10;
+
+// What-if branch continuing from the --fork-at instant in a forked copy of the process
+struct Branch{
+    std::string output; // CSV, including the shared prefix
+    std::vector<std::string> params;
+    float disturbance_force[3] = {0, 0, 0};
+};
+
+struct Config{
+    float duration = 10;
+    float trigger_start = 1;
+    unsigned log_interval_ms = 10;
+    std::vector<std::string> params;
+    std::vector<std::string> log_variables;
+    BatteryParameters battery;
+    const char* output = nullptr;
+    const char* trace = nullptr;
+    const char* timeline = nullptr;
+    const char* bus = nullptr;
+    uint32_t bus_capacity = TELEMETRY_BUS_DEFAULT_CAPACITY;
+    float fork_at = 0;
+    std::vector<Branch> branches;
+    unsigned jobs = 0;
+    const char* scenario = nullptr;
+    uint32_t seed = 0;
+    bool verbose = false;
+};
+
+static void usage(const char* name){
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --duration <s>            simulated time (default 10)\n"
+        "  --trigger-start <s>       time at which trigger packets start (default 1)\n"
+        "  --param <group.name=v>    set a firmware parameter after init (repeatable)\n"
+        "  --log <group.name>        add a LOG variable as CSV column (repeatable)\n"
+        "  --log-interval <ms>       CSV row interval (default 10)\n"
+        "  --battery <mAh>           battery capacity, 0 = ideal 4.2V supply (default 250)\n"
+        "  --motor-model <model>     mean_voltage (default) or back_emf (see battery.h)\n"
+        "  --output <file>           CSV output (default stdout)\n"
+        "  --trace <file>            record every controllerOutOfTree invocation (controller_trace.h records, see replay)\n"
+        "  --timeline <file>         record the stage timing of every invocation (controller_timeline.h, see scripts/timeline_trace.py)\n"
+        "  --bus <name>              publish every invocation on a shared-memory telemetry bus (e.g. " TELEMETRY_BUS_DEFAULT_NAME ")\n"
+        "  --bus-capacity <frames>   telemetry ring size, power of two (default %d)\n"
+        "  --fork-at <s>             simulated time at which the branches split off (default 0)\n"
+        "  --branch <spec>           what-if branch: \"<csv> [group.name=v ...] [force=fx,fy,fz]\" (repeatable)\n"
+        "  --branches <file>         one branch spec per line (# comments)\n"
+        "  --jobs <n>                branches running at the same time (default: online CPUs)\n"
+        "  --scenario <file>         apply the faults and parameters of a scenario (scenario.h; duration, trigger start\n"
+        "                            and battery still come from the options)\n"
+        "  --seed <n>                random seed of the scenario (default 0)\n"
+        "  --verbose                 print DEBUG_PRINT output to stderr\n", name, TELEMETRY_BUS_DEFAULT_CAPACITY);
+}
+
+static bool parse_branch(const std::string& spec, Branch& branch){
+    std::istringstream tokens(spec);
+    std::string token;
+    if(!(tokens >> branch.output)){
+        return false;
+    }
+    while(tokens >> token){
+        if(token.rfind("force=", 0) == 0){
+            if(sscanf(token.c_str() + 6, "%f,%f,%f", &branch.disturbance_force[0], &branch.disturbance_force[1], &branch.disturbance_force[2]) != 3){
+                return false;
+            }
+        }
+        else if(token.find('=') != std::string::npos){
+            branch.params.push_back(token);
+        }
+        else{
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool parse_branches(const char* path, std::vector<Branch>& branches){
+    std::ifstream file(path);
+    if(!file){
+        perror(path);
+        return false;
+    }
+    std::string line;
+    while(std::getline(file, line)){
+        line = line.substr(0, line.find('#'));
+        if(line.find_first_not_of(" \t\r") == std::string::npos){
+            continue;
+        }
+        Branch branch;
+        if(!parse_branch(line, branch)){
+            fprintf(stderr, "%s: invalid branch: %s\n", path, line.c_str());
+            return false;
+        }
+        branches.push_back(branch);
+    }
+    return true;
+}
+
+static bool parse(int argc, char** argv, Config& config){
+    for(int arg_i = 1; arg_i < argc; arg_i++){
+        std::string arg = argv[arg_i];
+        bool has_value = arg_i + 1 < argc;
+        if(arg == "--verbose"){
+            config.verbose = true;
+        }
+        else if(has_value && arg == "--duration"){
+            config.duration = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--trigger-start"){
+            config.trigger_start = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--param"){
+            config.params.push_back(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--log"){
+            config.log_variables.push_back(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--log-interval"){
+            config.log_interval_ms = (unsigned)atoi(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--battery"){
+            config.battery.capacity = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--motor-model"){
+            std::string model = argv[++arg_i];
+            if(model != "mean_voltage" && model != "back_emf"){
+                return false;
+            }
+            config.battery.motor_model = model == "back_emf" ? BATTERY_MOTOR_BACK_EMF : BATTERY_MOTOR_MEAN_VOLTAGE;
+        }
+        else if(has_value && arg == "--output"){
+            config.output = argv[++arg_i];
+        }
+        else if(has_value && arg == "--trace"){
+            config.trace = argv[++arg_i];
+        }
+        else if(has_value && arg == "--timeline"){
+            config.timeline = argv[++arg_i];
+        }
+        else if(has_value && arg == "--bus"){
+            config.bus = argv[++arg_i];
+        }
+        else if(has_value && arg == "--bus-capacity"){
+            config.bus_capacity = (uint32_t)atoi(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--fork-at"){
+            config.fork_at = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--branch"){
+            Branch branch;
+            if(!parse_branch(argv[++arg_i], branch)){
+                return false;
+            }
+            config.branches.push_back(branch);
+        }
+        else if(has_value && arg == "--branches"){
+            if(!parse_branches(argv[++arg_i], config.branches)){
+                return false;
+            }
+        }
+        else if(has_value && arg == "--jobs"){
+            config.jobs = (unsigned)atoi(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--scenario"){
+            config.scenario = argv[++arg_i];
+        }
+        else if(has_value && arg == "--seed"){
+            config.seed = (uint32_t)strtoul(argv[++arg_i], nullptr, 10);
+        }
+        else{
+            return false;
+        }
+    }
+    return config.log_interval_ms > 0 && (config.branches.empty() || (config.fork_at >= 0 && config.fork_at < config.duration));
+}
+
+static void write_header(FILE* output, const Config& config){
+    fprintf(output, "timestamp (ms),stateEstimate.x,stateEstimate.y,stateEstimate.z,stateEstimate.vx,stateEstimate.vy,stateEstimate.vz,motor.m1,motor.m2,motor.m3,motor.m4,pm.vbat");
+    for(const auto& name: config.log_variables){
+        fprintf(output, ",%s", name.c_str());
+    }
+    fprintf(output, "\n");
+}
+
+static void write_row(FILE* output, const Simulation& simulation, const std::vector<const log_s*>& log_variables){
+    const QuadrotorState& quadrotor = simulation.quadrotor;
+    fprintf(output, "%u,%f,%f,%f,%f,%f,%f,%u,%u,%u,%u,%f", simulation.tick,
+        quadrotor.position[0], quadrotor.position[1], quadrotor.position[2],
+        quadrotor.linear_velocity[0], quadrotor.linear_velocity[1], quadrotor.linear_velocity[2],
+        motorsGetRatio(MOTOR_M1), motorsGetRatio(MOTOR_M2), motorsGetRatio(MOTOR_M3), motorsGetRatio(MOTOR_M4),
+        simulation.battery.voltage);
+    for(const auto* variable: log_variables){
+        fprintf(output, ",%f", sim_log_value(variable));
+    }
+    fprintf(output, "\n");
+}
+
+// Forks one process per branch (at most config.jobs at a time). The whole world state (vehicle, battery, virtual
+// clock, controller and policy contexts, parameters, recorders) lives in this process, so the copy-on-write fork is
+// the snapshot. Returns the branch to continue in a child, nullptr in the parent (after all branches have started).
+static const Branch* fork_branches(const Config& config, unsigned& running, unsigned& failed){
+    fflush(nullptr); // buffered output must not be written by every copy
+    for(const auto& branch: config.branches){
+        while(running >= config.jobs){
+            int status;
+            if(wait(&status) > 0){
+                running--;
+                failed += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+            }
+        }
+        pid_t pid = fork();
+        if(pid == 0){
+            return &branch;
+        }
+        if(pid < 0){
+            perror("fork");
+            failed++;
+            continue;
+        }
+        running++;
+    }
+    return nullptr;
+}
+
+static bool start_branch(const Branch& branch, Simulation& simulation, FILE*& output, FILE* prefix, const char* prefix_data, size_t prefix_size){
+    // The recorders and the bus stay with the parent (baseline); their buffers were flushed before the fork
+    if(simulation.trace){
+        fclose(simulation.trace);
+        simulation.trace = nullptr;
+    }
+    if(simulation.timeline){
+        fclose(simulation.timeline);
+        simulation.timeline = nullptr;
+    }
+    simulation.telemetry = nullptr;
+    if(output != stdout){
+        fclose(output);
+    }
+    output = fopen(branch.output.c_str(), "w");
+    if(output == nullptr){
+        perror(branch.output.c_str());
+        return false;
+    }
+    fwrite(prefix_data, 1, prefix_size, output);
+    fclose(prefix);
+    for(const auto& param: branch.params){
+        if(!sim_firmware_set_param_string(param.c_str())){
+            fprintf(stderr, "%s: unknown parameter assignment: %s\n", branch.output.c_str(), param.c_str());
+            return false;
+        }
+    }
+    memcpy(simulation.disturbance_force, branch.disturbance_force, sizeof(simulation.disturbance_force));
+    return true;
+}
+
+int main(int argc, char** argv){
+    Config config;
+    if(!parse(argc, argv, config)){
+        usage(argv[0]);
+        return 1;
+    }
+    FILE* output = config.output ? fopen(config.output, "w") : stdout;
+    if(output == nullptr){
+        perror(config.output);
+        return 1;
+    }
+    sim_firmware_set_verbose(config.verbose);
+    Simulation simulation;
+    simulation_init(simulation, config.battery);
+    for(const auto& param: config.params){
+        if(!sim_firmware_set_param_string(param.c_str())){
+            fprintf(stderr, "unknown parameter assignment: %s\n", param.c_str());
+            return 1;
+        }
+    }
+    Scenario scenario;
+    ScenarioRun scenario_run;
+    if(config.scenario){
+        if(!scenario_read(config.scenario, scenario)){
+            return 1;
+        }
+        for(const auto& param: scenario.params){
+            if(!sim_firmware_set_param_string(param.c_str())){
+                fprintf(stderr, "%s: unknown parameter assignment: %s\n", config.scenario, param.c_str());
+                return 1;
+            }
+        }
+        scenario_start(scenario_run, scenario, config.seed);
+        simulation.scenario = &scenario_run;
+    }
+    if(config.trace){
+        simulation.trace = fopen(config.trace, "wb");
+        if(simulation.trace == nullptr){
+            perror(config.trace);
+            return 1;
+        }
+    }
+    if(config.timeline){
+        simulation.timeline = fopen(config.timeline, "wb");
+        if(simulation.timeline == nullptr){
+            perror(config.timeline);
+            return 1;
+        }
+        controller_timeline_header_t header;
+        controller_timeline_file_header(&header);
+        fwrite(&header, sizeof(header), 1, simulation.timeline);
+    }
+    TelemetryBus bus;
+    if(config.bus){
+        if(!telemetry_bus_create(bus, config.bus, config.bus_capacity)){
+            return 1;
+        }
+        simulation.telemetry = &bus;
+    }
+    std::vector<const log_s*> log_variables;
+    for(const auto& name: config.log_variables){
+        const log_s* variable = sim_log_find(name.c_str());
+        if(variable == nullptr){
+            fprintf(stderr, "unknown log variable: %s\n", name.c_str());
+            return 1;
+        }
+        log_variables.push_back(variable);
+    }
+
+    // With branches, the rows up to the fork are also kept in memory so every branch CSV starts with them
+    char* prefix_data = nullptr;
+    size_t prefix_size = 0;
+    FILE* prefix = config.branches.empty() ? nullptr : open_memstream(&prefix_data, &prefix_size);
+    if(config.jobs == 0){
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        config.jobs = cpus > 0 ? (unsigned)cpus : 1;
+    }
+    unsigned running = 0;
+    unsigned failed = 0;
+    const Branch* branch = nullptr;
+
+    write_header(output, config);
+    if(prefix){
+        write_header(prefix, config);
+    }
+
+    uint32_t steps = (uint32_t)(config.duration * SIMULATION_STABILIZER_RATE);
+    uint32_t fork_tick = (uint32_t)(config.fork_at * SIMULATION_STABILIZER_RATE);
+    while(simulation.tick < steps){
+        if(prefix && simulation.tick == fork_tick){
+            fflush(prefix);
+            branch = fork_branches(config, running, failed);
+            if(branch != nullptr && !start_branch(*branch, simulation, output, prefix, prefix_data, prefix_size)){
+                _exit(1);
+            }
+            if(branch == nullptr){
+                fclose(prefix);
+            }
+            prefix = nullptr;
+        }
+        uint32_t next_tick = simulation.tick + 1;
+        if(next_tick >= config.trigger_start * SIMULATION_STABILIZER_RATE && next_tick % TRIGGER_PACKET_INTERVAL_MS == 0){
+            if(simulation.scenario == nullptr || scenario_packet(*simulation.scenario, (float)next_tick / SIMULATION_STABILIZER_RATE)){
+                rl_tools_controller_packet_received();
+            }
+        }
+        simulation_step(simulation);
+
+        if(simulation.tick % config.log_interval_ms == 0){
+            write_row(output, simulation, log_variables);
+            if(prefix){
+                write_row(prefix, simulation, log_variables);
+            }
+        }
+    }
+    if(output != stdout){
+        fclose(output);
+    }
+    if(simulation.trace){
+        fclose(simulation.trace);
+    }
+    if(simulation.timeline){
+        fclose(simulation.timeline);
+    }
+    if(simulation.telemetry){
+        telemetry_bus_close(bus);
+    }
+    if(branch != nullptr){
+        return 0;
+    }
+    free(prefix_data);
+    while(running > 0){
+        int status;
+        if(wait(&status) > 0){
+            running--;
+            failed += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+        }
+    }
+    if(failed > 0){
+        fprintf(stderr, "%u of %zu branches failed\n", failed, config.branches.size());
+        return 1;
+    }
+    return 0;
+}
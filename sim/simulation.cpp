@@ -0,0 +1,139 @@
+#include "simulation.h"
+
+#include <chrono>
+#include <cmath>
+#include <ucontext.h>
+
+extern "C" {
+#include "firmware/motors.h"
+#include "firmware/math3d.h"
+#include "controller_trace.h"
+#include "controller_timeline.h"
+void controllerOutOfTreeInit(void);
+bool controllerOutOfTreeTest(void);
+void controllerOutOfTree(control_t *control, setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick);
+}
+#include "firmware.h"
+#include "scenario.h"
+
+void simulation_observe(const QuadrotorParameters& parameters, const QuadrotorState& quadrotor, state_t& state, sensorData_t& sensors){
+    state.position.x = quadrotor.position[0];
+    state.position.y = quadrotor.position[1];
+    state.position.z = quadrotor.position[2];
+    state.velocity.x = quadrotor.linear_velocity[0];
+    state.velocity.y = quadrotor.linear_velocity[1];
+    state.velocity.z = quadrotor.linear_velocity[2];
+    state.acc.x = quadrotor.linear_acceleration[0];
+    state.acc.y = quadrotor.linear_acceleration[1];
+    state.acc.z = quadrotor.linear_acceleration[2];
+    state.attitudeQuaternion.w = quadrotor.orientation[0];
+    state.attitudeQuaternion.x = quadrotor.orientation[1];
+    state.attitudeQuaternion.y = quadrotor.orientation[2];
+    state.attitudeQuaternion.z = quadrotor.orientation[3];
+    sensors.gyro.x = degrees(quadrotor.angular_velocity[0]);
+    sensors.gyro.y = degrees(quadrotor.angular_velocity[1]);
+    sensors.gyro.z = degrees(quadrotor.angular_velocity[2]);
+    // Accelerometer: specific force in the body frame [g], the floor's reaction while resting on it
+    const float* q = quadrotor.orientation;
+    float w = q[0], x = q[1], y = q[2], z = q[3];
+    float force[3] = {quadrotor.linear_acceleration[0], quadrotor.linear_acceleration[1], quadrotor.linear_acceleration[2] + parameters.gravity};
+    if(quadrotor.position[2] <= 0){
+        force[0] = force[1] = 0;
+        force[2] = parameters.gravity;
+    }
+    sensors.acc.x = ((1 - 2*y*y - 2*z*z) * force[0] + (2*x*y + 2*w*z) * force[1] + (2*x*z - 2*w*y) * force[2]) / parameters.gravity;
+    sensors.acc.y = ((2*x*y - 2*w*z) * force[0] + (1 - 2*x*x - 2*z*z) * force[1] + (2*y*z + 2*w*x) * force[2]) / parameters.gravity;
+    sensors.acc.z = ((2*x*z + 2*w*y) * force[0] + (2*y*z - 2*w*x) * force[1] + (1 - 2*x*x - 2*y*y) * force[2]) / parameters.gravity;
+}
+
+static FILE* trace_file = nullptr;
+static void write_trace(const controller_trace_record_t* record){
+    fwrite(record, sizeof(*record), 1, trace_file);
+}
+static FILE* timeline_file = nullptr;
+static void write_timeline(const controller_timeline_record_t* record){
+    fwrite(record, sizeof(*record), 1, timeline_file);
+}
+
+// controllerOutOfTree of the stepped simulation, timed, on Simulation::controller_stack if set
+static Simulation* controller_simulation = nullptr;
+static ucontext_t controller_caller, controller_callee;
+static void call_controller(){
+    Simulation& simulation = *controller_simulation;
+    auto start = std::chrono::steady_clock::now();
+    controllerOutOfTree(&simulation.control, &simulation.setpoint, &simulation.sensors, &simulation.state, simulation.tick);
+    simulation.controller_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+uint64_t simulation_time(const Simulation& simulation){
+    return (uint64_t)simulation.tick * (1000000 / SIMULATION_STABILIZER_RATE);
+}
+
+void simulation_init(Simulation& simulation, const BatteryParameters& battery_parameters){
+    simulation = Simulation{};
+    simulation.battery_parameters = battery_parameters;
+    simulation.battery.voltage = battery_parameters.nominal_voltage;
+    sim_firmware_set_time(0);
+    sim_firmware_set_battery_voltage(simulation.battery.voltage);
+    for(uint32_t motor_i = 0; motor_i < NBR_OF_MOTORS; motor_i++){
+        motorsSetRatio(motor_i, 0);
+    }
+    controllerOutOfTreeInit();
+    controllerOutOfTreeTest();
+}
+
+void simulation_step(Simulation& simulation){
+    simulation.tick++;
+    const float dt = 1.0f / SIMULATION_STABILIZER_RATE;
+    float time = simulation.tick * dt;
+    float disturbance_force[3] = {simulation.disturbance_force[0], simulation.disturbance_force[1], simulation.disturbance_force[2]};
+    float motor_thrust[4] = {1, 1, 1, 1};
+    float voltage = simulation.battery.voltage;
+    if(simulation.scenario != nullptr){
+        scenario_actuate(*simulation.scenario, time, dt, disturbance_force, motor_thrust, voltage);
+    }
+    sim_firmware_set_time(simulation_time(simulation));
+    sim_firmware_set_battery_voltage(voltage);
+    simulation_observe(simulation.parameters, simulation.quadrotor, simulation.state, simulation.sensors);
+    if(simulation.scenario != nullptr){
+        scenario_observe(*simulation.scenario, time, simulation.state, simulation.sensors);
+    }
+    sim_firmware_set_accelerometer(simulation.sensors.acc.x, simulation.sensors.acc.y, simulation.sensors.acc.z);
+    simulation.setpoint = simulation.commanded_setpoint;
+    // The controller's recorder hands over the completed record (inputs and outputs) of this invocation
+    trace_file = simulation.trace;
+    controller_trace_set_sink(trace_file != nullptr ? write_trace : nullptr);
+    timeline_file = simulation.timeline;
+    controller_timeline_set_sink(timeline_file != nullptr ? write_timeline : nullptr);
+    controller_simulation = &simulation;
+    if(simulation.controller_stack != nullptr){
+        getcontext(&controller_callee);
+        controller_callee.uc_stack.ss_sp = simulation.controller_stack;
+        controller_callee.uc_stack.ss_size = simulation.controller_stack_size;
+        controller_callee.uc_link = &controller_caller;
+        makecontext(&controller_callee, call_controller, 0);
+        swapcontext(&controller_caller, &controller_callee);
+    }
+    else{
+        call_controller();
+    }
+    if(simulation.telemetry != nullptr){
+        telemetry_bus_publish_controller(*simulation.telemetry, simulation.tick, simulation_time(simulation), simulation.state, simulation.sensors, voltage, simulation.controller_ns / 1000.0f);
+    }
+
+    float ratio[4];
+    for(uint32_t motor_i = 0; motor_i < 4; motor_i++){
+        ratio[motor_i] = motorsGetRatio(motor_i) / (float)UINT16_MAX;
+    }
+    float command[4];
+    battery_motor_rpm_fractions(simulation.battery_parameters, simulation.battery, voltage, ratio, command);
+    float rpm_setpoint[4];
+    float rpm_fraction[4];
+    for(uint32_t motor_i = 0; motor_i < 4; motor_i++){
+        // thrust ~ rpm^2: a motor producing a fraction of its thrust runs at its square root
+        rpm_setpoint[motor_i] = std::sqrt(motor_thrust[motor_i]) * quadrotor_motor_rpm(simulation.parameters, command[motor_i]);
+        rpm_fraction[motor_i] = simulation.quadrotor.rpm[motor_i] / simulation.parameters.max_rpm;
+    }
+    quadrotor_step(simulation.parameters, simulation.quadrotor, rpm_setpoint, disturbance_force, dt);
+    battery_step(simulation.battery_parameters, simulation.battery, ratio, rpm_fraction, dt);
+}
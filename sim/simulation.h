@@ -0,0 +1,55 @@
+// Closed-loop simulation state: Crazyflie model + battery + the firmware controller at the 1 kHz stabilizer rate
+#ifndef __SIM_SIMULATION_H__
+#define __SIM_SIMULATION_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+extern "C" {
+#include "firmware/stabilizer_types.h"
+}
+#include "quadrotor.h"
+#include "battery.h"
+#include "telemetry_bus.h"
+
+constexpr uint32_t SIMULATION_STABILIZER_RATE = 1000;
+
+struct ScenarioRun;
+
+struct Simulation{
+    QuadrotorParameters parameters;
+    QuadrotorState quadrotor;
+    BatteryParameters battery_parameters;
+    BatteryState battery;
+    float disturbance_force[3] = {0, 0, 0};
+    // What the commander hands to the stabilizer; copied every tick because the controller may overwrite it
+    setpoint_t commanded_setpoint = {};
+    setpoint_t setpoint = {};
+    control_t control = {};
+    state_t state = {};
+    sensorData_t sensors = {};
+    uint32_t tick = 0;
+    // If set, every controllerOutOfTree invocation is appended as a controller_trace_record_t
+    FILE* trace = nullptr;
+    // If set, the stage timing of every invocation is appended as a controller_timeline_record_t (after a header)
+    FILE* timeline = nullptr;
+    // If set, every controllerOutOfTree invocation is published as a TelemetryFrame
+    TelemetryBus* telemetry = nullptr;
+    // If set, its actuation and sensor faults are applied every tick (scenario.h)
+    ScenarioRun* scenario = nullptr;
+    // If set, controllerOutOfTree runs on this stack (e.g. painted to measure the stack usage of the controller)
+    void* controller_stack = nullptr;
+    size_t controller_stack_size = 0;
+    // Wall-clock time of the last controllerOutOfTree invocation [ns]
+    int64_t controller_ns = 0;
+};
+
+// Initializes the controller (controllerOutOfTreeInit + test) and resets the vehicle on the ground
+void simulation_init(Simulation& simulation, const BatteryParameters& battery_parameters);
+// Advances the virtual clock by one stabilizer tick and runs controller + dynamics
+void simulation_step(Simulation& simulation);
+uint64_t simulation_time(const Simulation& simulation);
+// State estimate and sensor data of the firmware from the true vehicle state (ideal estimator)
+void simulation_observe(const QuadrotorParameters& parameters, const QuadrotorState& quadrotor, state_t& state, sensorData_t& sensors);
+
+#endif
@@ -0,0 +1,359 @@
+// Batch stress test of the compiled policy under fault scenarios (scenario.h)
+// Every scenario x mode x seed combination is one closed-loop flight (as sim: trigger packets every 10 ms from the
+// scenario's trigger start) in its own forked process, at most --jobs at a time. A flight is scored from the settle
+// time after the learned controller took over: tracking error of the true position against the controller's target,
+// lowest height, action rate, motor saturation and the share of the time the learned controller stayed in control.
+// It crashes when the error exceeds CRASH_ERROR or the vehicle gets below CRASH_HEIGHT (scripts/sweep.py) and passes
+// if it neither crashes nor misses a criterion of the scenario. The margin is the smallest relative distance to a
+// limit (criteria, crash error and height), negative for failed flights.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern "C" {
+#include "firmware/motors.h"
+#include "rl_tools_controller.h"
+#include "rl_tools_adapter.h"
+}
+#include "firmware.h"
+#include "simulation.h"
+#include "scenario.h"
+
+constexpr unsigned TRIGGER_PACKET_INTERVAL_MS = 10;
+constexpr float CRASH_ERROR = 1.0f; // [m]
+constexpr float CRASH_HEIGHT = 0.02f; // [m]
+
+// Indices into SCENARIO_METRICS
+enum Metric{RMSE, MAX_ERROR, FINAL_ERROR, MIN_HEIGHT, ACTION_RATE, SATURATION, ACTIVE};
+static_assert(SCENARIO_METRIC_COUNT == ACTIVE + 1, "Metric has to follow SCENARIO_METRICS");
+
+struct Mode{
+    const char* name;
+    uint8_t value; // rlt.wn
+};
+static const Mode MODES[] = {{"position", 1}, {"waypoint", 2}, {"waypoint_dynamic", 3}, {"figure_eight", 4}};
+
+struct Config{
+    std::vector<const char*> scenarios;
+    std::vector<Mode> modes;
+    unsigned seeds = 1;
+    std::vector<std::string> params;
+    const char* output = nullptr;
+    unsigned jobs = 0;
+    bool verbose = false;
+};
+
+struct Flight{
+    unsigned scenario;
+    unsigned mode;
+    uint32_t seed;
+};
+
+// Written by the flight's process into shared memory
+struct Result{
+    bool done;
+    bool activated;
+    bool crashed;
+    float crash_time; // [s]
+    float metrics[SCENARIO_METRIC_COUNT]; // SCENARIO_METRICS
+};
+
+static void usage(const char* name){
+    fprintf(stderr,
+        "usage: %s [options] <scenario> ...\n"
+        "  --mode <list>             comma-separated modes crossed with the scenarios: position, waypoint,\n"
+        "                            waypoint_dynamic, figure_eight (default position,figure_eight)\n"
+        "  --seeds <n>               flights per scenario and mode, seeds 0..n-1 of the random effects (default 1)\n"
+        "  --param <group.name=v>    set a firmware parameter in every flight, before the scenario's (repeatable)\n"
+        "  --output <file>           CSV with one row per flight\n"
+        "  --jobs <n>                flights running at the same time (default: online CPUs)\n"
+        "  --verbose                 print DEBUG_PRINT output to stderr\n", name);
+}
+
+static bool parse_modes(const char* list, std::vector<Mode>& modes){
+    modes.clear();
+    std::string text = list;
+    for(size_t start = 0; start <= text.size();){
+        size_t end = std::min(text.find(',', start), text.size());
+        std::string name = text.substr(start, end - start);
+        const Mode* mode = std::find_if(std::begin(MODES), std::end(MODES), [&](const Mode& m){ return name == m.name; });
+        if(mode == std::end(MODES)){
+            fprintf(stderr, "unknown mode: %s\n", name.c_str());
+            return false;
+        }
+        modes.push_back(*mode);
+        start = end + 1;
+    }
+    return true;
+}
+
+static bool parse(int argc, char** argv, Config& config){
+    config.modes = {MODES[0], MODES[3]};
+    for(int arg_i = 1; arg_i < argc; arg_i++){
+        std::string arg = argv[arg_i];
+        bool has_value = arg_i + 1 < argc;
+        if(arg == "--verbose"){
+            config.verbose = true;
+        }
+        else if(has_value && arg == "--mode"){
+            if(!parse_modes(argv[++arg_i], config.modes)){
+                return false;
+            }
+        }
+        else if(has_value && arg == "--seeds"){
+            config.seeds = (unsigned)atoi(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--param"){
+            config.params.push_back(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--output"){
+            config.output = argv[++arg_i];
+        }
+        else if(has_value && arg == "--jobs"){
+            config.jobs = (unsigned)atoi(argv[++arg_i]);
+        }
+        else if(arg.rfind("--", 0) != 0){
+            config.scenarios.push_back(argv[arg_i]);
+        }
+        else{
+            return false;
+        }
+    }
+    return !config.scenarios.empty() && config.seeds > 0;
+}
+
+static bool apply_params(const std::vector<std::string>& params, const char* source){
+    for(const auto& param: params){
+        if(!sim_firmware_set_param_string(param.c_str())){
+            fprintf(stderr, "%s: unknown parameter assignment: %s\n", source, param.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool fly(const Config& config, const Scenario& scenario, const Mode& mode, uint32_t seed, Result& result){
+    BatteryParameters battery;
+    battery.capacity = scenario.battery;
+    Simulation simulation;
+    simulation_init(simulation, battery);
+    if(!apply_params(config.params, "--param") || !apply_params(scenario.params, scenario.name.c_str()) || !apply_params({"rlt.wn=" + std::to_string(mode.value)}, mode.name)){
+        return false;
+    }
+    ScenarioRun run;
+    scenario_start(run, scenario, seed);
+    simulation.scenario = &run;
+    const rl_tools_controller_context_t* controller = rl_tools_controller_context_global();
+
+    uint32_t steps = (uint32_t)(scenario.duration * SIMULATION_STABILIZER_RATE);
+    float activation = -1;
+    uint32_t ticks = 0, active_ticks = 0, saturated_ticks = 0, action_steps = 0;
+    double error_square_sum = 0, action_rate_sum = 0;
+    float max_error = 0, final_error = NAN, min_height = INFINITY;
+    float previous_action[RL_TOOLS_CONTROLLER_NUM_MOTORS];
+    bool has_previous_action = false;
+    while(simulation.tick < steps){
+        uint32_t next_tick = simulation.tick + 1;
+        float next_time = (float)next_tick / SIMULATION_STABILIZER_RATE;
+        if(next_time >= scenario.trigger_start && next_tick % TRIGGER_PACKET_INTERVAL_MS == 0 && scenario_packet(run, next_time)){
+            rl_tools_controller_packet_received();
+        }
+        simulation_step(simulation);
+        bool active = controller->log_set_motors == 1;
+        if(activation < 0 && active){
+            activation = next_time;
+        }
+        if(activation < 0 || next_time < activation + scenario.settle_time){
+            continue;
+        }
+        ticks++;
+        const float* position = simulation.quadrotor.position;
+        float error = std::sqrt(std::pow(controller->target_pos[0] - position[0], 2) + std::pow(controller->target_pos[1] - position[1], 2) + std::pow(controller->target_pos[2] - position[2], 2));
+        error_square_sum += error * error;
+        max_error = std::max(max_error, error);
+        final_error = error;
+        min_height = std::min(min_height, position[2]);
+        if(active){
+            active_ticks++;
+            bool saturated = false;
+            for(uint32_t motor_i = 0; motor_i < RL_TOOLS_CONTROLLER_NUM_MOTORS; motor_i++){
+                uint16_t ratio = motorsGetRatio(motor_i);
+                saturated = saturated || ratio == 0 || ratio == UINT16_MAX;
+            }
+            saturated_ticks += saturated;
+            if(controller->inference){
+                if(has_previous_action){
+                    for(uint32_t action_i = 0; action_i < RL_TOOLS_CONTROLLER_NUM_MOTORS; action_i++){
+                        action_rate_sum += std::pow(controller->action_output[action_i] - previous_action[action_i], 2);
+                    }
+                    action_steps++;
+                }
+                memcpy(previous_action, controller->action_output, sizeof(previous_action));
+                has_previous_action = true;
+            }
+        }
+        if(error > CRASH_ERROR || position[2] < CRASH_HEIGHT){
+            result.crashed = true;
+            result.crash_time = next_time;
+            break;
+        }
+    }
+    result.activated = ticks > 0;
+    result.metrics[RMSE] = ticks > 0 ? (float)std::sqrt(error_square_sum / ticks) : NAN;
+    result.metrics[MAX_ERROR] = ticks > 0 ? max_error : NAN;
+    result.metrics[FINAL_ERROR] = final_error;
+    result.metrics[MIN_HEIGHT] = ticks > 0 ? min_height : NAN;
+    result.metrics[ACTION_RATE] = action_steps > 0 ? (float)(action_rate_sum / action_steps) : NAN;
+    result.metrics[SATURATION] = active_ticks > 0 ? (float)saturated_ticks / active_ticks : NAN;
+    result.metrics[ACTIVE] = ticks > 0 ? (float)active_ticks / ticks : NAN;
+    return true;
+}
+
+static float criterion_margin(float value, float limit, bool less){
+    float scale = limit != 0 ? std::fabs(limit) : 1;
+    return (less ? limit - value : value - limit) / scale;
+}
+
+// Smallest relative distance to a limit, NaN if a metric the criteria need is undefined
+static float margin(const Scenario& scenario, const Result& result){
+    float margin = std::min(criterion_margin(result.metrics[MAX_ERROR], CRASH_ERROR, true), criterion_margin(result.metrics[MIN_HEIGHT], CRASH_HEIGHT, false));
+    for(const auto& criterion: scenario.criteria){
+        margin = std::min(margin, criterion_margin(result.metrics[criterion.metric], criterion.limit, criterion.less));
+    }
+    return margin;
+}
+
+int main(int argc, char** argv){
+    Config config;
+    if(!parse(argc, argv, config)){
+        usage(argv[0]);
+        return 1;
+    }
+    std::vector<Scenario> scenarios(config.scenarios.size());
+    for(size_t scenario_i = 0; scenario_i < scenarios.size(); scenario_i++){
+        if(!scenario_read(config.scenarios[scenario_i], scenarios[scenario_i])){
+            return 1;
+        }
+    }
+    FILE* output = nullptr;
+    if(config.output){
+        output = fopen(config.output, "w");
+        if(output == nullptr){
+            perror(config.output);
+            return 1;
+        }
+    }
+    sim_firmware_set_verbose(config.verbose);
+    if(config.jobs == 0){
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        config.jobs = cpus > 0 ? (unsigned)cpus : 1;
+    }
+    std::vector<Flight> flights;
+    for(unsigned scenario_i = 0; scenario_i < scenarios.size(); scenario_i++){
+        for(unsigned mode_i = 0; mode_i < config.modes.size(); mode_i++){
+            for(uint32_t seed = 0; seed < config.seeds; seed++){
+                flights.push_back({scenario_i, mode_i, seed});
+            }
+        }
+    }
+
+    // The firmware state is global, so every flight gets a fresh process; the results come back through shared memory
+    size_t results_size = flights.size() * sizeof(Result);
+    Result* results = (Result*)mmap(nullptr, results_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(results == MAP_FAILED){
+        perror("mmap");
+        return 1;
+    }
+    memset(results, 0, results_size);
+    fprintf(stderr, "%zu flights (%zu scenarios x %zu modes x %u seeds) on %u jobs, checkpoint %s\n", flights.size(), scenarios.size(), config.modes.size(), config.seeds, config.jobs, rl_tools_get_checkpoint_name());
+    fflush(nullptr);
+    unsigned running = 0;
+    for(size_t flight_i = 0; flight_i <= flights.size(); flight_i++){
+        while(running > 0 && (running >= config.jobs || flight_i == flights.size())){
+            int status;
+            if(wait(&status) > 0){
+                running--;
+            }
+        }
+        if(flight_i == flights.size()){
+            break;
+        }
+        pid_t pid = fork();
+        if(pid == 0){
+            const Flight& flight = flights[flight_i];
+            Result& result = results[flight_i];
+            bool ok = fly(config, scenarios[flight.scenario], config.modes[flight.mode], flight.seed, result);
+            result.done = ok;
+            _exit(ok ? 0 : 1);
+        }
+        if(pid < 0){
+            perror("fork");
+            continue;
+        }
+        running++;
+    }
+
+    if(output){
+        fprintf(output, "checkpoint,scenario,mode,seed,pass,margin,crashed,crash_time");
+        for(const char* metric: SCENARIO_METRICS){
+            fprintf(output, ",%s", metric);
+        }
+        fprintf(output, "\n");
+    }
+    printf("%-24s %-18s %6s %8s %8s %8s\n", "scenario", "mode", "pass", "margin", "rmse", "crashed");
+    unsigned failed = 0, errors = 0;
+    for(unsigned scenario_i = 0; scenario_i < scenarios.size(); scenario_i++){
+        const Scenario& scenario = scenarios[scenario_i];
+        for(unsigned mode_i = 0; mode_i < config.modes.size(); mode_i++){
+            unsigned passed = 0, crashed = 0, count = 0;
+            float worst_margin = INFINITY;
+            double rmse_sum = 0;
+            for(size_t flight_i = 0; flight_i < flights.size(); flight_i++){
+                const Flight& flight = flights[flight_i];
+                const Result& result = results[flight_i];
+                if(flight.scenario != scenario_i || flight.mode != mode_i){
+                    continue;
+                }
+                if(!result.done){
+                    fprintf(stderr, "%s %s seed %u: flight failed\n", scenario.name.c_str(), config.modes[mode_i].name, flight.seed);
+                    errors++;
+                    continue;
+                }
+                float flight_margin = result.activated ? margin(scenario, result) : NAN;
+                bool pass = result.activated && !result.crashed && flight_margin >= 0;
+                passed += pass;
+                crashed += result.crashed;
+                failed += !pass;
+                count++;
+                worst_margin = std::isnan(flight_margin) ? -INFINITY : std::min(worst_margin, flight_margin);
+                rmse_sum += result.metrics[RMSE];
+                if(output){
+                    fprintf(output, "%s,%s,%s,%u,%d,%f,%d,%f", rl_tools_get_checkpoint_name(), scenario.name.c_str(), config.modes[mode_i].name, flight.seed, pass, flight_margin, result.crashed, result.crashed ? result.crash_time : NAN);
+                    for(float value: result.metrics){
+                        fprintf(output, ",%f", value);
+                    }
+                    fprintf(output, "\n");
+                }
+            }
+            char pass_text[32];
+            snprintf(pass_text, sizeof(pass_text), "%u/%u", passed, count);
+            printf("%-24s %-18s %6s %8.3f %8.4f %8u\n", scenario.name.c_str(), config.modes[mode_i].name, pass_text, worst_margin, count > 0 ? rmse_sum / count : NAN, crashed);
+        }
+    }
+    if(output){
+        fclose(output);
+    }
+    munmap(results, results_size);
+    if(errors > 0){
+        fprintf(stderr, "%u of %zu flights did not complete\n", errors, flights.size());
+        return 1;
+    }
+    return failed > 0 ? 2 : 0;
+}
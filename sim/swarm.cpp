@@ -0,0 +1,520 @@
+// Swarm-size test of the broadcast swarm setpoints (swarm_setpoint.h)
+// For every --vehicles count, that many controller contexts (rl_tools_controller.h, one policy context each) fly in
+// NORMAL mode from a ground grid, stepped together at the stabilizer rate on the virtual clock with an ideal supply.
+// A host packer produces a frame of targets (hover or figure eight around each grid point) at --rate, the radio
+// stand-in transmits its packets one after another at --link-rate and delivers them --link-latency later to every
+// vehicle, each of which loses a packet with probability --loss and decodes its own slot. Packets of a frame that are
+// still queued when the next frame is ready are dropped (the next frame starts with the packet after the last one sent,
+// round robin). --link-jitter adds a random delay per packet (in order, as a radio with retransmissions). With
+// --transport unicast every vehicle gets an addressed position setpoint and trigger packet per frame instead, as from
+// commander --mode normal_trajectory. Reported per swarm size: link utilization, target updates per vehicle, age of the
+// target at the inference steps, target jitter (how far the controller's target moves between inference steps
+// differently from the reference, e.g. jumps at late setpoints; compare rltjb.mode), time in control and tracking
+// error against the host's reference. The achievable swarm size per radio is the largest one whose p99 target age
+// stays within --max-age with all vehicles in control.
+// Every swarm size runs on a thread of its own (contexts and virtual clock are per thread), at most --jobs at a time.
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+extern "C" {
+#include "firmware/motors.h"
+#include "firmware/task.h"
+#include "rl_tools_controller.h"
+#include "rl_tools_adapter.h"
+#include "swarm_setpoint.h"
+void controllerOutOfTreeInit(void);
+bool controllerOutOfTreeTest(void);
+}
+#include "firmware.h"
+#include "simulation.h"
+
+constexpr float CRASH_ERROR = 1.0f; // [m]
+constexpr float CRASH_HEIGHT = 0.02f; // [m]
+constexpr unsigned MAX_VEHICLES = 256; // uint8 drone ids
+
+struct Config{
+    std::vector<unsigned> vehicles = {1, 2, 4, 8, 16, 24, 30, 36, 48, 64};
+    float duration = 20;
+    float trigger_start = 1;
+    float settle_time = 2;
+    float rate = 100; // frames/s
+    float link_rate = 1000; // packets/s
+    float link_latency_ms = 2;
+    float link_jitter_ms = 0;
+    uint32_t tick_offset_ms = 0;
+    bool unicast = false;
+    float loss = 0;
+    float max_age_ms = 50;
+    bool figure_eight = true;
+    float height = 0.5;
+    float trajectory_scale = 0.3;
+    float trajectory_interval = 5.5;
+    float spacing = 1.5;
+    std::vector<std::string> params;
+    uint32_t seed = 0;
+    unsigned jobs = 0;
+    bool verbose = false;
+};
+
+// Written by the swarm's process into shared memory
+struct Result{
+    bool done;
+    unsigned packets_per_frame;
+    float utilization; // transmitted packets / link capacity
+    float dropped; // share of the packets not transmitted before the next frame
+    float update_rate; // received targets per vehicle and second [Hz]
+    float age_mean, age_p99; // target age at the inference steps in control [ms]
+    float target_jitter; // RMS difference between the target's and the reference's motion per inference step [mm]
+    float active; // share of the scored ticks in control
+    float rmse; // [m]
+    unsigned crashed;
+};
+
+struct Vehicle{
+    rl_tools_controller_context_t controller;
+    std::vector<unsigned char> policy;
+    QuadrotorState quadrotor;
+    uint16_t motor_ratio[RL_TOOLS_CONTROLLER_NUM_MOTORS] = {0, 0, 0, 0}; // the motors keep their ratio until set
+    setpoint_t setpoint = {}; // last commander setpoint (unicast)
+    float grid[2];
+    double target_time = -1; // generation time of the current target [us]
+    double activation = -1; // [us]
+    bool crashed = false;
+    bool has_previous_target = false;
+    float previous_target[3], previous_reference[3]; // at the previous inference step
+};
+
+struct Packet{
+    enum Kind{SWARM, SETPOINT, TRIGGER} kind;
+    uint8_t data[SWARM_SETPOINT_HEADER_SIZE + SWARM_SETPOINT_SLOTS * SWARM_SETPOINT_SLOT_SIZE]; // SWARM
+    uint8_t size;
+    unsigned vehicle; // SETPOINT, TRIGGER
+    float position[3]; // SETPOINT
+    double frame_time; // [us]
+    double send_at; // [us]
+    double deliver_at; // [us]
+};
+
+static void usage(const char* name){
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --vehicles <list>         comma-separated swarm sizes (default 1,2,4,8,16,24,30,36,48,64, at most %u)\n"
+        "  --duration <s>            simulated time per swarm (default 20)\n"
+        "  --trigger-start <s>       time at which the frames start (default 1)\n"
+        "  --settle <s>              hover before the figure eight and unscored time after the activation (default 2)\n"
+        "  --rate <frames/s>         swarm setpoint frame rate (default 100)\n"
+        "  --link-rate <packets/s>   emulated radio throughput (default 1000)\n"
+        "  --link-latency <ms>       emulated latency (default 2)\n"
+        "  --link-jitter <ms>        additional uniformly distributed delay per packet, in order (default 0)\n"
+        "  --transport <name>        broadcast (swarm setpoints) | unicast (position setpoint + trigger per vehicle)\n"
+        "                            (default broadcast)\n"
+        "  --tick-offset <ms>        offset of the firmware tick count from the microsecond clock (default 0)\n"
+        "  --loss <p>                probability that a vehicle misses a packet (default 0)\n"
+        "  --max-age <ms>            p99 target age of an achievable swarm size (default 50)\n"
+        "  --trajectory <name>       hover | figure_eight (default figure_eight)\n"
+        "  --height <m>              (default 0.5)\n"
+        "  --trajectory-scale <m>    figure eight scale (default 0.3)\n"
+        "  --trajectory-interval <s> figure eight period (default 5.5)\n"
+        "  --spacing <m>             ground grid spacing (default 1.5)\n"
+        "  --param <group.name=v>    set a firmware parameter of every vehicle (repeatable)\n"
+        "  --seed <n>                random seed of the packet loss (default 0)\n"
+        "  --jobs <n>                swarms running at the same time (default: online CPUs)\n"
+        "  --verbose                 print DEBUG_PRINT output to stderr\n", name, MAX_VEHICLES);
+}
+
+static bool parse_vehicles(const char* list, std::vector<unsigned>& vehicles){
+    vehicles.clear();
+    std::string text = list;
+    for(size_t start = 0; start <= text.size();){
+        size_t end = std::min(text.find(',', start), text.size());
+        int count = atoi(text.substr(start, end - start).c_str());
+        if(count < 1 || count > (int)MAX_VEHICLES){
+            return false;
+        }
+        vehicles.push_back((unsigned)count);
+        start = end + 1;
+    }
+    return true;
+}
+
+static bool parse(int argc, char** argv, Config& config){
+    for(int arg_i = 1; arg_i < argc; arg_i++){
+        std::string arg = argv[arg_i];
+        bool has_value = arg_i + 1 < argc;
+        if(arg == "--verbose"){
+            config.verbose = true;
+        }
+        else if(has_value && arg == "--vehicles"){
+            if(!parse_vehicles(argv[++arg_i], config.vehicles)){
+                return false;
+            }
+        }
+        else if(has_value && arg == "--duration"){
+            config.duration = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--trigger-start"){
+            config.trigger_start = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--settle"){
+            config.settle_time = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--rate"){
+            config.rate = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--link-rate"){
+            config.link_rate = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--link-latency"){
+            config.link_latency_ms = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--link-jitter"){
+            config.link_jitter_ms = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--transport"){
+            std::string name = argv[++arg_i];
+            if(name != "broadcast" && name != "unicast"){
+                return false;
+            }
+            config.unicast = name == "unicast";
+        }
+        else if(has_value && arg == "--tick-offset"){
+            config.tick_offset_ms = (uint32_t)strtoul(argv[++arg_i], nullptr, 10);
+        }
+        else if(has_value && arg == "--loss"){
+            config.loss = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--max-age"){
+            config.max_age_ms = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--trajectory"){
+            std::string name = argv[++arg_i];
+            if(name != "hover" && name != "figure_eight"){
+                return false;
+            }
+            config.figure_eight = name == "figure_eight";
+        }
+        else if(has_value && arg == "--height"){
+            config.height = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--trajectory-scale"){
+            config.trajectory_scale = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--trajectory-interval"){
+            config.trajectory_interval = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--spacing"){
+            config.spacing = strtof(argv[++arg_i], nullptr);
+        }
+        else if(has_value && arg == "--param"){
+            config.params.push_back(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--seed"){
+            config.seed = (uint32_t)strtoul(argv[++arg_i], nullptr, 10);
+        }
+        else if(has_value && arg == "--jobs"){
+            config.jobs = (unsigned)atoi(argv[++arg_i]);
+        }
+        else{
+            return false;
+        }
+    }
+    return config.rate > 0 && config.link_rate > 0 && config.link_latency_ms >= 0 && config.link_jitter_ms >= 0 && config.loss >= 0 && config.loss < 1 && config.trajectory_interval > 0;
+}
+
+// Host reference of a vehicle at time [s]: the start of the figure eight around its grid point until trigger start +
+// settle, then the figure eight (as commander --mode swarm_trajectory)
+static swarm_setpoint_target_t reference(const Config& config, const Vehicle& vehicle, float time){
+    swarm_setpoint_target_t target = {{vehicle.grid[0], vehicle.grid[1], config.height}, {0, 0, 0}};
+    if(!config.figure_eight){
+        return target;
+    }
+    float t = std::max(0.0f, time - config.trigger_start - config.settle_time);
+    float phase = t / config.trajectory_interval * 2 * (float)M_PI + (float)M_PI / 2;
+    float speed = t > 0 ? 2 * (float)M_PI / config.trajectory_interval * config.trajectory_scale : 0;
+    target.position[0] += cosf(phase) * config.trajectory_scale;
+    target.position[1] += sinf(2 * phase) / 2.0f * config.trajectory_scale;
+    target.velocity[0] = -sinf(phase) * speed;
+    target.velocity[1] = cosf(2 * phase) * speed;
+    return target;
+}
+
+static double percentile(std::vector<float> values, double p){
+    if(values.empty()){
+        return NAN;
+    }
+    std::sort(values.begin(), values.end());
+    return values[(size_t)(p * (values.size() - 1) + 0.5)];
+}
+
+// The global context is initialized and parameterized once, before the swarms fly
+static bool fly(const Config& config, unsigned vehicle_count, Result& result){
+    sim_firmware_set_time(0);
+    BatteryParameters supply;
+    supply.capacity = 0;
+    // Every vehicle starts from the parameterized global context, flies NORMAL mode and takes the slot of its index
+    const QuadrotorParameters parameters;
+    std::vector<Vehicle> vehicles(vehicle_count);
+    unsigned columns = (unsigned)std::ceil(std::sqrt((float)vehicle_count));
+    for(unsigned vehicle_i = 0; vehicle_i < vehicle_count; vehicle_i++){
+        Vehicle& vehicle = vehicles[vehicle_i];
+        vehicle.policy.resize(rl_tools_context_size());
+        vehicle.controller = *rl_tools_controller_context_global();
+        vehicle.controller.policy = rl_tools_context_init(vehicle.policy.data());
+        vehicle.controller.mode = 0; // NORMAL
+        vehicle.controller.swarm_id = (uint8_t)vehicle_i;
+        vehicle.grid[0] = (vehicle_i % columns) * config.spacing;
+        vehicle.grid[1] = (vehicle_i / columns) * config.spacing;
+        vehicle.quadrotor.position[0] = vehicle.grid[0];
+        vehicle.quadrotor.position[1] = vehicle.grid[1];
+    }
+
+    const float dt = 1.0f / SIMULATION_STABILIZER_RATE;
+    const double packet_interval = 1e6 / config.link_rate;
+    const double frame_interval = 1e6 / config.rate;
+    const unsigned packets_per_frame = config.unicast ? 2 * vehicle_count : (vehicle_count + SWARM_SETPOINT_SLOTS - 1) / SWARM_SETPOINT_SLOTS;
+    std::mt19937 random(config.seed);
+    std::uniform_real_distribution<float> uniform;
+    std::deque<Packet> in_flight; // ordered by send_at and deliver_at
+    double next_frame = config.trigger_start * 1e6;
+    double radio_free_at = 0, last_deliver_at = 0;
+    uint8_t frame = 0;
+    unsigned first_packet = 0; // round-robin start of the frame
+    uint64_t packets_sent = 0, packets_dropped = 0, updates = 0;
+    std::vector<float> ages;
+    uint64_t scored_ticks = 0, active_ticks = 0, target_steps = 0;
+    double error_square_sum = 0, target_jitter_square_sum = 0;
+
+    uint32_t steps = (uint32_t)(config.duration * SIMULATION_STABILIZER_RATE);
+    for(uint32_t tick = 1; tick <= steps; tick++){
+        uint64_t now = (uint64_t)tick * (1000000 / SIMULATION_STABILIZER_RATE);
+        float time = tick * dt;
+        sim_firmware_set_time(now);
+        while(now >= next_frame){
+            // Packets of the previous frame without a transmission slot yet are replaced by the new frame, which
+            // starts with the first of them
+            unsigned transmitted = packets_per_frame;
+            radio_free_at = std::max(radio_free_at, next_frame);
+            while(!in_flight.empty() && in_flight.back().send_at >= next_frame){
+                radio_free_at = in_flight.back().send_at;
+                in_flight.pop_back();
+                packets_dropped++;
+                transmitted--;
+            }
+            first_packet = (first_packet + transmitted) % packets_per_frame;
+            float frame_time = (float)(next_frame / 1e6);
+            for(unsigned packet_i = 0; packet_i < packets_per_frame; packet_i++){
+                unsigned index = (first_packet + packet_i) % packets_per_frame;
+                Packet packet;
+                if(config.unicast){
+                    // Setpoint first so it is in place when the trigger activates the controller
+                    packet.kind = index % 2 == 0 ? Packet::SETPOINT : Packet::TRIGGER;
+                    packet.vehicle = index / 2;
+                    swarm_setpoint_target_t target = reference(config, vehicles[packet.vehicle], frame_time);
+                    memcpy(packet.position, target.position, sizeof(packet.position));
+                }
+                else{
+                    unsigned first_id = index * SWARM_SETPOINT_SLOTS;
+                    uint8_t count = (uint8_t)std::min<unsigned>(SWARM_SETPOINT_SLOTS, vehicle_count - first_id);
+                    swarm_setpoint_target_t targets[SWARM_SETPOINT_SLOTS];
+                    for(uint8_t slot_i = 0; slot_i < count; slot_i++){
+                        targets[slot_i] = reference(config, vehicles[first_id + slot_i], frame_time);
+                    }
+                    packet.kind = Packet::SWARM;
+                    packet.size = swarm_setpoint_pack(packet.data, frame, (uint8_t)first_id, targets, count);
+                }
+                packet.frame_time = next_frame;
+                packet.send_at = radio_free_at;
+                float jitter_ms = config.link_jitter_ms > 0 ? uniform(random) * config.link_jitter_ms : 0; // keeps the loss draws of --seed
+                packet.deliver_at = std::max(last_deliver_at, radio_free_at + (config.link_latency_ms + jitter_ms) * 1000);
+                last_deliver_at = packet.deliver_at;
+                radio_free_at += packet_interval;
+                in_flight.push_back(packet);
+            }
+            frame++;
+            next_frame += frame_interval;
+        }
+        while(!in_flight.empty() && in_flight.front().deliver_at <= now){
+            const Packet& packet = in_flight.front();
+            packets_sent++;
+            if(packet.kind == Packet::SWARM){
+                // Broadcast: every vehicle receives every packet and keeps its own slot
+                for(auto& vehicle: vehicles){
+                    if(uniform(random) < config.loss){
+                        continue;
+                    }
+                    if(rl_tools_controller_context_swarm_packet_received(&vehicle.controller, packet.data, packet.size, now)){
+                        vehicle.target_time = packet.frame_time;
+                        updates++;
+                    }
+                }
+            }
+            else if(uniform(random) >= config.loss){
+                Vehicle& vehicle = vehicles[packet.vehicle];
+                if(packet.kind == Packet::SETPOINT){
+                    // As the commander's TYPE_POSITION decoding (link.cpp)
+                    setpoint_t& setpoint = vehicle.setpoint;
+                    setpoint = setpoint_t{};
+                    setpoint.timestamp = xTaskGetTickCount(); // as the firmware's commander
+                    setpoint.mode.x = modeAbs;
+                    setpoint.mode.y = modeAbs;
+                    setpoint.mode.z = modeAbs;
+                    setpoint.mode.yaw = modeAbs;
+                    setpoint.position.x = packet.position[0];
+                    setpoint.position.y = packet.position[1];
+                    setpoint.position.z = packet.position[2];
+                    vehicle.target_time = packet.frame_time;
+                    updates++;
+                }
+                else{
+                    rl_tools_controller_context_packet_received(&vehicle.controller, now);
+                }
+            }
+            in_flight.pop_front();
+        }
+
+        for(auto& vehicle: vehicles){
+            state_t state = {};
+            sensorData_t sensors = {};
+            setpoint_t setpoint = vehicle.setpoint; // the controller may overwrite it
+            control_t control = {};
+            simulation_observe(parameters, vehicle.quadrotor, state, sensors);
+            rl_tools_controller_context_step(&vehicle.controller, &control, &setpoint, &sensors, &state, tick, now, supply.nominal_voltage);
+            float rpm_setpoint[4];
+            for(uint32_t motor_i = 0; motor_i < 4; motor_i++){
+                if(vehicle.controller.motor_output_set){
+                    vehicle.motor_ratio[motor_i] = vehicle.controller.motor_output[motor_i];
+                }
+                rpm_setpoint[motor_i] = quadrotor_motor_rpm(parameters, vehicle.motor_ratio[motor_i] / (float)UINT16_MAX);
+            }
+            const float no_force[3] = {0, 0, 0};
+            quadrotor_step(parameters, vehicle.quadrotor, rpm_setpoint, no_force, dt);
+
+            bool active = vehicle.controller.log_set_motors == 1;
+            if(vehicle.activation < 0 && active){
+                vehicle.activation = now;
+            }
+            if(vehicle.crashed || vehicle.activation < 0 || now < vehicle.activation + config.settle_time * 1e6){
+                vehicle.has_previous_target = false;
+                continue;
+            }
+            scored_ticks++;
+            swarm_setpoint_target_t target = reference(config, vehicle, time);
+            const float* position = vehicle.quadrotor.position;
+            float error = std::sqrt(std::pow(target.position[0] - position[0], 2) + std::pow(target.position[1] - position[1], 2) + std::pow(target.position[2] - position[2], 2));
+            error_square_sum += error * error;
+            if(active){
+                active_ticks++;
+                if(vehicle.controller.inference && vehicle.target_time >= 0){
+                    ages.push_back((float)((now - vehicle.target_time) / 1000));
+                }
+                if(vehicle.controller.inference){
+                    if(vehicle.has_previous_target){
+                        for(int axis_i = 0; axis_i < 3; axis_i++){
+                            float deviation = (vehicle.controller.target_pos[axis_i] - vehicle.previous_target[axis_i]) - (target.position[axis_i] - vehicle.previous_reference[axis_i]);
+                            target_jitter_square_sum += deviation * deviation;
+                        }
+                        target_steps++;
+                    }
+                    memcpy(vehicle.previous_target, vehicle.controller.target_pos, sizeof(vehicle.previous_target));
+                    memcpy(vehicle.previous_reference, target.position, sizeof(vehicle.previous_reference));
+                    vehicle.has_previous_target = true;
+                }
+            }
+            else{
+                vehicle.has_previous_target = false;
+            }
+            if(error > CRASH_ERROR || position[2] < CRASH_HEIGHT){
+                vehicle.crashed = true;
+                result.crashed++;
+            }
+        }
+    }
+    float streaming_time = std::max(0.0f, config.duration - config.trigger_start);
+    result.packets_per_frame = packets_per_frame;
+    result.utilization = streaming_time > 0 ? packets_sent / (streaming_time * config.link_rate) : NAN;
+    result.dropped = packets_sent + packets_dropped > 0 ? (float)packets_dropped / (packets_sent + packets_dropped) : NAN;
+    result.update_rate = streaming_time > 0 ? updates / (streaming_time * vehicle_count) : NAN;
+    double age_sum = 0;
+    for(float age: ages){
+        age_sum += age;
+    }
+    result.age_mean = ages.empty() ? NAN : (float)(age_sum / ages.size());
+    result.age_p99 = (float)percentile(ages, 0.99);
+    result.target_jitter = target_steps > 0 ? (float)std::sqrt(target_jitter_square_sum / target_steps) * 1000 : NAN;
+    result.active = scored_ticks > 0 ? (float)active_ticks / scored_ticks : 0;
+    result.rmse = scored_ticks > 0 ? (float)std::sqrt(error_square_sum / scored_ticks) : NAN;
+    return true;
+}
+
+int main(int argc, char** argv){
+    Config config;
+    if(!parse(argc, argv, config)){
+        usage(argv[0]);
+        return 1;
+    }
+    sim_firmware_set_verbose(config.verbose);
+    if(config.jobs == 0){
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        config.jobs = cpus > 0 ? (unsigned)cpus : 1;
+    }
+    sim_firmware_set_tick_offset(config.tick_offset_ms);
+    sim_firmware_set_battery_voltage(BatteryParameters{}.nominal_voltage);
+    controllerOutOfTreeInit();
+    controllerOutOfTreeTest();
+    for(const auto& param: config.params){
+        if(!sim_firmware_set_param_string(param.c_str())){
+            fprintf(stderr, "unknown parameter assignment: %s\n", param.c_str());
+            return 1;
+        }
+    }
+    std::vector<Result> results(config.vehicles.size());
+    fprintf(stderr, "%zu swarm sizes on %u jobs, %s %.0f frames/s over %.0f packets/s (%.1fms latency, %.1fms jitter, %.1f%% loss), checkpoint %s\n", config.vehicles.size(), config.jobs,
+        config.unicast ? "unicast" : "broadcast", config.rate, config.link_rate, config.link_latency_ms, config.link_jitter_ms, config.loss * 100, rl_tools_get_checkpoint_name());
+    fflush(nullptr);
+    std::atomic<size_t> next_size{0};
+    std::vector<std::thread> jobs;
+    for(unsigned job_i = 0; job_i < std::min<size_t>(config.jobs, config.vehicles.size()); job_i++){
+        jobs.emplace_back([&](){
+            for(size_t size_i; (size_i = next_size++) < config.vehicles.size();){
+                Result& result = results[size_i];
+                result.done = fly(config, config.vehicles[size_i], result);
+            }
+        });
+    }
+    for(auto& job: jobs){
+        job.join();
+    }
+
+    printf("%8s %8s %8s %8s %9s %9s %9s %9s %8s %8s %8s %5s\n", "vehicles", "packets", "link", "dropped", "update", "age", "age_p99", "tjitter", "active", "rmse", "crashed", "pass");
+    unsigned achievable = 0, errors = 0;
+    for(size_t size_i = 0; size_i < config.vehicles.size(); size_i++){
+        const Result& result = results[size_i];
+        unsigned vehicle_count = config.vehicles[size_i];
+        if(!result.done){
+            fprintf(stderr, "%u vehicles: run failed\n", vehicle_count);
+            errors++;
+            continue;
+        }
+        bool pass = result.age_p99 <= config.max_age_ms && result.active >= 0.99f && result.crashed == 0;
+        if(pass){
+            achievable = std::max(achievable, vehicle_count);
+        }
+        printf("%8u %8u %7.1f%% %7.1f%% %7.1fHz %7.1fms %7.1fms %7.2fmm %7.1f%% %8.4f %8u %5s\n", vehicle_count, result.packets_per_frame, result.utilization * 100, result.dropped * 100,
+            result.update_rate, result.age_mean, result.age_p99, result.target_jitter, result.active * 100, result.rmse, result.crashed, pass ? "yes" : "no");
+    }
+    unsigned full_rate = (unsigned)(config.link_rate / config.rate) * SWARM_SETPOINT_SLOTS;
+    unsigned unicast = (unsigned)(config.link_rate / (config.rate * 2));
+    printf("Achievable swarm size per radio: %u (p99 target age <= %.0fms, all vehicles in control)\n", achievable, config.max_age_ms);
+    printf("Every target in every frame: %u vehicles; individually addressed setpoint + trigger packets: %u vehicles\n", full_rate, unicast);
+    return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,568 @@
+// System identification of the motor and thrust model (quadrotor.h) from flight logs
+// Fits the thrust and torque constants, the motor time constant, the roll/pitch inertia and the curvature of the
+// RPM-vs-command curve to the accelerometer and gyro of CSV or uSD-card logs of policy flights (acc.*, gyro.*,
+// rltm.m1..m4 and rltrp.sm, e.g. meta/config_sysid.txt). The flight is cut into segments on which the motors are
+// simulated from the logged commands; the body z specific force is compared with acc.z and the angular velocity
+// integrated over a short horizon from the logged one with gyro.*. Levenberg-Marquardt on all segments, whose
+// residuals and forward-difference Jacobians are evaluated in parallel. The result is written as a header
+// (-DSYSID_CONFIG) for the host simulation (quadrotor.h) and the motor mapping (motor_curve_linearize).
+// Mass, max RPM, yaw inertia and rotor geometry are not identifiable from these signals and stay at quadrotor.h.
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "flight_log.h"
+#include "quadrotor.h"
+
+enum Parameter{THRUST_CONSTANT, TORQUE_CONSTANT, MOTOR_TIME_CONSTANT, INERTIA_X, INERTIA_Y, RPM_CURVATURE, PARAMETERS};
+static const char* PARAMETER_NAMES[PARAMETERS] = {"thrust_constant", "torque_constant", "motor_time_constant", "inertia_x", "inertia_y", "rpm_curvature"};
+static const char* PARAMETER_MACROS[PARAMETERS] = {"SYSID_THRUST_CONSTANT", "SYSID_TORQUE_CONSTANT", "SYSID_MOTOR_TIME_CONSTANT", "SYSID_INERTIA_X", "SYSID_INERTIA_Y", "SYSID_RPM_CURVATURE"};
+static const char* PARAMETER_UNITS[PARAMETERS] = {"N / RPM^2", "Nm / N", "s", "kg m^2", "kg m^2", "rpm / max_rpm = c + b (c^2 - c)"};
+// All but the curvature are fitted in log space (positive, relative steps)
+constexpr int CURVATURE_LIMIT_PERCENT = 95; // |b| < 1 keeps the curve monotonic on 0..1
+constexpr double JACOBIAN_STEP = 1e-5;
+constexpr int CHANNELS = 4; // residuals per sample: acc.z, gyro.x, gyro.y, gyro.z
+
+struct Config{
+    std::vector<std::string> inputs;
+    const char* output = "sysid.h";
+    float period = 5; // [ms]
+    float segment = 1; // [s]
+    float warmup = 1; // [s]
+    float horizon = 50; // [ms]
+    float max_gap = 50; // [ms]
+    float min_height = 0.05f; // [m]
+    unsigned iterations = 100;
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+    bool gyro_rad = false;
+};
+
+static void usage(const char* name){
+    fprintf(stderr,
+        "usage: %s [options] <input> [<input> ...]\n"
+        "  input: a CSV or uSD-card log of a flight with the policy in control (acc.*, gyro.*, rltm.m1..m4, and\n"
+        "         rltrp.sm or set_motors to select the policy's samples, stateEstimate.z for --min-height); logs\n"
+        "         recorded together are joined with commas and aligned by their timestamps\n"
+        "  --output <file>           identified parameters as header (default sysid.h)\n"
+        "  --period <ms>             log resampling period (default 5)\n"
+        "  --segment <s>             length of the segments fitted in parallel (default 1)\n"
+        "  --warmup <s>              motor simulation before each segment, from the steady state of its command (default 1)\n"
+        "  --horizon <ms>            the angular velocity is predicted this far from the logged one (default 50)\n"
+        "  --max-gap <ms>            longer gaps between log samples end the segment (default 50)\n"
+        "  --min-height <m>          samples below are in ground effect or on the ground and skipped (default 0.05, needs\n"
+        "                            stateEstimate.z)\n"
+        "  --iterations <n>          Levenberg-Marquardt iterations (default 100)\n"
+        "  --jobs <n>                threads evaluating the segments (default: online CPUs)\n"
+        "  --gyro-rad                the log's gyro.* columns are rad/s (the controller's group), not deg/s\n", name);
+}
+
+static bool parse(int argc, char** argv, Config& config){
+    for(int arg_i = 1; arg_i < argc; arg_i++){
+        std::string arg = argv[arg_i];
+        bool has_value = arg_i + 1 < argc;
+        if(arg == "--gyro-rad"){
+            config.gyro_rad = true;
+        }
+        else if(has_value && arg == "--output"){
+            config.output = argv[++arg_i];
+        }
+        else if(has_value && arg == "--period"){
+            config.period = atof(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--segment"){
+            config.segment = atof(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--warmup"){
+            config.warmup = atof(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--horizon"){
+            config.horizon = atof(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--max-gap"){
+            config.max_gap = atof(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--min-height"){
+            config.min_height = atof(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--iterations"){
+            config.iterations = (unsigned)atoi(argv[++arg_i]);
+        }
+        else if(has_value && arg == "--jobs"){
+            config.jobs = (unsigned)atoi(argv[++arg_i]);
+        }
+        else if(arg[0] != '-'){
+            config.inputs.push_back(arg);
+        }
+        else{
+            return false;
+        }
+    }
+    return !config.inputs.empty() && config.period > 0 && config.segment * 1000 >= config.period && config.horizon >= config.period && config.warmup * 1000 >= config.horizon && config.jobs > 0;
+}
+
+// Resampled stretch of policy flight without gaps
+struct Run{
+    // Per sample and motor: mean of rltm / UINT16_MAX (the fraction of max RPM commanded) and of its square until the
+    // next sample, which determine the mean RPM setpoint of the quadratic curve exactly
+    std::vector<float> command;
+    std::vector<float> command_square;
+    std::vector<float> specific_force; // per sample: body z [m/s^2]
+    std::vector<float> angular_velocity; // per sample and axis: body [rad/s]
+    size_t size() const{
+        return specific_force.size();
+    }
+};
+
+// Residuals are taken on [begin, end) of a run, the motors are simulated from warmup_begin on
+struct Segment{
+    const Run* run;
+    size_t warmup_begin, begin, end;
+};
+
+struct Problem{
+    Config config;
+    QuadrotorParameters parameters; // fixed quantities and the initial guess
+    std::vector<Run> runs;
+    std::vector<Segment> segments;
+    unsigned substeps; // motor integration steps per sample (<= 1 ms as in the simulation)
+    size_t horizon_steps;
+    double scale[CHANNELS] = {1, 1, 1, 1}; // residual weights: RMS per channel at the initial guess
+};
+
+static bool wanted(const std::string& name){
+    static const char* PREFIXES[] = {"acc.", "gyro.", "rltm."};
+    if(name == "set_motors" || name == "rltrp.sm" || name == "stateEstimate.z"){
+        return true;
+    }
+    for(const char* prefix: PREFIXES){
+        if(name.compare(0, strlen(prefix), prefix) == 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool read_flight(Problem& problem, const std::string& input){
+    const Config& config = problem.config;
+    FlightLog log;
+    if(!flight_log_read(input, log, wanted)){
+        return false;
+    }
+    FlightLogChannel* acc = nullptr;
+    FlightLogChannel* gyro[3] = {};
+    FlightLogChannel* command[4] = {};
+    FlightLogChannel* policy = nullptr;
+    FlightLogChannel* height = nullptr;
+    const char* missing = nullptr;
+    if(!flight_log_find(log, {{"acc.z"}}, &acc)){
+        missing = "acc.z";
+    }
+    else if(!flight_log_find(log, {{"gyro.x", "gyro.y", "gyro.z"}}, gyro)){
+        missing = "gyro.x/y/z";
+    }
+    else if(!flight_log_find(log, {{"rltm.m1", "rltm.m2", "rltm.m3", "rltm.m4"}}, command)){
+        missing = "rltm.m1..m4";
+    }
+    if(missing != nullptr){
+        fprintf(stderr, "%s: no %s columns\n", input.c_str(), missing);
+        return false;
+    }
+    if(!flight_log_find(log, {{"set_motors"}, {"rltrp.sm"}}, &policy)){
+        fprintf(stderr, "%s: warning: no rltrp.sm or set_motors column, all samples are taken as flown by the policy\n", input.c_str());
+    }
+    if(config.min_height > 0 && !flight_log_find(log, {{"stateEstimate.z"}}, &height)){
+        fprintf(stderr, "%s: warning: no stateEstimate.z column, --min-height is not applied\n", input.c_str());
+    }
+    FlightLogChannel* signals[8] = {acc, gyro[0], gyro[1], gyro[2], command[0], command[1], command[2], command[3]};
+    double start, end;
+    flight_log_range(signals, 8, start, end);
+
+    const float gravity = problem.parameters.gravity;
+    const float gyro_scale = config.gyro_rad ? 1.0f : (float)M_PI / 180;
+    size_t runs = problem.runs.size();
+    unsigned samples = 0, skipped = 0;
+    Run run;
+    auto close_run = [&](){
+        if(run.size() > 0){
+            problem.runs.push_back(std::move(run));
+            run = Run{};
+        }
+    };
+    for(uint64_t step_i = 0; start + step_i * (double)config.period <= end; step_i++){
+        double time = start + step_i * (double)config.period;
+        float values[8], squares[4], flag = 1, z = INFINITY;
+        bool valid = flight_log_sample_all(signals, 4, time, config.max_gap, false, values);
+        for(int motor_i = 0; motor_i < 4; motor_i++){
+            valid = flight_log_average(command[motor_i], time, time + config.period, config.max_gap, values[4 + motor_i], &squares[motor_i]) && valid;
+        }
+        valid = (policy == nullptr || flight_log_sample(policy, time, config.max_gap, true, flag)) && valid;
+        valid = (height == nullptr || flight_log_sample(height, time, config.max_gap, false, z)) && valid;
+        if(!valid || flag == 0 || z < config.min_height){
+            close_run();
+            skipped++;
+            continue;
+        }
+        run.specific_force.push_back(values[0] * gravity);
+        for(int axis_i = 0; axis_i < 3; axis_i++){
+            run.angular_velocity.push_back(values[1 + axis_i] * gyro_scale);
+        }
+        for(int motor_i = 0; motor_i < 4; motor_i++){
+            run.command.push_back(values[4 + motor_i] / UINT16_MAX);
+            run.command_square.push_back(squares[motor_i] / ((float)UINT16_MAX * UINT16_MAX));
+        }
+        samples++;
+    }
+    close_run();
+    printf("%s: %u samples of %gms in %zu runs of policy flight, %u skipped\n", input.c_str(), samples, config.period, problem.runs.size() - runs, skipped);
+    return true;
+}
+
+static void make_segments(Problem& problem){
+    const Config& config = problem.config;
+    size_t warmup_steps = (size_t)std::lround(config.warmup * 1000 / config.period);
+    size_t segment_steps = std::max<size_t>(1, (size_t)std::lround(config.segment * 1000 / config.period));
+    for(const Run& run: problem.runs){
+        for(size_t begin = warmup_steps; begin < run.size(); begin += segment_steps){
+            problem.segments.push_back({&run, begin - warmup_steps, begin, std::min(begin + segment_steps, run.size())});
+        }
+    }
+}
+
+static void decode(const double* theta, double* values){
+    for(int parameter_i = 0; parameter_i < PARAMETERS; parameter_i++){
+        values[parameter_i] = parameter_i == RPM_CURVATURE ? theta[parameter_i] : std::exp(theta[parameter_i]);
+    }
+}
+
+// Scaled residuals of a segment (CHANNELS per sample of [begin, end))
+static void predict(const Problem& problem, const Segment& segment, const double* theta, std::vector<double>& residuals){
+    const QuadrotorParameters& fixed = problem.parameters;
+    double values[PARAMETERS];
+    decode(theta, values);
+    const double J[3] = {values[INERTIA_X], values[INERTIA_Y], fixed.inertia[2]};
+    const double T = problem.config.period / 1000.0;
+    const double dt = T / problem.substeps;
+    const double alpha = std::min(1.0, dt / values[MOTOR_TIME_CONSTANT]);
+    const double curvature = values[RPM_CURVATURE];
+    const Run& run = *segment.run;
+    auto rpm_setpoint = [&](size_t index){
+        double c = run.command[index], c2 = run.command_square[index];
+        return std::min((double)fixed.max_rpm, std::max(0.0, (c + curvature * (c2 - c)) * fixed.max_rpm));
+    };
+    double rpm[4];
+    for(int motor_i = 0; motor_i < 4; motor_i++){
+        rpm[motor_i] = rpm_setpoint(segment.warmup_begin * 4 + motor_i);
+    }
+    // Integral of the angular acceleration from warmup_begin to each sample
+    std::vector<double> integral((segment.end - segment.warmup_begin) * 3);
+    double sum[3] = {0, 0, 0};
+    residuals.clear();
+    for(size_t sample_i = segment.warmup_begin; sample_i < segment.end; sample_i++){
+        double w[3];
+        for(int axis_i = 0; axis_i < 3; axis_i++){
+            w[axis_i] = run.angular_velocity[sample_i * 3 + axis_i];
+            integral[(sample_i - segment.warmup_begin) * 3 + axis_i] = sum[axis_i];
+        }
+        if(sample_i >= segment.begin){
+            double thrust = 0;
+            for(int motor_i = 0; motor_i < 4; motor_i++){
+                thrust += values[THRUST_CONSTANT] * rpm[motor_i] * rpm[motor_i];
+            }
+            residuals.push_back((thrust / fixed.mass - run.specific_force[sample_i]) / problem.scale[0]);
+            size_t past = sample_i - problem.horizon_steps - segment.warmup_begin;
+            for(int axis_i = 0; axis_i < 3; axis_i++){
+                double predicted = run.angular_velocity[(sample_i - problem.horizon_steps) * 3 + axis_i] + sum[axis_i] - integral[past * 3 + axis_i];
+                residuals.push_back((predicted - w[axis_i]) / problem.scale[1 + axis_i]);
+            }
+        }
+        // Motor lag and the resulting rotation up to the next sample (gyroscopic term from the logged rate)
+        double setpoint[4];
+        for(int motor_i = 0; motor_i < 4; motor_i++){
+            setpoint[motor_i] = rpm_setpoint(sample_i * 4 + motor_i);
+        }
+        double gyroscopic[3] = {
+            w[1] * J[2] * w[2] - w[2] * J[1] * w[1],
+            w[2] * J[0] * w[0] - w[0] * J[2] * w[2],
+            w[0] * J[1] * w[1] - w[1] * J[0] * w[0],
+        };
+        for(unsigned substep_i = 0; substep_i < problem.substeps; substep_i++){
+            double torque[3] = {0, 0, 0};
+            for(int motor_i = 0; motor_i < 4; motor_i++){
+                rpm[motor_i] += alpha * (setpoint[motor_i] - rpm[motor_i]);
+                double thrust = values[THRUST_CONSTANT] * rpm[motor_i] * rpm[motor_i];
+                torque[0] += fixed.rotor_positions[motor_i][1] * thrust;
+                torque[1] -= fixed.rotor_positions[motor_i][0] * thrust;
+                torque[2] += fixed.rotor_torque_directions[motor_i] * values[TORQUE_CONSTANT] * thrust;
+            }
+            for(int axis_i = 0; axis_i < 3; axis_i++){
+                sum[axis_i] += (torque[axis_i] - gyroscopic[axis_i]) / J[axis_i] * dt;
+            }
+        }
+    }
+}
+
+// Normal equations of the Gauss-Newton step: cost = sum r^2, JtJ, Jtr
+struct Normal{
+    double cost = 0;
+    double jtj[PARAMETERS][PARAMETERS] = {};
+    double jtr[PARAMETERS] = {};
+    size_t residuals = 0;
+};
+
+static void accumulate(const Problem& problem, const Segment& segment, const double* theta, bool jacobian, Normal& normal){
+    std::vector<double> residuals, perturbed;
+    predict(problem, segment, theta, residuals);
+    for(double residual: residuals){
+        normal.cost += residual * residual;
+    }
+    normal.residuals += residuals.size();
+    if(!jacobian){
+        return;
+    }
+    std::vector<double> columns[PARAMETERS];
+    for(int parameter_i = 0; parameter_i < PARAMETERS; parameter_i++){
+        double theta_step[PARAMETERS];
+        memcpy(theta_step, theta, sizeof(theta_step));
+        theta_step[parameter_i] += JACOBIAN_STEP;
+        predict(problem, segment, theta_step, perturbed);
+        columns[parameter_i].resize(residuals.size());
+        for(size_t residual_i = 0; residual_i < residuals.size(); residual_i++){
+            columns[parameter_i][residual_i] = (perturbed[residual_i] - residuals[residual_i]) / JACOBIAN_STEP;
+        }
+    }
+    for(int row_i = 0; row_i < PARAMETERS; row_i++){
+        for(size_t residual_i = 0; residual_i < residuals.size(); residual_i++){
+            normal.jtr[row_i] += columns[row_i][residual_i] * residuals[residual_i];
+        }
+        for(int column_i = row_i; column_i < PARAMETERS; column_i++){
+            double dot = 0;
+            for(size_t residual_i = 0; residual_i < residuals.size(); residual_i++){
+                dot += columns[row_i][residual_i] * columns[column_i][residual_i];
+            }
+            normal.jtj[row_i][column_i] += dot;
+            normal.jtj[column_i][row_i] += column_i != row_i ? dot : 0;
+        }
+    }
+}
+
+// Sums the segments' normal equations over config.jobs threads
+static Normal evaluate(const Problem& problem, const double* theta, bool jacobian){
+    std::vector<Normal> partial(std::min<size_t>(problem.config.jobs, problem.segments.size()));
+    std::atomic<size_t> next{0};
+    auto work = [&](Normal& normal){
+        for(size_t segment_i = next++; segment_i < problem.segments.size(); segment_i = next++){
+            accumulate(problem, problem.segments[segment_i], theta, jacobian, normal);
+        }
+    };
+    std::vector<std::thread> threads;
+    for(size_t thread_i = 1; thread_i < partial.size(); thread_i++){
+        threads.emplace_back(work, std::ref(partial[thread_i]));
+    }
+    work(partial[0]);
+    for(auto& thread: threads){
+        thread.join();
+    }
+    Normal total;
+    for(const Normal& normal: partial){
+        total.cost += normal.cost;
+        total.residuals += normal.residuals;
+        for(int row_i = 0; row_i < PARAMETERS; row_i++){
+            total.jtr[row_i] += normal.jtr[row_i];
+            for(int column_i = 0; column_i < PARAMETERS; column_i++){
+                total.jtj[row_i][column_i] += normal.jtj[row_i][column_i];
+            }
+        }
+    }
+    return total;
+}
+
+// Gaussian elimination with partial pivoting, false if A is singular
+static bool solve(const double A[PARAMETERS][PARAMETERS], const double* b, double* x){
+    double M[PARAMETERS][PARAMETERS + 1];
+    for(int row_i = 0; row_i < PARAMETERS; row_i++){
+        memcpy(M[row_i], A[row_i], sizeof(A[row_i]));
+        M[row_i][PARAMETERS] = b[row_i];
+    }
+    for(int column_i = 0; column_i < PARAMETERS; column_i++){
+        int pivot = column_i;
+        for(int row_i = column_i + 1; row_i < PARAMETERS; row_i++){
+            pivot = std::abs(M[row_i][column_i]) > std::abs(M[pivot][column_i]) ? row_i : pivot;
+        }
+        if(!(std::abs(M[pivot][column_i]) > 1e-300)){
+            return false;
+        }
+        std::swap(M[pivot], M[column_i]);
+        for(int row_i = column_i + 1; row_i < PARAMETERS; row_i++){
+            double factor = M[row_i][column_i] / M[column_i][column_i];
+            for(int k = column_i; k <= PARAMETERS; k++){
+                M[row_i][k] -= factor * M[column_i][k];
+            }
+        }
+    }
+    for(int row_i = PARAMETERS - 1; row_i >= 0; row_i--){
+        double value = M[row_i][PARAMETERS];
+        for(int k = row_i + 1; k < PARAMETERS; k++){
+            value -= M[row_i][k] * x[k];
+        }
+        x[row_i] = value / M[row_i][row_i];
+    }
+    return true;
+}
+
+// Unscaled RMS per channel
+static void channel_rms(const Problem& problem, const double* theta, double* rms){
+    double sum[CHANNELS] = {};
+    size_t count = 0;
+    std::vector<double> residuals;
+    for(const Segment& segment: problem.segments){
+        predict(problem, segment, theta, residuals);
+        for(size_t residual_i = 0; residual_i < residuals.size(); residual_i++){
+            double residual = residuals[residual_i] * problem.scale[residual_i % CHANNELS];
+            sum[residual_i % CHANNELS] += residual * residual;
+        }
+        count += residuals.size() / CHANNELS;
+    }
+    for(int channel_i = 0; channel_i < CHANNELS; channel_i++){
+        rms[channel_i] = count > 0 ? std::sqrt(sum[channel_i] / count) : 0;
+    }
+}
+
+static bool write_config(const Problem& problem, const double* values, const double* errors, const double* rms){
+    const Config& config = problem.config;
+    FILE* file = fopen(config.output, "w");
+    if(file == nullptr){
+        return false;
+    }
+    std::string inputs;
+    for(const auto& input: config.inputs){
+        inputs += (inputs.empty() ? "" : " ") + input;
+    }
+    size_t samples = 0;
+    for(const Segment& segment: problem.segments){
+        samples += segment.end - segment.begin;
+    }
+    fprintf(file, "// Motor and thrust model for sim/quadrotor.h and motor_curve.c (-DSYSID_CONFIG), written by sim/build/sysid from %s\n", inputs.c_str());
+    fprintf(file, "// %zu segments, %.1fs of policy flight; residual RMS acc.z %.3g m/s^2, gyro %.3g/%.3g/%.3g rad/s over %gms\n",
+        problem.segments.size(), samples * config.period / 1000, rms[0], rms[1], rms[2], rms[3], config.horizon);
+    fprintf(file, "// Fixed: mass %g kg, max RPM %g, inertia z %g kg m^2\n", problem.parameters.mass, problem.parameters.max_rpm, problem.parameters.inertia[2]);
+    for(int parameter_i = 0; parameter_i < PARAMETERS; parameter_i++){
+        if(parameter_i == RPM_CURVATURE){
+            fprintf(file, "#define %s %.6ef // %s, +-%.2g\n", PARAMETER_MACROS[parameter_i], values[parameter_i], PARAMETER_UNITS[parameter_i], errors[parameter_i]);
+        }
+        else{
+            fprintf(file, "#define %s %.6ef // %s, +-%.2g%%\n", PARAMETER_MACROS[parameter_i], values[parameter_i], PARAMETER_UNITS[parameter_i], errors[parameter_i] * 100);
+        }
+    }
+    return fclose(file) == 0;
+}
+
+int main(int argc, char** argv){
+    Problem problem;
+    if(!parse(argc, argv, problem.config)){
+        usage(argv[0]);
+        return 1;
+    }
+    const Config& config = problem.config;
+    for(const auto& input: config.inputs){
+        if(!read_flight(problem, input)){
+            return 1;
+        }
+    }
+    make_segments(problem);
+    problem.substeps = (unsigned)std::ceil(config.period - 1e-3f);
+    problem.substeps = std::max(1u, problem.substeps);
+    problem.horizon_steps = (size_t)std::lround(config.horizon / config.period);
+    size_t samples = 0;
+    for(const Segment& segment: problem.segments){
+        samples += segment.end - segment.begin;
+    }
+    if(samples * CHANNELS < 10 * PARAMETERS){
+        fprintf(stderr, "not enough policy flight: %zu samples after the --warmup of every run\n", samples);
+        return 1;
+    }
+
+    const QuadrotorParameters& initial = problem.parameters;
+    double theta[PARAMETERS] = {
+        std::log(initial.thrust_constant), std::log(initial.torque_constant), std::log(initial.motor_time_constant),
+        std::log(initial.inertia[0]), std::log(initial.inertia[1]), initial.rpm_curvature,
+    };
+    double initial_values[PARAMETERS];
+    decode(theta, initial_values);
+    // Channels weighted by their RMS at the initial guess
+    double rms[CHANNELS];
+    channel_rms(problem, theta, rms);
+    for(int channel_i = 0; channel_i < CHANNELS; channel_i++){
+        problem.scale[channel_i] = std::max(rms[channel_i], 1e-6);
+    }
+
+    Normal normal = evaluate(problem, theta, true);
+    printf("%zu segments, %zu samples, %u threads; initial cost %.6g\n", problem.segments.size(), samples, (unsigned)std::min<size_t>(config.jobs, problem.segments.size()), normal.cost);
+    double lambda = 1e-3;
+    unsigned iteration = 0;
+    for(; iteration < config.iterations; iteration++){
+        double A[PARAMETERS][PARAMETERS], b[PARAMETERS], step[PARAMETERS];
+        for(int row_i = 0; row_i < PARAMETERS; row_i++){
+            for(int column_i = 0; column_i < PARAMETERS; column_i++){
+                A[row_i][column_i] = normal.jtj[row_i][column_i] * (row_i == column_i ? 1 + lambda : 1);
+            }
+            b[row_i] = -normal.jtr[row_i];
+        }
+        if(!solve(A, b, step)){
+            lambda *= 10;
+            continue;
+        }
+        double candidate[PARAMETERS];
+        for(int parameter_i = 0; parameter_i < PARAMETERS; parameter_i++){
+            candidate[parameter_i] = theta[parameter_i] + step[parameter_i];
+        }
+        candidate[RPM_CURVATURE] = std::min(CURVATURE_LIMIT_PERCENT / 100.0, std::max(-CURVATURE_LIMIT_PERCENT / 100.0, candidate[RPM_CURVATURE]));
+        Normal trial = evaluate(problem, candidate, false);
+        if(trial.cost < normal.cost){
+            double improvement = (normal.cost - trial.cost) / normal.cost;
+            memcpy(theta, candidate, sizeof(theta));
+            normal = evaluate(problem, theta, true);
+            lambda = std::max(lambda / 3, 1e-12);
+            if(improvement < 1e-10){
+                break;
+            }
+        }
+        else{
+            lambda *= 4;
+            if(lambda > 1e12){
+                break;
+            }
+        }
+    }
+
+    // Standard errors from the inverse of JtJ scaled by the residual variance (relative for the log-space parameters)
+    double values[PARAMETERS], errors[PARAMETERS];
+    decode(theta, values);
+    double variance = normal.cost / std::max<double>(1, (double)normal.residuals - PARAMETERS);
+    for(int parameter_i = 0; parameter_i < PARAMETERS; parameter_i++){
+        double unit[PARAMETERS] = {}, column[PARAMETERS];
+        unit[parameter_i] = 1;
+        errors[parameter_i] = solve(normal.jtj, unit, column) ? std::sqrt(std::max(0.0, column[parameter_i] * variance)) : INFINITY;
+    }
+    channel_rms(problem, theta, rms);
+    printf("%u iterations, cost %.6g; residual RMS acc.z %.3g m/s^2, gyro %.3g/%.3g/%.3g rad/s over %gms\n", iteration, normal.cost, rms[0], rms[1], rms[2], rms[3], config.horizon);
+    for(int parameter_i = 0; parameter_i < PARAMETERS; parameter_i++){
+        if(parameter_i == RPM_CURVATURE){
+            printf("  %-20s %12.6g -> %12.6g  +-%.2g\n", PARAMETER_NAMES[parameter_i], initial_values[parameter_i], values[parameter_i], errors[parameter_i]);
+        }
+        else{
+            printf("  %-20s %12.6g -> %12.6g  +-%.2g%%\n", PARAMETER_NAMES[parameter_i], initial_values[parameter_i], values[parameter_i], errors[parameter_i] * 100);
+        }
+    }
+    if(!write_config(problem, values, errors, rms)){
+        perror(config.output);
+        return 1;
+    }
+    printf("written to %s (make SYSID=%s, -DSYSID_CONFIG='\"%s\"')\n", config.output, config.output, config.output);
+    return 0;
+}
@@ -0,0 +1,203 @@
+#include "telemetry_bus.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+extern "C" {
+#include "firmware/motors.h"
+#include "firmware/math3d.h"
+#include "rl_tools_controller.h"
+}
+
+static_assert(sizeof(TelemetrySlot) % 8 == 0, "TelemetrySlot has to keep the sequence numbers 8-byte aligned");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the sequence numbers are shared between processes");
+
+static size_t bus_size(uint32_t capacity){
+    return sizeof(TelemetryBusHeader) + (size_t)capacity * sizeof(TelemetrySlot);
+}
+
+bool telemetry_bus_create(TelemetryBus& bus, const char* name, uint32_t capacity){
+    if(capacity == 0 || (capacity & (capacity - 1)) != 0){
+        fprintf(stderr, "%s: capacity has to be a power of two\n", name);
+        return false;
+    }
+    // Consumers still attached to a previous bus of the same name see it closed and re-attach to the new one
+    int previous = shm_open(name, O_RDWR, 0);
+    if(previous >= 0){
+        struct stat info;
+        if(fstat(previous, &info) == 0 && (size_t)info.st_size >= sizeof(TelemetryBusHeader)){
+            void* memory = mmap(nullptr, sizeof(TelemetryBusHeader), PROT_READ | PROT_WRITE, MAP_SHARED, previous, 0);
+            if(memory != MAP_FAILED){
+                ((TelemetryBusHeader*)memory)->closed = 1;
+                munmap(memory, sizeof(TelemetryBusHeader));
+            }
+        }
+        close(previous);
+        shm_unlink(name);
+    }
+    bus = TelemetryBus{};
+    bus.size = bus_size(capacity);
+    bus.fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if(bus.fd < 0 || ftruncate(bus.fd, bus.size) != 0){
+        perror(name);
+        telemetry_bus_close(bus);
+        return false;
+    }
+    bus.memory = mmap(nullptr, bus.size, PROT_READ | PROT_WRITE, MAP_SHARED, bus.fd, 0);
+    if(bus.memory == MAP_FAILED){
+        perror(name);
+        bus.memory = nullptr;
+        telemetry_bus_close(bus);
+        return false;
+    }
+    // ftruncate zero-fills: write_index 0 and all sequences 0 (never a valid "complete" value 2 * index + 2)
+    bus.header = (TelemetryBusHeader*)bus.memory;
+    bus.slots = (TelemetrySlot*)((uint8_t*)bus.memory + sizeof(TelemetryBusHeader));
+    bus.header->frame_size = sizeof(TelemetryFrame);
+    bus.header->capacity = capacity;
+    bus.header->version = TELEMETRY_BUS_VERSION;
+    std::atomic_thread_fence(std::memory_order_release);
+    bus.header->magic = TELEMETRY_BUS_MAGIC;
+    return true;
+}
+
+TelemetryFrame* telemetry_bus_begin(TelemetryBus& bus){
+    TelemetrySlot& slot = bus.slots[bus.index & (bus.header->capacity - 1)];
+    slot.sequence.store(2 * bus.index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return &slot.frame;
+}
+
+void telemetry_bus_commit(TelemetryBus& bus){
+    TelemetrySlot& slot = bus.slots[bus.index & (bus.header->capacity - 1)];
+    slot.sequence.store(2 * bus.index + 2, std::memory_order_release);
+    bus.index++;
+    bus.header->write_index.store(bus.index, std::memory_order_release);
+}
+
+void telemetry_bus_publish_controller(TelemetryBus& bus, uint32_t tick, uint64_t time_us, const state_t& state, const sensorData_t& sensors, float battery_voltage, float controller_us){
+    const rl_tools_controller_context_t* controller = rl_tools_controller_context_global();
+    TelemetryFrame* frame = telemetry_bus_begin(bus);
+    frame->tick = tick;
+    frame->time_us = time_us;
+    frame->position[0] = state.position.x;
+    frame->position[1] = state.position.y;
+    frame->position[2] = state.position.z;
+    frame->linear_velocity[0] = state.velocity.x;
+    frame->linear_velocity[1] = state.velocity.y;
+    frame->linear_velocity[2] = state.velocity.z;
+    frame->orientation[0] = state.attitudeQuaternion.w;
+    frame->orientation[1] = state.attitudeQuaternion.x;
+    frame->orientation[2] = state.attitudeQuaternion.y;
+    frame->orientation[3] = state.attitudeQuaternion.z;
+    frame->angular_velocity[0] = radians(sensors.gyro.x);
+    frame->angular_velocity[1] = radians(sensors.gyro.y);
+    frame->angular_velocity[2] = radians(sensors.gyro.z);
+    memcpy(frame->state_input, controller->state_input, sizeof(frame->state_input));
+    memcpy(frame->action_output, controller->action_output, sizeof(frame->action_output));
+    memcpy(frame->target_pos, controller->target_pos, sizeof(frame->target_pos));
+    memcpy(frame->motor_cmd, controller->motor_cmd, sizeof(frame->motor_cmd));
+    for(uint32_t motor_i = 0; motor_i < 4; motor_i++){
+        frame->motor_ratio[motor_i] = motorsGetRatio(motor_i);
+    }
+    frame->battery_voltage = battery_voltage;
+    frame->controller_us = controller_us;
+    frame->flags = (controller->log_set_motors ? TELEMETRY_FLAG_SET_MOTORS : 0) | (controller->inference ? TELEMETRY_FLAG_INFERENCE : 0);
+    telemetry_bus_commit(bus);
+}
+
+void telemetry_bus_close(TelemetryBus& bus){
+    if(bus.header != nullptr){
+        std::atomic_thread_fence(std::memory_order_release);
+        bus.header->closed = 1;
+    }
+    if(bus.memory != nullptr){
+        munmap(bus.memory, bus.size);
+    }
+    if(bus.fd >= 0){
+        close(bus.fd);
+    }
+    bus = TelemetryBus{};
+}
+
+bool telemetry_bus_attach(TelemetryBusReader& reader, const char* name, bool history){
+    reader = TelemetryBusReader{};
+    reader.fd = shm_open(name, O_RDONLY, 0);
+    if(reader.fd < 0){
+        perror(name);
+        return false;
+    }
+    struct stat info;
+    if(fstat(reader.fd, &info) != 0 || (size_t)info.st_size < sizeof(TelemetryBusHeader)){
+        fprintf(stderr, "%s: not a telemetry bus\n", name);
+        telemetry_bus_detach(reader);
+        return false;
+    }
+    reader.size = info.st_size;
+    reader.memory = mmap(nullptr, reader.size, PROT_READ, MAP_SHARED, reader.fd, 0);
+    if(reader.memory == MAP_FAILED){
+        perror(name);
+        reader.memory = nullptr;
+        telemetry_bus_detach(reader);
+        return false;
+    }
+    reader.header = (const TelemetryBusHeader*)reader.memory;
+    reader.slots = (const TelemetrySlot*)((const uint8_t*)reader.memory + sizeof(TelemetryBusHeader));
+    if(reader.header->magic != TELEMETRY_BUS_MAGIC || reader.header->version != TELEMETRY_BUS_VERSION || reader.header->frame_size != sizeof(TelemetryFrame) || reader.size != bus_size(reader.header->capacity)){
+        fprintf(stderr, "%s: not a version %d telemetry bus\n", name, TELEMETRY_BUS_VERSION);
+        telemetry_bus_detach(reader);
+        return false;
+    }
+    uint64_t write_index = reader.header->write_index.load(std::memory_order_acquire);
+    reader.cursor = write_index;
+    if(history){
+        reader.cursor = write_index > reader.header->capacity ? write_index - reader.header->capacity : 0;
+    }
+    return true;
+}
+
+size_t telemetry_bus_read(TelemetryBusReader& reader, TelemetryFrame* frames, size_t max_frames){
+    uint64_t write_index = reader.header->write_index.load(std::memory_order_acquire);
+    uint64_t capacity = reader.header->capacity;
+    if(write_index - reader.cursor > capacity){
+        reader.dropped += write_index - capacity - reader.cursor;
+        reader.cursor = write_index - capacity;
+    }
+    size_t count = 0;
+    while(reader.cursor < write_index && count < max_frames){
+        const TelemetrySlot& slot = reader.slots[reader.cursor & (capacity - 1)];
+        uint64_t expected = 2 * reader.cursor + 2;
+        reader.cursor++;
+        if(slot.sequence.load(std::memory_order_acquire) != expected){
+            reader.dropped++; // already being overwritten
+            continue;
+        }
+        memcpy(&frames[count], &slot.frame, sizeof(TelemetryFrame));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot.sequence.load(std::memory_order_relaxed) != expected){
+            reader.dropped++; // overwritten while copying
+            continue;
+        }
+        count++;
+    }
+    return count;
+}
+
+bool telemetry_bus_closed(const TelemetryBusReader& reader){
+    return ((const volatile TelemetryBusHeader*)reader.header)->closed != 0 && reader.cursor == reader.header->write_index.load(std::memory_order_acquire);
+}
+
+void telemetry_bus_detach(TelemetryBusReader& reader){
+    if(reader.memory != nullptr){
+        munmap(reader.memory, reader.size);
+    }
+    if(reader.fd >= 0){
+        close(reader.fd);
+    }
+    reader = TelemetryBusReader{};
+}
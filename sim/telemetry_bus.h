@@ -0,0 +1,103 @@
+// Shared-memory telemetry bus: single producer (sim, sim_link, replay), any number of consumers (scripts/telemetry_bus.py,
+// or C++ through TelemetryBusReader). The producer writes every controller invocation as a fixed-size frame in place
+// into a POSIX shared-memory ring (/dev/shm/<name>) and never waits for consumers: each slot is guarded by a sequence
+// number (odd while being written, 2 * index + 2 once frame number index is complete), so consumers that fall more
+// than capacity frames behind, or read a slot while it is overwritten, count the frames as dropped instead of
+// slowing down the simulation.
+#ifndef __SIM_TELEMETRY_BUS_H__
+#define __SIM_TELEMETRY_BUS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+extern "C" {
+#include "firmware/stabilizer_types.h"
+}
+
+#define TELEMETRY_BUS_DEFAULT_NAME "/rl_tools_telemetry"
+#define TELEMETRY_BUS_DEFAULT_CAPACITY 65536 // frames, power of two (~12 MB)
+#define TELEMETRY_BUS_MAGIC 0x4d4c4554 // "TELM"
+#define TELEMETRY_BUS_VERSION 1
+
+#define TELEMETRY_FLAG_SET_MOTORS (1 << 0) // learned controller active
+#define TELEMETRY_FLAG_INFERENCE (1 << 1) // the policy ran in this invocation
+
+// One controllerOutOfTree invocation; the layout is mirrored in scripts/telemetry_bus.py
+struct TelemetryFrame{
+    uint64_t tick;
+    uint64_t time_us;
+    // Vehicle state (simulation ground truth or recorded state estimate)
+    float position[3];
+    float linear_velocity[3];
+    float orientation[4]; // w, x, y, z
+    float angular_velocity[3]; // rad/s
+    // Controller internals
+    float state_input[13];
+    float action_output[4];
+    float target_pos[3];
+    uint16_t motor_cmd[4];
+    uint16_t motor_ratio[4]; // applied motor ratios M1..M4
+    float battery_voltage;
+    // Timing
+    float controller_us; // host wall time of the controllerOutOfTree call
+    uint32_t flags;
+};
+static_assert(sizeof(TelemetryFrame) == 176, "TelemetryFrame layout changed, update scripts/telemetry_bus.py");
+
+struct TelemetrySlot{
+    std::atomic<uint64_t> sequence;
+    TelemetryFrame frame;
+};
+
+struct TelemetryBusHeader{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t frame_size;
+    uint32_t capacity;
+    uint32_t closed; // set when the producer is done
+    std::atomic<uint64_t> write_index; // frames published
+    uint8_t padding[40];
+};
+static_assert(sizeof(TelemetryBusHeader) == 64, "TelemetryBusHeader layout changed, update scripts/telemetry_bus.py");
+
+struct TelemetryBus{
+    int fd = -1;
+    void* memory = nullptr;
+    size_t size = 0;
+    TelemetryBusHeader* header = nullptr;
+    TelemetrySlot* slots = nullptr;
+    uint64_t index = 0;
+};
+
+// Replaces an existing bus of the same name (attached consumers keep the old one, which is marked closed)
+bool telemetry_bus_create(TelemetryBus& bus, const char* name, uint32_t capacity);
+// Returns the slot of the next frame to be filled in place; published by telemetry_bus_commit
+TelemetryFrame* telemetry_bus_begin(TelemetryBus& bus);
+void telemetry_bus_commit(TelemetryBus& bus);
+// Marks the bus closed and unmaps it; the shared memory stays until the next create of the same name
+void telemetry_bus_close(TelemetryBus& bus);
+// Publishes the controllerOutOfTree invocation that just returned: the state it was given, the global controller
+// context (rl_tools_controller_context_global) and the motor ratios
+void telemetry_bus_publish_controller(TelemetryBus& bus, uint32_t tick, uint64_t time_us, const state_t& state, const sensorData_t& sensors, float battery_voltage, float controller_us);
+
+struct TelemetryBusReader{
+    int fd = -1;
+    void* memory = nullptr;
+    size_t size = 0;
+    const TelemetryBusHeader* header = nullptr;
+    const TelemetrySlot* slots = nullptr;
+    uint64_t cursor = 0;
+    uint64_t dropped = 0;
+};
+
+// Attaches to a bus, starting at the next published frame or, with history, at the oldest frame still in the ring
+bool telemetry_bus_attach(TelemetryBusReader& reader, const char* name, bool history);
+// Copies up to max_frames consistent frames, returns their number (0 if nothing new)
+size_t telemetry_bus_read(TelemetryBusReader& reader, TelemetryFrame* frames, size_t max_frames);
+// True once the producer closed the bus and every frame was read
+bool telemetry_bus_closed(const TelemetryBusReader& reader);
+void telemetry_bus_detach(TelemetryBusReader& reader);
+
+#endif
@@ -0,0 +1,18 @@
+// Firmware receiver of the broadcast swarm setpoints (swarm_setpoint.h). The commander's META_COMMAND decoder belongs to
+// the firmware, so the packets travel on the app channel (CRTP_PORT_PLATFORM, channel 2) and this app task hands them
+// to the controller. Only built with CONFIG_APP_ENABLE (make SWARM_APP=1, see Makefile); the host simulation compiles
+// it against stand-in headers. The host tools call rl_tools_controller_swarm_packet_received (sim_link) or the context
+// variant (swarm) directly.
+#include "app.h"
+#include "app_channel.h"
+#include "rl_tools_controller.h"
+
+void appMain(void){
+  uint8_t packet[APPCHANNEL_MTU];
+  while(1){
+    size_t size = appchannelReceiveDataPacket(packet, sizeof(packet), APPCHANNEL_WAIT_FOREVER);
+    if(size > 0){
+      rl_tools_controller_swarm_packet_received(packet, (uint8_t)size);
+    }
+  }
+}
@@ -0,0 +1,51 @@
+#include "swarm_setpoint.h"
+#include <math.h>
+
+static int32_t quantize(float value, float scale, int32_t limit){
+  float q = roundf(value / scale);
+  if(q > limit){
+    return limit;
+  }
+  if(q < -limit){
+    return -limit;
+  }
+  return (int32_t)q;
+}
+
+uint8_t swarm_setpoint_pack(uint8_t* packet, uint8_t frame, uint8_t first_id, const swarm_setpoint_target_t* targets, uint8_t count){
+  if(count > SWARM_SETPOINT_SLOTS){
+    count = SWARM_SETPOINT_SLOTS;
+  }
+  packet[0] = SWARM_SETPOINT_PACKET_TYPE;
+  packet[1] = frame;
+  packet[2] = first_id;
+  for(uint8_t slot_i = 0; slot_i < count; slot_i++){
+    uint8_t* slot = packet + SWARM_SETPOINT_HEADER_SIZE + slot_i * SWARM_SETPOINT_SLOT_SIZE;
+    for(uint8_t axis_i = 0; axis_i < 3; axis_i++){
+      uint16_t position = (uint16_t)(int16_t)quantize(targets[slot_i].position[axis_i], SWARM_SETPOINT_POSITION_SCALE, INT16_MAX);
+      slot[2 * axis_i] = position & 0xFF;
+      slot[2 * axis_i + 1] = position >> 8;
+      slot[6 + axis_i] = (uint8_t)(int8_t)quantize(targets[slot_i].velocity[axis_i], SWARM_SETPOINT_VELOCITY_SCALE, INT8_MAX);
+    }
+  }
+  return SWARM_SETPOINT_HEADER_SIZE + count * SWARM_SETPOINT_SLOT_SIZE;
+}
+
+bool swarm_setpoint_unpack(const uint8_t* packet, uint8_t size, uint8_t id, uint8_t* frame, swarm_setpoint_target_t* target){
+  if(size < SWARM_SETPOINT_HEADER_SIZE || packet[0] != SWARM_SETPOINT_PACKET_TYPE){
+    return false;
+  }
+  uint8_t slot_i = id - packet[2];
+  uint32_t offset = SWARM_SETPOINT_HEADER_SIZE + (uint32_t)slot_i * SWARM_SETPOINT_SLOT_SIZE;
+  if(slot_i >= SWARM_SETPOINT_SLOTS || offset + SWARM_SETPOINT_SLOT_SIZE > size){
+    return false;
+  }
+  const uint8_t* slot = packet + offset;
+  *frame = packet[1];
+  for(uint8_t axis_i = 0; axis_i < 3; axis_i++){
+    int16_t position = (int16_t)(slot[2 * axis_i] | slot[2 * axis_i + 1] << 8);
+    target->position[axis_i] = position * SWARM_SETPOINT_POSITION_SCALE;
+    target->velocity[axis_i] = (int8_t)slot[6 + axis_i] * SWARM_SETPOINT_VELOCITY_SCALE;
+  }
+  return true;
+}
@@ -0,0 +1,34 @@
+#ifndef __SWARM_SETPOINT_H__
+#define __SWARM_SETPOINT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Broadcast setpoints for a swarm: one app channel packet (CRTP_PORT_PLATFORM channel 2, received by swarm_app.c)
+// carries the position and velocity targets of up to SWARM_SETPOINT_SLOTS consecutive drone ids, so a frame for N
+// vehicles is ceil(N / 3) packets instead of a setpoint and a trigger packet per vehicle. Layout (little endian,
+// 30 bytes when full):
+//   [0]  SWARM_SETPOINT_PACKET_TYPE
+//   [1]  frame id, the same in all packets of a frame and incremented per frame (wraps)
+//   [2]  drone id of the first slot
+//   [3 + 9 * slot]  x, y, z  int16 [mm]   vx, vy, vz  int8 [SWARM_SETPOINT_VELOCITY_SCALE m/s]
+// A vehicle decodes its slot at offset 3 + 9 * (id - first id) (O(1), independent of the swarm size).
+#define SWARM_SETPOINT_PACKET_TYPE 2 // tells the packet apart from other app channel traffic
+#define SWARM_SETPOINT_HEADER_SIZE 3
+#define SWARM_SETPOINT_SLOT_SIZE 9
+#define SWARM_SETPOINT_SLOTS 3 // (CRTP_MAX_DATA_SIZE - SWARM_SETPOINT_HEADER_SIZE) / SWARM_SETPOINT_SLOT_SIZE
+#define SWARM_SETPOINT_POSITION_SCALE 0.001f // [m], +-32.7 m
+#define SWARM_SETPOINT_VELOCITY_SCALE 0.02f // [m/s], +-2.54 m/s
+
+typedef struct {
+  float position[3]; // [m]
+  float velocity[3]; // [m/s]
+} swarm_setpoint_target_t;
+
+// Host side: packs the targets of ids first_id .. first_id + count - 1 (count <= SWARM_SETPOINT_SLOTS, saturating
+// quantization) and returns the packet size
+uint8_t swarm_setpoint_pack(uint8_t* packet, uint8_t frame, uint8_t first_id, const swarm_setpoint_target_t* targets, uint8_t count);
+// Vehicle side: false if the packet is no swarm setpoint or carries no slot for id
+bool swarm_setpoint_unpack(const uint8_t* packet, uint8_t size, uint8_t id, uint8_t* frame, swarm_setpoint_target_t* target);
+
+#endif